@@ -39,11 +39,34 @@
 #define DEFAULT_PULSE_WIDTH 5   // Default PWM pulse width in us
 #define DEFAULT_PAGES       16  // Number of pages for each control
                                 // block sequence
+#define DEFAULT_RING_BUFS   4   // Number of control block buffers
+                                // in each channel's ring
 
 #define MOTOR_PULSE_WIDTH 0.4   // Motor PWM pulse width in us
 #define SERVO_PULSE_WIDTH 50    // Servo PWM pulse width in us
 #define LED_PULSE_WIDTH   5000  // LED PWM pulse width in us
 
+#define DEFAULT_CAPTURE_WINDOW 100000 // Default capture sliding window in us
+
+#define DEFAULT_DMA_PRIO    7  // Default AXI bus priority and panic priority
+#define DEFAULT_FIFO_THRESH 15 // Default PWM FIFO DREQ and panic thresholds
+
+#define IMAGE_PWM_MAGIC   "DMAPWMIM" // Signal image magic (8 bytes)
+#define IMAGE_PWM_VERSION 1          // Signal image format version
+
+// Channel events (see read_events_pwm()):
+#define EVENT_UPDATE   0 // Queued PWM signal reached by the DMA
+#define EVENT_BURST    1 // CB chain ran to its end
+#define EVENT_STALL    2 // Control block not moving on for the stall time
+#define EVENT_RECOVER  3 // Stalled channel moving on again
+#define EVENT_CAPTURE  4 // Capture sample block ready to be decoded
+#define EVENT_UNDERRUN 5 // Capture samples lost or serializer FIFO ran dry
+
+// Link addresses of signal image CB programs (relocated when loaded):
+#define IMAGE_PWM_CB_ADDR    0x10000000 // First CB of a program
+#define IMAGE_PWM_SET_ADDR   0x0FFFFFF0 // GPIO set mask
+#define IMAGE_PWM_CLEAR_ADDR 0x0FFFFFF8 // GPIO clear mask
+
 // Error numbers:
 #define ECHNLREQ    1  // At least one channel has been requested
 #define EINVPW      2  // Invalid pulse width
@@ -56,6 +79,20 @@
 #define ENOPIVER    9  // Could not get PI board revision
 #define EMAPFAIL    10 // Peripheral memory mapping failed
 #define ESIGHDNFAIL 11 // Signal handler failed to setup 
+#define EINVWIN     12 // Invalid capture window
+#define ENOTCAPTURE 13 // Channel or GPIO is not set up for input capture
+#define EINVRANGE   14 // Invalid ranging trigger, listen window or interval
+#define ENOTRANGE   15 // Channel or sensor is not set up for ranging
+#define ECALFAIL    16 // CB overhead calibration did not complete
+#define EINVBUS     17 // Invalid bus priority or FIFO threshold
+#define EBUSBUDGET  18 // Bus transfer budget exceeded
+#define ECLKBUSY    19 // General purpose clock used by another channel
+#define EFIFOBUSY   20 // PWM FIFO used by another channel
+#define EINVRING    21 // Invalid number of CB buffers
+#define EIMAGEIO    22 // Signal image could not be read or written
+#define EINVIMAGE   23 // Invalid signal image or not for this board
+#define EINVEVENT   24 // Invalid event interval or stall time
+#define EEVENTFD    25 // Event fd could not be created or is not open
 
 // Structure definitions:
 struct reg_pwm {
@@ -68,16 +105,135 @@ struct reg_pwm {
     uint32_t dma_debug;     // Debug
 };
 
+struct capture_pwm {
+    float freq;       // Measured frequency in Hz
+    float duty_cycle; // Measured duty cycle in percent
+    uint64_t pulses;  // Rising edges counted since capture was set
+    uint8_t level;    // Last sampled level
+    uint8_t overrun;  // Samples were lost since last call
+};
+
+struct edge_pwm {
+    uint64_t tick;  // Sample tick of edge since capture was set
+    double time_us; // Time of edge in us since capture was set
+    int gpio;       // BCM GPIO pin
+    uint8_t level;  // Level after edge
+};
+
+struct range_pwm {
+    float echo_us;   // Echo pulse width in us
+    float delay_us;  // Time from end of trigger to echo rising edge in us
+    uint8_t done;    // Sensor has been sampled since ranging was enabled
+    uint8_t timeout; // No complete echo within the listen window
+};
+
+struct cache_pwm {
+    uint64_t hits;   // set_pwm() calls finding their sequence cached
+    uint64_t misses; // set_pwm() calls building their sequence
+    size_t entries;  // Cached sequences
+    size_t bytes;    // Memory of cached sequences
+};
+
+struct merge_pwm {
+    int *gpio;            // BCM GPIO pins of the signal
+    size_t num_gpio;      // Number of GPIO pins
+    float freq;           // Desired frequency in Hz
+    float duty_cycle;     // Desired duty cycle in percent
+    float freq_act;       // Actual frequency in Hz
+    float duty_cycle_act; // Actual duty cycle in percent
+};
+
+struct merge_size_pwm {
+    float period_us;       // Period of the merged sequence in us
+    size_t edges;          // GPIO set and clear CBs per period
+    size_t cbs;            // CBs of the merged sequence
+    size_t merged_bytes;   // Memory of the merged sequence
+    size_t separate_bytes; // Memory of the signals on channels of their own
+    size_t buffer_bytes;   // Memory of a CB buffer
+    uint8_t worthwhile;    // Merged sequence fits and takes less memory
+};
+
+struct image_pwm_header {
+    char magic[8];         // IMAGE_PWM_MAGIC
+    uint32_t version;      // IMAGE_PWM_VERSION
+    uint32_t pi_version;   // Board version compiled for
+    uint32_t pages;        // Pages allocated per CB buffer
+    uint32_t clock_div;    // PWM clock divisor
+    uint32_t pwm_rng;      // PWM range
+    float pulse_width;     // Pulse width in us
+    float cb_overhead;     // CB overhead in us the signals were planned with
+    uint32_t num_channels; // Channel records following the header
+};
+
+struct image_pwm_channel {
+    uint64_t mask;        // GPIOs (bit n for BCM GPIO n)
+    uint32_t offset;      // CB program offset from the image start
+    uint32_t num_cbs;     // CBs in the program
+    uint32_t cb_seq_num;  // CB sequence length
+    uint32_t cb_set_num;  // "Wait" CBs while GPIOs set
+    uint32_t cb_clr_num;  // "Wait" CBs while GPIOs clear
+    uint32_t t_sub_us;    // Period in us
+    uint32_t ti;          // Transfer information shared by the CBs
+    uint32_t gpio_len;    // Length of GPIO set and clear CBs
+    uint8_t compressed;   // "Wait" CBs span many pulse widths
+    uint8_t prio;         // AXI bus priority
+    uint8_t panic_prio;   // AXI bus panic priority
+    uint8_t res;          // Reserved
+    float freq;           // Desired frequency in Hz
+    float freq_act;       // Actual frequency in Hz
+    float duty_cycle;     // Desired duty cycle in percent
+    float duty_cycle_act; // Actual duty cycle in percent
+    float bus_rate;       // Bus transfers per second
+};
+
+struct bus_pwm {
+    uint8_t prio;        // AXI bus priority (0 to 15)
+    uint8_t panic_prio;  // AXI bus panic priority (0 to 15)
+    uint8_t wide_bursts; // Allow writes as 2 beat bursts
+    uint8_t wait_resp;   // Wait for a response to each write
+};
+
+struct event_pwm {
+    int channel; // Requested channel
+    int type;    // Event (EVENT_UPDATE to EVENT_UNDERRUN)
+};
+
+struct migrate_pwm {
+    int dma_channel;      // DMA engine now running the channel
+    float latency_us;     // Time from the call until the old engine stopped
+    float phase_error_us; // Most the new engine lags behind the old one
+                          // (-1 if not known)
+};
+
 // Set memory usage and pulse width
 float config_pwm(int pages, float pulse_width);
 
+// Set number of CB buffers each channel cycles through:
+int config_ring_pwm(int num_bufs);
+
 // Request an available DMA channel to use for PWM:
 int request_pwm();
 
+// Keep buffers of a number of channels allocated across requests:
+int pool_pwm(int num_channels);
+
 // Setup a PWM signal for a requested channel
 int set_pwm(int channel, int *gpio, size_t num_gpio, \
     float freq, float duty_cycle);
 
+// Merge PWM signals into one sequence of a requested channel
+int set_merge_pwm(int channel, struct merge_pwm *signals, \
+    size_t num_signals);
+
+// Estimate memory of merging PWM signals on a requested channel
+int estimate_merge_pwm(int channel, struct merge_pwm *signals, \
+    size_t num_signals, struct merge_size_pwm *size);
+
+// Setup a PWM signal timed by DMA writes of the PWM range for a requested
+// channel
+int set_timebase_pwm(int channel, int *gpio, size_t num_gpio, \
+    float freq, float duty_cycle);
+
 // Enable PWM output for a requested channel
 int enable_pwm(int channel);
 
@@ -90,12 +246,96 @@ float get_freq_pwm(int channel);
 // Get PWM pulse width:
 float get_pulse_width();
 
+// Measure the duration of an unpaced CB on this board
+float calibrate_pwm(int channel);
+
+// Get measured duration of an unpaced CB
+float get_cb_overhead_pwm();
+
+// Get sample period of input capture and ranging in us
+float get_sample_tick_pwm();
+
 // Disable PWM output for a requested channel
 int disable_pwm(int channel);
 
 // Clean-up
 int free_pwm(int channel);
 
+// Move a requested channel to a free DMA engine without dropping its output
+int migrate_pwm(int channel, struct migrate_pwm *migrate);
+
+// Setup input capture for a requested channel
+int set_capture_pwm(int channel, int *gpio, size_t num_gpio, float window);
+
+// Get measured input signal properties of a captured GPIO
+int get_capture_pwm(int channel, int gpio, struct capture_pwm *capture);
+
+// Read edges of captured GPIOs in order of occurrence
+int read_capture_pwm(int channel, struct edge_pwm *edges, size_t max_edges);
+
+// Setup ultrasonic ranging for a requested channel
+int set_range_pwm(int channel, int *trig_gpio, int *echo_gpio, \
+    size_t num_sensors, float pulse, int cycles, float listen, \
+    float interval);
+
+// Get echo of a ranging sensor
+int get_range_pwm(int channel, int sensor, struct range_pwm *range);
+
+// Setup a general purpose clock output for a requested channel
+int set_clock_pwm(int channel, int gpio, float freq);
+
+// Setup a serializer output of PWM channel 1 for a requested channel
+int set_serial_pwm(int channel, int gpio, float freq, float duty_cycle);
+
+// Set bus priority and transfer settings of a requested channel
+int set_bus_pwm(int channel, struct bus_pwm *bus);
+
+// Get bus priority and transfer settings of a requested channel
+int get_bus_pwm(int channel, struct bus_pwm *bus);
+
+// Allow signals on a PWM channel 2 GPIO to be passed through to it
+int set_passthrough_pwm(int channel, int enable);
+
+// Allow signals on the SPI MOSI GPIO to be streamed through SPI0
+int set_spi_engine_pwm(int channel, int enable);
+
+// Set sequence cache memory cap of a requested channel
+int set_cache_pwm(int channel, size_t max_bytes);
+
+// Build a PWM signal into the sequence cache without setting it
+int preload_pwm(int channel, int *gpio, size_t num_gpio, \
+    float freq, float duty_cycle);
+
+// Get sequence cache statistics of a requested channel
+int get_cache_pwm(int channel, struct cache_pwm *cache);
+
+// Set PWM FIFO DREQ and panic thresholds shared by all channels
+int set_fifo_pwm(int dreq, int panic);
+
+// Set bus transfers per second allowed for all channels (0 = unlimited)
+int set_bus_budget_pwm(float budget);
+
+// Get bus transfers per second of a channel
+float get_bus_load_pwm(int channel);
+
+// Get bus transfers per second of all channels
+float get_bus_total_pwm();
+
+// Save PWM signals of requested channels as a signal image
+int save_image_pwm(const char *path, int *channels, size_t num_channels);
+
+// Start the PWM signals of a signal image on newly requested channels
+int load_image_pwm(const char *path, int *channels, size_t max_channels);
+
+// Open a pollable fd for channel events
+int open_events_pwm(float interval_us, float stall_us);
+
+// Read channel events once the event fd is readable
+int read_events_pwm(struct event_pwm *events, size_t max_events);
+
+// Close the event fd
+int close_events_pwm();
+
 // Get register status for debugging:
 struct reg_pwm get_reg_pwm(int channel);
 
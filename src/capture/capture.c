@@ -0,0 +1,434 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdint.h> // C Standard integer types
+#include <string.h> // C Standard string manipulation libary
+
+// Include header files:
+#include "dma_pwm.h" // PWM via DMA
+#include "capture.h" // Input capture decoding
+#include "kernels.h" // Hot kernels
+
+// Allocate capture decoding state:
+struct capture_state *capture_init__(int *gpio, size_t num_gpio, \
+    size_t window) {
+    // Definitions:
+    size_t i;
+
+    struct capture_state *state; // Capture decoding state
+
+    // Allocate state and captured GPIOs:
+    state = calloc(1, sizeof(struct capture_state));
+
+    // Check success:
+    if (state == NULL) {
+        // Exit with error:
+        return NULL;
+    }
+
+    state->pins = calloc(num_gpio, sizeof(struct capture_pin));
+    state->edges = calloc(CAPTURE_EDGE_QUEUE, sizeof(struct capture_edge));
+
+    // Check success:
+    if ((state->pins == NULL) || (state->edges == NULL)) {
+        // Clean-up:
+        free(state->pins);
+        free(state->edges);
+        free(state);
+
+        // Exit with error:
+        return NULL;
+    }
+
+    // Set window and GPIOs:
+    state->num_gpio = num_gpio;
+    state->window = window;
+
+    // No sample bit is captured until assigned:
+    for (i = 0; i < 32; i++) {
+        state->pin_index[i] = -1;
+    }
+
+    // Set up each captured GPIO:
+    for (i = 0; i < num_gpio; i++) {
+        // Allocate window blocks:
+        state->pins[i].gpio = gpio[i];
+        state->pins[i].blk_periods = calloc(window, sizeof(uint32_t));
+        state->pins[i].blk_period_ticks = calloc(window, sizeof(uint64_t));
+        state->pins[i].blk_high_ticks = calloc(window, sizeof(uint64_t));
+
+        // Check success:
+        if ((state->pins[i].blk_periods == NULL) || \
+           (state->pins[i].blk_period_ticks == NULL) || \
+           (state->pins[i].blk_high_ticks == NULL)) {
+            // Clean-up:
+            state->num_gpio = i + 1;
+            capture_free__(state);
+
+            // Exit with error:
+            return NULL;
+        }
+
+        // Map sample bit to GPIO and append to mask:
+        state->pin_index[gpio[i] % 32] = i;
+        state->mask |= (1u << (gpio[i] % 32));
+    }
+
+    // Exit with state:
+    return state;
+}
+
+// Free capture decoding state:
+void capture_free__(struct capture_state *state) {
+    // Definitions:
+    size_t i;
+
+    // Nothing to free:
+    if (state == NULL) {
+        // Exit:
+        return;
+    }
+
+    // Free window blocks of each captured GPIO:
+    for (i = 0; i < state->num_gpio; i++) {
+        free(state->pins[i].blk_periods);
+        free(state->pins[i].blk_period_ticks);
+        free(state->pins[i].blk_high_ticks);
+    }
+
+    // Free state:
+    free(state->pins);
+    free(state->edges);
+    free(state);
+}
+
+// Forget edge history (lost = samples were lost):
+// (window statistics are kept as they describe complete periods)
+void capture_resync__(struct capture_state *state, int lost) {
+    // Definitions:
+    size_t i;
+
+    // Next sample primes the decoder again:
+    state->primed = 0;
+
+    // Invalidate edges of each captured GPIO:
+    for (i = 0; i < state->num_gpio; i++) {
+        state->pins[i].rise_valid = 0;
+        state->pins[i].fall_valid = 0;
+        state->pins[i].overrun |= (lost != 0);
+    }
+}
+
+// Queue an edge (oldest edge is dropped if the queue is full):
+static void queue_edge(struct capture_state *state, struct capture_pin *pin, \
+    uint8_t level) {
+    // Definitions:
+    struct capture_edge *edge; // Queued edge
+
+    // Drop oldest edge if full:
+    if (state->edge_num == CAPTURE_EDGE_QUEUE) {
+        // Edges were lost:
+        state->edge_head = (state->edge_head + 1) % CAPTURE_EDGE_QUEUE;
+        state->edge_num--;
+        pin->overrun = 1;
+    }
+
+    // Append edge:
+    edge = &state->edges[(state->edge_head + state->edge_num) % \
+        CAPTURE_EDGE_QUEUE];
+    edge->tick = state->tick;
+    edge->gpio = pin->gpio;
+    edge->level = level;
+    state->edge_num++;
+}
+
+// Slide window by one block for a captured GPIO:
+static void slide_window(struct capture_state *state, \
+    struct capture_pin *pin) {
+    // Definitions:
+    size_t head; // Window block to overwrite
+
+    // Get window block to overwrite:
+    head = state->win_head;
+
+    // Subtract oldest block if window is full:
+    if (state->win_blocks == state->window) {
+        pin->win_periods -= pin->blk_periods[head];
+        pin->win_period_ticks -= pin->blk_period_ticks[head];
+        pin->win_high_ticks -= pin->blk_high_ticks[head];
+    }
+
+    // Store current block:
+    pin->blk_periods[head] = pin->cur_periods;
+    pin->blk_period_ticks[head] = pin->cur_period_ticks;
+    pin->blk_high_ticks[head] = pin->cur_high_ticks;
+
+    // Add current block:
+    pin->win_periods += pin->cur_periods;
+    pin->win_period_ticks += pin->cur_period_ticks;
+    pin->win_high_ticks += pin->cur_high_ticks;
+
+    // Reset current block:
+    pin->cur_periods = 0;
+    pin->cur_period_ticks = 0;
+    pin->cur_high_ticks = 0;
+}
+
+// Decode a block of samples and slide the window by one block:
+void capture_block__(struct capture_state *state, \
+    volatile uint32_t *samples, size_t num_samples) {
+    // Definitions:
+    size_t i;
+    size_t start;    // First sample of copied block
+    size_t num_copy; // Number of copied samples
+    size_t skip;     // Number of samples without edges
+
+    int bit;         // Changed sample bit
+    uint32_t sample; // GPIO level sample
+    uint32_t diff;   // Changed captured GPIOs
+
+    uint32_t block[CAPTURE_BLOCK_SAMPLES]; // Cached copy of samples
+
+    struct capture_pin *pin; // Captured GPIO
+
+    // Decode each block of samples:
+    for (start = 0; start < num_samples; start += num_copy) {
+        // Copy block out of uncached memory in wide reads:
+        num_copy = num_samples - start;
+
+        if (num_copy > CAPTURE_BLOCK_SAMPLES) {
+            num_copy = CAPTURE_BLOCK_SAMPLES;
+        }
+
+        copy_from_uncached__(block, samples + start, num_copy);
+
+        // Decode each sample:
+        for (i = 0; i < num_copy; i++) {
+            // First sample only sets levels:
+            if (!(state->primed)) {
+                // Prime:
+                state->last_sample = block[i];
+                state->primed = 1;
+                state->tick++;
+
+                // Next sample:
+                continue;
+            }
+
+            // Skip samples without edges on captured GPIOs (only captured
+            // GPIO levels of the last sample are used):
+            skip = find_change__(block + i, num_copy - i, \
+                state->last_sample, state->mask);
+            state->tick += skip;
+            i += skip;
+
+            if (i == num_copy) {
+                // Next block:
+                break;
+            }
+
+            // Find captured GPIOs that changed level:
+            sample = block[i];
+            diff = (sample ^ state->last_sample) & state->mask;
+
+            // Process each edge:
+            while (diff) {
+                // Get lowest changed bit and its GPIO:
+                bit = __builtin_ctz(diff);
+                diff &= diff - 1;
+                pin = &state->pins[state->pin_index[bit]];
+
+                // Queue edge:
+                queue_edge(state, pin, (sample >> bit) & 0x01);
+
+                // Rising edge closes a period:
+                if ((sample >> bit) & 0x01) {
+                    // Accumulate period if both edges of it were seen:
+                    if (pin->rise_valid && pin->fall_valid) {
+                        pin->cur_periods++;
+                        pin->cur_period_ticks += state->tick - pin->last_rise;
+                        pin->cur_high_ticks += pin->last_fall - \
+                            pin->last_rise;
+                    }
+
+                    // Start new period:
+                    pin->last_rise = state->tick;
+                    pin->rise_valid = 1;
+                    pin->fall_valid = 0;
+                    pin->pulses++;
+                // Falling edge ends the high time of the period:
+                } else if (pin->rise_valid) {
+                    // Set falling edge:
+                    pin->last_fall = state->tick;
+                    pin->fall_valid = 1;
+                }
+            }
+
+            // Update:
+            state->last_sample = sample;
+            state->tick++;
+        }
+    }
+
+    // Slide window of each captured GPIO:
+    for (i = 0; i < state->num_gpio; i++) {
+        slide_window(state, &state->pins[i]);
+    }
+
+    // Advance window:
+    state->win_head = (state->win_head + 1) % state->window;
+
+    // Window fills up until full:
+    if (state->win_blocks < state->window) {
+        state->win_blocks++;
+    }
+}
+
+// Get measured signal properties of a captured GPIO:
+int capture_get__(struct capture_state *state, int gpio, float tick_us, \
+    struct capture_pwm *capture) {
+    // Definitions:
+    size_t i;
+
+    struct capture_pin *pin = NULL; // Captured GPIO
+
+    // Find captured GPIO:
+    for (i = 0; i < state->num_gpio; i++) {
+        // Check match:
+        if (state->pins[i].gpio == gpio) {
+            // Set:
+            pin = &state->pins[i];
+
+            // Exit loop:
+            break;
+        }
+    }
+
+    // Abort if GPIO is not captured:
+    if (pin == NULL) {
+        // Exit with error:
+        return -1;
+    }
+
+    // Clear properties:
+    memset(capture, 0, sizeof(struct capture_pwm));
+
+    // Level of last decoded sample:
+    capture->level = (state->last_sample >> (gpio % 32)) & 0x01;
+
+    // Frequency and duty cycle over complete periods in the window:
+    if (pin->win_periods) {
+        capture->freq = pin->win_periods / \
+            (pin->win_period_ticks * tick_us * 1e-6);
+        capture->duty_cycle = \
+            100.0 * pin->win_high_ticks / pin->win_period_ticks;
+    // No complete period; duty cycle follows a constant level:
+    } else {
+        capture->duty_cycle = capture->level ? 100 : 0;
+    }
+
+    // Pulses counted and lost samples:
+    capture->pulses = pin->pulses;
+    capture->overrun = pin->overrun;
+
+    // Clear lost samples as they have been reported:
+    pin->overrun = 0;
+
+    // Exit with success:
+    return 0;
+}
+
+// Read queued edges of all captured GPIOs:
+size_t capture_read__(struct capture_state *state, float tick_us, \
+    struct edge_pwm *edges, size_t max_edges) {
+    // Definitions:
+    size_t i;
+
+    struct capture_edge *edge; // Queued edge
+
+    // Read up to the number of queued edges:
+    for (i = 0; (i < max_edges) && (state->edge_num > 0); i++) {
+        // Get oldest edge:
+        edge = &state->edges[state->edge_head];
+
+        // Copy out:
+        edges[i].tick = edge->tick;
+        edges[i].time_us = edge->tick * (double)tick_us;
+        edges[i].gpio = edge->gpio;
+        edges[i].level = edge->level;
+
+        // Remove from queue:
+        state->edge_head = (state->edge_head + 1) % CAPTURE_EDGE_QUEUE;
+        state->edge_num--;
+    }
+
+    // Exit with number of edges read:
+    return i;
+}
+
+// Find the first complete pulse of a GPIO in a sample sequence:
+// (a rising edge after a low sample followed by a falling edge, so a level
+// already high at the first sample is not taken as a pulse)
+int capture_pulse__(volatile uint32_t *samples, size_t num_samples, int gpio, \
+    size_t *rise, size_t *fall) {
+    // Definitions:
+    size_t i;
+
+    uint8_t level;    // Sampled level
+    uint8_t low = 0;  // Low level observed
+    uint8_t high = 0; // Rising edge observed
+
+    for (i = 0; i < num_samples; i++) {
+        // Get level:
+        level = (samples[i] >> gpio) & 0x01;
+
+        if (!(level)) {
+            // Falling edge completes the pulse:
+            if (high) {
+                *fall = i;
+
+                // Exit with pulse found:
+                return 1;
+            }
+
+            low = 1;
+        } else if (low && !(high)) {
+            // Rising edge:
+            *rise = i;
+            high = 1;
+        }
+    }
+
+    // Exit with no complete pulse:
+    return 0;
+}
@@ -0,0 +1,115 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Number of samples in a capture block:
+#define CAPTURE_BLOCK_SAMPLES 64
+
+// Number of edges queued for reading:
+#define CAPTURE_EDGE_QUEUE 4096
+
+// Queued edge:
+struct capture_edge {
+    uint64_t tick; // Sample tick of edge
+    int gpio;      // BCM GPIO pin
+    uint8_t level; // Level after edge
+};
+
+// Captured GPIO decoding state:
+struct capture_pin {
+    int gpio; // BCM GPIO pin
+
+    uint8_t rise_valid; // Rising edge observed since last resync
+    uint8_t fall_valid; // Falling edge observed since last rising edge
+
+    uint64_t last_rise; // Sample tick of last rising edge
+    uint64_t last_fall; // Sample tick of last falling edge
+    uint64_t pulses;    // Rising edges counted
+    uint8_t overrun;    // Samples were lost since last read
+
+    uint32_t cur_periods;      // Complete periods in current block
+    uint64_t cur_period_ticks; // Ticks of complete periods in current block
+    uint64_t cur_high_ticks;   // High ticks of complete periods in current
+                               // block
+
+    uint32_t *blk_periods;      // Complete periods per window block
+    uint64_t *blk_period_ticks; // Period ticks per window block
+    uint64_t *blk_high_ticks;   // High ticks per window block
+
+    uint64_t win_periods;      // Complete periods in the window
+    uint64_t win_period_ticks; // Period ticks in the window
+    uint64_t win_high_ticks;   // High ticks in the window
+};
+
+// Input capture decoding state:
+struct capture_state {
+    size_t num_gpio;          // Number of captured GPIOs
+    struct capture_pin *pins; // Captured GPIOs
+    int pin_index[32];        // Sample bit to captured GPIO index (-1 = none)
+    uint32_t mask;            // Sample mask of captured GPIOs
+
+    size_t window;     // Number of blocks in the sliding window
+    size_t win_head;   // Next window block to overwrite
+    size_t win_blocks; // Number of blocks currently in the window
+
+    uint64_t tick;        // Number of samples decoded
+    uint32_t last_sample; // Last decoded sample
+    uint8_t primed;       // At least one sample decoded since resync
+
+    struct capture_edge *edges; // Edge queue
+    size_t edge_head;           // Oldest queued edge
+    size_t edge_num;            // Number of queued edges
+};
+
+// Allocate capture decoding state
+struct capture_state *capture_init__(int *gpio, size_t num_gpio, \
+    size_t window);
+
+// Free capture decoding state
+void capture_free__(struct capture_state *state);
+
+// Forget edge history (lost = samples were lost)
+void capture_resync__(struct capture_state *state, int lost);
+
+// Decode a block of samples and slide the window by one block
+void capture_block__(struct capture_state *state, \
+    volatile uint32_t *samples, size_t num_samples);
+
+// Get measured signal properties of a captured GPIO
+int capture_get__(struct capture_state *state, int gpio, float tick_us, \
+    struct capture_pwm *capture);
+
+// Read queued edges of all captured GPIOs
+size_t capture_read__(struct capture_state *state, float tick_us, \
+    struct edge_pwm *edges, size_t max_edges);
+
+// Find the first complete pulse of a GPIO in a sample sequence
+int capture_pulse__(volatile uint32_t *samples, size_t num_samples, int gpio, \
+    size_t *rise, size_t *fall);
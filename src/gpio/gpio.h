@@ -32,13 +32,40 @@
 // Set GPIO function:
 #define GPIO_INP(addr, p) *(addr + ((p)/10)) &= ~(7 << (((p) % 10)*3)) // Input
 #define GPIO_OUT(addr, p) *(addr + ((p)/10)) |=  (1 << (((p) % 10)*3)) // Output
+#define GPIO_ALT(addr, p, f) \
+    *(addr + ((p)/10)) = (*(addr + ((p)/10)) & ~(7 << (((p) % 10)*3))) | \
+    ((f) << (((p) % 10)*3)) // Alternate function f
 
-// Set and clear GPIO:
-#define GPIO_SET(addr, p)   *(addr + 7)  = (1 << p)
-#define GPIO_CLEAR(addr, p) *(addr + 10) = (1 << p)
+#define GPIO_FSEL_ALT0 4 // Function select of alternate function 0
+#define GPIO_FSEL_ALT5 2 // Function select of alternate function 5
+
+// Set and clear GPIO (bank 0 for pins 0 to 31, bank 1 above):
+#define GPIO_SET(addr, p)   *(addr + 7 + ((p)/32))  = (1 << ((p) % 32))
+#define GPIO_CLEAR(addr, p) *(addr + 10 + ((p)/32)) = (1 << ((p) % 32))
 
 // GPIO level:
-#define GPIO_READ(addr, p) (*(addr + 13) & (1 << p))
+#define GPIO_READ(addr, p) (*(addr + 13 + ((p)/32)) & (1 << ((p) % 32)))
+
+// RP1 (Raspberry Pi 5) GPIOs of bank 0 are driven by registered IO (RIO):
+#define RP1_FUNCSEL_RIO 5        // IO_BANK0 function select of RIO
+#define RP1_PAD_IE      (1 << 6) // Pad input enable
+#define RP1_PAD_OD      (1 << 7) // Pad output disable
+
+// Select RIO function and enable pad (IO_BANK0 and PADS_BANK0):
+#define RP1_GPIO_RIO(ctrl, p) *(ctrl + 2*(p) + 1) = RP1_FUNCSEL_RIO
+#define RP1_PAD_EN(pads, p) \
+    *(pads + 1 + (p)) = ((*(pads + 1 + (p)) & ~RP1_PAD_OD) | RP1_PAD_IE)
+
+// Set RIO output enable (SET and CLR atomic aliases):
+#define RP1_GPIO_OUT(set, p) *(set + 1) = (1 << (p)) // Output
+#define RP1_GPIO_INP(clr, p) *(clr + 1) = (1 << (p)) // Input
+
+// Set and clear GPIO (SET and CLR atomic aliases):
+#define RP1_GPIO_SET(set, p)   *(set) = (1 << (p))
+#define RP1_GPIO_CLEAR(clr, p) *(clr) = (1 << (p))
+
+// GPIO level (RIO synchronized input):
+#define RP1_GPIO_READ(rio, p) (*(rio + 2) & (1 << (p)))
 
 // Make GCC happy
 extern int make_iso_compilers_happy;
\ No newline at end of file
@@ -41,8 +41,10 @@
 #include <errno.h>  // C Standard for error conditions
 
 // Include C POSIX libraries:
-#include <sys/mman.h> // Memory management library
-#include <unistd.h>   // Symbolic constants and types library
+#include <sys/mman.h>    // Memory management library
+#include <sys/stat.h>    // File status library
+#include <sys/timerfd.h> // Timer file descriptor library
+#include <unistd.h>      // Symbolic constants and types library
 
 // Include header files:
 #include "dma_pwm.h"        // PWM via DMA
@@ -51,6 +53,8 @@
                             // (via mailbox) functions
 #include "get_pi_version.h" // Get PI board revision
 #include "map_peripheral.h" // Map peripherals into memory
+#include "capture.h"        // Input capture decoding
+#include "kernels.h"        // Hot kernels
 
 // Check if debug logs are enabled:
 #ifndef DEBUG
@@ -72,27 +76,59 @@
 #define BCM2711_PERI_BASE_PHYS_ADDR 0xFE000000
 #define BCM2711_PERI_BASE_BUS_ADDR  0x7E000000
 
+#define RP1_PERI_BASE_PHYS_ADDR 0x1F00000000 // RP1 (Pi 5) behind PCIe
+#define RP1_PERI_BASE_BUS_ADDR  0x40000000   // As seen by the RP1 DMA
+
+// RP1 peripheral offsets:
+#define RP1_DMA       0x188000 // DMA controller
+#define RP1_PWM0      0x098000 // PWM0
+#define RP1_IO_BANK0  0x0D0000 // GPIO function select of bank 0
+#define RP1_SYS_RIO0  0x0E0000 // Registered IO of bank 0
+#define RP1_PADS_BANK0 0x0F0000 // GPIO pads of bank 0
+#define RP1_SET       0x2000   // Atomic set alias of a register
+#define RP1_CLR       0x3000   // Atomic clear alias of a register
+
 // PWM clock manager register offset:
 #define PWM_CLK 0xA0
 
+// General purpose clock manager register offsets (GPCLK0 to GPCLK2):
+#define GP_CLK(n) (0x70 + (8 * (n)))
+
 // Register Masks
 
 // PWM clock manager:
 #define CM_ENAB (1 << 4)     // Enable the clock generator
+#define CM_BUSY (1 << 7)     // Clock generator is running
 #define CM_BASE (0x5A << 24) // Password = 0x5a
+#define CM_MASH(m) (((m) & 0x3) << 9) // MASH noise shaping stages
+#define CM_DIVF_BITS 12                 // Fractional divisor bits
 
 // PWM controller:
 #define PWM_DMA_ENB      (1 << 31) // DMA enabled
 #define PWM_CLRF         (1 << 6)  // Clear FIFO buffer
 #define PWM_USEF         (1 << 5)  // FIFO used for transmission
 #define PWM_EN1          (1 << 0)  // Channel 1 enabled
-#define PWM_DREQ_THRESH  (15 << 0) // Threshold for data required signal
-#define PWM_PANIC_THRESH (15 << 8) // Threshold for panic signal
+#define PWM_MODE1        (1 << 1)  // Channel 1 serializer mode
+#define PWM_EN2          (1 << 8)  // Channel 2 enabled
+#define PWM_MSEN2        (1 << 15) // Channel 2 mark-space mode
+#define PWM_GAPO1        (1 << 4)  // Channel 1 gap occurred (status)
+#define PWM_DREQ_THRESH(t)  \
+    (((t) & 0xFF) << 0)            // Threshold for data required signal
+#define PWM_PANIC_THRESH(t) \
+    (((t) & 0xFF) << 8)            // Threshold for panic signal
+
+// SPI controller:
+#define SPI_CS_CLEAR (3 << 4) // Clear TX and RX FIFOs
+#define SPI_CS_TA    (1 << 7) // Transfer active
+#define SPI_CS_DMAEN (1 << 8) // DMA enabled
 
 // DMA controller:
 #define DMA_NO_WIDE_BURSTS (1 << 26) // Don't do writes as 2 beat bursts
 #define DMA_WAIT_RESP      (1 << 3)  // Wait for response for each write
+#define DMA_DEST_INC       (1 << 4)  // Increment destination address
+#define DMA_SRC_INC        (1 << 8)  // Increment source address
 #define DMA_DREQ           (1 << 6)  // Write when data is required
+#define DMA_SRC_DREQ       (1 << 10) // Read when data is available
 #define DMA_PER_MAP(p)     (p << 16) // Peripheral number whose ready signal
                                      // shall be used to control the rate of
                                      // transfer (5 = PWM)
@@ -107,16 +143,166 @@
 #define DMA_PRIO(p)        \
     (((p) & 0xF) << 16)              // Set norm bus priority transactions
 
+// DMA4 engine (BCM2711 DMA channels 11 to 14):
+#define DMA4_WAIT_RESP (1 << 2)             // Wait for response for each write
+#define DMA4_PER_MAP(p) ((p) << 9)          // Peripheral number pacing writes
+#define DMA4_D_DREQ    (1 << 15)            // Write when data is required
+#define DMA4_S_DREQ    (1 << 14)            // Read when data is available
+#define DMA4_INC       (1 << 12)            // Increment source or destination
+#define DMA4_RESET     (1 << 23)            // Reset the DMA (debug register)
+#define DMA4_PERI_ADDR_HIGH 0x04            // Address bits 39:32 of the
+                                            // peripherals in the 40 bit map
+#define DMA4_RAM_ADDR_MASK  0x3FFFFFFF      // SDRAM address in the 40 bit map
+                                            // of an uncached bus address
+
+// RP1 DMA controller (Synopsys DesignWare AXI DMAC, Raspberry Pi 5):
+#define RP1_DMAC_CFG   (0x10 / 4) // Common configuration register
+#define RP1_DMAC_CHEN  (0x18 / 4) // Channel enable register
+#define RP1_DMAC_EN    (1 << 0)   // Enable the DMA controller
+#define RP1_CH_EN(c)   (1 << (c))       // Channel enabled
+#define RP1_CH_EN_WE(c) (1 << ((c) + 8)) // Channel enable write enable
+#define RP1_DMA_CFG_LLI  ((3 << 0) | (3 << 2)) // Source and destination
+                                               // blocks from linked lists
+#define RP1_DMA_CFG_DST_PER(p) ((p) << 11) // Handshake pacing destination
+#define RP1_DMA_CFG_MEM_TO_PER 1           // Memory to peripheral transfers
+                                           // (DMA flow control)
+#define RP1_DMA_SINC_FIXED (1 << 4) // Don't increment source address
+#define RP1_DMA_DINC_FIXED (1 << 6) // Don't increment destination address
+#define RP1_DMA_WIDTH_32   ((2 << 8) | (2 << 11)) // 32 bit transfers
+#define RP1_DMA_LLI_LAST   (1u << 30) // Last descriptor of the list
+#define RP1_DMA_LLI_VALID  (1u << 31) // Descriptor is valid
+#define RP1_DREQ_PWM0      24         // PWM0 data request handshake
+#define RP1_RAM_ADDR_HIGH  0x10       // Address bits 63:32 of host SDRAM
+                                      // as seen by the RP1 DMA
+
+// RP1 PWM controller:
+#define RP1_PWM_CHAN_EN(c)    (1 << (c))  // Channel enabled
+#define RP1_PWM_SET_UPDATE    (1u << 31)  // Apply channel settings
+#define RP1_PWM_FIFO_FLUSH    (1 << 5)    // Clear FIFO buffer
+#define RP1_PWM_FIFO_DREQ_EN  (1u << 31)  // DMA enabled
+#define RP1_PWM_FIFO_THRESH(t) \
+    ((((t) > 0x1F) ? 0x1F : (t)) << 11)   // Threshold for data required
+                                          // signal
+#define RP1_PWM_MODE_TRAILING 1           // Trailing edge modulation
+#define RP1_PWM_USEFIFO       (1 << 5)    // FIFO used for transmission
+#define RP1_PWM_CLOCK_FREQ    50e6        // PWM0 clock frequency
+
 // Defaults
 #define DEFAULT_CLOCK_SOURCE 6     // PLLD
 #define DEFAULT_CLOCK_FREQ   500e6 // Source frequency
 #define DEFAULT_CLOCK_DIV    50    // Clock integer divisor
 
+#define BCM2711_PLLD_CLOCK_FREQ 750e6 // PLLD frequency of the BCM2711
+
+#define OSC_CLOCK_SOURCE       1      // Oscillator
+#define OSC_CLOCK_FREQ         19.2e6 // Oscillator frequency
+#define BCM2711_OSC_CLOCK_FREQ 54e6   // Oscillator frequency of the BCM2711
+
+#define CORE_CLOCK_FREQ         250e6 // Core clock frequency (SPI source)
+#define BCM2711_CORE_CLOCK_FREQ 500e6 // Core clock frequency of the BCM2711
+
 #define DEFAULT_PWM_RNG 100 // Period of length
 
 // Constants
 #define NUM_DMA_CHANNELS 7 // Number of DMA channels
 
+// Maximum PWM controller writes of one paced CB (DMA lite channels have a
+// 16 bit transfer length):
+#define MAX_PACED_WORDS (0xFFFF / 4)
+
+// Bus transfers of one CB load (the DMA controller reads all 8 words):
+#define CB_BUS_WORDS 8
+
+// First DMA channel with a DMA4 engine on the BCM2711:
+#define BCM2711_DMA4_FIRST 11
+
+// Maximum PWM controller writes of one paced DMA4 CB (30 bit transfer
+// length):
+#define DMA4_MAX_PACED_WORDS (0x3FFFFFFF / 4)
+
+// Number of RP1 DMA channels (used from the highest down):
+#define RP1_NUM_DMA_CHANNELS 8
+
+// Maximum PWM controller writes of one RP1 DMA descriptor:
+#define RP1_DMA_MAX_PACED_WORDS 0x10000
+
+// RP1 DMA descriptors re-arming a buffer of size bytes besides the template
+// of each (a copy per block of templates, the copy of the last re-arm
+// descriptor, the last one and templates of these):
+#define RP1_REARM_CBS(size) \
+    (2 * ((size) / (RP1_DMA_MAX_PACED_WORDS * 4) + 1) + 4)
+
+// DMA engines:
+#define DMA_ENGINE_LEGACY 0 // DMA and DMA lite channels
+#define DMA_ENGINE_DMA4   1 // DMA4 channels (40 bit addresses)
+#define DMA_ENGINE_RP1    2 // RP1 DMA channels (Raspberry Pi 5)
+
+// Highest BCM GPIO pin (GPIO 32 and above are in bank 1):
+#define BCM2835_MAX_GPIO 53 // BCM2835, BCM2836 and BCM2837
+#define BCM2711_MAX_GPIO 57 // BCM2711
+#define RP1_MAX_GPIO     27 // RP1 bank 0 (40 pin header)
+
+// CB buffers of a channel (a ring of 2 to MAX_RING_BUFS buffers, see
+// config_ring_pwm(), followed by the sequence cache, see set_cache_pwm()):
+#define MAX_RING_BUFS   8
+#define SEQ_CACHE_FIRST MAX_RING_BUFS
+#define SEQ_CACHE_SLOTS 8
+#define NUM_CB_BUFS     (SEQ_CACHE_FIRST + SEQ_CACHE_SLOTS)
+
+// CB buffer states (see update_ring()):
+#define BUF_FREE     0 // DMA cannot reach it
+#define BUF_BUILDING 1 // Sequence being built
+#define BUF_QUEUED   2 // Linked from a running sequence; DMA may enter it
+#define BUF_LIVE     3 // DMA was last seen executing it
+
+// Maximum unpaced CBs timed by calibrate_pwm():
+#define CALIBRATION_CBS 4096
+
+// Time allowed for the calibration CB chain to complete in us:
+#define CALIBRATION_TIMEOUT_US 100000
+
+// CPU timed calibration runs (without a system timer):
+#define CALIBRATION_RUNS 5
+
+// General purpose clocks:
+#define NUM_GPCLK      3     // Number of general purpose clocks
+#define GPCLK_MAX_FREQ 125e6 // Highest output frequency of a GPIO
+#define GPCLK_MAX_DIVI 4095  // Highest integer divisor
+#define GPCLK_BUSY_POLLS 100 // Polls for a clock to stop (per delay)
+
+// Channel modes:
+#define CHANNEL_MODE_PWM      0 // PWM output on GPIOs
+#define CHANNEL_MODE_CAPTURE  1 // GPIO level sampling for input capture
+#define CHANNEL_MODE_RANGE    2 // Trigger bursts with echo sampling
+#define CHANNEL_MODE_CLOCK    3 // General purpose clock output on a GPIO
+#define CHANNEL_MODE_PWM2     4 // PWM channel 2 output on a GPIO
+#define CHANNEL_MODE_SERIAL   5 // PWM channel 1 serializer output on a GPIO
+#define CHANNEL_MODE_SPI      6 // SPI0 MOSI output on a GPIO
+#define CHANNEL_MODE_MERGE    7 // Merged PWM signals on GPIOs
+#define CHANNEL_MODE_TIMEBASE 8 // PWM signal with DMA written PWM range
+
+// Bits serialized from each PWM FIFO word (most significant first):
+#define SERIAL_BITS 32
+
+// Time allowed for a migrated channel's DMA to reach the next control block
+// in us:
+#define MIGRATE_TIMEOUT_US 1000000
+
+// Channel events queued for read_events_pwm():
+#define EVENT_QUEUE_LEN 64
+
+// Lowest PWM range written by a timebase chain (FIFO words of fewer clock
+// cycles would drain faster than the DMA refills them):
+#define TIMEBASE_MIN_RNG 32
+
+// SPI0 output engine:
+#define SPI_MOSI_GPIO   10    // SPI0 MOSI (ALT0)
+#define SPI_MAX_CDIV    65534 // Highest (even) clock divisor
+#define SPI_CHUNK_WORDS 8     // Words queued ahead of the shifter (half the
+                              // TX FIFO)
+#define SPI_DREQ_TX     6     // SPI TX data request
+#define SPI_DREQ_RX     7     // SPI RX data request
+
 // Structure definitions
 
 // DMA controller register map:
@@ -132,6 +318,33 @@ struct dma_reg_map {
     uint32_t debug;     // Debug
 };
 
+// DMA4 controller register map:
+struct dma4_reg_map {
+    uint32_t cs;      // Control & status
+    uint32_t cb;      // Control block address (bits 39:5)
+    uint32_t pad;     // Padding
+    uint32_t debug;   // Debug
+    uint32_t ti;      // Transfer information
+    uint32_t src;     // Source address (bits 31:0)
+    uint32_t srci;    // Source information
+    uint32_t dest;    // Destination address (bits 31:0)
+    uint32_t desti;   // Destination information
+    uint32_t len;     // Transfer length
+    uint32_t next_cb; // Next CB address (bits 39:5)
+    uint32_t debug2;  // More debug
+};
+
+// RP1 DMA channel register map (64 bit registers as low and high words):
+struct rp1_dma_reg_map {
+    uint32_t sar[2];      // Source address
+    uint32_t dar[2];      // Destination address
+    uint32_t block_ts[2]; // Block transfer size
+    uint32_t ctl[2];      // Control
+    uint32_t cfg[2];      // Configuration
+    uint32_t llp[2];      // Next linked list descriptor address
+    uint32_t status[2];   // Status
+};
+
 // PWM controller register map:
 struct pwm_ctl_reg_map {
     uint32_t ctl;  // Control
@@ -152,18 +365,141 @@ struct pwm_clk_reg_map {
     uint32_t pwmdiv; // Clock divisor
 };
 
+// SPI controller register map:
+struct spi_reg_map {
+    uint32_t cs;   // Control & status
+    uint32_t fifo; // TX and RX FIFOs
+    uint32_t clk;  // Clock divisor
+    uint32_t dlen; // Data length
+    uint32_t ltoh; // LoSSI output hold delay
+    uint32_t dc;   // DMA DREQ controls
+};
+
+// General purpose clock register map:
+struct gp_clk_reg_map {
+    uint32_t ctl; // Control
+    uint32_t div; // Clock divisor
+};
+
+// GPIO with a general purpose clock output:
+struct gpclk_pin {
+    int gpio;  // BCM GPIO pin
+    int gpclk; // General purpose clock
+    int fsel;  // Function select of the clock output
+};
+
+// GPIO with a PWM controller output:
+struct pwm_pin {
+    int gpio; // BCM GPIO pin
+    int pwm;  // PWM channel (1 or 2)
+    int fsel; // Function select of the PWM output
+};
+
+// RP1 PWM controller register map:
+struct rp1_pwm_reg_map {
+    uint32_t global_ctrl;  // Global control
+    uint32_t fifo_ctrl;    // FIFO control
+    uint32_t common_range; // Common range
+    uint32_t common_duty;  // Common duty
+    uint32_t duty_fifo;    // FIFO input
+    uint32_t chan0_ctrl;   // Channel 0 control
+    uint32_t chan0_range;  // Channel 0 range
+    uint32_t chan0_phase;  // Channel 0 phase
+    uint32_t chan0_duty;   // Channel 0 duty
+};
+
+// Output stop of a channel precomputed for signal handlers:
+struct teardown {
+    volatile uint32_t *halt_reg; // DMA register stopping the channel
+    uint32_t halt_val;           // Value stopping the channel
+    volatile uint32_t *out_reg;  // Clock, PWM or SPI register stopping the
+                                 // output (NULL if none)
+    uint32_t out_val;            // Value stopping the output
+    volatile uint32_t *clr_reg;  // GPIO clear register(s)
+    int clr_words;               // GPIO clear registers (banks)
+    uint64_t clear_mask;         // GPIOs to clear
+};
+
+// Ranging sensor:
+struct range_sensor {
+    int trig_gpio;   // BCM GPIO pin of the trigger
+    int echo_gpio;   // BCM GPIO pin of the echo
+    size_t first_cb; // Index of first CB of the sensor's slot
+    size_t end_cb;   // Index of first CB after the sensor's slot
+    float end_us;    // End of the sensor's slot from start of the round
+};
+
+// Identity of a built PWM signal CB sequence (equal keys build equal
+// sequences):
+struct seq_key {
+    uint64_t mask;     // GPIO set and clear mask
+    size_t cb_seq_num; // Number of control blocks in sequence
+    size_t cb_set_num; // Number of "wait" control blocks during GPIO set
+    size_t cb_clr_num; // Number of "wait" control blocks during GPIO clear
+    uint32_t ti;       // Transfer information flags of every CB
+    uint32_t gpio_len; // Length of GPIO set and clear CBs
+    uint8_t compressed; // "Wait" CBs span several ticks
+    uint8_t levels;     // GPIOs are cleared (0), set (1) or both (2)
+};
+
+// Cached CB sequence:
+struct seq_entry {
+    struct seq_key key; // Sequence identity
+    size_t bytes;       // Size of its CB buffer
+    uint64_t last_use;  // Cache use count at its last use (LRU)
+    uint8_t valid;      // Holds a built sequence
+};
+
+// Edge of a merged PWM signal:
+struct merge_edge {
+    double at;      // Time in "wait" ticks from start of the merged period
+    uint64_t mask;  // GPIOs of the signal
+    size_t signal;  // Signal index
+    uint8_t clear;  // GPIOs are cleared (else set)
+};
+
+// Merged PWM signals over their common period:
+struct merge_plan {
+    struct merge_edge *edges; // Edges sorted by time, sets first
+    size_t num_edges;         // Number of edges
+    uint64_t mask;            // GPIOs of every signal
+    uint32_t gpio_len;        // Length of GPIO set and clear CBs
+    uint64_t ticks;           // Common period in "wait" ticks
+    uint64_t *sig_ticks;      // Period of each signal in "wait" ticks
+    double *rise_us;          // First set of each signal in the sequence
+    double *fall_us;          // First clear of each signal in the sequence
+
+    size_t cbs;          // Control blocks of the sequence
+    size_t gpio_cbs;     // GPIO set and clear CBs (one mask word each)
+    size_t wait_words;   // Words written to the PWM FIFO
+    double period_us;    // Duration of the sequence
+};
+
 // PWM DMA channel:
 struct channel {
     // Memory addresses:
-    struct uncached_mem *cb_base[2];    // CB base uncached memory struct
-    struct uncached_mem *set_mask[2];   // GPIO set mask uncached memory struct
-    struct uncached_mem *clear_mask[2]; // GPIO clear mask uncached memory struct
-
-    uint32_t cb_base_bus_addr[2];    // Control block seq. phys base address
-    uint32_t set_mask_bus_addr[2];   // GPIO set mask physical address
-    uint32_t clear_mask_bus_addr[2]; // GPIO clear mask physical address
-
-    volatile struct dma_reg_map *dma_reg; // DMA register map for the channel
+    struct uncached_mem *cb_base[NUM_CB_BUFS];    // CB base uncached memory
+                                                  // struct
+    struct uncached_mem *set_mask[NUM_CB_BUFS];   // GPIO set mask uncached
+                                                  // memory struct
+    struct uncached_mem *clear_mask[NUM_CB_BUFS]; // GPIO clear mask uncached
+                                                  // memory struct
+    struct uncached_mem *rearm[NUM_CB_BUFS];      // RP1 descriptor re-arm
+                                                  // uncached memory struct
+
+    uint32_t cb_base_bus_addr[NUM_CB_BUFS];    // Control block seq. phys base
+                                               // address
+    uint32_t set_mask_bus_addr[NUM_CB_BUFS];   // GPIO set mask physical
+                                               // address
+    uint32_t clear_mask_bus_addr[NUM_CB_BUFS]; // GPIO clear mask physical
+                                               // address
+    uint32_t rearm_bus_addr[NUM_CB_BUFS];      // RP1 descriptor re-arm
+                                               // physical address
+
+    volatile struct dma_reg_map *dma_reg;   // DMA register map for the channel
+    volatile struct dma4_reg_map *dma4_reg; // Same registers of a DMA4 engine
+    volatile struct rp1_dma_reg_map *rp1_reg; // RP1 DMA channel registers
+    int rp1_channel;                          // RP1 DMA channel number
 
     // Inputs:
     float freq_des;   // Desired frequency
@@ -173,17 +509,85 @@ struct channel {
     float pwm_d_res;  // PWM duty cycle resolution
     float freq_act;   // Actual frequency
     float pwm_d_act;  // Actual PWM duty cycle
+    float bus_rate;   // Bus transfers per second of the CB sequence
 
     unsigned t_sub_us; // Sub cycle period
 
     size_t cb_seq_num; // Number of control blocks in sequence
+    size_t cb_num[NUM_CB_BUFS]; // Number of control blocks built in each
+                                // buffer
+    size_t rearm_blocks[NUM_CB_BUFS]; // Template copies re-arming each RP1
+                                      // buffer every round (0 if it does
+                                      // not loop)
+    uint8_t buf_state[NUM_CB_BUFS]; // State of each buffer
     size_t cb_clr_num; // Number of "wait" control blocks during GPIO clear
     size_t cb_set_num; // Number of "wait" control blocks during GPIO set
 
+    uint32_t gpio_ti;  // Extra transfer information of GPIO set and clear CBs
+    uint32_t gpio_len; // Length of GPIO set and clear CBs (8 bytes write
+                       // both banks)
+
+    // Input capture:
+    struct capture_state *capture;       // Capture decoding state
+    volatile uint32_t *cap_samples;      // Sample ring virtual address
+    size_t cap_blocks;                   // Number of blocks in sample ring
+    size_t cap_next_block;               // Next sample block to decode
+    struct timespec cap_last;            // Time of last decode
+
+    // Ranging:
+    struct range_sensor *range;          // Ranging sensors
+    size_t range_num;                    // Number of ranging sensors
+    volatile uint32_t *range_samples;    // Echo samples virtual address
+    size_t range_num_samples;            // Echo samples per sensor
+    size_t range_pulse_ticks;            // Trigger high and low time in ticks
+    size_t range_cycles;                 // Trigger pulses per burst
+    size_t range_pad_ticks;              // Idle ticks to fill the interval
+                                         // (0 = one round per enable)
+    struct timespec range_start;         // Time the channel was enabled
+
+    // General purpose clock, PWM channel 2, serializer and SPI output:
+    int gpclk;           // General purpose clock output
+    int alt_gpio;        // BCM GPIO pin of the clock, PWM channel 2,
+                         // serializer or SPI output
+    size_t serial_words; // Words of the serializer or SPI bit pattern loop
+    uint32_t spi_cdiv;   // SPI clock divisor
+    uint32_t gpclk_ctl;  // Clock control (source and MASH stages)
+    uint32_t gpclk_div;  // Clock divisor
+
+    // Sequence cache (buffers from SEQ_CACHE_FIRST):
+    struct seq_entry cache[SEQ_CACHE_SLOTS]; // Cached PWM signal sequences
+    size_t cache_max;                        // Cache memory cap in bytes
+                                             // (0 = disabled)
+    size_t cache_bytes;                      // Cache memory in use
+    uint64_t cache_uses;                     // Cache lookups (LRU clock)
+    uint64_t cache_hits;                     // Lookups finding the sequence
+    uint64_t cache_misses;                   // Lookups building it
+
+    // Events (see read_events_pwm()):
+    uint8_t update_pending;   // Queued sequence not yet reached by the DMA
+    uint8_t stalled;          // Control block not moving on
+    uint8_t ended;            // CB chain ran to its end
+    uint8_t cap_lost;         // Capture samples being lost
+    uint32_t ev_cb;           // Control block register at the last check
+    struct timespec ev_moved; // Time the control block register changed
+    size_t ev_block;          // Capture sample block at the last check
+
+    // Bus settings:
+    uint32_t ti;        // Transfer information flags of every CB
+    uint8_t prio;       // AXI bus priority
+    uint8_t panic_prio; // AXI bus panic priority
+
     // Flags:
     uint8_t enabled;         // Channel enabled
-    uint8_t selected_cb_buf; // Selected CB buffer (0 or 1)
+    uint8_t passthrough;     // Route signals on a PWM channel 2 GPIO to it
+    uint8_t spi;             // Route signals on the SPI MOSI GPIO to SPI0
+    uint8_t selected_cb_buf; // Selected CB buffer (in the ring, or a cached
+                             // sequence)
     uint8_t seq_built;       // PWM signal set
+    uint8_t compressed;      // "Wait" CBs of a PWM signal span several ticks
+    uint8_t engine;          // DMA engine of the channel
+    uint8_t mode;            // Channel mode (PWM output, input capture or
+                             // ranging)
 };
 
 // DMA controller control block:
@@ -197,31 +601,79 @@ struct dma_cb {
     uint32_t res[2]; // Reserved
 };
 
+// DMA4 controller control block:
+struct dma4_cb {
+    uint32_t ti;      // TI
+    uint32_t src;     // SRC (bits 31:0)
+    uint32_t srci;    // SRCI (bits 39:32 and increment)
+    uint32_t dest;    // DEST (bits 31:0)
+    uint32_t desti;   // DESTI (bits 39:32 and increment)
+    uint32_t len;     // LEN
+    uint32_t next_cb; // NEXT_CB (bits 39:5)
+    uint32_t res;     // Reserved
+};
+
+// RP1 DMA linked list descriptor:
+struct rp1_dma_cb {
+    uint32_t sar[2];        // Source address
+    uint32_t dar[2];        // Destination address
+    uint32_t block_ts;      // Block transfer size (words - 1)
+    uint32_t res1;          // Reserved
+    uint32_t llp[2];        // Next descriptor address
+    uint32_t ctl[2];        // Control
+    uint32_t sstat;         // Source status
+    uint32_t dstat;         // Destination status
+    uint32_t llp_status[2]; // Status write back
+    uint32_t res2[2];       // Reserved
+};
+
 // Global variables
-static int gpio_base_phys_addr;    // GPIO base physical address
-static int dma_ctl_base_phys_addr; // DMA base physical address
-static int pwm_ctl_base_phys_addr; // PWM base physical address
-static int pwm_clk_base_phys_addr; // PWM clock base physical address
+static uint64_t gpio_base_phys_addr;    // GPIO base physical address
+static uint64_t dma_ctl_base_phys_addr; // DMA base physical address
+static uint64_t pwm_ctl_base_phys_addr; // PWM base physical address
+static uint64_t pwm_clk_base_phys_addr; // PWM clock base physical address
+static uint64_t spi_base_phys_addr;     // SPI0 base physical address
 
 static int gpset0_bus_addr;  // GPIO set bus address
 static int gpclr0_bus_addr;  // GPIO clear bus address
+static int gplev0_bus_addr;  // GPIO level bus address
 static int pwmfif1_bus_addr; // PWM FIF1 bus address
+static int pwmrng1_bus_addr; // PWM RNG1 bus address
+static int pwmupd_bus_addr;  // PWM settings update bus address (RP1 only)
+static int spififo_bus_addr; // SPI0 FIFO bus address
+static int stclo_bus_addr;   // System timer counter bus address
 
 static volatile uint32_t *gpio_base_virt_addr;    // GPIO base virt. ad.
 static volatile uint32_t *dma_ctl_base_virt_addr; // DMA contoller virt. ad.
 static volatile uint32_t *pwm_ctl_base_virt_addr; // PWM Controller virt ad.
 static volatile uint32_t *pwm_clk_base_virt_addr; // PWM Clock Manager virt.
                                                    // address
+static volatile uint32_t *spi_base_virt_addr;     // SPI0 virt. address
+static volatile uint32_t *rio_base_virt_addr;  // RP1 RIO virt. address
+static volatile uint32_t *rio_set_virt_addr;   // RP1 RIO set alias virt. ad.
+static volatile uint32_t *rio_clr_virt_addr;   // RP1 RIO clear alias virt.
+                                               // address
+static volatile uint32_t *pads_base_virt_addr; // RP1 GPIO pads virt. address
 
 static int pi_version; // Raspberry PI board version
 
 static unsigned int clock_div = DEFAULT_CLOCK_DIV; // Clock divisor
 static unsigned int pwm_rng = DEFAULT_PWM_RNG;     // Period of length
 
+static unsigned int dreq_thresh = DEFAULT_FIFO_THRESH;  // PWM FIFO DREQ
+static unsigned int panic_thresh = DEFAULT_FIFO_THRESH; // PWM FIFO panic
+
+static float bus_budget = 0; // Bus transfers per second allowed for all
+                             // channels (0 = unlimited)
+
 static int allocated_pages = DEFAULT_PAGES; // Allocated uncached memory
                                             // pages for CB sequence
+static int ring_bufs = DEFAULT_RING_BUFS;   // CB buffers in each channel's
+                                            // ring
 
 static float pulse_width_us; // PWM signal pulse width
+static float cb_overhead_us; // Duration of an unpaced (GPIO set, clear or
+                             // copy) CB, see calibrate_pwm()
 
 // Tested on Raspberry Pi 3b+ running Linux raspberrypi 5.10.17-v7+ #1403
 // No interruptions observed over 40 minute continuous output
@@ -233,55 +685,147 @@ static int valid_dma_channels[NUM_DMA_CHANNELS] = \
 static int dma_channels_status[NUM_DMA_CHANNELS] = \
     {1, 1, 1, 1, 1, 1, 1}; // 1 = Availabe/free
 
+static int dma_channels_pooled[NUM_DMA_CHANNELS] = \
+    {0, 0, 0, 0, 0, 0, 0}; // 1 = Buffers kept allocated when freed
+
 static struct channel dma_channels[NUM_DMA_CHANNELS]; // Channel structure for
                                                       // each DMA channel
 
 static volatile struct pwm_ctl_reg_map *pwm_ctl_reg; // PWM controller reg map
 static volatile struct pwm_clk_reg_map *pwm_clk_reg; // Clock manager reg map
+static volatile struct spi_reg_map *spi_reg;         // SPI0 reg map
+static volatile struct rp1_pwm_reg_map *rp1_pwm_reg; // RP1 PWM controller reg
+                                                     // map
 
 static int init_state = 0; // Initialized?
 
+static int export_seqs = 0; // Leave built CB sequences in the legacy layout
+                            // (see save_image_pwm())
+
+// GPIOs with a general purpose clock output (BCM2835 to BCM2711):
+static const struct gpclk_pin gpclk_pins[] = {
+    {4, 0, GPIO_FSEL_ALT0}, {5, 1, GPIO_FSEL_ALT0}, {6, 2, GPIO_FSEL_ALT0},
+    {20, 0, GPIO_FSEL_ALT5}, {21, 1, GPIO_FSEL_ALT5},
+    {32, 0, GPIO_FSEL_ALT0}, {34, 0, GPIO_FSEL_ALT0},
+    {42, 1, GPIO_FSEL_ALT0}, {43, 2, GPIO_FSEL_ALT0}, {44, 1, GPIO_FSEL_ALT0}
+};
+
+// Header GPIOs with a PWM controller output (BCM2835 to BCM2711):
+static const struct pwm_pin pwm_pins[] = {
+    {12, 1, GPIO_FSEL_ALT0}, {18, 1, GPIO_FSEL_ALT5},
+    {13, 2, GPIO_FSEL_ALT0}, {19, 2, GPIO_FSEL_ALT5}
+};
+
 // DMA delay per data sheet:
 static struct timespec delay = {
     .tv_sec = 0,
     .tv_nsec = 10e3 // 10 us
 };
 
-// Procees termination signal handler
-static void signal_handler(int sig, siginfo_t* sig_info, void* context) {
+static int event_fd = -1;       // Timer of channel event checks (-1 =
+                                // closed)
+static float event_interval_us; // Mean time between checks
+static float event_stall_us;    // Time before an unmoving control block is
+                                // reported stalled
+static unsigned event_seed;     // Check time dither state
+static struct event_pwm event_queue[EVENT_QUEUE_LEN]; // Events not yet read
+static size_t event_first; // First event in the queue
+static size_t event_num;   // Number of events in the queue
+
+static struct teardown teardowns[NUM_DMA_CHANNELS]; // Output stops
+static volatile sig_atomic_t teardown_armed[NUM_DMA_CHANNELS]; // 1 = Stop
+                                                              // on exit
+
+// Fatal and termination signals stopping the outputs:
+static const int caught_signals[] = {SIGHUP, SIGQUIT, SIGINT, SIGTERM, \
+    SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static struct sigaction prev_actions[sizeof(caught_signals) / \
+    sizeof(int)]; // Actions before initialization
+
+// Stop every armed output with plain register writes:
+// (async-signal-safe: no calls, locks or allocations, so it can run from a
+// crashing thread; memory is released at the next start, see init_once())
+static void teardown_outputs() {
     // Definitions:
     int i;
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("Signal %d received; aborting!\n", sig);
-    }
+    struct teardown *t; // Output stop
 
-    // Terminate any used DMA channels and free allocated memory:
     for (i = 0; i < NUM_DMA_CHANNELS; i++) {
-        // Diabled and free:
-        free_pwm(i);
+        // Skip channels without output:
+        if (!(teardown_armed[i])) {
+            // Next channel:
+            continue;
+        }
+
+        t = &teardowns[i];
+
+        // Stop DMA first so it does not set the GPIOs again:
+        if (t->halt_reg != NULL) {
+            *t->halt_reg = t->halt_val;
+        }
+
+        // Stop clock, PWM or SPI output:
+        if (t->out_reg != NULL) {
+            *t->out_reg = t->out_val;
+        }
+
+        // Clear GPIOs:
+        t->clr_reg[0] = (uint32_t)t->clear_mask;
+        if (t->clr_words > 1) {
+            t->clr_reg[1] = (uint32_t)(t->clear_mask >> 32);
+        }
+    }
+}
+
+// Procees termination signal handler
+static void signal_handler(int sig, siginfo_t* sig_info, void* context) {
+    // Definitions:
+    size_t i;
+
+    // Silence every output:
+    teardown_outputs();
+
+    // Hand the signal on to its action before initialization (terminating
+    // or dumping core by default):
+    for (i = 0; i < (sizeof(caught_signals) / sizeof(int)); i++) {
+        if (caught_signals[i] == sig) {
+            sigaction(sig, &prev_actions[i], NULL);
+        }
     }
+    raise(sig);
+}
+
+// Exit hook (outputs of channels not freed would keep running):
+static void exit_handler() {
+    // Silence every output:
+    teardown_outputs();
 }
 
-// Setup signal handler to catch process terminating signals
-// (Required to terminate DMA and free allocated uncached memory)
+// Setup signal handler to catch process terminating signals and crashes
+// (Required to stop DMA and outputs, see teardown_outputs())
 static int setup_signal_handler() {
     // Definitions:
     int i;
-    int signals[4] = {SIGHUP, SIGQUIT, SIGINT, SIGTERM}; // Signals to catch
+    const int *signals = caught_signals; // Signals to catch
 
-    struct sigaction sig; // Signal action structure
+    struct sigaction sig;  // Signal action structure
+    struct sigaction prev; // Action replaced
 
     // Assign handler to sig:
+    memset(&sig, 0, sizeof(sig));
     sig.sa_sigaction = &signal_handler;
     sig.sa_flags = SA_SIGINFO;
+    sigemptyset(&sig.sa_mask);
+
+    // Stop outputs on exit as well:
+    atexit(exit_handler);
 
     // Assign signal handler to each termination signal:
-    for (i = 0; i < (sizeof(signals) / sizeof(int)); i++) {
+    for (i = 0; i < (sizeof(caught_signals) / sizeof(int)); i++) {
         // Register handler with sigaction for signal type:
-        if (sigaction(signals[i], &sig, NULL) < 0) {
+        if (sigaction(signals[i], &sig, &prev) < 0) {
             // Debug logs:
             if (DEBUG) {
                 // Logs:
@@ -295,6 +839,11 @@ static int setup_signal_handler() {
             return -ESIGHDNFAIL;
         }
 
+        // Keep the action from before the first initialization attempt:
+        if (prev.sa_sigaction != &signal_handler) {
+            prev_actions[i] = prev;
+        }
+
         // Debug logs:
         if (DEBUG) {
             // Logs:
@@ -336,6 +885,291 @@ static int check_channel(int channel) {
     return 0;
 }
 
+// Determine bus transfers per second of a CB sequence:
+// (every CB is loaded and every word it transfers is read and written)
+static float seq_bus_rate(size_t cbs, size_t words, float period_us) {
+    // Return rate:
+    return ((CB_BUS_WORDS * cbs) + (2 * words)) * 1e6 / period_us;
+}
+
+// Check a channel's new bus transfer rate against the budget:
+// (channel -1 checks a channel yet to be requested)
+static int check_bus_budget(int channel, float rate) {
+    // Definitions:
+    int i;
+
+    float load = rate; // Total load with the new rate
+
+    // No budget:
+    if (bus_budget <= 0) {
+        // Exit with success:
+        return 0;
+    }
+
+    // Add every other channel with a CB sequence:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if ((i != channel) && !(dma_channels_status[i]) && \
+            dma_channels[i].seq_built) {
+            load += dma_channels[i].bus_rate;
+        }
+    }
+
+    // Abort if over budget:
+    if (load > bus_budget) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: bus load %0.0f transfers/s > budget %0.0f\n", \
+                load, bus_budget);
+        }
+
+        // Exit with error:
+        return -EBUSBUDGET;
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Reset channel state:
+static void reset_channel(int channel) {
+    // Definitions:
+    int i;
+
+    // Set flags:
+    dma_channels[channel].enabled = 0;
+    dma_channels[channel].selected_cb_buf = 1;
+    dma_channels[channel].seq_built = 0;
+    dma_channels[channel].compressed = 0;
+    dma_channels[channel].bus_rate = 0;
+    dma_channels[channel].mode = CHANNEL_MODE_PWM;
+    dma_channels[channel].capture = NULL;
+    dma_channels[channel].gpclk = -1;
+    dma_channels[channel].passthrough = 0;
+    dma_channels[channel].spi = 0;
+
+    // Disable sequence cache (emptied when the channel was freed):
+    dma_channels[channel].cache_max = 0;
+    dma_channels[channel].cache_bytes = 0;
+    dma_channels[channel].cache_uses = 0;
+    dma_channels[channel].cache_hits = 0;
+    dma_channels[channel].cache_misses = 0;
+
+    for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+        dma_channels[channel].cache[i].valid = 0;
+    }
+
+    // Free every CB buffer:
+    for (i = 0; i < NUM_CB_BUFS; i++) {
+        dma_channels[channel].buf_state[i] = BUF_FREE;
+    }
+
+    // Set default bus settings:
+    dma_channels[channel].ti = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP;
+    dma_channels[channel].prio = DEFAULT_DMA_PRIO;
+    dma_channels[channel].panic_prio = DEFAULT_DMA_PRIO;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Setting channel %d selected CB buffer to %d\n", channel, \
+            dma_channels[channel].selected_cb_buf);
+    }
+}
+
+// Allocate a CB buffer of a channel and its GPIO masks:
+static void alloc_buf(int channel, int buf, size_t size) {
+    // Definitions:
+    size_t page_size; // Page size
+
+    // Get page size:
+    page_size = getpagesize();
+
+    // Allocate memory for uncached mem structs:
+    dma_channels[channel].cb_base[buf] = malloc(sizeof(struct uncached_mem));
+    dma_channels[channel].set_mask[buf] = malloc(sizeof(struct uncached_mem));
+    dma_channels[channel].clear_mask[buf] = \
+        malloc(sizeof(struct uncached_mem));
+
+    // Set uncached memory struct size and alignment:
+    dma_channels[channel].cb_base[buf]->size = size;
+    dma_channels[channel].cb_base[buf]->alignment = page_size;
+
+    dma_channels[channel].set_mask[buf]->size = sizeof(uint64_t);
+    dma_channels[channel].set_mask[buf]->alignment = sizeof(uint64_t);
+
+    dma_channels[channel].clear_mask[buf]->size = sizeof(uint64_t);
+    dma_channels[channel].clear_mask[buf]->alignment = sizeof(uint64_t);
+
+    // Record the DMA channel reading them (see stop_stale_dma()):
+    dma_channels[channel].cb_base[buf]->dma_channel = channel;
+    dma_channels[channel].set_mask[buf]->dma_channel = channel;
+    dma_channels[channel].clear_mask[buf]->dma_channel = channel;
+
+    // Allocate page aligned uncached memory via mailbox:
+    dma_channels[channel].cb_base[buf] = \
+        uncached_malloc__(dma_channels[channel].cb_base[buf]);
+    dma_channels[channel].set_mask[buf] = \
+        uncached_malloc__(dma_channels[channel].set_mask[buf]);
+    dma_channels[channel].clear_mask[buf] = \
+        uncached_malloc__(dma_channels[channel].clear_mask[buf]);
+
+    // RP1 DMA descriptor templates and re-arm descriptors (the DMA clears
+    // the valid bit of each descriptor it completes, see
+    // translate_rp1_seq()):
+    dma_channels[channel].rearm[buf] = NULL;
+    dma_channels[channel].rearm_bus_addr[buf] = 0;
+    dma_channels[channel].rearm_blocks[buf] = 0;
+
+    if (pi_version == 5) {
+        dma_channels[channel].rearm[buf] = \
+            malloc(sizeof(struct uncached_mem));
+        dma_channels[channel].rearm[buf]->size = size + \
+            RP1_REARM_CBS(size) * sizeof(struct rp1_dma_cb);
+        dma_channels[channel].rearm[buf]->alignment = page_size;
+        dma_channels[channel].rearm[buf]->dma_channel = channel;
+        dma_channels[channel].rearm[buf] = \
+            uncached_malloc__(dma_channels[channel].rearm[buf]);
+        dma_channels[channel].rearm_bus_addr[buf] = \
+            dma_channels[channel].rearm[buf]->bus_addr;
+    }
+
+    // Bus addresses for DMA transfer:
+    dma_channels[channel].cb_base_bus_addr[buf] = \
+        dma_channels[channel].cb_base[buf]->bus_addr;
+    dma_channels[channel].set_mask_bus_addr[buf] = \
+        dma_channels[channel].set_mask[buf]->bus_addr;
+    dma_channels[channel].clear_mask_bus_addr[buf] = \
+        dma_channels[channel].clear_mask[buf]->bus_addr;
+
+    // No GPIOs until a signal is set (mailbox memory starts as all ones):
+    *(uint64_t*)dma_channels[channel].set_mask[buf]->virt_addr = 0;
+    *(uint64_t*)dma_channels[channel].clear_mask[buf]->virt_addr = 0;
+}
+
+// Free a CB buffer of a channel and its GPIO masks:
+static void free_buf(int channel, int buf) {
+    // Free allocated uncached memory:
+    uncached_free__(dma_channels[channel].cb_base[buf]);
+    uncached_free__(dma_channels[channel].set_mask[buf]);
+    uncached_free__(dma_channels[channel].clear_mask[buf]);
+
+    // Free allocated memory:
+    free(dma_channels[channel].cb_base[buf]);
+    free(dma_channels[channel].set_mask[buf]);
+    free(dma_channels[channel].clear_mask[buf]);
+
+    // Free RP1 DMA re-arm area:
+    if (dma_channels[channel].rearm[buf] != NULL) {
+        uncached_free__(dma_channels[channel].rearm[buf]);
+        free(dma_channels[channel].rearm[buf]);
+        dma_channels[channel].rearm[buf] = NULL;
+    }
+}
+
+// Record the DMA channel reading a channel's CB buffers (after its state
+// moved to another engine):
+static void set_buf_channel(int channel) {
+    // Definitions:
+    int i;
+
+    for (i = 0; i < NUM_CB_BUFS; i++) {
+        // Skip buffers not allocated:
+        if (((i < SEQ_CACHE_FIRST) && (i >= ring_bufs)) || \
+           ((i >= SEQ_CACHE_FIRST) && \
+           !(dma_channels[channel].cache[i - SEQ_CACHE_FIRST].valid))) {
+            continue;
+        }
+
+        uncached_set_channel__(dma_channels[channel].cb_base[i], channel);
+        uncached_set_channel__(dma_channels[channel].set_mask[i], channel);
+        uncached_set_channel__(dma_channels[channel].clear_mask[i], channel);
+
+        if (dma_channels[channel].rearm[i] != NULL) {
+            uncached_set_channel__(dma_channels[channel].rearm[i], channel);
+        }
+    }
+}
+
+// Select a channel's first CB buffer if a cached sequence is selected
+// (before the GPIO masks of the selected buffer are changed):
+static void select_base_buf(int channel) {
+    // Select first buffer:
+    if (dma_channels[channel].selected_cb_buf >= SEQ_CACHE_FIRST) {
+        dma_channels[channel].selected_cb_buf = 0;
+    }
+}
+
+// Map the DMA registers of a channel:
+static void map_channel(int channel) {
+    // Map DMA register map:
+    dma_channels[channel].dma_reg = \
+        (struct dma_reg_map*)((char *)dma_ctl_base_virt_addr + \
+        0x100 * valid_dma_channels[channel]);
+    dma_channels[channel].dma4_reg = \
+        (struct dma4_reg_map*)dma_channels[channel].dma_reg;
+
+    // Higher BCM2711 channels are DMA4 engines:
+    dma_channels[channel].engine = ((pi_version == 4) && \
+        (valid_dma_channels[channel] >= BCM2711_DMA4_FIRST)) ? \
+        DMA_ENGINE_DMA4 : DMA_ENGINE_LEGACY;
+
+    // RP1 DMA channels are used from the highest down:
+    if (pi_version == 5) {
+        dma_channels[channel].engine = DMA_ENGINE_RP1;
+        dma_channels[channel].rp1_channel = \
+            RP1_NUM_DMA_CHANNELS - 1 - channel;
+        dma_channels[channel].rp1_reg = \
+            (struct rp1_dma_reg_map*)((char *)dma_ctl_base_virt_addr + \
+            0x100 + 0x100 * dma_channels[channel].rp1_channel);
+        dma_channels[channel].dma_reg = NULL;
+        dma_channels[channel].dma4_reg = NULL;
+    }
+}
+
+// Allocate channel buffers and map its registers:
+static void alloc_channel(int channel) {
+    // Definitions:
+    int i;
+
+    size_t page_size; // Page size
+
+    // Get page size:
+    page_size = getpagesize();
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Setting page size to %d bytes\n", page_size);
+    }
+
+    // Initialize for each ring buffer:
+    for (i = 0; i < ring_bufs; i++) {
+        alloc_buf(channel, i, page_size * allocated_pages);
+    }
+
+    // Map registers:
+    map_channel(channel);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Channel %d allocated %d bytes (x%d)\n", channel, \
+            (page_size * allocated_pages), ring_bufs);
+    }
+}
+
+// Free channel buffers:
+static void dealloc_channel(int channel) {
+    // Definitions:
+    int i;
+
+    // Free ring buffers:
+    for (i = 0; i < ring_bufs; i++) {
+        free_buf(channel, i);
+    }
+}
+
 // Set memory usage and pulse width
 float config_pwm(int pages, float pulse_width) {
     // Definitions:
@@ -370,8 +1204,17 @@ float config_pwm(int pages, float pulse_width) {
     // Set to current:
     pwm_rng_temp = pwm_rng;
 
-    // Update:
-    allocated_pages = pages;
+    // Update, reallocating buffers of pooled channels (all free):
+    if (pages != allocated_pages) {
+        allocated_pages = pages;
+
+        for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+            if (dma_channels_pooled[i]) {
+                dealloc_channel(i);
+                alloc_channel(i);
+            }
+        }
+    }
 
     // Check is desired pulse width is out of bounds:
     if ((pulse_width > 35175782146) || (pulse_width < 0.4)) {
@@ -436,83 +1279,284 @@ float config_pwm(int pages, float pulse_width) {
     return 0;
 }
 
-// Initialize
-static int init_pwm() {
+// Set number of CB buffers each channel cycles through:
+int config_ring_pwm(int num_bufs) {
     // Definitions:
-    int bcm_peri_base_phys_addr;
-    int bcm_peri_base_bus_addr;
+    int i;
+    int j;
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("DEBUG logs enabled for dma_pwm.c!\n");
-        printf("Initializing dma_pwm.c\n");
-    }
-
-    // Setup termination signal handler:
-    if (setup_signal_handler() != 0) {
-        // Exit with error:
-        return -ESIGHDNFAIL;
+        printf("Configuring %d CB buffers per channel\n", num_bufs);
     }
 
-    // Get PI version:
-    pi_version = get_pi_version__();
-
-    // Set BCM base addresses according to PI version:
-    if ((pi_version == 0) || (pi_version == 1)) {
-        // Set BCM base addresses:
-        bcm_peri_base_phys_addr = BCM2835_PERI_BASE_PHYS_ADDR;
-        bcm_peri_base_bus_addr = BCM2835_PERI_BASE_BUS_ADDR;
-    } else if ((pi_version == 2) || (pi_version == 3)) {
-        // Set BCM base addresses:
-        bcm_peri_base_phys_addr = BCM2837_PERI_BASE_PHYS_ADDR;
-        bcm_peri_base_bus_addr = BCM2837_PERI_BASE_BUS_ADDR;
-    } else if (pi_version == 4) {
-        // Set BCM base addresses:
-        bcm_peri_base_phys_addr = BCM2711_PERI_BASE_PHYS_ADDR;
-        bcm_peri_base_bus_addr = BCM2711_PERI_BASE_BUS_ADDR;
-    // Did not find PI version:
-    } else {
+    // Abort if number of buffers is out of bounds:
+    if ((num_bufs < 2) || (num_bufs > MAX_RING_BUFS)) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: get_pi_version() could not get PI board" \
-                " version\n");
+            printf("ERROR: %d CB buffers out of bounds\n", num_bufs);
+            printf("ERROR: config_ring_pwm() returned with %d\n", -EINVRING);
         }
 
         // Exit with error:
-        return -ENOPIVER;
+        return -EINVRING;
     }
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("Setting PI board version as %d\n", pi_version);
-        printf("BCM peripheral base physical address = 0x%08X\n", \
-            bcm_peri_base_phys_addr);
-        printf("BCM peripheral base bus address = 0x%08X\n", \
-            bcm_peri_base_bus_addr);
+    // Abort if any channel is requested:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        // Exit with error if requested:
+        if (!(dma_channels_status[i])) {
+            // Debug logs:
+            if (DEBUG) {
+                // Logs:
+                printf("ERROR: channel %d has been requested\n", i);
+                printf("ERROR: config_ring_pwm() returned with %d\n", \
+                    -ECHNLREQ);
+            }
+
+            // Exit with error:
+            return -ECHNLREQ;
+        }
     }
 
-    // Set peripheral addresses:
-    gpio_base_phys_addr = \
-        (bcm_peri_base_phys_addr + 0x200000); // GPIOs
-    dma_ctl_base_phys_addr = \
-        (bcm_peri_base_phys_addr + 0x007000); // DMA controller
-    pwm_ctl_base_phys_addr = \
-        (bcm_peri_base_phys_addr + 0x20C000); // PWM Controller
-    pwm_clk_base_phys_addr = \
-        (bcm_peri_base_phys_addr + 0x101000); // PWM Clock Manager
+    // Free or allocate the buffers pooled channels gain or lose (all free):
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!(dma_channels_pooled[i])) {
+            continue;
+        }
+
+        for (j = num_bufs; j < ring_bufs; j++) {
+            free_buf(i, j);
+        }
+
+        for (j = ring_bufs; j < num_bufs; j++) {
+            alloc_buf(i, j, getpagesize() * allocated_pages);
+        }
+    }
+
+    // Update:
+    ring_bufs = num_bufs;
+
+    // Exit with success:
+    return 0;
+}
+
+// Initialize RP1 (Raspberry Pi 5) peripherals:
+// (the RP1 DMA is paced by the RP1 PWM FIFO and drives GPIOs through RIO)
+static int init_rp1() {
+    // Definitions:
+    volatile uint32_t *io_bank_virt_addr; // IO_BANK0 virtual address
+
+    // Set peripheral addresses:
+    gpio_base_phys_addr = RP1_PERI_BASE_PHYS_ADDR + RP1_IO_BANK0; // GPIOs
+    dma_ctl_base_phys_addr = RP1_PERI_BASE_PHYS_ADDR + RP1_DMA;   // DMA
+    pwm_ctl_base_phys_addr = RP1_PERI_BASE_PHYS_ADDR + RP1_PWM0;  // PWM0
+
+    gpset0_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_SYS_RIO0 + \
+        RP1_SET; // RIO output set
+    gpclr0_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_SYS_RIO0 + \
+        RP1_CLR; // RIO output clear
+    gplev0_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_SYS_RIO0 + \
+        0x08; // RIO synchronized input
+    pwmfif1_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_PWM0 + \
+        0x10; // PWM0 FIFO buffer
+    pwmrng1_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_PWM0 + \
+        0x18; // PWM0 channel 0 range
+    pwmupd_bus_addr = RP1_PERI_BASE_BUS_ADDR + RP1_PWM0; // PWM0 global
+    stclo_bus_addr = 0; // System timer is not on the RP1
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("RIO set bus address = 0x%08X\n", gpset0_bus_addr);
+        printf("RIO clear bus address = 0x%08X\n", gpclr0_bus_addr);
+        printf("RIO input bus address = 0x%08X\n", gplev0_bus_addr);
+        printf("PWM0 FIFO bus address = 0x%08X\n", pwmfif1_bus_addr);
+    }
+
+    // Calculate PWM pulse width:
+    pulse_width_us = 1e6 * \
+        (pwm_rng / (DEFAULT_CLOCK_FREQ / clock_div));
+
+    // Map peripherals into virtual memory:
+    io_bank_virt_addr = map_peripheral__(gpio_base_phys_addr);
+    rio_base_virt_addr = map_peripheral__(RP1_PERI_BASE_PHYS_ADDR + \
+        RP1_SYS_RIO0);
+    rio_set_virt_addr = map_peripheral__(RP1_PERI_BASE_PHYS_ADDR + \
+        RP1_SYS_RIO0 + RP1_SET);
+    rio_clr_virt_addr = map_peripheral__(RP1_PERI_BASE_PHYS_ADDR + \
+        RP1_SYS_RIO0 + RP1_CLR);
+    pads_base_virt_addr = map_peripheral__(RP1_PERI_BASE_PHYS_ADDR + \
+        RP1_PADS_BANK0);
+    dma_ctl_base_virt_addr = map_peripheral__(dma_ctl_base_phys_addr);
+    pwm_ctl_base_virt_addr = map_peripheral__(pwm_ctl_base_phys_addr);
+
+    // Abort if mapped incorrectly:
+    if ((io_bank_virt_addr == NULL) || (rio_base_virt_addr == NULL) || \
+       (rio_set_virt_addr == NULL) || (rio_clr_virt_addr == NULL) || \
+       (pads_base_virt_addr == NULL) || (dma_ctl_base_virt_addr == NULL) || \
+       (pwm_ctl_base_virt_addr == NULL)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: map_peripheral() returned a NULL address\n");
+            printf("Most likely did not run as root\n");
+            printf("ERROR: init_pwm() returned with %d\n", -EMAPFAIL);
+        }
+
+        // Exit with error:
+        return -EMAPFAIL;
+    }
+
+    // GPIO functions are selected in IO_BANK0:
+    gpio_base_virt_addr = io_bank_virt_addr;
+
+    // Set mapped peripheral address to register map:
+    rp1_pwm_reg = (struct rp1_pwm_reg_map*)pwm_ctl_base_virt_addr;
+
+    // Enable DMA controller:
+    dma_ctl_base_virt_addr[RP1_DMAC_CFG] = RP1_DMAC_EN;
+
+    // Disable PWM controller:
+    rp1_pwm_reg->global_ctrl = RP1_PWM_SET_UPDATE;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Clear FIFO buffer:
+    rp1_pwm_reg->fifo_ctrl = RP1_PWM_FIFO_FLUSH;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // One FIFO word per "wait" CB period (two pulse widths, see
+    // set_pwm()):
+    rp1_pwm_reg->chan0_range = (uint32_t)(2 * pulse_width_us * \
+        RP1_PWM_CLOCK_FREQ / 1e6);
+    rp1_pwm_reg->chan0_ctrl = RP1_PWM_MODE_TRAILING | RP1_PWM_USEFIFO;
+
+    // Enable DMA and set threshold:
+    rp1_pwm_reg->fifo_ctrl = RP1_PWM_FIFO_DREQ_EN | \
+        RP1_PWM_FIFO_THRESH(dreq_thresh);
+
+    // Enable channel:
+    rp1_pwm_reg->global_ctrl = RP1_PWM_SET_UPDATE | RP1_PWM_CHAN_EN(0);
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("RP1 PWM0 initialized:\n");
+        printf("PWM0 Register: GLOBAL_CTRL = 0x%08X\n", \
+            rp1_pwm_reg->global_ctrl);
+        printf("PWM0 Register: FIFO_CTRL = 0x%08X\n", rp1_pwm_reg->fifo_ctrl);
+        printf("PWM0 Register: CHAN0_RANGE = 0x%08X\n", \
+            rp1_pwm_reg->chan0_range);
+        printf("Initialized dma_pwm.c\n");
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Initialize
+static int init_pwm() {
+    // Definitions:
+    uint32_t bcm_peri_base_phys_addr;
+    uint32_t bcm_peri_base_bus_addr;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("DEBUG logs enabled for dma_pwm.c!\n");
+        printf("Initializing dma_pwm.c\n");
+    }
+
+    // Setup termination signal handler:
+    if (setup_signal_handler() != 0) {
+        // Exit with error:
+        return -ESIGHDNFAIL;
+    }
+
+    // Get PI version:
+    pi_version = get_pi_version__();
+
+    // Set BCM base addresses according to PI version:
+    if ((pi_version == 0) || (pi_version == 1)) {
+        // Set BCM base addresses:
+        bcm_peri_base_phys_addr = BCM2835_PERI_BASE_PHYS_ADDR;
+        bcm_peri_base_bus_addr = BCM2835_PERI_BASE_BUS_ADDR;
+    } else if ((pi_version == 2) || (pi_version == 3)) {
+        // Set BCM base addresses:
+        bcm_peri_base_phys_addr = BCM2837_PERI_BASE_PHYS_ADDR;
+        bcm_peri_base_bus_addr = BCM2837_PERI_BASE_BUS_ADDR;
+    } else if (pi_version == 4) {
+        // Set BCM base addresses:
+        bcm_peri_base_phys_addr = BCM2711_PERI_BASE_PHYS_ADDR;
+        bcm_peri_base_bus_addr = BCM2711_PERI_BASE_BUS_ADDR;
+    } else if (pi_version == 5) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("Setting PI board version as %d (RP1)\n", pi_version);
+        }
+
+        // GPIOs, PWM and DMA are on the RP1:
+        return init_rp1();
+    // Did not find PI version:
+    } else {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_pi_version() could not get PI board" \
+                " version\n");
+        }
+
+        // Exit with error:
+        return -ENOPIVER;
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Setting PI board version as %d\n", pi_version);
+        printf("BCM peripheral base physical address = 0x%08X\n", \
+            bcm_peri_base_phys_addr);
+        printf("BCM peripheral base bus address = 0x%08X\n", \
+            bcm_peri_base_bus_addr);
+    }
+
+    // Set peripheral addresses:
+    gpio_base_phys_addr = \
+        (bcm_peri_base_phys_addr + 0x200000); // GPIOs
+    dma_ctl_base_phys_addr = \
+        (bcm_peri_base_phys_addr + 0x007000); // DMA controller
+    pwm_ctl_base_phys_addr = \
+        (bcm_peri_base_phys_addr + 0x20C000); // PWM Controller
+    pwm_clk_base_phys_addr = \
+        (bcm_peri_base_phys_addr + 0x101000); // PWM Clock Manager
+    spi_base_phys_addr = \
+        (bcm_peri_base_phys_addr + 0x204000); // SPI0
 
     gpset0_bus_addr = (bcm_peri_base_bus_addr + 0x20001C); // GPIO Set
     gpclr0_bus_addr = (bcm_peri_base_bus_addr + 0x200028); // GPIO Clear
+    gplev0_bus_addr = (bcm_peri_base_bus_addr + 0x200034); // GPIO Level
     pwmfif1_bus_addr = (bcm_peri_base_bus_addr + 0x20C018); // PWM FIFO buffer
+    pwmrng1_bus_addr = (bcm_peri_base_bus_addr + 0x20C010); // PWM range
+    pwmupd_bus_addr = 0; // Range changes apply without an update
+    spififo_bus_addr = (bcm_peri_base_bus_addr + 0x204004); // SPI0 FIFO
+    stclo_bus_addr = (bcm_peri_base_bus_addr + 0x003004); // System timer
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
         printf("GPSET0 bus address = 0x%08X\n", gpset0_bus_addr);
         printf("GPCLR0 bus address = 0x%08X\n", gpclr0_bus_addr);
+        printf("GPLEV0 bus address = 0x%08X\n", gplev0_bus_addr);
         printf("PWMFIF1 bus address = 0x%08X\n", gpclr0_bus_addr);
     }
 
@@ -531,10 +1575,12 @@ static int init_pwm() {
     dma_ctl_base_virt_addr = map_peripheral__(dma_ctl_base_phys_addr);
     pwm_ctl_base_virt_addr = map_peripheral__(pwm_ctl_base_phys_addr);
     pwm_clk_base_virt_addr = map_peripheral__(pwm_clk_base_phys_addr);
+    spi_base_virt_addr = map_peripheral__(spi_base_phys_addr);
 
     // Abort if mapped incorrectly:
     if ((gpio_base_virt_addr == NULL) || (dma_ctl_base_virt_addr == NULL) || \
-       (pwm_ctl_base_virt_addr == NULL) || (pwm_clk_base_virt_addr == NULL)) {
+       (pwm_ctl_base_virt_addr == NULL) || (pwm_clk_base_virt_addr == NULL) || \
+       (spi_base_virt_addr == NULL)) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
@@ -546,6 +1592,7 @@ static int init_pwm() {
                 pwm_ctl_base_virt_addr);
             printf("PWM CLK base virtual address  = %p\n", \
                 pwm_clk_base_virt_addr);
+            printf("SPI0 base virtual address = %p\n", spi_base_virt_addr);
             printf("Most likely did not run as root\n");
             printf("ERROR: init_pwm() returned with %d\n", -EMAPFAIL);
         }
@@ -571,6 +1618,7 @@ static int init_pwm() {
     pwm_ctl_reg = (struct pwm_ctl_reg_map*)pwm_ctl_base_virt_addr;
     pwm_clk_reg = (struct pwm_clk_reg_map*)\
         ((char*)pwm_clk_base_virt_addr + PWM_CLK);
+    spi_reg = (struct spi_reg_map*)spi_base_virt_addr;
 
     // Reset PWM controller:
     pwm_ctl_reg->ctl = 0;
@@ -603,7 +1651,8 @@ static int init_pwm() {
     nanosleep(&delay, NULL);
 
     // Enable DMA and set threshold
-    pwm_ctl_reg->dmac = (PWM_DMA_ENB | PWM_DREQ_THRESH | PWM_PANIC_THRESH);
+    pwm_ctl_reg->dmac = (PWM_DMA_ENB | PWM_DREQ_THRESH(dreq_thresh) | \
+        PWM_PANIC_THRESH(panic_thresh));
 
     // Delay per data sheet:
     nanosleep(&delay, NULL);
@@ -640,84 +1689,154 @@ static int init_pwm() {
 // - Set up PWM clock mananger
 // - Set up PWM controller
 // - Set up all DMA channels
-// - Allocate page aligned memory for CB
+// - Allocate page aligned memory for CB (pooled channels already hold it)
 static int init_channel(int channel) {
-    // Definitions:
-    int i;
-
-    size_t page_size; // Page size
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Initializing channel %d\n", channel);
+    }
 
-    // Get page size:
-    page_size = getpagesize();
+    // Reset state:
+    reset_channel(channel);
 
-    // Set flags:
-    dma_channels[channel].enabled = 0;
-    dma_channels[channel].selected_cb_buf = 1;
-    dma_channels[channel].seq_built = 0;
+    // Allocate buffers:
+    if (!(dma_channels_pooled[channel])) {
+        alloc_channel(channel);
+    }
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("Initializing channel %d\n", channel);
-        printf("Setting page size to %d bytes\n", page_size);
-        printf("Setting channel %d selected CB buffer to %d\n", channel, \
-            dma_channels[channel].selected_cb_buf);
+        printf("Channel %d initialized\n", channel);
     }
 
-    // Initialize for each buffer:
-    for (i = 0; i < 2; i++) {
-        // Allocate memory for uncached mem structs:
-        dma_channels[channel].cb_base[i] = \
-            malloc(sizeof(struct uncached_mem));
-        dma_channels[channel].set_mask[i] = \
-            malloc(sizeof(struct uncached_mem));
-        dma_channels[channel].clear_mask[i] = \
-            malloc(sizeof(struct uncached_mem));
+    // Exit with success:
+    return 0;
+}
+
+// Get highest GPIO of bank 0 (sampled by input capture and ranging):
+static int max_bank0_gpio(void) {
+    // Return highest GPIO:
+    return (pi_version == 5) ? RP1_MAX_GPIO : 31;
+}
+
+// Set a GPIO to output:
+static void gpio_out(int gpio) {
+    // RP1 GPIOs are driven by RIO:
+    if (pi_version == 5) {
+        RP1_GPIO_RIO(gpio_base_virt_addr, gpio);
+        RP1_PAD_EN(pads_base_virt_addr, gpio);
+        RP1_GPIO_OUT(rio_set_virt_addr, gpio);
+    } else {
+        GPIO_OUT(gpio_base_virt_addr, gpio);
+    }
+}
+
+// Set a GPIO to input:
+static void gpio_in(int gpio) {
+    // RP1 GPIOs are read from RIO:
+    if (pi_version == 5) {
+        RP1_GPIO_RIO(gpio_base_virt_addr, gpio);
+        RP1_PAD_EN(pads_base_virt_addr, gpio);
+        RP1_GPIO_INP(rio_clr_virt_addr, gpio);
+    } else {
+        GPIO_INP(gpio_base_virt_addr, gpio);
+    }
+}
 
-        // Set uncached memory struct size and alignment:
-        dma_channels[channel].cb_base[i]->size = \
-            page_size * allocated_pages;
-        dma_channels[channel].cb_base[i]->alignment = page_size;
+// Clear a GPIO:
+static void gpio_clear(int gpio) {
+    // RP1 GPIOs are driven by RIO:
+    if (pi_version == 5) {
+        RP1_GPIO_CLEAR(rio_clr_virt_addr, gpio);
+    } else {
+        GPIO_CLEAR(gpio_base_virt_addr, gpio);
+    }
+}
 
-        dma_channels[channel].set_mask[i]->size = sizeof(uint32_t);
-        dma_channels[channel].set_mask[i]->alignment = sizeof(uint32_t);
+// Stop a DMA channel of an exited process:
+// (before releasing its memory, which the DMA may still be reading if the
+// process was killed without teardown_outputs())
+static void stop_stale_dma(int channel) {
+    // Definitions:
+    volatile uint32_t *reg; // DMA channel registers
 
-        dma_channels[channel].clear_mask[i]->size = sizeof(uint32_t);
-        dma_channels[channel].clear_mask[i]->alignment = sizeof(uint32_t);
+    // Not a channel of this library:
+    if ((channel < 0) || (channel >= NUM_DMA_CHANNELS)) {
+        // Exit:
+        return;
+    }
 
-        // Allocate page aligned uncached memory via mailbox:
-        dma_channels[channel].cb_base[i] = \
-            uncached_malloc__(dma_channels[channel].cb_base[i]);
-        dma_channels[channel].set_mask[i] = \
-            uncached_malloc__(dma_channels[channel].set_mask[i]);
-        dma_channels[channel].clear_mask[i] = \
-            uncached_malloc__(dma_channels[channel].clear_mask[i]);
+    // RP1 DMA channels are used from the highest down:
+    if (pi_version == 5) {
+        dma_ctl_base_virt_addr[RP1_DMAC_CHEN] = \
+            RP1_CH_EN_WE(RP1_NUM_DMA_CHANNELS - 1 - channel);
 
-        // Bus addresses for DMA transfer:
-        dma_channels[channel].cb_base_bus_addr[i] = \
-            dma_channels[channel].cb_base[i]->bus_addr;
-        dma_channels[channel].set_mask_bus_addr[i] = \
-            dma_channels[channel].set_mask[i]->bus_addr;
-        dma_channels[channel].clear_mask_bus_addr[i] = \
-            dma_channels[channel].clear_mask[i]->bus_addr;
+        // Exit:
+        return;
     }
 
-    // Map DMA register map:
-    dma_channels[channel].dma_reg = \
-        (struct dma_reg_map*)((char *)dma_ctl_base_virt_addr + \
-        0x100 * valid_dma_channels[channel]);
+    // Reset DMA4 engines from the debug register, others from CS:
+    reg = dma_ctl_base_virt_addr + \
+        ((0x100 * valid_dma_channels[channel]) / 4);
+    if ((pi_version == 4) && \
+       (valid_dma_channels[channel] >= BCM2711_DMA4_FIRST)) {
+        ((volatile struct dma4_reg_map*)reg)->debug = DMA4_RESET;
+    } else {
+        ((volatile struct dma_reg_map*)reg)->cs = DMA_RESET;
+    }
+}
+
+// Initialize memory and hardware if not yet initialized:
+static int init_once() {
+    // Definitions:
+    int ret; // Function return value
+
+    // Already initialized:
+    if (init_state) {
+        // Exit with success:
+        return 0;
+    }
+
+    // Initialize:
+    if ((ret = init_pwm()) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: Could not initialize dma_pwm.c\n");
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Release memory left by a process that crashed or was killed:
+    ret = uncached_reclaim__(stop_stale_dma);
 
     // Debug logs:
-    if (DEBUG) {
+    if (DEBUG && (ret > 0)) {
         // Logs:
-        printf("Channel %d initialized with %d bytes allocated (x2)\n", \
-            channel, (page_size * allocated_pages));
+        printf("Released %d blocks of exited processes\n", ret);
     }
 
+    // Set status to true:
+    init_state = 1;
+
     // Exit with success:
     return 0;
 }
 
+// Measure CB overhead of this board on the first initialized channel (the
+// timing model falls back to no overhead if this fails):
+static void calibrate_once(int channel) {
+    // Calibrate once:
+    if (init_state == 1) {
+        calibrate_pwm(channel);
+        init_state = 2;
+    }
+}
+
 // Request an available DMA channel to use for PWM:
 int request_pwm() {
     // Definitions:
@@ -727,25 +1846,36 @@ int request_pwm() {
     int channel; // Available DMA channel
 
     // Initialize if not yet initialized:
-    if (!(init_state)) {
-        // Initialize:
-        if ((ret = init_pwm()) < 0) {
-            // Debug logs:
-            if (DEBUG) {
-                // Logs:
-                printf("ERROR: Could not initialize dma_pwm.c\n");
-            }
+    if ((ret = init_once()) < 0) {
+        // Exit with error:
+        return ret;
+    }
 
-            // Exit with error:
-            return ret;
+    // Abort if the bus budget cannot hold another channel's slowest
+    // signal (one PWM controller write per "wait" period):
+    if ((ret = check_bus_budget(-1, seq_bus_rate(0, 1, \
+        2 * pulse_width_us))) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: request_pwm() returned with %d\n", ret);
         }
 
-        // Set status to true:
-        init_state = 1;
+        // Exit with error:
+        return ret;
     }
 
-    // Find available channel
+    // Find available channel (pooled channels first, they need no
+    // allocation):
     for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        // Check if channel is available and pooled:
+        if (dma_channels_status[i] && dma_channels_pooled[i]) {
+            // Exit:
+            break;
+        }
+    }
+
+    for (i = (i == NUM_DMA_CHANNELS) ? 0 : i; i < NUM_DMA_CHANNELS; i++) {
         // Check if channel is available:
         if (dma_channels_status[i]) {
             // Set channel as index:
@@ -777,613 +1907,6703 @@ int request_pwm() {
     // Initialize channel:
     init_channel(channel);
 
+    // Measure CB overhead of this board on the first channel:
+    calibrate_once(channel);
+
     // Return available channel:
     return channel;
 }
 
-// Build control block sequence for a DMA channel:
-static void build_cb_seq(int channel) {
+// Keep buffers of a number of channels allocated across requests:
+int pool_pwm(int num_channels) {
     // Definitions:
     int i;
+    int ret; // Function return value
 
-    int cb_buf; // Which CB buffer to use
+    int num_pooled = 0; // Number of pooled channels
 
-    // Get which CB buffer to use:
-    cb_buf = dma_channels[channel].selected_cb_buf;
+    // Abort if number of channels does not make sense:
+    if ((num_channels < 0) || (num_channels > NUM_DMA_CHANNELS)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: %d pooled channels is nonsensical\n", \
+                num_channels);
+            printf("ERROR: pool_pwm() returned %d\n", -EINVCHNL);
+        }
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("Building CB sequence for channel %d on buffer %d \n", \
-            channel, cb_buf);
+        // Exit with error:
+        return -EINVCHNL;
     }
 
-    // Assign control block sequence to channel's cb virtual base:
-    // (virtual base begins at a page-aligned addresses located in
-    // uncached memory)
-    struct dma_cb *dma_cb_seq = \
-        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    // Initialize if not yet initialized:
+    if (num_channels && ((ret = init_once()) < 0)) {
+        // Exit with error:
+        return ret;
+    }
 
-    // Build CB sequence:
-    for (i = 0; i < dma_channels[channel].cb_seq_num; i++) {
-        // Set or clear GPIOs depending on duty cycle for first CB:
-        if (i == 0) {
-            // Build control block
-            dma_cb_seq->info = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP;
+    // Count pooled channels:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        num_pooled += dma_channels_pooled[i];
+    }
 
-            // Set GPIOs if duty cycle is not 0:
-            if ((int)dma_channels[channel].pwm_d_des != 0) {
-                dma_cb_seq->src = \
-                    dma_channels[channel].set_mask_bus_addr[cb_buf];
-                dma_cb_seq->dst = gpset0_bus_addr;
-            } else {
-                dma_cb_seq->src = \
-                    dma_channels[channel].clear_mask_bus_addr[cb_buf];
-                dma_cb_seq->dst = gpclr0_bus_addr;
+    // Pool free channels until there are enough:
+    for (i = 0; (i < NUM_DMA_CHANNELS) && (num_pooled < num_channels); i++) {
+        // Skip requested and pooled channels:
+        if (!(dma_channels_status[i]) || dma_channels_pooled[i]) {
+            // Next channel:
+            continue;
+        }
+
+        // Allocate buffers:
+        alloc_channel(i);
+        dma_channels_pooled[i] = 1;
+        num_pooled++;
+
+        // Measure CB overhead of this board now instead of on the first
+        // request (the channel is held while calibrating):
+        if (init_state == 1) {
+            dma_channels_status[i] = 0;
+            reset_channel(i);
+            calibrate_once(i);
+            disable_pwm(i);
+            dma_channels_status[i] = 1;
+        }
+    }
+
+    // Release free channels, and then requested ones when they are freed,
+    // until there are few enough:
+    for (i = NUM_DMA_CHANNELS; (i-- > 0) && (num_pooled > num_channels);) {
+        // Skip channels that are not pooled:
+        if (!(dma_channels_pooled[i])) {
+            // Next channel:
+            continue;
+        }
+
+        // Free buffers now if the channel is free:
+        if (dma_channels_status[i]) {
+            dealloc_channel(i);
+        }
+
+        dma_channels_pooled[i] = 0;
+        num_pooled--;
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("%d channels pooled\n", num_pooled);
+    }
+
+    // Exit with number of pooled channels:
+    return num_pooled;
+}
+
+// Get maximum PWM controller writes of one paced CB of a channel:
+static size_t max_paced_words(int channel) {
+    // Return maximum:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        return RP1_DMA_MAX_PACED_WORDS;
+    }
+    return (dma_channels[channel].engine == DMA_ENGINE_DMA4) ? \
+        DMA4_MAX_PACED_WORDS : MAX_PACED_WORDS;
+}
+
+// Get size of a translated CB of a channel:
+// (RP1 descriptors take twice the space of the CBs they are built from)
+static size_t cb_size(int channel) {
+    // Return size:
+    return (dma_channels[channel].engine == DMA_ENGINE_RP1) ? \
+        sizeof(struct rp1_dma_cb) : sizeof(struct dma_cb);
+}
+
+// Convert a bus address to bits 31:0 of a DMA4 address, setting bits 39:32
+// in high:
+static uint32_t dma4_addr(uint32_t bus_addr, uint32_t *high) {
+    // Peripherals keep their bus address in the 40 bit map:
+    if ((bus_addr & 0xFF000000) == BCM2711_PERI_BASE_BUS_ADDR) {
+        // Exit with peripheral address:
+        *high = DMA4_PERI_ADDR_HIGH;
+        return bus_addr;
+    }
+
+    // Exit with SDRAM address (no uncached alias):
+    *high = 0;
+    return bus_addr & DMA4_RAM_ADDR_MASK;
+}
+
+// Convert a bus address to an RP1 DMA address, setting bits 63:32 in high:
+static uint32_t rp1_addr(uint32_t bus_addr, uint32_t *high) {
+    // RP1 peripherals:
+    if ((bus_addr & 0xF0000000) == RP1_PERI_BASE_BUS_ADDR) {
+        // Exit with peripheral address:
+        *high = 0;
+        return bus_addr;
+    }
+
+    // Exit with host SDRAM address (through PCIe):
+    *high = RP1_RAM_ADDR_HIGH;
+    return bus_addr & DMA4_RAM_ADDR_MASK;
+}
+
+// Enable or disable an RP1 DMA channel:
+// (channel enable bits of other channels are written back unchanged, their
+// write enable bits are not set)
+static void enable_rp1_dma(int channel, int enable) {
+    // Definitions:
+    int c; // RP1 DMA channel number
+
+    // Write own enable bit:
+    c = dma_channels[channel].rp1_channel;
+    dma_ctl_base_virt_addr[RP1_DMAC_CHEN] = \
+        (dma_ctl_base_virt_addr[RP1_DMAC_CHEN] & 0xFF & ~RP1_CH_EN(c)) | \
+        (enable ? RP1_CH_EN(c) : 0) | RP1_CH_EN_WE(c);
+}
+
+// Reset a DMA channel:
+static void reset_dma(int channel) {
+    // RP1 DMA channels stop when disabled:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        enable_rp1_dma(channel, 0);
+    // DMA4 engines reset from the debug register:
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        dma_channels[channel].dma4_reg->debug |= DMA4_RESET;
+    } else {
+        dma_channels[channel].dma_reg->cs |= DMA_RESET;
+    }
+}
+
+// Get bus address of the descriptor an RP1 DMA channel is executing:
+// (0 if none)
+static uint32_t current_rp1_cb(int channel) {
+    // Definitions:
+    int cb_buf;   // Which CB buffer is loaded
+    size_t index; // Index of next descriptor
+
+    uint32_t high;  // Address bits 63:32
+    uint32_t base;  // Descriptor buffer RP1 address
+    uint32_t rearm; // Re-arm area RP1 address
+    uint32_t llp;   // Next descriptor RP1 address
+
+    // Nothing executing if disabled:
+    if (!(dma_ctl_base_virt_addr[RP1_DMAC_CHEN] & \
+        RP1_CH_EN(dma_channels[channel].rp1_channel))) {
+        // Exit:
+        return 0;
+    }
+
+    // Get next descriptor:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+    base = rp1_addr(dma_channels[channel].cb_base_bus_addr[cb_buf], &high);
+    rearm = rp1_addr(dma_channels[channel].rearm_bus_addr[cb_buf], &high);
+    llp = dma_channels[channel].rp1_reg->llp[0];
+    index = (llp - base) / sizeof(struct rp1_dma_cb);
+
+    // Re-arming the sequence after its last descriptor:
+    if ((llp >= rearm) && \
+       ((llp - rearm) < dma_channels[channel].rearm[cb_buf]->size)) {
+        index = 0;
+    }
+
+    // Outside the sequence (e.g. not yet loaded):
+    if (index > dma_channels[channel].cb_num[cb_buf]) {
+        // Exit:
+        return 0;
+    }
+
+    // Sequences only link back to their first descriptor from their last
+    // (or its re-arm descriptors):
+    index = (index == 0) ? dma_channels[channel].cb_num[cb_buf] : index;
+
+    // Exit with address of the descriptor before:
+    return dma_channels[channel].cb_base_bus_addr[cb_buf] + \
+        (index - 1) * sizeof(struct rp1_dma_cb);
+}
+
+// Check if a DMA channel reached the end of its CB chain:
+static int dma_done(int channel) {
+    // RP1 DMA channels disable themselves:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Exit with status:
+        return !(dma_ctl_base_virt_addr[RP1_DMAC_CHEN] & \
+            RP1_CH_EN(dma_channels[channel].rp1_channel));
+    }
+
+    // Exit with status:
+    return (dma_channels[channel].dma_reg->cs & DMA_END) ? 1 : 0;
+}
+
+// Stop a DMA channel:
+static void stop_dma(int channel) {
+    // RP1 DMA channels stop when disabled:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Reset channel:
+        reset_dma(channel);
+
+        // Delay per data sheet:
+        nanosleep(&delay, NULL);
+
+        // Exit:
+        return;
+    }
+
+    // Abort current DMA transfer:
+    dma_channels[channel].dma_reg->cs |= DMA_ABORT;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Pause DMA transfer:
+    dma_channels[channel].dma_reg->cs &= ~DMA_ACTIVE;
+
+    // Reset channel:
+    reset_dma(channel);
+}
+
+// Get bus address of the control block a DMA channel is executing:
+// (0 if none)
+static uint32_t current_cb(int channel) {
+    // Definitions:
+    uint32_t cb; // DMA4 control block address bits 39:5
+
+    // RP1 DMA channels hold the next descriptor (the one before it is
+    // executing) until disabled:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Exit with address:
+        return current_rp1_cb(channel);
+    }
+
+    // Legacy engines hold the bus address:
+    if (dma_channels[channel].engine != DMA_ENGINE_DMA4) {
+        // Exit with address:
+        return dma_channels[channel].dma_reg->conblk_ad;
+    }
+
+    // DMA4 engines hold the SDRAM address; restore the uncached alias:
+    cb = dma_channels[channel].dma4_reg->cb;
+
+    // Exit with address:
+    return cb ? ((cb << 5) | (dma_channels[channel].cb_base_bus_addr[0] & \
+        ~DMA4_RAM_ADDR_MASK)) : 0;
+}
+
+// Stop a DMA channel and set it up to be started by run_dma():
+static void prepare_dma(int channel) {
+    // RP1 DMA channels have their own registers:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Stop channel:
+        stop_dma(channel);
+
+        // Linked list descriptors with writes paced by the PWM FIFO:
+        dma_channels[channel].rp1_reg->cfg[0] = RP1_DMA_CFG_LLI | \
+            RP1_DMA_CFG_DST_PER(RP1_DREQ_PWM0);
+        dma_channels[channel].rp1_reg->cfg[1] = RP1_DMA_CFG_MEM_TO_PER;
+
+        // Exit:
+        return;
+    }
+
+    // Abort current DMA transfer:
+    dma_channels[channel].dma_reg->cs |= DMA_ABORT;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Pause DMA transfer:
+    dma_channels[channel].dma_reg->cs &= ~DMA_ACTIVE;
+
+    // Clear transfer complete:
+    dma_channels[channel].dma_reg->cs |= DMA_END;
+
+    // Reset channel:
+    reset_dma(channel);
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Set transaction priority and wait for outstanding writes:
+    dma_channels[channel].dma_reg->cs = \
+        DMA_PANIC_PRIO(dma_channels[channel].panic_prio) | \
+        DMA_PRIO(dma_channels[channel].prio) | DMA_WAIT;
+}
+
+// Get the control block register of a DMA channel as the engine holds it:
+// (DMA4 address bits 39:5, or the next descriptor of an RP1 DMA channel)
+static uint32_t cb_reg(int channel) {
+    // Return register:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        return dma_channels[channel].rp1_reg->llp[0];
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        return dma_channels[channel].dma4_reg->cb;
+    }
+
+    return dma_channels[channel].dma_reg->conblk_ad;
+}
+
+// Load the control block register (and RP1 address bits 63:32) of a
+// prepared DMA channel and start it:
+// (no delays, so that another engine can be handed over to it)
+static void run_dma(int channel, uint32_t cb, uint32_t high) {
+    // Load first control block and let's go:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        dma_channels[channel].rp1_reg->llp[0] = cb;
+        dma_channels[channel].rp1_reg->llp[1] = high;
+        enable_rp1_dma(channel, 1);
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        dma_channels[channel].dma4_reg->cb = cb;
+        dma_channels[channel].dma_reg->cs |= DMA_ACTIVE;
+    } else {
+        dma_channels[channel].dma_reg->conblk_ad = cb;
+        dma_channels[channel].dma_reg->cs |= DMA_ACTIVE;
+    }
+}
+
+// Restart a DMA channel at a control block:
+static void start_dma(int channel, uint32_t cb_bus_addr) {
+    // Definitions:
+    uint32_t cb;   // Control block register
+    uint32_t high; // DMA4 address bits 39:32 or RP1 address bits 63:32
+
+    // Stop and set up channel:
+    prepare_dma(channel);
+
+    // Get control block register:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        cb = rp1_addr(cb_bus_addr, &high);
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        cb = dma4_addr(cb_bus_addr, &high) >> 5;
+    } else {
+        cb = cb_bus_addr;
+        high = 0;
+    }
+
+    // Let's go:
+    run_dma(channel, cb, high);
+
+    // Debug logs:
+    if (DEBUG && (dma_channels[channel].engine == DMA_ENGINE_RP1)) {
+        // Logs:
+        printf("RP1 DMA Channel %d Register: LLP = 0x%02X%08X\n", \
+            dma_channels[channel].rp1_channel, \
+            dma_channels[channel].rp1_reg->llp[1], \
+            dma_channels[channel].rp1_reg->llp[0]);
+    } else if (DEBUG) {
+        // Logs:
+        printf("DMA Channel %d Register: CONBLK_AD = 0x%08X\n", \
+            channel, current_cb(channel));
+        printf("DMA Channel %d Register: CS = 0x%08X\n", \
+            channel, dma_channels[channel].dma_reg->cs);
+    }
+}
+
+// Get the CB buffer a channel's DMA is executing:
+// (-1 if stopped or not known; an RP1 channel holding the first descriptor
+// of a buffer may still be executing the last one of another)
+static int executing_buf(int channel) {
+    // Definitions:
+    int i;
+
+    uint32_t addr; // Current (next on RP1) control block address
+    uint32_t base;  // Buffer address
+    uint32_t rearm; // RP1 re-arm area address
+    uint32_t high;  // Address bits 63:32
+    size_t index;   // Control block index in buffer
+
+    // RP1 DMA channels hold the next descriptor:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        addr = (dma_ctl_base_virt_addr[RP1_DMAC_CHEN] & \
+            RP1_CH_EN(dma_channels[channel].rp1_channel)) ? \
+            dma_channels[channel].rp1_reg->llp[0] : 0;
+    } else {
+        addr = current_cb(channel);
+    }
+
+    // Find the buffer holding it:
+    for (i = 0; (i < NUM_CB_BUFS) && addr; i++) {
+        // Skip buffers without a sequence:
+        if (((i < SEQ_CACHE_FIRST) && (i >= ring_bufs)) || \
+           ((i >= SEQ_CACHE_FIRST) && \
+           !(dma_channels[channel].cache[i - SEQ_CACHE_FIRST].valid))) {
+            continue;
+        }
+
+        // Index of control block in buffer:
+        base = dma_channels[channel].cb_base_bus_addr[i];
+        base = (dma_channels[channel].engine == DMA_ENGINE_RP1) ? \
+            rp1_addr(base, &high) : base;
+        index = (addr - base) / cb_size(channel);
+
+        if ((addr >= base) && (index < dma_channels[channel].cb_num[i])) {
+            // Exit with buffer (unknown if ambiguous):
+            return ((dma_channels[channel].engine == DMA_ENGINE_RP1) && \
+                (index == 0)) ? -1 : i;
+        }
+
+        // Re-arming an RP1 sequence after its last descriptor:
+        if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+            rearm = rp1_addr(dma_channels[channel].rearm_bus_addr[i], &high);
+
+            if ((addr >= rearm) && \
+               ((addr - rearm) < dma_channels[channel].rearm[i]->size)) {
+                // Exit with buffer:
+                return i;
             }
-            dma_cb_seq->length = 4;
-            dma_cb_seq->stride = 0;
-            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
-                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
-        // Clear GPIOs for non-trivial duty cycles (no need to clear in
-        // those cases once "wait" CB while GPIO is set expends):
-        } else if ((i == (dma_channels[channel].cb_set_num + 1)) && \
-        ((int)dma_channels[channel].pwm_d_des % 100 != 0)) {
-            // Build control block
-            dma_cb_seq->info = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP;
-            dma_cb_seq->src = \
-                dma_channels[channel].clear_mask_bus_addr[cb_buf];
-            dma_cb_seq->dst = gpclr0_bus_addr;
-            dma_cb_seq->length = 4;
-            dma_cb_seq->stride = 0;
-            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
-                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
-        // Write data to PWM controller to wait if no need to clear or
-        // set GPIOs:
+        }
+    }
+
+    // Exit with not known:
+    return -1;
+}
+
+// Mark every CB buffer of a channel free except the selected one, which is
+// live if running:
+static void reset_ring(int channel, int running) {
+    // Definitions:
+    int i;
+
+    // Update states:
+    for (i = 0; i < NUM_CB_BUFS; i++) {
+        dma_channels[channel].buf_state[i] = BUF_FREE;
+    }
+
+    dma_channels[channel].buf_state[dma_channels[channel].selected_cb_buf] = \
+        running ? BUF_LIVE : BUF_FREE;
+}
+
+// Update CB buffer states from the control block the DMA is executing:
+// (every running or queued sequence links to the selected one, which loops
+// on itself, so the others are unreachable once the DMA is in it)
+static void update_ring(int channel) {
+    // Definitions:
+    int cur; // Buffer being executed
+
+    // Nothing to update if not running or not known:
+    if ((cur = executing_buf(channel)) < 0) {
+        // Exit:
+        return;
+    }
+
+    // Others are free once the DMA reached the selected buffer:
+    if (cur == dma_channels[channel].selected_cb_buf) {
+        reset_ring(channel, 1);
+    } else {
+        dma_channels[channel].buf_state[cur] = BUF_LIVE;
+    }
+}
+
+// Restore the RP1 DMA descriptors of a CB buffer's sequence from their
+// templates before the DMA enters it (descriptors it completed are no longer
+// valid, see translate_rp1_seq()):
+static void rearm_rp1_seq(int channel, int cb_buf) {
+    // Definitions:
+    size_t i;
+
+    size_t num_cbs; // Number of descriptors
+    size_t blocks;  // Template blocks
+
+    struct rp1_dma_cb desc;            // Template
+    volatile struct rp1_dma_cb *rp1;   // RP1 DMA descriptors
+    volatile struct rp1_dma_cb *rearm; // Templates and re-arm descriptors
+
+    // Nothing to restore on other engines:
+    if (dma_channels[channel].engine != DMA_ENGINE_RP1) {
+        // Exit:
+        return;
+    }
+
+    // Get buffer:
+    rp1 = (volatile struct rp1_dma_cb*)dma_channels[channel]. \
+        cb_base[cb_buf]->virt_addr;
+    rearm = (volatile struct rp1_dma_cb*)dma_channels[channel]. \
+        rearm[cb_buf]->virt_addr;
+    num_cbs = dma_channels[channel].cb_num[cb_buf];
+    blocks = dma_channels[channel].rearm_blocks[cb_buf];
+
+    // Restore descriptors:
+    for (i = 0; i < num_cbs; i++) {
+        copy_from_uncached__((uint32_t*)&desc, \
+            (volatile uint32_t*)&rearm[i], sizeof(desc) / 4);
+        copy_to_uncached__((volatile uint32_t*)&rp1[i], (uint32_t*)&desc, \
+            sizeof(desc) / 4);
+    }
+
+    // Restore re-arm descriptors:
+    for (i = 0; blocks && (i < blocks + 2); i++) {
+        copy_from_uncached__((uint32_t*)&desc, \
+            (volatile uint32_t*)&rearm[num_cbs + blocks + 2 + i], \
+            sizeof(desc) / 4);
+        copy_to_uncached__((volatile uint32_t*)&rearm[num_cbs + i], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+    }
+}
+
+// Mark the RP1 DMA descriptor at an RP1 address valid again, so that
+// another channel can restart it once the one executing it wrote it back:
+static void revalidate_rp1_cb(int channel, uint32_t addr) {
+    // Definitions:
+    int i;
+
+    uint32_t high;   // Address bits 63:32
+    uint32_t base;   // CB buffer RP1 address
+    uint32_t rearm;  // Re-arm area RP1 address
+    char *virt_addr; // Descriptor virtual address
+
+    // Find the buffer or re-arm area holding it:
+    for (i = 0; i < NUM_CB_BUFS; i++) {
+        // Skip buffers without a sequence:
+        if (((i < SEQ_CACHE_FIRST) && (i >= ring_bufs)) || \
+           ((i >= SEQ_CACHE_FIRST) && \
+           !(dma_channels[channel].cache[i - SEQ_CACHE_FIRST].valid))) {
+            continue;
+        }
+
+        base = rp1_addr(dma_channels[channel].cb_base_bus_addr[i], &high);
+        rearm = rp1_addr(dma_channels[channel].rearm_bus_addr[i], &high);
+
+        if ((addr >= base) && \
+           ((addr - base) < dma_channels[channel].cb_base[i]->size)) {
+            virt_addr = (char*)dma_channels[channel].cb_base[i]->virt_addr + \
+                (addr - base);
+        } else if ((addr >= rearm) && \
+           ((addr - rearm) < dma_channels[channel].rearm[i]->size)) {
+            virt_addr = (char*)dma_channels[channel].rearm[i]->virt_addr + \
+                (addr - rearm);
         } else {
-            // Build control block
-            dma_cb_seq->info = DMA_NO_WIDE_BURSTS | DMA_WAIT_RESP | \
-                DMA_DREQ | DMA_PER_MAP(5);
-            dma_cb_seq->src = 0xABCDEF; // Random data
-            dma_cb_seq->dst = pwmfif1_bus_addr;
-            dma_cb_seq->length = 4;
-            dma_cb_seq->stride = 0;
-            // Link to beginning of the sequence if last iteration:
-            if (i == (dma_channels[channel].cb_seq_num - 1)) {
-                // Link to beginning:
-                dma_cb_seq->next = \
-                    dma_channels[channel].cb_base_bus_addr[cb_buf];
-            // Continue:
-            } else {
-                // Link to next CB:
-                dma_cb_seq->next = uncached_virt_to_bus_addr__( \
-                    dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
-            }
+            continue;
+        }
+
+        // Set valid bit (one word write):
+        ((volatile struct rp1_dma_cb*)virt_addr)->ctl[1] |= \
+            RP1_DMA_LLI_VALID;
+
+        // Exit:
+        return;
+    }
+}
+
+// Link the last control block of a CB buffer's looping sequence to the
+// first one of a buffer:
+static void link_seq(int channel, int from_buf, int to_buf) {
+    // Definitions:
+    size_t last;   // Last control block
+    size_t blocks; // RP1 template blocks
+
+    uint32_t high; // Address bits 63:32 (39:32 on DMA4)
+    uint32_t to;   // Bus address of first control block
+
+    volatile struct rp1_dma_cb *rearm; // RP1 re-arm area
+
+    // Get last control block and first one to link to:
+    last = dma_channels[channel].cb_num[from_buf] - 1;
+    to = dma_channels[channel].cb_base_bus_addr[to_buf];
+    blocks = dma_channels[channel].rearm_blocks[from_buf];
+
+    // Link (one word write, the DMA loads whole control blocks; a re-armed
+    // RP1 sequence links from its last re-arm descriptor, template first as
+    // the one before restores it):
+    if ((dma_channels[channel].engine == DMA_ENGINE_RP1) && blocks) {
+        rearm = (volatile struct rp1_dma_cb*)dma_channels[channel]. \
+            rearm[from_buf]->virt_addr;
+        rearm[last + 2 * blocks + 4].llp[0] = rp1_addr(to, &high);
+        rearm[last + blocks + 2].llp[0] = rp1_addr(to, &high);
+    } else if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        ((volatile struct rp1_dma_cb*)dma_channels[channel]. \
+            cb_base[from_buf]->virt_addr)[last].llp[0] = rp1_addr(to, &high);
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        ((volatile struct dma4_cb*)dma_channels[channel]. \
+            cb_base[from_buf]->virt_addr)[last].next_cb = \
+            dma4_addr(to, &high) >> 5;
+    } else {
+        ((volatile struct dma_cb*)dma_channels[channel]. \
+            cb_base[from_buf]->virt_addr)[last].next = to;
+    }
+}
+
+// Precompute the output stop of an enabled channel for teardown_outputs():
+// (disarmed while it is rewritten, as a signal may arrive at any time)
+static void arm_teardown(int channel) {
+    // Definitions:
+    uint8_t mode; // Mode of the channel
+
+    struct teardown *t; // Output stop
+
+    t = &teardowns[channel];
+    mode = dma_channels[channel].mode;
+    teardown_armed[channel] = 0;
+
+    // Stop DMA with a single write:
+    if ((mode == CHANNEL_MODE_CLOCK) || (mode == CHANNEL_MODE_PWM2)) {
+        t->halt_reg = NULL;
+    } else if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        t->halt_reg = &dma_ctl_base_virt_addr[RP1_DMAC_CHEN];
+        t->halt_val = RP1_CH_EN_WE(dma_channels[channel].rp1_channel);
+    } else if (dma_channels[channel].engine == DMA_ENGINE_DMA4) {
+        t->halt_reg = &dma_channels[channel].dma4_reg->debug;
+        t->halt_val = DMA4_RESET;
+    } else {
+        t->halt_reg = &dma_channels[channel].dma_reg->cs;
+        t->halt_val = DMA_RESET;
+    }
+
+    // Stop clock (control register of its clock manager), PWM controller
+    // or SPI0 output:
+    t->out_reg = NULL;
+    if (mode == CHANNEL_MODE_CLOCK) {
+        t->out_reg = (volatile uint32_t*)((char*)pwm_clk_base_virt_addr + \
+            GP_CLK(dma_channels[channel].gpclk));
+        t->out_val = CM_BASE | dma_channels[channel].gpclk_ctl;
+    } else if ((mode == CHANNEL_MODE_PWM2) || (mode == CHANNEL_MODE_SERIAL)) {
+        t->out_reg = &pwm_ctl_reg->ctl;
+        t->out_val = 0;
+    } else if (mode == CHANNEL_MODE_SPI) {
+        t->out_reg = &spi_reg->cs;
+        t->out_val = SPI_CS_CLEAR;
+    }
+
+    // Clear the GPIOs of the signal and of clock, PWM channel 2, serializer
+    // or SPI outputs:
+    t->clear_mask = *(uint64_t*)dma_channels[channel].set_mask[ \
+        dma_channels[channel].selected_cb_buf]->virt_addr;
+    if ((mode == CHANNEL_MODE_CLOCK) || (mode == CHANNEL_MODE_PWM2) || \
+        (mode == CHANNEL_MODE_SERIAL) || (mode == CHANNEL_MODE_SPI)) {
+        t->clear_mask |= ((uint64_t)1 << dma_channels[channel].alt_gpio);
+    }
+
+    // RP1 GPIOs are cleared through RIO:
+    if (pi_version == 5) {
+        t->clr_reg = rio_clr_virt_addr;
+        t->clr_words = 1;
+    } else {
+        t->clr_reg = gpio_base_virt_addr + 10;
+        t->clr_words = 2;
+    }
+
+    teardown_armed[channel] = 1;
+}
+
+// Queue a looping PWM signal sequence of a running channel: each running
+// or queued sequence moves on to it at the end of its current period
+// instead of the DMA being restarted:
+static void queue_seq(int channel, int cb_buf) {
+    // Definitions:
+    int i;
+
+    // Loop on itself (cached sequences may have been linked elsewhere or
+    // left part way through):
+    rearm_rp1_seq(channel, cb_buf);
+    link_seq(channel, cb_buf, cb_buf);
+
+    // Link every sequence the DMA may be in or enter:
+    for (i = 0; i < NUM_CB_BUFS; i++) {
+        if ((i != cb_buf) && \
+           ((dma_channels[channel].buf_state[i] == BUF_LIVE) || \
+           (dma_channels[channel].buf_state[i] == BUF_QUEUED))) {
+            link_seq(channel, i, cb_buf);
+            dma_channels[channel].buf_state[i] = BUF_QUEUED;
+        }
+    }
+
+    // Update states (the DMA may already be in it):
+    dma_channels[channel].buf_state[cb_buf] = BUF_QUEUED;
+    dma_channels[channel].update_pending = 1;
+    update_ring(channel);
+
+    // Stop the GPIOs of the new sequence on teardown as well:
+    arm_teardown(channel);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Queued CB sequence of channel %d on buffer %d\n", \
+            channel, cb_buf);
+    }
+}
+
+// Get a free ring buffer of a channel to build a sequence in, other than
+// the selected one:
+// (stops the DMA if every buffer can still be reached, so that the new
+// sequence is started instead of queued)
+static int next_buf(int channel) {
+    // Definitions:
+    int i;
+
+    int buf;   // Candidate buffer
+    int first; // Buffer after the selected one
+
+    // Update states:
+    update_ring(channel);
+
+    // Search the ring from the buffer after the selected one:
+    first = (dma_channels[channel].selected_cb_buf < ring_bufs) ? \
+        (dma_channels[channel].selected_cb_buf + 1) : 0;
+
+    for (i = 0; i < ring_bufs; i++) {
+        buf = (first + i) % ring_bufs;
+
+        if ((buf != dma_channels[channel].selected_cb_buf) && \
+           (dma_channels[channel].buf_state[buf] == BUF_FREE)) {
+            // Exit with buffer:
+            return buf;
+        }
+    }
+
+    // Stop DMA, freeing every buffer:
+    if (dma_channels[channel].enabled) {
+        stop_dma(channel);
+    }
+
+    reset_ring(channel, 0);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("No free CB buffer on channel %d; DMA stopped\n", channel);
+    }
+
+    // Exit with buffer:
+    return first % ring_bufs;
+}
+
+// Set up an RP1 DMA descriptor copying words from one bus address to
+// another:
+static void rp1_copy_cb(struct rp1_dma_cb *desc, uint32_t src, uint32_t dst, \
+    size_t words, uint32_t next) {
+    // Definitions:
+    uint32_t high; // Address bits 63:32
+
+    // Addresses:
+    desc->sar[0] = rp1_addr(src, &high);
+    desc->sar[1] = high;
+    desc->dar[0] = rp1_addr(dst, &high);
+    desc->dar[1] = high;
+
+    // Number of 32 bit words:
+    desc->block_ts = words - 1;
+    desc->res1 = 0;
+
+    // Next descriptor:
+    desc->llp[0] = rp1_addr(next, &high);
+    desc->llp[1] = high;
+
+    // Both addresses increment:
+    desc->ctl[0] = RP1_DMA_WIDTH_32;
+    desc->ctl[1] = RP1_DMA_LLI_VALID;
+
+    // Status:
+    desc->sstat = 0;
+    desc->dstat = 0;
+    desc->llp_status[0] = 0;
+    desc->llp_status[1] = 0;
+    desc->res2[0] = 0;
+    desc->res2[1] = 0;
+}
+
+// Translate a built CB sequence to RP1 DMA descriptors:
+// (descriptors are twice the size of the CBs, so they are converted in
+// place from the last one and links are remapped by CB index; a template
+// of each is kept in the re-arm area of the buffer)
+//
+// The DMA writes back each descriptor it completes with its valid bit
+// cleared, so a looping sequence re-arms itself every round: the last
+// descriptor links to copies of the templates over the descriptors (one per
+// block of templates), then to a copy of the template of the last re-arm
+// descriptor over it and then to that last one, which copies the templates
+// of the other re-arm descriptors over them and links back to the first
+// descriptor (see link_seq()). The copies are paced like any other write,
+// so they run while the PWM FIFO drains the last "wait" CB writes.
+//
+// Re-arm area layout (in descriptors, with n CBs and k template blocks):
+// n templates, k + 1 copies, the last re-arm descriptor, templates of the
+// k + 2 re-arm descriptors.
+static void translate_rp1_seq(int channel, int cb_buf, size_t num_cbs) {
+    // Definitions:
+    size_t i;
+
+    uint32_t high; // Address bits 63:32
+
+    struct dma_cb cb;         // Legacy control block
+    struct rp1_dma_cb desc;   // RP1 DMA descriptor
+    struct dma_cb *legacy;    // Legacy control blocks
+    struct rp1_dma_cb *rp1;   // RP1 DMA descriptors
+    struct rp1_dma_cb *rearm; // Templates and re-arm descriptors
+
+    uint32_t base_bus_addr;  // CB buffer bus address
+    uint32_t rearm_bus_addr; // Re-arm area bus address
+
+    size_t blocks; // Template blocks (0 if the sequence does not loop)
+    size_t words;  // Template words left to copy
+
+    // Get buffer:
+    legacy = (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    rp1 = (struct rp1_dma_cb*)legacy;
+    rearm = (struct rp1_dma_cb*)dma_channels[channel].rearm[cb_buf]->virt_addr;
+    base_bus_addr = dma_channels[channel].cb_base_bus_addr[cb_buf];
+    rearm_bus_addr = dma_channels[channel].rearm_bus_addr[cb_buf];
+
+    // Copies of the templates (sequences only link back to their first
+    // descriptor from their last):
+    blocks = 0;
+    if (num_cbs && \
+       (((volatile struct dma_cb*)legacy)[num_cbs - 1].next == \
+       base_bus_addr)) {
+        blocks = (num_cbs * sizeof(struct rp1_dma_cb) / 4 + \
+            RP1_DMA_MAX_PACED_WORDS - 1) / RP1_DMA_MAX_PACED_WORDS;
+    }
+
+    dma_channels[channel].rearm_blocks[cb_buf] = blocks;
+
+    // Convert each CB from the last (descriptor i only overlaps CBs i and
+    // above):
+    for (i = num_cbs; i-- > 0;) {
+        // Copy as it is overwritten (uncached memory is read and written
+        // whole, in the widest accesses the CPU has):
+        copy_from_uncached__((uint32_t*)&cb, (volatile uint32_t*)&legacy[i], \
+            sizeof(cb) / 4);
+
+        // Addresses:
+        desc.sar[0] = rp1_addr(cb.src, &high);
+        desc.sar[1] = high;
+        desc.dar[0] = rp1_addr(cb.dst, &high);
+        desc.dar[1] = high;
+
+        // Number of 32 bit words:
+        desc.block_ts = (cb.length / 4) - 1;
+        desc.res1 = 0;
+
+        // Next descriptor (same index as the next CB, re-arming first when
+        // looping back) or end of list:
+        if (cb.next && blocks && (cb.next == base_bus_addr)) {
+            desc.llp[0] = rp1_addr(rearm_bus_addr + \
+                num_cbs * sizeof(struct rp1_dma_cb), &high);
+            desc.llp[1] = high;
+        } else if (cb.next) {
+            desc.llp[0] = rp1_addr(base_bus_addr + \
+                ((cb.next - base_bus_addr) / sizeof(struct dma_cb)) * \
+                sizeof(struct rp1_dma_cb), &high);
+            desc.llp[1] = high;
+        } else {
+            desc.llp[0] = 0;
+            desc.llp[1] = 0;
+        }
+
+        // Increments and last descriptor (every write is paced by the PWM
+        // FIFO handshake of the channel, which only holds back the "wait"
+        // CB writes that fill it):
+        desc.ctl[0] = RP1_DMA_WIDTH_32 | \
+            ((cb.info & DMA_SRC_INC) ? 0 : RP1_DMA_SINC_FIXED) | \
+            ((cb.info & DMA_DEST_INC) ? 0 : RP1_DMA_DINC_FIXED);
+        desc.ctl[1] = RP1_DMA_LLI_VALID | (cb.next ? 0 : RP1_DMA_LLI_LAST);
+
+        // Status:
+        desc.sstat = 0;
+        desc.dstat = 0;
+        desc.llp_status[0] = 0;
+        desc.llp_status[1] = 0;
+        desc.res2[0] = 0;
+        desc.res2[1] = 0;
+
+        // Write descriptor and its template:
+        copy_to_uncached__((volatile uint32_t*)&rp1[i], (uint32_t*)&desc, \
+            sizeof(desc) / 4);
+        copy_to_uncached__((volatile uint32_t*)&rearm[i], (uint32_t*)&desc, \
+            sizeof(desc) / 4);
+    }
+
+    // Re-arm descriptors of a looping sequence:
+    words = num_cbs * sizeof(struct rp1_dma_cb) / 4;
+    for (i = 0; i < blocks; i++) {
+        // Copy a block of templates over the descriptors:
+        rp1_copy_cb(&desc, rearm_bus_addr + i * RP1_DMA_MAX_PACED_WORDS * 4, \
+            base_bus_addr + i * RP1_DMA_MAX_PACED_WORDS * 4, \
+            (words > RP1_DMA_MAX_PACED_WORDS) ? \
+            RP1_DMA_MAX_PACED_WORDS : words, rearm_bus_addr + \
+            (num_cbs + i + 1) * sizeof(struct rp1_dma_cb));
+        words -= (words > RP1_DMA_MAX_PACED_WORDS) ? \
+            RP1_DMA_MAX_PACED_WORDS : words;
+
+        // Write re-arm descriptor and its template:
+        copy_to_uncached__((volatile uint32_t*)&rearm[num_cbs + i], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+        copy_to_uncached__( \
+            (volatile uint32_t*)&rearm[num_cbs + blocks + 2 + i], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+    }
+
+    if (blocks) {
+        // Copy the template of the last re-arm descriptor over it:
+        rp1_copy_cb(&desc, rearm_bus_addr + \
+            (num_cbs + 2 * blocks + 3) * sizeof(struct rp1_dma_cb), \
+            rearm_bus_addr + (num_cbs + blocks + 1) * \
+            sizeof(struct rp1_dma_cb), sizeof(desc) / 4, rearm_bus_addr + \
+            (num_cbs + blocks + 1) * sizeof(struct rp1_dma_cb));
+        copy_to_uncached__((volatile uint32_t*)&rearm[num_cbs + blocks], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+        copy_to_uncached__( \
+            (volatile uint32_t*)&rearm[num_cbs + 2 * blocks + 2], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+
+        // Copy the templates of the others over them and loop back:
+        rp1_copy_cb(&desc, rearm_bus_addr + \
+            (num_cbs + blocks + 2) * sizeof(struct rp1_dma_cb), \
+            rearm_bus_addr + num_cbs * sizeof(struct rp1_dma_cb), \
+            (blocks + 1) * sizeof(desc) / 4, base_bus_addr);
+        copy_to_uncached__((volatile uint32_t*)&rearm[num_cbs + blocks + 1], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+        copy_to_uncached__( \
+            (volatile uint32_t*)&rearm[num_cbs + 2 * blocks + 3], \
+            (uint32_t*)&desc, sizeof(desc) / 4);
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Translated %zu CBs of channel %d buffer %d to RP1 DMA\n", \
+            num_cbs, channel, cb_buf);
+    }
+}
+
+// Translate a built CB sequence to the channel's DMA engine:
+// (CBs are built for the legacy engine and DMA4 CBs have the same size, so
+// each CB is converted in place)
+static void translate_seq(int channel, int cb_buf, size_t num_cbs) {
+    // Definitions:
+    size_t i;
+
+    uint32_t high; // Address bits 39:32
+
+    struct dma_cb cb;      // Legacy control block
+    struct dma4_cb out;    // Converted control block
+    struct dma4_cb *dma4;  // DMA4 control blocks
+
+    // Remember sequence length:
+    dma_channels[channel].cb_num[cb_buf] = num_cbs;
+
+    // Exported sequences are translated when loaded:
+    if (export_seqs) {
+        // Exit:
+        return;
+    }
+
+    // RP1 descriptors:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Translate:
+        translate_rp1_seq(channel, cb_buf, num_cbs);
+
+        // Exit:
+        return;
+    }
+
+    // Nothing to do for the legacy engine:
+    if (dma_channels[channel].engine != DMA_ENGINE_DMA4) {
+        // Exit:
+        return;
+    }
+
+    // Convert each CB:
+    dma4 = (struct dma4_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    for (i = 0; i < num_cbs; i++) {
+        // Copy as it is overwritten (uncached memory is read and written
+        // whole, in the widest accesses the CPU has):
+        copy_from_uncached__((uint32_t*)&cb, (volatile uint32_t*)&dma4[i], \
+            sizeof(cb) / 4);
+
+        // Write response and peripheral pacing:
+        out.ti = ((cb.info & DMA_WAIT_RESP) ? DMA4_WAIT_RESP : 0) | \
+            ((cb.info & DMA_DREQ) ? DMA4_D_DREQ : 0) | \
+            ((cb.info & DMA_SRC_DREQ) ? DMA4_S_DREQ : 0) | \
+            ((cb.info & (DMA_DREQ | DMA_SRC_DREQ)) ? \
+            DMA4_PER_MAP((cb.info >> 16) & 0x1F) : 0);
+
+        // Addresses and increments:
+        out.src = dma4_addr(cb.src, &high);
+        out.srci = high | ((cb.info & DMA_SRC_INC) ? DMA4_INC : 0);
+        out.dest = dma4_addr(cb.dst, &high);
+        out.desti = high | ((cb.info & DMA_DEST_INC) ? DMA4_INC : 0);
+
+        // Length and next CB (32 byte aligned, end of chain stays 0):
+        out.len = cb.length;
+        out.next_cb = cb.next ? (dma4_addr(cb.next, &high) >> 5) : 0;
+        out.res = 0;
+
+        // Write control block:
+        copy_to_uncached__((volatile uint32_t*)&dma4[i], (uint32_t*)&out, \
+            sizeof(out) / 4);
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Translated %zu CBs of channel %d buffer %d to DMA4\n", \
+            num_cbs, channel, cb_buf);
+    }
+}
+
+// Build "wait" CBs for a number of ticks, each writing to the PWM
+// controller as many times as a paced CB can:
+// (returns the control block following them)
+static struct dma_cb *build_wait_cbs(int channel, int cb_buf, \
+    struct dma_cb *dma_cb_seq, size_t ticks) {
+    // Definitions:
+    size_t i;
+    size_t j;
+
+    for (i = ticks; i > 0; i -= j) {
+        // Split into lengths a paced CB can transfer:
+        j = (i > max_paced_words(channel)) ? max_paced_words(channel) : i;
+
+        dma_cb_seq->info = dma_channels[channel].ti | \
+            DMA_DREQ | DMA_PER_MAP(5);
+        dma_cb_seq->src = 0xABCDEF; // Random data
+        dma_cb_seq->dst = pwmfif1_bus_addr;
+        dma_cb_seq->length = 4 * j;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        dma_cb_seq++;
+    }
+
+    // Return following control block:
+    return dma_cb_seq;
+}
+
+// Build control block sequence for a DMA channel:
+static void build_cb_seq(int channel) {
+    // Definitions:
+    int i;
+
+    int cb_buf; // Which CB buffer to use
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+
+    // Assign control block sequence to channel's cb virtual base:
+    // (virtual base begins at a page-aligned addresses located in
+    // uncached memory)
+    struct dma_cb *dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+
+    // Build CB sequence:
+    for (i = 0; i < dma_channels[channel].cb_seq_num; i++) {
+        // Set or clear GPIOs depending on duty cycle for first CB:
+        if (i == 0) {
+            // Build control block
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                dma_channels[channel].gpio_ti;
+
+            // Set GPIOs if duty cycle is not 0:
+            if ((int)dma_channels[channel].pwm_d_des != 0) {
+                dma_cb_seq->src = \
+                    dma_channels[channel].set_mask_bus_addr[cb_buf];
+                dma_cb_seq->dst = gpset0_bus_addr;
+            } else {
+                dma_cb_seq->src = \
+                    dma_channels[channel].clear_mask_bus_addr[cb_buf];
+                dma_cb_seq->dst = gpclr0_bus_addr;
+            }
+            dma_cb_seq->length = dma_channels[channel].gpio_len;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        // Clear GPIOs for non-trivial duty cycles (no need to clear in
+        // those cases once "wait" CB while GPIO is set expends):
+        } else if ((i == (dma_channels[channel].cb_set_num + 1)) && \
+        ((int)dma_channels[channel].pwm_d_des % 100 != 0)) {
+            // Build control block
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                dma_channels[channel].gpio_ti;
+            dma_cb_seq->src = \
+                dma_channels[channel].clear_mask_bus_addr[cb_buf];
+            dma_cb_seq->dst = gpclr0_bus_addr;
+            dma_cb_seq->length = dma_channels[channel].gpio_len;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        // Write data to PWM controller to wait if no need to clear or
+        // set GPIOs:
+        } else {
+            // Build control block
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                DMA_DREQ | DMA_PER_MAP(5);
+            dma_cb_seq->src = 0xABCDEF; // Random data
+            dma_cb_seq->dst = pwmfif1_bus_addr;
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            // Link to beginning of the sequence if last iteration:
+            if (i == (dma_channels[channel].cb_seq_num - 1)) {
+                // Link to beginning:
+                dma_cb_seq->next = \
+                    dma_channels[channel].cb_base_bus_addr[cb_buf];
+            // Continue:
+            } else {
+                // Link to next CB:
+                dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                    dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            }
+        }
+
+        // Increment control block:
+        dma_cb_seq++;
+    }
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, dma_channels[channel].cb_seq_num);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+}
+
+// Build control block sequence for a DMA channel with compressed "wait"
+// CBs (same timing as build_cb_seq() with a fraction of the CBs):
+static void build_compressed_seq(int channel) {
+    // Definitions:
+    int cb_buf; // Which CB buffer to use
+
+    struct dma_cb *dma_cb_base; // First control block
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building compressed CB sequence for channel %d on buffer " \
+            "%d \n", channel, cb_buf);
+    }
+
+    // Assign control block sequence to channel's cb virtual base:
+    struct dma_cb *dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    dma_cb_base = dma_cb_seq;
+
+    // Set GPIOs if duty cycle is not 0 or clear them otherwise:
+    dma_cb_seq->info = dma_channels[channel].ti | dma_channels[channel].gpio_ti;
+    if ((int)dma_channels[channel].pwm_d_des != 0) {
+        dma_cb_seq->src = dma_channels[channel].set_mask_bus_addr[cb_buf];
+        dma_cb_seq->dst = gpset0_bus_addr;
+    } else {
+        dma_cb_seq->src = dma_channels[channel].clear_mask_bus_addr[cb_buf];
+        dma_cb_seq->dst = gpclr0_bus_addr;
+    }
+    dma_cb_seq->length = dma_channels[channel].gpio_len;
+    dma_cb_seq->stride = 0;
+    dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+        dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+    dma_cb_seq++;
+
+    // Wait while GPIOs are set:
+    dma_cb_seq = build_wait_cbs(channel, cb_buf, dma_cb_seq, \
+        dma_channels[channel].cb_set_num);
+
+    // Clear GPIOs for non-trivial duty cycles:
+    if ((int)dma_channels[channel].pwm_d_des % 100 != 0) {
+        dma_cb_seq->info = dma_channels[channel].ti | \
+            dma_channels[channel].gpio_ti;
+        dma_cb_seq->src = dma_channels[channel].clear_mask_bus_addr[cb_buf];
+        dma_cb_seq->dst = gpclr0_bus_addr;
+        dma_cb_seq->length = dma_channels[channel].gpio_len;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        dma_cb_seq++;
+    }
+
+    // Wait while GPIOs are clear:
+    dma_cb_seq = build_wait_cbs(channel, cb_buf, dma_cb_seq, \
+        dma_channels[channel].cb_clr_num);
+
+    // Link last CB to beginning:
+    (dma_cb_seq - 1)->next = dma_channels[channel].cb_base_bus_addr[cb_buf];
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, dma_cb_seq - dma_cb_base);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built %zu CB compressed sequence for channel %d on buffer " \
+            "%d \n", (size_t)(dma_cb_seq - dma_cb_base), channel, cb_buf);
+    }
+}
+
+// Get time an unpaced (GPIO set, clear or copy) CB adds to the output:
+// (the DMA runs ahead of the PWM FIFO output by up to its DREQ threshold in
+// words, so only the CB overhead the queued words do not cover delays it)
+static float unpaced_us(void) {
+    // Definitions:
+    float queued_us; // Output queued ahead of the DMA
+
+    queued_us = dreq_thresh * 2 * pulse_width_us;
+
+    // Return delay:
+    return (cb_overhead_us > queued_us) ? (cb_overhead_us - queued_us) : 0;
+}
+
+// Get time between the starts of two unpaced CBs with paced words between
+// them: the words drained while the first one runs are refilled at once,
+// so the rest are paced (and the CBs cannot start closer than the CB
+// overhead)
+static float unpaced_interval_us(size_t words) {
+    // Definitions:
+    float interval_us; // Time between the CBs
+
+    interval_us = (words * 2 * pulse_width_us) + unpaced_us();
+
+    // Return interval:
+    return (interval_us > cb_overhead_us) ? interval_us : cb_overhead_us;
+}
+
+// Get sample period of input capture and ranging:
+// (one GPIO level copy CB and one "wait" CB per sample)
+static float sample_tick_us(void) {
+    // Return sample period:
+    return unpaced_interval_us(1);
+}
+
+// Build control block sequence for input capture on a DMA channel:
+// (each sample copies the GPIO levels into the sample ring followed by a
+// write to the PWM controller to pace the next sample)
+static void build_capture_seq(int channel, size_t num_samples) {
+    // Definitions:
+    size_t i;
+
+    int cb_buf; // Which CB buffer to use
+
+    uint32_t sample_bus_addr; // Sample ring bus address
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building capture CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+
+    // Assign control block sequence to channel's cb virtual base:
+    struct dma_cb *dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+
+    // Sample ring follows the control block sequence:
+    sample_bus_addr = uncached_virt_to_bus_addr__( \
+        dma_channels[channel].cb_base[cb_buf], \
+        (void*)dma_channels[channel].cap_samples);
+
+    // Build CB sequence:
+    for (i = 0; i < num_samples; i++) {
+        // Copy GPIO levels into the sample ring:
+        dma_cb_seq->info = dma_channels[channel].ti;
+        dma_cb_seq->src = gplev0_bus_addr;
+        dma_cb_seq->dst = sample_bus_addr + (i * sizeof(uint32_t));
+        dma_cb_seq->length = 4;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+
+        // Increment control block:
+        dma_cb_seq++;
+
+        // Write data to PWM controller to wait for the next sample:
+        dma_cb_seq->info = dma_channels[channel].ti | \
+            DMA_DREQ | DMA_PER_MAP(5);
+        dma_cb_seq->src = 0xABCDEF; // Random data
+        dma_cb_seq->dst = pwmfif1_bus_addr;
+        dma_cb_seq->length = 4;
+        dma_cb_seq->stride = 0;
+
+        // Link to beginning of the sequence if last sample:
+        if (i == (num_samples - 1)) {
+            // Link to beginning:
+            dma_cb_seq->next = \
+                dma_channels[channel].cb_base_bus_addr[cb_buf];
+        // Continue:
+        } else {
+            // Link to next CB:
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        }
+
+        // Increment control block:
+        dma_cb_seq++;
+    }
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, 2 * num_samples);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built capture CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+}
+
+// Build control block sequence for ranging on a DMA channel:
+// (each sensor in turn gets a trigger burst of set and clear writes paced
+// by the PWM controller followed by echo sampling like input capture, so
+// only one sensor listens at a time)
+static void build_range_seq(int channel) {
+    // Definitions:
+    size_t i;
+    size_t j;
+    size_t k;
+
+    int cb_buf; // Which CB buffer to use
+
+    uint32_t mask_bus_addr;   // Trigger masks bus address
+    uint32_t sample_bus_addr; // Echo samples bus address
+
+    struct range_sensor *sensor; // Ranging sensor
+    struct dma_cb *dma_cb_base;  // First control block
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building ranging CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+
+    // Assign control block sequence to channel's cb virtual base:
+    struct dma_cb *dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    dma_cb_base = dma_cb_seq;
+
+    // Trigger masks (one word per sensor) precede the echo samples:
+    sample_bus_addr = uncached_virt_to_bus_addr__( \
+        dma_channels[channel].cb_base[cb_buf], \
+        (void*)dma_channels[channel].range_samples);
+    mask_bus_addr = sample_bus_addr - \
+        (dma_channels[channel].range_num * sizeof(uint32_t));
+
+    // Build each sensor's slot:
+    for (k = 0; k < dma_channels[channel].range_num; k++) {
+        sensor = &dma_channels[channel].range[k];
+        sensor->first_cb = dma_cb_seq - dma_cb_base;
+
+        // Trigger burst:
+        for (i = 0; i < dma_channels[channel].range_cycles; i++) {
+            // Set trigger:
+            dma_cb_seq->info = dma_channels[channel].ti;
+            dma_cb_seq->src = mask_bus_addr + (k * sizeof(uint32_t));
+            dma_cb_seq->dst = gpset0_bus_addr;
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+
+            // Wait for high time (one PWM controller write per tick):
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                DMA_DREQ | DMA_PER_MAP(5);
+            dma_cb_seq->src = 0xABCDEF; // Random data
+            dma_cb_seq->dst = pwmfif1_bus_addr;
+            dma_cb_seq->length = 4 * dma_channels[channel].range_pulse_ticks;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+
+            // Clear trigger:
+            dma_cb_seq->info = dma_channels[channel].ti;
+            dma_cb_seq->src = mask_bus_addr + (k * sizeof(uint32_t));
+            dma_cb_seq->dst = gpclr0_bus_addr;
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+
+            // Wait for low time between burst cycles (listening starts
+            // right after the last one):
+            if (i != (dma_channels[channel].range_cycles - 1)) {
+                dma_cb_seq->info = dma_channels[channel].ti | \
+                    DMA_DREQ | DMA_PER_MAP(5);
+                dma_cb_seq->src = 0xABCDEF; // Random data
+                dma_cb_seq->dst = pwmfif1_bus_addr;
+                dma_cb_seq->length = \
+                    4 * dma_channels[channel].range_pulse_ticks;
+                dma_cb_seq->stride = 0;
+                dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                    dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+                dma_cb_seq++;
+            }
+        }
+
+        // Sample echo:
+        for (j = 0; j < dma_channels[channel].range_num_samples; j++) {
+            // Copy GPIO levels into the sensor's samples:
+            dma_cb_seq->info = dma_channels[channel].ti;
+            dma_cb_seq->src = gplev0_bus_addr;
+            dma_cb_seq->dst = sample_bus_addr + (((k * \
+                dma_channels[channel].range_num_samples) + j) * \
+                sizeof(uint32_t));
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+
+            // Write data to PWM controller to wait for the next sample:
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                DMA_DREQ | DMA_PER_MAP(5);
+            dma_cb_seq->src = 0xABCDEF; // Random data
+            dma_cb_seq->dst = pwmfif1_bus_addr;
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+        }
+
+        sensor->end_cb = dma_cb_seq - dma_cb_base;
+    }
+
+    // Idle until the next round if repeating:
+    dma_cb_seq = build_wait_cbs(channel, cb_buf, dma_cb_seq, \
+        dma_channels[channel].range_pad_ticks);
+
+    // Link last CB to beginning if repeating or end the chain (DMA stops
+    // after one round):
+    (dma_cb_seq - 1)->next = dma_channels[channel].range_pad_ticks ? \
+        dma_channels[channel].cb_base_bus_addr[cb_buf] : 0;
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, dma_cb_seq - dma_cb_base);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built ranging CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+}
+
+// Get duration of a serialized bit in us:
+// (two PWM clock cycles, as a FIFO word spans two pulse widths in the
+// timing model of set_pwm())
+static float serial_bit_us(void) {
+    // Return duration:
+    return 2 * pulse_width_us / pwm_rng;
+}
+
+// Plan the looping bit pattern of a PWM signal for a bit duration:
+// (the pattern repeats after the least common multiple of period and word
+// length)
+static int plan_pattern(float freq, float duty_cycle, float bit_us, \
+    size_t *period, size_t *high, size_t *num_words) {
+    // Definitions:
+    size_t a; // GCD of period and word length
+    size_t b; // GCD remainder
+    size_t r; // Remainder
+
+    // Determine PWM period and high time in bits:
+    *period = (freq > 0) ? ROUND((1e6 / freq) / bit_us) : 0;
+    *high = ROUND(*period * (duty_cycle / 100));
+
+    // Abort if frequency is out of bounds:
+    if (*period < 1) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: %0.3f Hz is faster than a %0.4f us bit\n", \
+                freq, bit_us);
+        }
+
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Words until period and word boundaries line up again:
+    a = *period;
+    b = SERIAL_BITS;
+    while (b) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    *num_words = *period / a;
+
+    // Exit with success:
+    return 0;
+}
+
+// Fill the looping bit pattern of a PWM signal:
+// (bits are shifted out most significant first, of each word for the PWM
+// serializer or of each byte in memory order for SPI)
+static void fill_pattern(uint32_t *words, size_t num_words, size_t period, \
+    size_t high, int bytewise) {
+    // Definitions:
+    size_t i;
+
+    uint8_t *bytes = (uint8_t*)words; // Pattern bytes
+
+    // Clear pattern:
+    memset(words, 0, num_words * sizeof(uint32_t));
+
+    // Set high bits:
+    for (i = 0; i < num_words * SERIAL_BITS; i++) {
+        if ((i % period) >= high) {
+            // Next bit:
+            continue;
+        }
+
+        if (bytewise) {
+            bytes[i / 8] |= (1 << (7 - (i % 8)));
+        } else {
+            words[i / SERIAL_BITS] |= (1u << (SERIAL_BITS - 1 - \
+                (i % SERIAL_BITS)));
+        }
+    }
+}
+
+// Build control block sequence streaming a serializer bit pattern loop to
+// the PWM FIFO:
+// (the pattern follows the CBs, which each write as many words as a paced
+// CB can)
+static void build_serial_seq(int channel, size_t num_cbs) {
+    // Definitions:
+    size_t i;
+    size_t j;
+
+    int cb_buf; // Which CB buffer to use
+
+    uint32_t words_bus_addr; // Bit pattern bus address
+    size_t num_words;        // Words in the bit pattern loop
+
+    struct dma_cb *dma_cb_seq; // Control block
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building serializer CB sequence for channel %d on buffer " \
+            "%d \n", channel, cb_buf);
+    }
+
+    // Bit pattern follows the CBs:
+    dma_cb_seq = (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    words_bus_addr = dma_channels[channel].cb_base_bus_addr[cb_buf] + \
+        (num_cbs * cb_size(channel));
+    num_words = dma_channels[channel].serial_words;
+
+    // Each CB writes as many words as it can to the PWM FIFO:
+    for (i = 0; i < num_words; i += j) {
+        // Split into lengths a paced CB can transfer:
+        j = ((num_words - i) > max_paced_words(channel)) ? \
+            max_paced_words(channel) : (num_words - i);
+
+        // Build control block:
+        dma_cb_seq->info = dma_channels[channel].ti | DMA_SRC_INC | \
+            DMA_DREQ | DMA_PER_MAP(5);
+        dma_cb_seq->src = words_bus_addr + (4 * i);
+        dma_cb_seq->dst = pwmfif1_bus_addr;
+        dma_cb_seq->length = 4 * j;
+        dma_cb_seq->stride = 0;
+
+        // Link to beginning after the last CB:
+        dma_cb_seq->next = ((i + j) < num_words) ? \
+            uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1)) : \
+            dma_channels[channel].cb_base_bus_addr[cb_buf];
+        dma_cb_seq++;
+    }
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, num_cbs);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built serializer CB sequence for channel %d on buffer %d \n",\
+            channel, cb_buf);
+    }
+}
+
+// Switch PWM channel 1 between serializing FIFO words and pacing DMA:
+// (FIFO words are dropped, so no other channel may be writing to the FIFO)
+static void serialize_pwm(int enable) {
+    // Stop channel 1:
+    pwm_ctl_reg->ctl &= ~(PWM_EN1 | PWM_MODE1);
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Each word serializes its bits or spans a pulse width:
+    pwm_ctl_reg->rng1 = enable ? SERIAL_BITS : pwm_rng;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Clear FIFO buffer:
+    pwm_ctl_reg->ctl |= PWM_CLRF;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Use FIFO buffer and enable channel 1:
+    pwm_ctl_reg->ctl |= (PWM_USEF | PWM_EN1 | (enable ? PWM_MODE1 : 0));
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+}
+
+// Get the duration of one PWM range step of a FIFO word in us:
+// (a word spans two pulse widths at the range set by init_pwm())
+static float range_step_us(void) {
+    // Return duration:
+    return (pi_version == 5) ? (1e6 / RP1_PWM_CLOCK_FREQ) : serial_bit_us();
+}
+
+// Restore the PWM range so each FIFO word spans a "wait" tick again:
+// (a timebase chain leaves the range of its last segment)
+static void restore_range(void) {
+    if (pi_version == 5) {
+        rp1_pwm_reg->chan0_range = (uint32_t)(2 * pulse_width_us * \
+            RP1_PWM_CLOCK_FREQ / 1e6);
+        rp1_pwm_reg->global_ctrl = RP1_PWM_SET_UPDATE | RP1_PWM_CHAN_EN(0);
+    } else {
+        pwm_ctl_reg->rng1 = pwm_rng;
+    }
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+}
+
+// Build control block sequence streaming an SPI bit pattern loop to the SPI0
+// FIFO:
+// (the pattern follows the CBs, with a word receiving the RX FIFO after it;
+// every chunk of words written is read back from the RX FIFO, which would
+// stall the transfer once full, while the next chunk is already queued)
+static void build_spi_seq(int channel, size_t num_chunks) {
+    // Definitions:
+    size_t i;
+
+    int cb_buf; // Which CB buffer to use
+
+    uint32_t words_bus_addr; // Bit pattern bus address
+    uint32_t sink_bus_addr;  // RX FIFO sink bus address
+    size_t num_words;        // Words in the bit pattern loop
+    size_t num_cbs;          // CB sequence length
+    size_t chunk;            // Chunk written or read back
+    size_t chunk_words;      // Words of the chunk
+
+    struct dma_cb *dma_cb_seq; // Control block
+    struct dma_cb *loop_cb;    // First CB of the loop
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Building SPI CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+
+    // Bit pattern and RX FIFO sink follow the CBs (the first chunk is
+    // queued once, then the loop writes the next chunk before reading back
+    // the one before it):
+    num_cbs = 1 + (2 * num_chunks);
+    num_words = dma_channels[channel].serial_words;
+    dma_cb_seq = (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    words_bus_addr = dma_channels[channel].cb_base_bus_addr[cb_buf] + \
+        (num_cbs * cb_size(channel));
+    sink_bus_addr = words_bus_addr + (num_words * sizeof(uint32_t));
+    loop_cb = dma_cb_seq + 1;
+
+    // Build control blocks:
+    for (i = 0; i < num_cbs; i++) {
+        // Chunk written (first and odd CBs) or read back (even CBs):
+        chunk = ((i == 0) || (i % 2)) ? (((i + 1) / 2) % num_chunks) : \
+            ((i / 2) - 1);
+        chunk_words = ((chunk + 1) == num_chunks) ? \
+            (num_words - (SPI_CHUNK_WORDS * chunk)) : SPI_CHUNK_WORDS;
+
+        // Queue a chunk paced by the TX FIFO:
+        if ((i == 0) || (i % 2)) {
+            dma_cb_seq->info = dma_channels[channel].ti | DMA_SRC_INC | \
+                DMA_DREQ | DMA_PER_MAP(SPI_DREQ_TX);
+            dma_cb_seq->src = words_bus_addr + \
+                (4 * SPI_CHUNK_WORDS * chunk);
+            dma_cb_seq->dst = spififo_bus_addr;
+        // Read back a chunk paced by the RX FIFO:
+        } else {
+            dma_cb_seq->info = dma_channels[channel].ti | DMA_SRC_DREQ | \
+                DMA_PER_MAP(SPI_DREQ_RX);
+            dma_cb_seq->src = spififo_bus_addr;
+            dma_cb_seq->dst = sink_bus_addr;
+        }
+        dma_cb_seq->length = 4 * chunk_words;
+        dma_cb_seq->stride = 0;
+
+        // Link to the first CB of the loop after the last CB:
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], ((i + 1) < num_cbs) ? \
+            (void*)(dma_cb_seq + 1) : (void*)loop_cb);
+        dma_cb_seq++;
+    }
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, num_cbs);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built SPI CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+}
+
+// Start shifting SPI0 FIFO words out on the MOSI GPIO:
+static void start_spi(int channel) {
+    // Stop transfer and clear FIFOs:
+    spi_reg->cs = SPI_CS_CLEAR;
+
+    // Set clock divisor:
+    spi_reg->clk = dma_channels[channel].spi_cdiv;
+
+    // Output MOSI on GPIO:
+    GPIO_ALT(gpio_base_virt_addr, dma_channels[channel].alt_gpio, \
+        GPIO_FSEL_ALT0);
+
+    // Start transfer fed by DMA:
+    spi_reg->cs = SPI_CS_DMAEN | SPI_CS_TA;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("SPI0 Register: CLK = 0x%08X\n", spi_reg->clk);
+        printf("SPI0 Register: CS = 0x%08X\n", spi_reg->cs);
+    }
+}
+
+// Check if enabling a channel conflicts with another enabled channel's use
+// of the PWM FIFO:
+// (serializer output and timebase chains need the FIFO to itself, while PWM
+// signals, input capture and ranging are paced by it)
+static int fifo_busy(int channel) {
+    // Definitions:
+    int i;
+
+    uint8_t mode;  // Mode of the channel
+    uint8_t other; // Mode of another channel
+
+    // Clock, PWM channel 2 and SPI outputs don't use the FIFO:
+    mode = dma_channels[channel].mode;
+    if ((mode == CHANNEL_MODE_CLOCK) || (mode == CHANNEL_MODE_PWM2) || \
+        (mode == CHANNEL_MODE_SPI)) {
+        // Exit with not busy:
+        return 0;
+    }
+
+    // Check each other enabled channel:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        // Skip channel, free and disabled channels:
+        if ((i == channel) || dma_channels_status[i] || \
+            !(dma_channels[i].enabled)) {
+            // Next channel:
+            continue;
+        }
+
+        // Check conflict:
+        other = dma_channels[i].mode;
+        if ((other != CHANNEL_MODE_CLOCK) && (other != CHANNEL_MODE_PWM2) && \
+           (other != CHANNEL_MODE_SPI) && ((mode == CHANNEL_MODE_SERIAL) || \
+           (other == CHANNEL_MODE_SERIAL) || \
+           (mode == CHANNEL_MODE_TIMEBASE) || \
+           (other == CHANNEL_MODE_TIMEBASE))) {
+            // Debug logs:
+            if (DEBUG) {
+                // Logs:
+                printf("ERROR: PWM FIFO is used by channel %d\n", i);
+            }
+
+            // Exit with busy:
+            return 1;
+        }
+    }
+
+    // Exit with not busy:
+    return 0;
+}
+
+// Get general purpose clock registers:
+static volatile struct gp_clk_reg_map *gpclk_reg(int gpclk) {
+    // Return register map:
+    return (struct gp_clk_reg_map*)((char*)pwm_clk_base_virt_addr + \
+        GP_CLK(gpclk));
+}
+
+// Stop a general purpose clock:
+static void stop_gpclk(int gpclk) {
+    // Definitions:
+    int i;
+
+    volatile struct gp_clk_reg_map *reg; // Clock registers
+
+    // Get registers:
+    reg = gpclk_reg(gpclk);
+
+    // Disable clock (it stops at the end of its cycle):
+    reg->ctl = CM_BASE | (reg->ctl & 0xFFFF & ~CM_ENAB);
+
+    // Wait until stopped before it may be changed:
+    for (i = 0; (i < GPCLK_BUSY_POLLS) && (reg->ctl & CM_BUSY); i++) {
+        nanosleep(&delay, NULL);
+    }
+}
+
+// Start the general purpose clock of a channel:
+static void start_gpclk(int channel) {
+    // Definitions:
+    volatile struct gp_clk_reg_map *reg; // Clock registers
+
+    // Stop clock:
+    stop_gpclk(dma_channels[channel].gpclk);
+
+    // Get registers:
+    reg = gpclk_reg(dma_channels[channel].gpclk);
+
+    // Set clock divisor:
+    reg->div = CM_BASE | dma_channels[channel].gpclk_div;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Set clock source and MASH stages:
+    reg->ctl = CM_BASE | dma_channels[channel].gpclk_ctl;
+
+    // Delay per data sheet:
+    nanosleep(&delay, NULL);
+
+    // Enable clock:
+    reg->ctl = CM_BASE | dma_channels[channel].gpclk_ctl | CM_ENAB;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("GPCLK%d CM Register: DIV = 0x%08X\n", \
+            dma_channels[channel].gpclk, reg->div);
+        printf("GPCLK%d CM Register: CTL = 0x%08X\n", \
+            dma_channels[channel].gpclk, reg->ctl);
+    }
+}
+
+// Leave input capture, ranging, clock, PWM channel 2, serializer, SPI or
+// timebase output and free its state:
+static void leave_mode(int channel) {
+    // Stop clock and release its GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_CLOCK) {
+        stop_gpclk(dma_channels[channel].gpclk);
+        GPIO_INP(gpio_base_virt_addr, dma_channels[channel].alt_gpio);
+        dma_channels[channel].gpclk = -1;
+    }
+
+    // Stop PWM channel 2 and release its GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_PWM2) {
+        pwm_ctl_reg->ctl &= ~(PWM_EN2 | PWM_MSEN2);
+        GPIO_INP(gpio_base_virt_addr, dma_channels[channel].alt_gpio);
+    }
+
+    // Return PWM channel 1 to pacing DMA and release the serializer GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_SERIAL) {
+        if (dma_channels[channel].enabled) {
+            serialize_pwm(0);
+        }
+        GPIO_INP(gpio_base_virt_addr, dma_channels[channel].alt_gpio);
+    }
+
+    // Stop the chain (restarted by the caller) before returning the PWM
+    // range to "wait" ticks:
+    if ((dma_channels[channel].mode == CHANNEL_MODE_TIMEBASE) && \
+        dma_channels[channel].enabled) {
+        stop_dma(channel);
+        restore_range();
+    }
+
+    // Stop SPI0 and release the MOSI GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_SPI) {
+        spi_reg->cs = SPI_CS_CLEAR;
+        GPIO_INP(gpio_base_virt_addr, dma_channels[channel].alt_gpio);
+    }
+
+    // Free decoding state:
+    capture_free__(dma_channels[channel].capture);
+    free(dma_channels[channel].range);
+
+    // Update channel structure:
+    dma_channels[channel].capture = NULL;
+    dma_channels[channel].range = NULL;
+    dma_channels[channel].range_num = 0;
+    dma_channels[channel].mode = CHANNEL_MODE_PWM;
+}
+
+// Check if a GPIO is driven by a channel's PWM signal:
+static int gpio_driven(int gpio) {
+    // Definitions:
+    int i;
+
+    uint64_t set_mask; // GPIO set mask
+
+    // Check each requested channel with a PWM signal, clock, PWM channel 2,
+    // serializer or SPI output:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        // Check clock, PWM channel 2, serializer or SPI output:
+        if (!(dma_channels_status[i]) && \
+           ((dma_channels[i].mode == CHANNEL_MODE_CLOCK) || \
+           (dma_channels[i].mode == CHANNEL_MODE_PWM2) || \
+           (dma_channels[i].mode == CHANNEL_MODE_SERIAL) || \
+           (dma_channels[i].mode == CHANNEL_MODE_SPI)) && \
+           (dma_channels[i].alt_gpio == gpio)) {
+            // Exit with driven:
+            return 1;
+        }
+
+        // Skip free, unset and capturing channels:
+        if ((dma_channels_status[i]) || !(dma_channels[i].seq_built) || \
+           (dma_channels[i].mode == CHANNEL_MODE_CAPTURE)) {
+            // Next channel:
+            continue;
+        }
+
+        // Get GPIO set mask:
+        set_mask = *(uint64_t*)dma_channels[i].set_mask[ \
+            dma_channels[i].selected_cb_buf]->virt_addr;
+
+        // Check if GPIO is in mask:
+        if ((set_mask >> gpio) & 0x01) {
+            // Exit with driven:
+            return 1;
+        }
+    }
+
+    // Exit with not driven:
+    return 0;
+}
+
+// Get PLLD frequency, the source of the PWM and general purpose clocks:
+static double plld_clock_freq(void) {
+    // Return frequency of the board:
+    return (pi_version == 4) ? BCM2711_PLLD_CLOCK_FREQ : DEFAULT_CLOCK_FREQ;
+}
+
+// Get function select of a GPIO's PWM channel 1 or 2 output (-1 if none):
+static int pwm_fsel(int pwm, int gpio) {
+    // Definitions:
+    size_t i;
+
+    // The RP1 PWM is not routed to GPIOs:
+    if (pi_version == 5) {
+        // Exit with none:
+        return -1;
+    }
+
+    // Find GPIO:
+    for (i = 0; i < sizeof(pwm_pins) / sizeof(pwm_pins[0]); i++) {
+        if ((pwm_pins[i].gpio == gpio) && (pwm_pins[i].pwm == pwm)) {
+            // Exit with function select:
+            return pwm_pins[i].fsel;
+        }
+    }
+
+    // Exit with none:
+    return -1;
+}
+
+// Check if PWM channel 2 outputs a signal of another channel:
+static int pwm2_used(int channel) {
+    // Definitions:
+    int i;
+
+    // Check each requested channel:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if ((i != channel) && !(dma_channels_status[i]) && \
+           (dma_channels[i].mode == CHANNEL_MODE_PWM2)) {
+            // Exit with used:
+            return 1;
+        }
+    }
+
+    // Exit with unused:
+    return 0;
+}
+
+// Output a PWM signal of a channel on PWM channel 2 in mark-space mode:
+// (an update of the signal is two register writes)
+static int set_pwm2(int channel, int gpio, float freq, float duty_cycle) {
+    // Definitions:
+    uint8_t enabled; // Channel enabled
+
+    double clock_freq; // PWM clock frequency
+    double rng;        // Period in PWM clock cycles
+    uint32_t rng2;     // Channel 2 range
+    uint32_t dat2;     // Channel 2 data
+
+    // Determine range and data in PWM clock cycles:
+    clock_freq = plld_clock_freq() / clock_div;
+    rng = (freq > 0) ? (clock_freq / freq) : 0;
+
+    // Abort if the period is not between one and 2^32 - 1 clock cycles:
+    if ((rng < 0.5) || (rng >= UINT32_MAX)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_pwm() returned %d\n", -EFREQNOTMET);
+        }
+
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    rng2 = (uint32_t)(rng + 0.5);
+    dat2 = (uint32_t)((rng2 * (double)duty_cycle / 100) + 0.5);
+
+    // Move signal to PWM channel 2 (stopping its DMA) unless already there:
+    if ((dma_channels[channel].mode != CHANNEL_MODE_PWM2) || \
+       (dma_channels[channel].alt_gpio != gpio)) {
+        // Stop DMA or previous output (restarted below):
+        enabled = dma_channels[channel].enabled;
+        if (enabled) {
+            disable_pwm(channel);
+        }
+        leave_mode(channel);
+
+        // No GPIOs to clear when disabled (in a buffer of its own, cached
+        // sequences keep their masks):
+        select_base_buf(channel);
+        *(uint64_t*)dma_channels[channel].clear_mask[ \
+            dma_channels[channel].selected_cb_buf]->virt_addr = 0;
+        *(uint64_t*)dma_channels[channel].set_mask[ \
+            dma_channels[channel].selected_cb_buf]->virt_addr = 0;
+
+        // Output PWM channel 2 on GPIO:
+        GPIO_ALT(gpio_base_virt_addr, gpio, pwm_fsel(2, gpio));
+
+        // Update channel structure:
+        dma_channels[channel].alt_gpio = gpio;
+        dma_channels[channel].mode = CHANNEL_MODE_PWM2;
+        dma_channels[channel].enabled = enabled;
+    }
+
+    // Set signal:
+    pwm_ctl_reg->rng2 = rng2;
+    pwm_ctl_reg->dat2 = dat2;
+
+    // Update channel structure:
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = clock_freq / rng2;
+    dma_channels[channel].pwm_d_des = duty_cycle;
+    dma_channels[channel].pwm_d_act = 100.0 * dat2 / rng2;
+    dma_channels[channel].pwm_d_res = 100.0 / rng2;
+    dma_channels[channel].compressed = 0;
+    dma_channels[channel].bus_rate = 0;
+    dma_channels[channel].seq_built = 1;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Setting PWM channel 2 signal on GPIO %d:\n", gpio);
+        printf("PWM CTL Register: RNG2 = 0x%08X\n", rng2);
+        printf("PWM CTL Register: DAT2 = 0x%08X\n", dat2);
+        printf("Actual frequency = %.7f Hz\n", \
+            dma_channels[channel].freq_act);
+        printf("Actual duty cycle = %.7f%%\n", \
+            dma_channels[channel].pwm_d_act);
+    }
+
+    // Start output if channel is enabled:
+    if (dma_channels[channel].enabled) {
+        // Enable PWM channel 2:
+        enable_pwm(channel);
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Check if SPI0 outputs a signal of another channel:
+static int spi_used(int channel) {
+    // Definitions:
+    int i;
+
+    // Check each requested channel:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if ((i != channel) && !(dma_channels_status[i]) && \
+           (dma_channels[i].mode == CHANNEL_MODE_SPI)) {
+            // Exit with used:
+            return 1;
+        }
+    }
+
+    // Exit with unused:
+    return 0;
+}
+
+// Stream a PWM signal of a channel as a bit pattern through SPI0 MOSI:
+// (the clock divisor starts from the serializer bit of the pulse width set
+// by config_pwm() and doubles until the pattern fits the CB buffer and the
+// bus budget)
+static int set_spi(int channel, int gpio, float freq, float duty_cycle) {
+    // Definitions:
+    int ret;         // Function return value
+    uint8_t enabled; // Channel enabled
+
+    float core_freq;   // Core clock frequency
+    uint32_t cdiv;     // SPI clock divisor
+    float bit_us;      // SPI bit duration
+    size_t period;     // PWM period in bits
+    size_t high;       // PWM high time in bits
+    size_t num_words;  // Words in the bit pattern loop
+    size_t num_chunks; // Chunks of the bit pattern loop
+    size_t num_cbs;    // CB sequence length
+    size_t size_req;   // Required CB buffer size
+    float bus_rate;    // Bus transfers per second
+
+    int cb_buf;      // Which CB buffer to use
+    uint32_t *words; // Bit pattern
+
+    // Smallest even divisor of a bit at least as long as the serializer's:
+    core_freq = (pi_version == 4) ? BCM2711_CORE_CLOCK_FREQ : CORE_CLOCK_FREQ;
+    cdiv = (uint32_t)(core_freq * serial_bit_us() / 1e6);
+    cdiv = (cdiv < 2) ? 2 : (cdiv + (cdiv % 2));
+
+    // Lengthen bits until the bit pattern fits:
+    ret = -EFREQNOTMET;
+    for (; cdiv <= SPI_MAX_CDIV; cdiv *= 2) {
+        // Plan bit pattern (longer bits cannot meet a faster frequency):
+        bit_us = 1e6 * cdiv / core_freq;
+        if ((ret = plan_pattern(freq, duty_cycle, bit_us, &period, &high, \
+            &num_words)) < 0) {
+            // Exit loop:
+            break;
+        }
+
+        // First chunk, then each chunk written and read back:
+        num_chunks = (num_words + SPI_CHUNK_WORDS - 1) / SPI_CHUNK_WORDS;
+        num_cbs = 1 + (2 * num_chunks);
+
+        // Next divisor if CBs, bit pattern and RX sink do not fit in the CB
+        // buffer:
+        size_req = (num_cbs * cb_size(channel)) + \
+            ((num_words + 1) * sizeof(uint32_t));
+        if (size_req > dma_channels[channel].cb_base[0]->size) {
+            // Next divisor:
+            ret = -ENOMEM;
+            continue;
+        }
+
+        // Next divisor if bus budget is exceeded (every word is written and
+        // read back):
+        bus_rate = seq_bus_rate(num_cbs - 1, 2 * num_words, \
+            num_words * SERIAL_BITS * bit_us);
+        if ((ret = check_bus_budget(channel, bus_rate)) == 0) {
+            // Exit loop:
+            break;
+        }
+    }
+
+    // Abort if no divisor meets the signal:
+    if (ret < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Stop DMA of the current output (restarted below as an SPI output):
+    enabled = dma_channels[channel].enabled;
+    if (enabled) {
+        disable_pwm(channel);
+    }
+
+    // Replace decoding, ranging, clock, PWM channel 2 or serializer output
+    // state:
+    leave_mode(channel);
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Hold GPIO low while disabled:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = 0;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = 0;
+    gpio_in(gpio);
+    GPIO_CLEAR(gpio_base_virt_addr, gpio);
+    gpio_out(gpio);
+
+    // Fill bit pattern, most significant bit of each byte first:
+    words = (uint32_t*)((char*)dma_channels[channel].cb_base[cb_buf]->virt_addr \
+        + (num_cbs * cb_size(channel)));
+    fill_pattern(words, num_words, period, high, 1);
+
+    // Update channel structure:
+    dma_channels[channel].alt_gpio = gpio;
+    dma_channels[channel].serial_words = num_words;
+    dma_channels[channel].spi_cdiv = cdiv;
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = 1e6 / (period * bit_us);
+    dma_channels[channel].pwm_d_des = duty_cycle;
+    dma_channels[channel].pwm_d_act = 100 * (float)high / period;
+    dma_channels[channel].pwm_d_res = 100.0 / period;
+    dma_channels[channel].compressed = 0;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_SPI;
+
+    // Build control block sequence for the DMA channel:
+    build_spi_seq(channel, num_chunks);
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting SPI signal on GPIO %d:\n", gpio);
+        printf("Clock divisor = %u (bit = %0.4f us)\n", cdiv, bit_us);
+        printf("Period = %zu bits, high = %zu bits\n", period, high);
+        printf("Pattern = %zu words\n", num_words);
+        printf("Actual frequency = %.7f Hz\n", \
+            dma_channels[channel].freq_act);
+        printf("Actual duty cycle = %.7f%%\n", \
+            dma_channels[channel].pwm_d_act);
+    }
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Load CB and start DMA if channel is already enabled:
+    if (enabled) {
+        // Restart SPI output:
+        enable_pwm(channel);
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Compare two sequence keys:
+static int same_seq(struct seq_key *a, struct seq_key *b) {
+    // Return equal:
+    return (a->mask == b->mask) && (a->cb_seq_num == b->cb_seq_num) && \
+        (a->cb_set_num == b->cb_set_num) && \
+        (a->cb_clr_num == b->cb_clr_num) && (a->ti == b->ti) && \
+        (a->gpio_len == b->gpio_len) && (a->compressed == b->compressed) && \
+        (a->levels == b->levels);
+}
+
+// Drop a cached sequence and free its buffer:
+static void drop_seq(int channel, int slot) {
+    // Free buffer:
+    free_buf(channel, SEQ_CACHE_FIRST + slot);
+
+    // Update cache:
+    dma_channels[channel].cache_bytes -= \
+        dma_channels[channel].cache[slot].bytes;
+    dma_channels[channel].cache[slot].valid = 0;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Dropped cached sequence %d of channel %d\n", slot, channel);
+    }
+}
+
+// Drop all cached sequences of a channel:
+static void flush_cache(int channel) {
+    // Definitions:
+    int i;
+
+    // Drop each cached sequence:
+    for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+        if (dma_channels[channel].cache[i].valid) {
+            drop_seq(channel, i);
+        }
+    }
+}
+
+// Find the CB buffer of a cached sequence:
+// (returns -1 if it is not cached)
+static int find_seq(int channel, struct seq_key *key) {
+    // Definitions:
+    int i;
+
+    // Count use:
+    dma_channels[channel].cache_uses++;
+
+    // Compare each cached sequence:
+    for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+        if (dma_channels[channel].cache[i].valid && \
+           same_seq(&dma_channels[channel].cache[i].key, key)) {
+            // Mark as used:
+            dma_channels[channel].cache[i].last_use = \
+                dma_channels[channel].cache_uses;
+
+            // Exit with buffer:
+            return SEQ_CACHE_FIRST + i;
+        }
+    }
+
+    // Exit with not cached:
+    return -1;
+}
+
+// Allocate a CB buffer for a new cached sequence, dropping the least
+// recently used sequences (except the selected one and those the DMA may
+// still be running) to stay within the memory cap:
+// (returns -1 if the sequence cannot be cached)
+static int store_seq(int channel, struct seq_key *key, size_t bytes) {
+    // Definitions:
+    int i;
+
+    int slot;   // Free or least recently used cache slot
+    int oldest; // Least recently used droppable slot
+
+    struct seq_entry *cache = dma_channels[channel].cache; // Cache
+
+    // Abort if the sequence alone exceeds the cap:
+    if (bytes > dma_channels[channel].cache_max) {
+        // Exit with not cached:
+        return -1;
+    }
+
+    // Update CB buffer states:
+    update_ring(channel);
+
+    // Drop sequences until there is a free slot and enough memory:
+    do {
+        slot = -1;
+        oldest = -1;
+
+        for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+            if (!(cache[i].valid)) {
+                slot = (slot < 0) ? i : slot;
+            } else if (((SEQ_CACHE_FIRST + i) != \
+                dma_channels[channel].selected_cb_buf) && \
+                (dma_channels[channel].buf_state[SEQ_CACHE_FIRST + i] == \
+                BUF_FREE) && ((oldest < 0) || \
+                (cache[i].last_use < cache[oldest].last_use))) {
+                oldest = i;
+            }
+        }
+
+        // Done if it fits:
+        if ((slot >= 0) && ((dma_channels[channel].cache_bytes + bytes) <= \
+            dma_channels[channel].cache_max)) {
+            break;
+        }
+
+        // Abort if nothing can be dropped (only sequences in use are
+        // cached):
+        if (oldest < 0) {
+            // Exit with not cached:
+            return -1;
+        }
+
+        drop_seq(channel, oldest);
+    } while (1);
+
+    // Allocate buffer:
+    alloc_buf(channel, SEQ_CACHE_FIRST + slot, bytes);
+
+    // Update cache:
+    cache[slot].key = *key;
+    cache[slot].bytes = bytes;
+    cache[slot].last_use = dma_channels[channel].cache_uses;
+    cache[slot].valid = 1;
+    dma_channels[channel].cache_bytes += bytes;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Caching sequence of channel %d in slot %d (%zu bytes)\n", \
+            channel, slot, bytes);
+    }
+
+    // Exit with buffer:
+    return SEQ_CACHE_FIRST + slot;
+}
+
+// Set up the CB sequence of a PWM signal, or only build it into the
+// sequence cache if preloading:
+static int set_seq(int channel, int* gpio, size_t num_gpio, \
+    float freq, float duty_cycle, int preload) {
+    // Definitions:
+    int i;
+
+    int ret; // Function return value
+
+    unsigned t_sub_us; // PWM sub cycle period
+    float tick_us;     // "Wait" CB period
+    size_t cb_unpaced; // Number of GPIO set and clear CBs
+    float period_us;   // Actual PWM period achieved
+    size_t cb_seq_num; // CB sequence length
+    float freq_act;    // Actual PWM frequency achieved
+    float pwm_d_res;   // PWM duty cycle resolution
+    float pwm_d_act;   // Actual PWM duty cycle achieved 
+    size_t cb_set_num; // Number of "wait" CBs while GPIO set
+    size_t cb_clr_num; // Number of "wait" CBs while GPIO clear
+
+    size_t cb_wait_num; // Number of compressed "wait" CBs
+    uint8_t compressed; // Compress "wait" CBs
+    float bus_rate;     // Bus transfers per second
+
+    uint64_t set_mask = 0;   // GPIO set mask
+    uint64_t clear_mask = 0; // GPIO clear mask
+    uint32_t gpio_len;       // Length of GPIO set and clear CBs
+
+    int max_gpio; // Highest GPIO of the board
+
+    int cb_buf; // Which CB buffer to use
+    int cached; // Sequence is already built in the cache
+    int seamless; // Queue the sequence on the running DMA
+
+    size_t page_size;     // Page size
+    struct seq_key key;   // Sequence identity
+    struct channel saved; // Channel state while preloading
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("PWM signal to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if duty cycle is not within bounds:
+    if ((duty_cycle < 0) || (duty_cycle > 100)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: duty cycle %0.3f is out of bounds\n", duty_cycle);
+            printf("ERROR: set_pwm() returned %d\n", -EINVDUTY);
+        }
+
+        // Exit with error:
+        return -EINVDUTY;
+    }
+
+    // Abort if input GPIOs do not make sense:
+    max_gpio = (pi_version == 5) ? RP1_MAX_GPIO : \
+        ((pi_version == 4) ? BCM2711_MAX_GPIO : BCM2835_MAX_GPIO);
+    gpio_len = 4;
+    for (i = 0; i < num_gpio; i++) {
+        if ((gpio[i] < 0) || (gpio[i] > max_gpio)) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: GPIO %d is not valid\n", gpio[i]);
+                printf("ERROR: set_pwm() returned %d\n", -EINVGPIO);
+            }
+
+            // Exit with error:
+            return -EINVGPIO;
+        }
+
+        // Write both banks with one CB if any GPIO is in bank 1:
+        gpio_len = (gpio[i] > 31) ? 8 : gpio_len;
+
+        // Append to mask:
+        set_mask |= ((uint64_t)1 << gpio[i]);
+        clear_mask |= ((uint64_t)1 << gpio[i]);
+    }
+
+    // Pass a signal on a single PWM channel 2 GPIO through to it if allowed
+    // and not used by another channel:
+    if (!(preload) && dma_channels[channel].passthrough && (num_gpio == 1) && \
+       (pwm_fsel(2, gpio[0]) >= 0) && !(pwm2_used(channel))) {
+        // Exit with result:
+        return set_pwm2(channel, gpio[0], freq, duty_cycle);
+    }
+
+    // Stream a signal on the SPI MOSI GPIO through SPI0 if selected and not
+    // used by another channel (the RP1 SPI is not supported):
+    if (!(preload) && dma_channels[channel].spi && (num_gpio == 1) && \
+       (gpio[0] == SPI_MOSI_GPIO) && (pi_version != 5) && \
+       !(spi_used(channel))) {
+        // Exit with result:
+        return set_spi(channel, gpio[0], freq, duty_cycle);
+    }
+
+    // Determine sub cycle period:
+    t_sub_us = 1e6 * (1.0 / freq);
+
+    // Each "wait" CB spans two pulse widths and each GPIO set or clear CB
+    // adds the part of the CB overhead the PWM FIFO does not cover (duty
+    // cycles of 0 and 100 only need one of them, see unpaced_us()):
+    tick_us = 2 * pulse_width_us;
+    cb_unpaced = ((int)duty_cycle % 100 == 0) ? 1 : 2;
+
+    // Determine number of "wait" CBs required, compensated for the GPIO
+    // set and clear CBs:
+    cb_seq_num = ((t_sub_us - cb_unpaced * unpaced_us()) > 0) ? \
+        ROUND((t_sub_us - cb_unpaced * unpaced_us()) / tick_us) : 0;
+
+    // Abort if number of CBs is 0 (desired frequency cannot be met):
+    if (cb_seq_num == 0) {
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Determine achieved frequency:
+    period_us = (cb_seq_num * tick_us) + (cb_unpaced * unpaced_us());
+    freq_act = 1e6 / period_us;
+
+    // For duty cycles of 0 and 100, desired can always be achieved:
+    // (duty cycles below 1% are 0%, see build_cb_seq())
+    if ((int)duty_cycle % 100 == 0) {
+        // Set actual to desired duty cycle:
+        pwm_d_act = ((int)duty_cycle == 0) ? 0 : 100;
+
+        // Number of "wait" CBs while GPIO set:
+        cb_set_num = ((int)duty_cycle == 0) ? 0 : cb_seq_num;
+
+        // Determine achieved frequency:
+        period_us = unpaced_interval_us(cb_seq_num);
+        freq_act = 1e6 / period_us;
+    // For all other duty cycles, round desired to the nearest number of
+    // "wait" CBs (GPIOs stay set for those plus the clear CB):
+    } else {
+        // Round to nearest number of "wait" CBs while GPIO set:
+        cb_set_num = ((duty_cycle / 100 * period_us) > unpaced_us()) ? \
+            ROUND(((duty_cycle / 100 * period_us) - unpaced_us()) / \
+            tick_us) : 0;
+        // (the clear CB cannot be the last CB of the sequence)
+        cb_set_num = (cb_set_num >= cb_seq_num) ? (cb_seq_num - 1) : \
+            cb_set_num;
+
+        // Determine achieved frequency and duty cycle (the set and clear
+        // CBs cannot start closer than the CB overhead):
+        period_us = unpaced_interval_us(cb_set_num) + \
+            unpaced_interval_us(cb_seq_num - cb_set_num);
+        freq_act = 1e6 / period_us;
+        pwm_d_act = 100.0 * unpaced_interval_us(cb_set_num) / period_us;
+    }
+
+    // Determine PWM resolution (one "wait" CB):
+    pwm_d_res = 100.0 * tick_us / period_us;
+
+    // Determine number of clear CBs:
+    cb_clr_num = cb_seq_num - cb_set_num;
+
+    // Bus transfers of one CB per "wait" period (every CB also transfers
+    // one word, or two for both GPIO banks):
+    bus_rate = seq_bus_rate(cb_seq_num + cb_unpaced, \
+        cb_seq_num + (cb_unpaced * gpio_len / 4), period_us);
+
+    // Add additional number of CBs for GPIO set and clear:
+    cb_seq_num += cb_unpaced;
+
+    // Compress "wait" CBs if the sequence does not fit in the CB buffer or
+    // its CB loads exceed the bus budget (the PWM controller writes and
+    // so the timing are the same):
+    compressed = 0;
+    if (((cb_seq_num * cb_size(channel)) > \
+        dma_channels[channel].cb_base[0]->size) || \
+        (check_bus_budget(channel, bus_rate) < 0)) {
+        // Number of "wait" CBs while GPIO set and clear:
+        cb_wait_num = \
+            ((cb_set_num + max_paced_words(channel) - 1) / \
+            max_paced_words(channel)) + \
+            ((cb_clr_num + max_paced_words(channel) - 1) / \
+            max_paced_words(channel));
+
+        bus_rate = seq_bus_rate(cb_wait_num + cb_unpaced, \
+            cb_seq_num - cb_unpaced + (cb_unpaced * gpio_len / 4), \
+            period_us);
+        cb_seq_num = cb_wait_num + cb_unpaced;
+        compressed = 1;
+
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("Compressing \"wait\" CBs to %zu CBs\n", cb_seq_num);
+        }
+    }
+
+    // Abort if the CB sequence does not fit in the CB buffer:
+    if ((cb_seq_num * cb_size(channel)) > \
+        dma_channels[channel].cb_base[0]->size) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: CB sequence requires %zu bytes > %zu allocated\n", \
+                cb_seq_num * cb_size(channel), \
+                (size_t)dma_channels[channel].cb_base[0]->size);
+            printf("ERROR: set_pwm() returned %d\n", -ENOMEM);
+        }
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Abort if bus budget is still exceeded:
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Select a ring buffer to use after looking up the cache (it's not
+    // active):
+    cb_buf = -1;
+    cached = 0;
+
+    // Use the sequence cache if enabled, building the sequence into it on
+    // a miss:
+    if (dma_channels[channel].cache_max) {
+        // Sequence identity:
+        key.mask = set_mask;
+        key.cb_seq_num = cb_seq_num;
+        key.cb_set_num = cb_set_num;
+        key.cb_clr_num = cb_clr_num;
+        key.ti = dma_channels[channel].ti;
+        key.gpio_len = gpio_len;
+        key.compressed = compressed;
+        key.levels = ((int)duty_cycle % 100 != 0) ? 2 : \
+            ((int)duty_cycle != 0);
+
+        // Look up or allocate its buffer (page aligned):
+        if ((ret = find_seq(channel, &key)) >= 0) {
+            cached = 1;
+        } else {
+            page_size = getpagesize();
+            ret = store_seq(channel, &key, ((cb_seq_num * cb_size(channel) + \
+                page_size - 1) / page_size) * page_size);
+        }
+
+        // Count lookups of signals being set:
+        if (!(preload)) {
+            dma_channels[channel].cache_hits += cached;
+            dma_channels[channel].cache_misses += !(cached);
+        }
+
+        cb_buf = (ret >= 0) ? ret : cb_buf;
+    }
+
+    // Preloading only builds uncached sequences into the cache:
+    if (preload && (!(dma_channels[channel].cache_max) || \
+        (cb_buf < SEQ_CACHE_FIRST))) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: sequence does not fit in the cache\n");
+            printf("ERROR: preload_pwm() returned %d\n", -ENOMEM);
+        }
+
+        // Exit with error:
+        return -ENOMEM;
+    } else if (preload && cached) {
+        // Exit:
+        return 0;
+    } else if (cb_buf < 0) {
+        cb_buf = next_buf(channel);
+    }
+
+    // Queue the sequence instead of restarting the DMA if a PWM signal is
+    // being output from the ring:
+    seamless = !(preload) && dma_channels[channel].enabled && \
+        ((dma_channels[channel].mode == CHANNEL_MODE_PWM) || \
+        (dma_channels[channel].mode == CHANNEL_MODE_MERGE)) && \
+        ((dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_LIVE) || \
+        (dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_QUEUED));
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Selecting CB buffer %d for channel %d \n", \
+            cb_buf, channel);
+    }
+
+    // Keep channel state when preloading, else leave input capture,
+    // ranging or clock output (which releases its GPIO first) and set
+    // GPIOs to output if not already:
+    if (preload) {
+        saved = dma_channels[channel];
+    } else {
+        leave_mode(channel);
+
+        for (i = 0; i < num_gpio; i++) {
+            gpio_out(gpio[i]);
+        }
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Setting GPIO masks\n");
+        printf("GPIO set mask = 0x%016llX\n", (unsigned long long)set_mask);
+        printf("GPIO clear mask = 0x%016llX\n", \
+            (unsigned long long)clear_mask);
+    }
+
+    // Update masks (bank 0 in the low word is followed by bank 1):
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = \
+        clear_mask;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = set_mask;
+
+    // Update channel structure:
+    dma_channels[channel].t_sub_us = t_sub_us;
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = freq_act;
+    dma_channels[channel].pwm_d_des = duty_cycle;
+    dma_channels[channel].pwm_d_act = pwm_d_act;
+    dma_channels[channel].cb_seq_num = cb_seq_num;
+    dma_channels[channel].cb_set_num = cb_set_num;
+    dma_channels[channel].cb_clr_num = cb_clr_num;
+    dma_channels[channel].gpio_ti = (gpio_len > 4) ? \
+        (DMA_SRC_INC | DMA_DEST_INC) : 0;
+    dma_channels[channel].gpio_len = gpio_len;
+    dma_channels[channel].compressed = compressed;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+
+    // Debug logs:
+    if (DEBUG) { 
+        printf("Setting PWM signal and CB sequence properties:\n");
+        printf("Pulse width = %0.4f us\n", pulse_width_us);
+        printf("Subcycle = %d us\n", t_sub_us);
+        printf("Actual frequency = %.7f Hz\n", freq_act);
+        printf("Duty cycle resolution = %.7f%%\n", pwm_d_res);
+        printf("Actual duty cycle = %.7f%%\n", pwm_d_act);
+        printf("CB sequence \"set\" number = %d\n", cb_set_num);
+        printf("CB sequence \"clear\" number = %d\n", cb_clr_num);
+        printf("CB sequence total number = %d\n", cb_seq_num);
+        printf("Bus transfers = %0.0f /s\n", bus_rate);
+    }
+
+    // Mark buffer as being built until queued or loaded:
+    if (!(preload)) {
+        dma_channels[channel].buf_state[cb_buf] = BUF_BUILDING;
+    }
+
+    // Build control block sequence for the DMA channel (cached sequences
+    // are already built):
+    if (cached) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("Using cached CB sequence on buffer %d\n", cb_buf);
+        }
+    } else if (compressed) {
+        build_compressed_seq(channel);
+    } else {
+        build_cb_seq(channel);
+    }
+
+    // Restore channel state after preloading (saved with the new cached
+    // sequence buffer):
+    if (preload) {
+        saved.cb_num[cb_buf] = dma_channels[channel].cb_num[cb_buf];
+        dma_channels[channel] = saved;
+
+        // Exit:
+        return 0;
+    }
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Channel %d PWM signal set\n", channel);
+    }
+
+    // Queue CB sequence at the end of the current period or load it and
+    // start DMA if channel is already enabled (update PWM signal):
+    if (seamless) {
+        // Update PWM signal:
+        queue_seq(channel, cb_buf);
+    } else if (dma_channels[channel].enabled) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("Updating PWM signal now on channel %d as it's enabled\n",\
+                channel);
+        }
+
+        // Update PWM signal:
+        enable_pwm(channel);
+    } else {
+        dma_channels[channel].buf_state[cb_buf] = BUF_FREE;
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Setup a PWM signal for a requested channel:
+int set_pwm(int channel, int* gpio, size_t num_gpio, \
+    float freq, float duty_cycle) {
+    // Exit with result:
+    return set_seq(channel, gpio, num_gpio, freq, duty_cycle, 0);
+}
+
+// Build a PWM signal into the sequence cache of a requested channel without
+// setting it:
+int preload_pwm(int channel, int* gpio, size_t num_gpio, \
+    float freq, float duty_cycle) {
+    // Exit with result:
+    return set_seq(channel, gpio, num_gpio, freq, duty_cycle, 1);
+}
+
+// Compare edges of merged PWM signals by time, sets before clears:
+static int compare_edges(const void *a, const void *b) {
+    // Definitions:
+    const struct merge_edge *x = a;
+    const struct merge_edge *y = b;
+
+    // Return order:
+    if (x->at != y->at) {
+        return (x->at < y->at) ? -1 : 1;
+    }
+    return (int)x->clear - (int)y->clear;
+}
+
+// Free a merge plan:
+static void free_merge(struct merge_plan *plan) {
+    free(plan->edges);
+    free(plan->sig_ticks);
+    free(plan->rise_us);
+    free(plan->fall_us);
+}
+
+// Get the greatest common divisor of two periods in ticks:
+static uint64_t gcd_ticks(uint64_t a, uint64_t b) {
+    // Definitions:
+    uint64_t t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    // Return divisor:
+    return a;
+}
+
+// Plan the sorted edges of PWM signals over their common period (each
+// signal's period rounded to "wait" ticks and their least common multiple):
+static int plan_merge(int channel, struct merge_pwm *signals, \
+    size_t num_signals, struct merge_plan *plan) {
+    // Definitions:
+    size_t i;
+    size_t j;
+    uint64_t k;
+
+    int max_gpio;      // Highest GPIO of the board
+    uint64_t mask;     // GPIOs of a signal
+    uint64_t reps;     // Periods of a signal in the common period
+    uint64_t gcd;      // Greatest common divisor of periods
+    size_t max_edges;  // Most GPIO CBs fitting in the CB buffer
+    size_t num_edges;  // Edges in the common period
+    double high;       // High time of a signal in ticks
+    float tick_us;     // "Wait" CB period
+
+    memset(plan, 0, sizeof(*plan));
+
+    // Abort if there is nothing to merge:
+    if ((signals == NULL) || (num_signals == 0)) {
+        // Exit with error:
+        return -EINVGPIO;
+    }
+
+    tick_us = 2 * pulse_width_us;
+    max_gpio = (pi_version == 5) ? RP1_MAX_GPIO : \
+        ((pi_version == 4) ? BCM2711_MAX_GPIO : BCM2835_MAX_GPIO);
+    max_edges = dma_channels[channel].cb_base[0]->size / cb_size(channel);
+
+    plan->gpio_len = 4;
+    plan->ticks = 1;
+    plan->sig_ticks = calloc(num_signals, sizeof(uint64_t));
+
+    // Check signals and find their common period:
+    for (i = 0; i < num_signals; i++) {
+        // Abort if duty cycle is not within bounds:
+        if ((signals[i].duty_cycle < 0) || (signals[i].duty_cycle > 100)) {
+            free_merge(plan);
+
+            // Exit with error:
+            return -EINVDUTY;
+        }
+
+        // Abort if GPIOs are invalid or used by another signal:
+        mask = 0;
+        for (j = 0; j < signals[i].num_gpio; j++) {
+            if ((signals[i].gpio[j] < 0) || (signals[i].gpio[j] > max_gpio)) {
+                free_merge(plan);
+
+                // Exit with error:
+                return -EINVGPIO;
+            }
+
+            // Write both banks with one CB if any GPIO is in bank 1:
+            plan->gpio_len = (signals[i].gpio[j] > 31) ? 8 : plan->gpio_len;
+            mask |= ((uint64_t)1 << signals[i].gpio[j]);
+        }
+
+        if ((mask == 0) || (mask & plan->mask)) {
+            free_merge(plan);
+
+            // Exit with error:
+            return -EINVGPIO;
+        }
+
+        plan->mask |= mask;
+
+        // Round period to "wait" ticks:
+        plan->sig_ticks[i] = (signals[i].freq > 0) ? \
+            ROUND(1e6 / signals[i].freq / tick_us) : 0;
+
+        if (plan->sig_ticks[i] == 0) {
+            free_merge(plan);
+
+            // Exit with error:
+            return -EFREQNOTMET;
+        }
+
+        // Abort if the common period has more periods of this signal than
+        // edges fit in the CB buffer:
+        gcd = gcd_ticks(plan->ticks, plan->sig_ticks[i]);
+        if ((plan->ticks / gcd) > max_edges) {
+            free_merge(plan);
+
+            // Exit with error:
+            return -ENOMEM;
+        }
+
+        plan->ticks = (plan->ticks / gcd) * plan->sig_ticks[i];
+    }
+
+    // Count edges (duty cycles of 0 and 100 only need one):
+    num_edges = 0;
+    for (i = 0; i < num_signals; i++) {
+        reps = plan->ticks / plan->sig_ticks[i];
+        if ((reps > max_edges) || (num_edges > max_edges)) {
+            free_merge(plan);
+
+            // Exit with error:
+            return -ENOMEM;
+        }
+
+        num_edges += ((int)signals[i].duty_cycle % 100 == 0) ? 1 : (2 * reps);
+    }
+
+    // Abort if the edges alone do not fit in the CB buffer:
+    if (num_edges > max_edges) {
+        free_merge(plan);
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    plan->edges = malloc(num_edges * sizeof(struct merge_edge));
+    plan->rise_us = malloc(num_signals * sizeof(double));
+    plan->fall_us = malloc(num_signals * sizeof(double));
+
+    // List edges of every period of every signal:
+    for (i = 0; i < num_signals; i++) {
+        // Get GPIO mask:
+        mask = 0;
+        for (j = 0; j < signals[i].num_gpio; j++) {
+            mask |= ((uint64_t)1 << signals[i].gpio[j]);
+        }
+
+        // Duty cycles of 0 and 100 clear or set once:
+        if ((int)signals[i].duty_cycle % 100 == 0) {
+            plan->edges[plan->num_edges].at = 0;
+            plan->edges[plan->num_edges].mask = mask;
+            plan->edges[plan->num_edges].signal = i;
+            plan->edges[plan->num_edges].clear = \
+                ((int)signals[i].duty_cycle == 0);
+            plan->num_edges++;
+            continue;
+        }
+
+        // Set at start of each period and clear after the high time:
+        high = signals[i].duty_cycle / 100 * plan->sig_ticks[i];
+        reps = plan->ticks / plan->sig_ticks[i];
+        for (k = 0; k < reps; k++) {
+            plan->edges[plan->num_edges].at = k * plan->sig_ticks[i];
+            plan->edges[plan->num_edges].mask = mask;
+            plan->edges[plan->num_edges].signal = i;
+            plan->edges[plan->num_edges].clear = 0;
+            plan->num_edges++;
+
+            plan->edges[plan->num_edges] = plan->edges[plan->num_edges - 1];
+            plan->edges[plan->num_edges].at += high;
+            plan->edges[plan->num_edges].clear = 1;
+            plan->num_edges++;
+        }
+    }
+
+    // Sort edges by time:
+    qsort(plan->edges, plan->num_edges, sizeof(struct merge_edge), \
+        compare_edges);
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Build the CB sequence of merged PWM signals into a CB buffer, or only
+// size it if the buffer is -1: each group of edges at the same time is one
+// GPIO set or clear CB with a mask word of its own (after the CBs), with
+// compressed "wait" CBs in between so the sequence grows with the edges
+// rather than the period
+// (edges are placed at the nearest tick from the time reached, so CB
+// overheads do not accumulate, see unpaced_interval_us())
+static void build_merge_seq(int channel, int cb_buf, struct merge_plan *plan) {
+    // Definitions:
+    size_t i;
+    size_t j;
+
+    size_t ticks;        // "Wait" ticks before an edge
+    size_t max_words;    // Words a paced CB can transfer
+    uint64_t mask;       // GPIOs of a group of edges
+    double time_us;      // Time reached in the sequence
+    double last_us;      // Start of the last GPIO CB
+    float tick_us;       // "Wait" CB period
+    uint64_t *words;     // Mask words of the GPIO CBs
+
+    struct dma_cb *dma_cb_base = NULL; // First control block
+    struct dma_cb *dma_cb_seq = NULL;  // Next control block
+
+    tick_us = 2 * pulse_width_us;
+    max_words = max_paced_words(channel);
+
+    // Mask words follow the CBs (sized before building):
+    if (cb_buf >= 0) {
+        dma_cb_base = \
+            (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+        dma_cb_seq = dma_cb_base;
+        words = (uint64_t*)((char*)dma_cb_base + \
+            (plan->cbs * cb_size(channel)));
+    }
+
+    plan->cbs = 0;
+    plan->gpio_cbs = 0;
+    plan->wait_words = 0;
+    time_us = 0;
+    last_us = -cb_overhead_us;
+
+    for (i = 0; i < plan->num_edges; i++) {
+        plan->rise_us[plan->edges[i].signal] = -1;
+        plan->fall_us[plan->edges[i].signal] = -1;
+    }
+
+    for (i = 0; i < plan->num_edges; i = j) {
+        // Wait until the edge:
+        ticks = ((plan->edges[i].at * tick_us) > time_us) ? \
+            ROUND(((plan->edges[i].at * tick_us) - time_us) / tick_us) : 0;
+
+        if (cb_buf >= 0) {
+            dma_cb_seq = build_wait_cbs(channel, cb_buf, dma_cb_seq, ticks);
+        }
+
+        plan->cbs += (ticks + max_words - 1) / max_words;
+        plan->wait_words += ticks;
+        time_us += ticks * tick_us;
+
+        // GPIO CBs cannot start closer than the CB overhead:
+        time_us = (time_us > (last_us + cb_overhead_us)) ? time_us : \
+            (last_us + cb_overhead_us);
+
+        // Group edges of the same time and kind:
+        mask = 0;
+        for (j = i; (j < plan->num_edges) && \
+            (plan->edges[j].at == plan->edges[i].at) && \
+            (plan->edges[j].clear == plan->edges[i].clear); j++) {
+            mask |= plan->edges[j].mask;
+
+            // Remember first edges of each signal:
+            if (plan->edges[j].clear && \
+               (plan->fall_us[plan->edges[j].signal] < 0)) {
+                plan->fall_us[plan->edges[j].signal] = time_us;
+            } else if (!(plan->edges[j].clear) && \
+               (plan->rise_us[plan->edges[j].signal] < 0)) {
+                plan->rise_us[plan->edges[j].signal] = time_us;
+            }
+        }
+
+        // Set or clear GPIOs:
+        if (cb_buf >= 0) {
+            words[plan->gpio_cbs] = mask;
+
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                ((plan->gpio_len > 4) ? (DMA_SRC_INC | DMA_DEST_INC) : 0);
+            dma_cb_seq->src = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], \
+                &words[plan->gpio_cbs]);
+            dma_cb_seq->dst = plan->edges[i].clear ? gpclr0_bus_addr : \
+                gpset0_bus_addr;
+            dma_cb_seq->length = plan->gpio_len;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+        }
+
+        plan->cbs++;
+        plan->gpio_cbs++;
+        last_us = time_us;
+        time_us += unpaced_us();
+    }
+
+    // Wait until the end of the common period (at least one tick, so the
+    // sequence loops from a "wait" CB):
+    ticks = ((plan->ticks * tick_us) > time_us) ? \
+        ROUND(((plan->ticks * tick_us) - time_us) / tick_us) : 0;
+    ticks = (ticks == 0) ? 1 : ticks;
+
+    if (cb_buf >= 0) {
+        dma_cb_seq = build_wait_cbs(channel, cb_buf, dma_cb_seq, ticks);
+
+        // Link last CB to beginning:
+        (dma_cb_seq - 1)->next = dma_channels[channel].cb_base_bus_addr[cb_buf];
+    }
+
+    plan->cbs += (ticks + max_words - 1) / max_words;
+    plan->wait_words += ticks;
+    plan->period_us = ((time_us + (ticks * tick_us)) > \
+        (last_us + cb_overhead_us)) ? (time_us + (ticks * tick_us)) : \
+        (last_us + cb_overhead_us);
+
+    // Translate for the channel's DMA engine:
+    if (cb_buf >= 0) {
+        translate_seq(channel, cb_buf, dma_cb_seq - dma_cb_base);
+    }
+}
+
+// Get memory of a merged sequence (CBs and their mask words):
+static size_t merge_bytes(int channel, struct merge_plan *plan) {
+    // Return size:
+    return (plan->cbs * cb_size(channel)) + \
+        (plan->gpio_cbs * sizeof(uint64_t));
+}
+
+// Set actual frequency and duty cycle of merged PWM signals:
+static void merge_actuals(struct merge_pwm *signals, size_t num_signals, \
+    struct merge_plan *plan) {
+    // Definitions:
+    size_t i;
+
+    double period_us; // Actual period of a signal
+
+    for (i = 0; i < num_signals; i++) {
+        period_us = plan->period_us * plan->sig_ticks[i] / plan->ticks;
+        signals[i].freq_act = 1e6 / period_us;
+
+        // Duty cycles of 0 and 100 are always achieved:
+        if ((int)signals[i].duty_cycle % 100 == 0) {
+            signals[i].duty_cycle_act = ((int)signals[i].duty_cycle == 0) ? \
+                0 : 100;
+        } else {
+            signals[i].duty_cycle_act = 100 * \
+                (plan->fall_us[i] - plan->rise_us[i]) / period_us;
+        }
+    }
+}
+
+// Merge PWM signals into one CB sequence of a requested channel:
+int set_merge_pwm(int channel, struct merge_pwm *signals, \
+    size_t num_signals) {
+    // Definitions:
+    size_t i;
+    size_t j;
+
+    int ret;      // Function return value
+    int cb_buf;   // Which CB buffer to use
+    int seamless; // Queue the sequence on the running DMA
+    float bus_rate; // Bus transfers per second
+
+    struct merge_plan plan; // Merged edges
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("%zu PWM signals to be merged on channel %d\n", num_signals, \
+            channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_merge_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Plan and size the merged sequence:
+    if ((ret = plan_merge(channel, signals, num_signals, &plan)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_merge_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    build_merge_seq(channel, -1, &plan);
+
+    // Abort if the merged sequence does not fit in the CB buffer:
+    if (merge_bytes(channel, &plan) > dma_channels[channel].cb_base[0]->size) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: merged sequence requires %zu bytes > %zu " \
+                "allocated\n", merge_bytes(channel, &plan), \
+                (size_t)dma_channels[channel].cb_base[0]->size);
+            printf("ERROR: set_merge_pwm() returned %d\n", -ENOMEM);
+        }
+
+        free_merge(&plan);
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Abort if bus budget is exceeded:
+    bus_rate = seq_bus_rate(plan.cbs, plan.wait_words + \
+        (plan.gpio_cbs * plan.gpio_len / 4), plan.period_us);
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_merge_pwm() returned %d\n", ret);
+        }
+
+        free_merge(&plan);
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Queue the sequence instead of restarting the DMA if a PWM signal is
+    // being output from the ring:
+    seamless = dma_channels[channel].enabled && \
+        ((dma_channels[channel].mode == CHANNEL_MODE_PWM) || \
+        (dma_channels[channel].mode == CHANNEL_MODE_MERGE)) && \
+        ((dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_LIVE) || \
+        (dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_QUEUED));
+
+    // Leave input capture, ranging or clock output and set GPIOs to output:
+    leave_mode(channel);
+
+    for (i = 0; i < num_signals; i++) {
+        for (j = 0; j < signals[i].num_gpio; j++) {
+            gpio_out(signals[i].gpio[j]);
+        }
+    }
+
+    // Every GPIO is cleared when disabled:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = \
+        plan.mask;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = plan.mask;
+
+    // Build control block sequence for the DMA channel:
+    dma_channels[channel].buf_state[cb_buf] = BUF_BUILDING;
+    build_merge_seq(channel, cb_buf, &plan);
+    merge_actuals(signals, num_signals, &plan);
+
+    // Update channel structure (properties of the first signal):
+    dma_channels[channel].t_sub_us = plan.period_us;
+    dma_channels[channel].freq_des = signals[0].freq;
+    dma_channels[channel].freq_act = signals[0].freq_act;
+    dma_channels[channel].pwm_d_des = signals[0].duty_cycle;
+    dma_channels[channel].pwm_d_act = signals[0].duty_cycle_act;
+    dma_channels[channel].pwm_d_res = 100.0 * 2 * pulse_width_us * \
+        plan.ticks / (plan.sig_ticks[0] * plan.period_us);
+    dma_channels[channel].cb_seq_num = plan.cbs;
+    dma_channels[channel].cb_set_num = 0;
+    dma_channels[channel].cb_clr_num = 0;
+    dma_channels[channel].gpio_ti = (plan.gpio_len > 4) ? \
+        (DMA_SRC_INC | DMA_DEST_INC) : 0;
+    dma_channels[channel].gpio_len = plan.gpio_len;
+    dma_channels[channel].compressed = 1;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_MERGE;
+    dma_channels[channel].seq_built = 1;
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Merged period = %0.1f us (%llu ticks)\n", plan.period_us, \
+            (unsigned long long)plan.ticks);
+        printf("GPIO CBs = %zu, total CBs = %zu\n", plan.gpio_cbs, plan.cbs);
+        printf("Bus transfers = %0.0f /s\n", bus_rate);
+    }
+
+    free_merge(&plan);
+
+    // Queue CB sequence at the end of the current period or load it and
+    // start DMA if channel is already enabled:
+    if (seamless) {
+        queue_seq(channel, cb_buf);
+    } else if (dma_channels[channel].enabled) {
+        enable_pwm(channel);
+    } else {
+        dma_channels[channel].buf_state[cb_buf] = BUF_FREE;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Estimate memory of merging PWM signals on a requested channel against
+// setting each on a channel of its own:
+int estimate_merge_pwm(int channel, struct merge_pwm *signals, \
+    size_t num_signals, struct merge_size_pwm *size) {
+    // Definitions:
+    size_t i;
+
+    int ret;            // Function return value
+    size_t cb_seq_num;  // CBs of a signal on its own
+    size_t cb_set_num;  // "Wait" CBs while its GPIOs are set
+    size_t cb_unpaced;  // Its GPIO set and clear CBs
+    size_t max_words;   // Words a paced CB can transfer
+
+    struct merge_plan plan; // Merged edges
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Exit with error:
+        return ret;
+    }
+
+    // Plan and size the merged sequence:
+    if ((ret = plan_merge(channel, signals, num_signals, &plan)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: estimate_merge_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    build_merge_seq(channel, -1, &plan);
+    merge_actuals(signals, num_signals, &plan);
+
+    memset(size, 0, sizeof(*size));
+    size->period_us = plan.period_us;
+    size->edges = plan.gpio_cbs;
+    size->cbs = plan.cbs;
+    size->merged_bytes = merge_bytes(channel, &plan);
+    size->buffer_bytes = dma_channels[channel].cb_base[0]->size;
+
+    // Each signal on its own: one "wait" CB per tick unless that does not
+    // fit (see set_pwm()), plus its set and clear mask words:
+    max_words = max_paced_words(channel);
+    for (i = 0; i < num_signals; i++) {
+        cb_unpaced = ((int)signals[i].duty_cycle % 100 == 0) ? 1 : 2;
+        cb_seq_num = plan.sig_ticks[i] + cb_unpaced;
+
+        if ((cb_seq_num * cb_size(channel)) > size->buffer_bytes) {
+            cb_set_num = ROUND(signals[i].duty_cycle / 100 * \
+                plan.sig_ticks[i]);
+            cb_seq_num = ((cb_set_num + max_words - 1) / max_words) + \
+                ((plan.sig_ticks[i] - cb_set_num + max_words - 1) / \
+                max_words) + cb_unpaced;
+        }
+
+        size->separate_bytes += (cb_seq_num * cb_size(channel)) + \
+            (2 * sizeof(uint64_t));
+    }
+
+    // Worth merging if it fits and takes no more memory:
+    size->worthwhile = (size->merged_bytes <= size->buffer_bytes) && \
+        (size->merged_bytes <= size->separate_bytes);
+
+    free_merge(&plan);
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Setup input capture for a requested channel:
+int set_capture_pwm(int channel, int *gpio, size_t num_gpio, float window) {
+    // Definitions:
+    size_t i;
+
+    int ret; // Function return value
+
+    size_t num_samples;   // Number of samples in the sample ring
+    size_t cap_blocks;    // Number of blocks in the sample ring
+    size_t window_blocks; // Number of blocks in the sliding window
+    float block_us;       // Sample block period
+    float bus_rate;       // Bus transfers per second
+
+    int cb_buf; // Which CB buffer to use
+
+    struct capture_state *capture; // Capture decoding state
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Input capture to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_capture_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if window does not make sense:
+    if (window <= 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: capture window %0.3f us is invalid\n", window);
+            printf("ERROR: set_capture_pwm() returned %d\n", -EINVWIN);
+        }
+
+        // Exit with error:
+        return -EINVWIN;
+    }
+
+    // Abort if input GPIOs do not make sense:
+    for (i = 0; i < num_gpio; i++) {
+        if ((gpio[i] < 0) || (gpio[i] > max_bank0_gpio())) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: GPIO %d is not valid\n", gpio[i]);
+                printf("ERROR: set_capture_pwm() returned %d\n", -EINVGPIO);
+            }
+
+            // Exit with error:
+            return -EINVGPIO;
+        }
+    }
+
+    // Abort if there is nothing to capture:
+    if (num_gpio == 0) {
+        // Exit with error:
+        return -EINVGPIO;
+    }
+
+    // Determine number of samples fitting in the CB buffer (two CBs and
+    // one sample each) in whole blocks:
+    num_samples = dma_channels[channel].cb_base[0]->size / \
+        (2 * cb_size(channel) + sizeof(uint32_t));
+    cap_blocks = num_samples / CAPTURE_BLOCK_SAMPLES;
+    num_samples = cap_blocks * CAPTURE_BLOCK_SAMPLES;
+
+    // Abort if the sample ring cannot hold two blocks (one being written
+    // while the other is decoded):
+    if (cap_blocks < 2) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: sample ring needs at least 2 blocks\n");
+            printf("ERROR: set_capture_pwm() returned %d\n", -ENOMEM);
+        }
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Abort if bus budget is exceeded (two CBs and words per sample):
+    bus_rate = seq_bus_rate(2, 2, sample_tick_us());
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_capture_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Determine sliding window length in blocks (each sample is paced by
+    // one "wait" CB, see set_pwm()):
+    block_us = CAPTURE_BLOCK_SAMPLES * sample_tick_us();
+    window_blocks = CEILING(window / block_us);
+
+    // Allocate decoding state:
+    capture = capture_init__(gpio, num_gpio, window_blocks);
+
+    // Check success:
+    if (capture == NULL) {
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Set input GPIOs to input unless driven by a channel (which allows
+    // measuring a channel's own output):
+    for (i = 0; i < num_gpio; i++) {
+        // Set pin to input:
+        if (!(gpio_driven(gpio[i]))) {
+            gpio_in(gpio[i]);
+        }
+    }
+
+    // No GPIOs to clear when disabled:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = 0;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = 0;
+
+    // Replace decoding or ranging state:
+    leave_mode(channel);
+
+    // Update channel structure:
+    dma_channels[channel].capture = capture;
+    dma_channels[channel].cap_samples = (volatile uint32_t*) \
+        ((char*)dma_channels[channel].cb_base[cb_buf]->virt_addr + \
+        (num_samples * 2 * cb_size(channel)));
+    dma_channels[channel].cap_blocks = cap_blocks;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].freq_act = 0;
+    dma_channels[channel].pwm_d_act = 0;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_CAPTURE;
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting input capture properties:\n");
+        printf("Sample period = %0.4f us\n", sample_tick_us());
+        printf("Sample ring = %zu samples\n", num_samples);
+        printf("Sliding window = %zu blocks\n", window_blocks);
+    }
+
+    // Build control block sequence for the DMA channel:
+    build_capture_seq(channel, num_samples);
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Channel %d input capture set\n", channel);
+    }
+
+    // Load CB and start DMA if channel is already enabled:
+    if (dma_channels[channel].enabled) {
+        // Restart sampling:
+        enable_pwm(channel);
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Setup ultrasonic ranging for a requested channel:
+int set_range_pwm(int channel, int *trig_gpio, int *echo_gpio, \
+    size_t num_sensors, float pulse, int cycles, float listen, \
+    float interval) {
+    // Definitions:
+    size_t i;
+
+    int ret; // Function return value
+
+    size_t pulse_ticks; // Trigger high and low time in "wait" CBs
+    size_t num_samples; // Echo samples per sensor
+    size_t pad_ticks;   // Idle "wait" CBs to fill the interval
+    size_t cb_seq_num;  // CB sequence length
+    size_t size_req;    // Required CB buffer size
+    float tick_us;      // "Wait" CB period
+    float slot_us;      // Duration of one sensor's slot
+    float bus_rate;     // Bus transfers per second
+    uint32_t trig_mask; // Union of trigger masks
+
+    int cb_buf; // Which CB buffer to use
+
+    struct range_sensor *range; // Ranging sensors
+    uint32_t *masks;            // Trigger masks
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Ranging to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_range_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if GPIOs do not make sense:
+    for (i = 0; i < num_sensors; i++) {
+        if ((trig_gpio[i] < 0) || (trig_gpio[i] > max_bank0_gpio()) || \
+            (echo_gpio[i] < 0) || (echo_gpio[i] > max_bank0_gpio())) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: sensor %zu GPIOs are not valid\n", i);
+                printf("ERROR: set_range_pwm() returned %d\n", -EINVGPIO);
+            }
+
+            // Exit with error:
+            return -EINVGPIO;
+        }
+    }
+
+    // Abort if there is nothing to range:
+    if (num_sensors == 0) {
+        // Exit with error:
+        return -EINVGPIO;
+    }
+
+    // Determine trigger length in "wait" CBs (the GPIO clear CB adds to
+    // the high time, see set_pwm()) and listen window length in samples:
+    tick_us = 2 * pulse_width_us;
+    pulse_ticks = (pulse > unpaced_us()) ? \
+        ROUND((pulse - unpaced_us()) / tick_us) : 0;
+    num_samples = (listen > 0) ? CEILING(listen / sample_tick_us()) : 0;
+
+    // Abort if burst or listen window does not make sense:
+    if ((pulse_ticks == 0) || (pulse_ticks > max_paced_words(channel)) || \
+        (cycles < 1) || (num_samples == 0) || (interval < 0)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: trigger %0.3f us x %d or listen window %0.3f us "
+                "is invalid\n", pulse, cycles, listen);
+            printf("ERROR: set_range_pwm() returned %d\n", -EINVRANGE);
+        }
+
+        // Exit with error:
+        return -EINVRANGE;
+    }
+
+    // Each sensor's slot: GPIO set and clear CBs with high and low times
+    // between burst cycles, the last clear CB then the listen window:
+    slot_us = ((2 * cycles - 1) * unpaced_interval_us(pulse_ticks)) + \
+        unpaced_interval_us(0) + (num_samples * sample_tick_us());
+    cb_seq_num = num_sensors * ((4 * cycles - 1) + (2 * num_samples));
+
+    // Pad repeated rounds to the interval:
+    pad_ticks = 0;
+    if (interval > 0) {
+        // Abort if the interval cannot hold a round:
+        if (ROUND((interval - num_sensors * slot_us) / tick_us) < 1) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: interval %0.3f us is shorter than a round "
+                    "of %0.3f us\n", interval, num_sensors * slot_us);
+                printf("ERROR: set_range_pwm() returned %d\n", -EINVRANGE);
+            }
+
+            // Exit with error:
+            return -EINVRANGE;
+        }
+
+        pad_ticks = ROUND((interval - num_sensors * slot_us) / tick_us);
+        cb_seq_num += (pad_ticks + max_paced_words(channel) - 1) / \
+            max_paced_words(channel);
+    }
+
+    // Abort if CBs, trigger masks and echo samples do not fit in the CB
+    // buffer:
+    size_req = (cb_seq_num * cb_size(channel)) + \
+        (num_sensors * (1 + num_samples) * sizeof(uint32_t));
+    if (size_req > dma_channels[channel].cb_base[0]->size) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: ranging requires %zu bytes > %zu allocated\n", \
+                size_req, (size_t)dma_channels[channel].cb_base[0]->size);
+            printf("ERROR: set_range_pwm() returned %d\n", -ENOMEM);
+        }
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Abort if bus budget is exceeded (over a round, every trigger and
+    // sample CB transfers one word and every "wait" CB one per tick):
+    bus_rate = seq_bus_rate(cb_seq_num, (num_sensors * ((2 * cycles) + \
+        ((2 * cycles - 1) * pulse_ticks) + (2 * num_samples))) + pad_ticks, \
+        (num_sensors * slot_us) + (pad_ticks * tick_us));
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_range_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Allocate sensors:
+    range = malloc(num_sensors * sizeof(struct range_sensor));
+
+    // Check success:
+    if (range == NULL) {
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Trigger masks follow the CB sequence:
+    masks = (uint32_t*)((char*)dma_channels[channel].cb_base[cb_buf]->virt_addr \
+        + (cb_seq_num * cb_size(channel)));
+
+    // Replace decoding, ranging or clock output state (which releases its
+    // GPIO first):
+    leave_mode(channel);
+
+    // Set up sensor GPIOs:
+    trig_mask = 0;
+    for (i = 0; i < num_sensors; i++) {
+        range[i].trig_gpio = trig_gpio[i];
+        range[i].echo_gpio = echo_gpio[i];
+
+        // Triggers are outputs and echoes inputs:
+        gpio_in(trig_gpio[i]);
+        gpio_out(trig_gpio[i]);
+        if (!(gpio_driven(echo_gpio[i]))) {
+            gpio_in(echo_gpio[i]);
+        }
+
+        masks[i] = (1 << trig_gpio[i]);
+        trig_mask |= masks[i];
+    }
+
+    // Clear triggers when disabled:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = \
+        trig_mask;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = trig_mask;
+
+    // Update channel structure:
+    dma_channels[channel].range = range;
+    dma_channels[channel].range_num = num_sensors;
+    dma_channels[channel].range_samples = (volatile uint32_t*)(masks + \
+        num_sensors);
+    dma_channels[channel].range_num_samples = num_samples;
+    dma_channels[channel].range_pulse_ticks = pulse_ticks;
+    dma_channels[channel].range_cycles = cycles;
+    dma_channels[channel].range_pad_ticks = pad_ticks;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].freq_act = 0;
+    dma_channels[channel].pwm_d_act = 0;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_RANGE;
+
+    // No echo sampled yet:
+    memset((void*)dma_channels[channel].range_samples, 0, \
+        num_sensors * num_samples * sizeof(uint32_t));
+
+    // Build control block sequence for the DMA channel:
+    build_range_seq(channel);
+
+    // End of each sensor's slot from start of the round:
+    for (i = 0; i < num_sensors; i++) {
+        range[i].end_us = (i + 1) * slot_us;
+    }
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting ranging properties:\n");
+        printf("Trigger = %0.4f us x %d\n", \
+            unpaced_interval_us(pulse_ticks), cycles);
+        printf("Listen window = %zu samples of %0.4f us\n", num_samples, \
+            sample_tick_us());
+        printf("Round = %0.4f us\n", \
+            (num_sensors * slot_us) + (pad_ticks * tick_us));
+    }
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Load CB and start DMA if channel is already enabled:
+    if (dma_channels[channel].enabled) {
+        // Restart ranging:
+        enable_pwm(channel);
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Setup a general purpose clock output for a requested channel:
+int set_clock_pwm(int channel, int gpio, float freq) {
+    // Definitions:
+    int i;
+
+    int ret;         // Function return value
+    uint8_t enabled; // Channel enabled
+
+    int gpclk = -1; // General purpose clock of the GPIO
+    int fsel = 0;   // Function select of the clock output
+
+    float src_freq; // Clock source frequency
+    int src;        // Clock source
+    double div;     // Clock divisor
+    uint32_t divi;  // Integer part of the clock divisor
+    uint32_t divf;  // Fractional part of the clock divisor
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Clock output to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_clock_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Find general purpose clock of the GPIO (the RP1 has none):
+    for (i = 0; (pi_version != 5) && \
+        (i < (int)(sizeof(gpclk_pins) / sizeof(gpclk_pins[0]))); i++) {
+        if (gpclk_pins[i].gpio == gpio) {
+            gpclk = gpclk_pins[i].gpclk;
+            fsel = gpclk_pins[i].fsel;
+        }
+    }
+
+    // Abort if GPIO has no clock output:
+    if (gpclk < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: GPIO %d has no clock output\n", gpio);
+            printf("ERROR: set_clock_pwm() returned %d\n", -EINVGPIO);
+        }
+
+        // Exit with error:
+        return -EINVGPIO;
+    }
+
+    // Abort if clock is used by another channel:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if ((i != channel) && !(dma_channels_status[i]) && \
+           (dma_channels[i].mode == CHANNEL_MODE_CLOCK) && \
+           (dma_channels[i].gpclk == gpclk)) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: GPCLK%d is used by channel %d\n", gpclk, i);
+                printf("ERROR: set_clock_pwm() returned %d\n", -ECLKBUSY);
+            }
+
+            // Exit with error:
+            return -ECLKBUSY;
+        }
+    }
+
+    // Abort if frequency is out of bounds:
+    if ((freq <= 0) || (freq > GPCLK_MAX_FREQ)) {
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Divide PLLD down, or the oscillator for low frequencies:
+    src = DEFAULT_CLOCK_SOURCE;
+    src_freq = plld_clock_freq();
+    if ((src_freq / freq) >= (GPCLK_MAX_DIVI + 1)) {
+        src = OSC_CLOCK_SOURCE;
+        src_freq = (pi_version == 4) ? BCM2711_OSC_CLOCK_FREQ : \
+            OSC_CLOCK_FREQ;
+    }
+
+    // Determine integer and fractional divisor:
+    div = src_freq / freq;
+    divi = (uint32_t)div;
+    divf = ROUND((div - divi) * (1 << CM_DIVF_BITS));
+    if (divf == (1 << CM_DIVF_BITS)) {
+        divi++;
+        divf = 0;
+    }
+
+    // Abort if the divisor cannot be met:
+    if ((divi < 2) || (divi > GPCLK_MAX_DIVI)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: clock divisor %0.3f is out of bounds\n", div);
+            printf("ERROR: set_clock_pwm() returned %d\n", -EFREQNOTMET);
+        }
+
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Stop DMA of a PWM signal, input capture or ranging (restarted below
+    // as a clock output):
+    enabled = dma_channels[channel].enabled;
+    if (enabled && (dma_channels[channel].mode != CHANNEL_MODE_CLOCK)) {
+        disable_pwm(channel);
+    }
+
+    // Replace decoding, ranging or clock output state:
+    leave_mode(channel);
+
+    // No GPIOs to clear when disabled (in a buffer of its own, cached
+    // sequences keep their masks):
+    select_base_buf(channel);
+    *(uint64_t*)dma_channels[channel].clear_mask[ \
+        dma_channels[channel].selected_cb_buf]->virt_addr = 0;
+    *(uint64_t*)dma_channels[channel].set_mask[ \
+        dma_channels[channel].selected_cb_buf]->virt_addr = 0;
+
+    // Output clock on GPIO:
+    GPIO_ALT(gpio_base_virt_addr, gpio, fsel);
+
+    // Update channel structure (fractional divisors need MASH):
+    dma_channels[channel].gpclk = gpclk;
+    dma_channels[channel].alt_gpio = gpio;
+    dma_channels[channel].gpclk_ctl = (src << 0) | CM_MASH(divf ? 1 : 0);
+    dma_channels[channel].gpclk_div = (divi << CM_DIVF_BITS) | divf;
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = src_freq / \
+        (divi + ((float)divf / (1 << CM_DIVF_BITS)));
+    dma_channels[channel].pwm_d_des = 50;
+    dma_channels[channel].pwm_d_act = 50;
+    dma_channels[channel].bus_rate = 0;
+    dma_channels[channel].mode = CHANNEL_MODE_CLOCK;
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting clock output properties:\n");
+        printf("GPCLK%d on GPIO %d\n", gpclk, gpio);
+        printf("Clock source = %d (%0.0f Hz)\n", src, src_freq);
+        printf("Divisor = %u + %u / 4096\n", divi, divf);
+        printf("Actual frequency = %.3f Hz\n", \
+            dma_channels[channel].freq_act);
+    }
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Start clock if channel is already enabled:
+    if (enabled) {
+        // Restart clock:
+        enable_pwm(channel);
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Setup a serializer output of PWM channel 1 for a requested channel:
+// (bits of a looping pattern are streamed through the PWM FIFO, each lasting
+// a PWM clock cycle instead of a "wait" CB tick)
+int set_serial_pwm(int channel, int gpio, float freq, float duty_cycle) {
+    // Definitions:
+    int ret;         // Function return value
+    uint8_t enabled; // Channel enabled
+
+    float bit_us;     // Serialized bit duration
+    size_t period;    // PWM period in bits
+    size_t high;      // PWM high time in bits
+    size_t num_words; // Words in the bit pattern loop
+    size_t num_cbs;   // CB sequence length
+    size_t size_req;  // Required CB buffer size
+    float bus_rate;   // Bus transfers per second
+
+    int cb_buf;      // Which CB buffer to use
+    uint32_t *words; // Bit pattern
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Serializer output to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_serial_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if GPIO has no PWM channel 1 output (the RP1 has none):
+    if (pwm_fsel(1, gpio) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: GPIO %d has no PWM channel 1 output\n", gpio);
+            printf("ERROR: set_serial_pwm() returned %d\n", -EINVGPIO);
+        }
+
+        // Exit with error:
+        return -EINVGPIO;
+    }
+
+    // Abort if duty cycle does not make sense:
+    if ((duty_cycle < 0) || (duty_cycle > 100)) {
+        // Exit with error:
+        return -EINVDUTY;
+    }
+
+    // Plan bit pattern:
+    bit_us = serial_bit_us();
+    if ((ret = plan_pattern(freq, duty_cycle, bit_us, &period, &high, \
+        &num_words)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_serial_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+    num_cbs = (num_words + max_paced_words(channel) - 1) / \
+        max_paced_words(channel);
+
+    // Abort if CBs and bit pattern do not fit in the CB buffer:
+    size_req = (num_cbs * cb_size(channel)) + (num_words * sizeof(uint32_t));
+    if (size_req > dma_channels[channel].cb_base[0]->size) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: serializer requires %zu bytes > %zu allocated\n", \
+                size_req, (size_t)dma_channels[channel].cb_base[0]->size);
+            printf("ERROR: set_serial_pwm() returned %d\n", -ENOMEM);
+        }
+
+        // Exit with error:
+        return -ENOMEM;
+    }
+
+    // Abort if bus budget is exceeded (every word is one transfer):
+    bus_rate = seq_bus_rate(num_cbs, num_words, \
+        num_words * SERIAL_BITS * bit_us);
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_serial_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Stop DMA of the current output (restarted below as a serializer
+    // output):
+    enabled = dma_channels[channel].enabled;
+    if (enabled) {
+        disable_pwm(channel);
+    }
+
+    // Replace decoding, ranging, clock or PWM channel 2 output state:
+    leave_mode(channel);
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Hold GPIO low while disabled:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = 0;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = 0;
+    gpio_in(gpio);
+    GPIO_CLEAR(gpio_base_virt_addr, gpio);
+    gpio_out(gpio);
+
+    // Fill bit pattern, most significant bit first:
+    words = (uint32_t*)((char*)dma_channels[channel].cb_base[cb_buf]->virt_addr \
+        + (num_cbs * cb_size(channel)));
+    fill_pattern(words, num_words, period, high, 0);
+
+    // Update channel structure:
+    dma_channels[channel].alt_gpio = gpio;
+    dma_channels[channel].serial_words = num_words;
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = 1e6 / (period * bit_us);
+    dma_channels[channel].pwm_d_des = duty_cycle;
+    dma_channels[channel].pwm_d_act = 100 * (float)high / period;
+    dma_channels[channel].pwm_d_res = 100.0 / period;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_SERIAL;
+
+    // Build control block sequence for the DMA channel:
+    build_serial_seq(channel, num_cbs);
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting serializer output properties:\n");
+        printf("Bit = %0.4f us\n", bit_us);
+        printf("Period = %zu bits, high = %zu bits\n", period, high);
+        printf("Pattern = %zu words\n", num_words);
+        printf("Actual frequency = %.3f Hz\n", \
+            dma_channels[channel].freq_act);
+    }
+
+    // Update flags:
+    dma_channels[channel].seq_built = 1;
+
+    // Load CB and start DMA if channel is already enabled:
+    if (enabled) {
+        // Restart serializer output:
+        enable_pwm(channel);
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Build the CB sequence of a timebase chain into the selected CB buffer:
+// each segment sets or clears GPIOs and waits its FIFO words, writing the
+// range of the next segment from a table after the CBs (and applying it on
+// the RP1) before its last word
+//
+// The DMA runs ahead of the PWM output by the words queued in the FIFO and
+// a word is output with the range set when it starts, so a GPIO edge is
+// followed by the word the FIFO started with it, output in the range of the
+// segment before. Writing the range one word ahead makes that word and the
+// queued ones last the range of the new segment too. The last segment
+// writes the range of the first one from the first table entry, which is
+// the range of the queued sequence once linked to one (see
+// link_timebase_seq()).
+static void build_timebase_seq(int channel, size_t num_seg, uint32_t *rng, \
+    size_t *words, uint8_t *clear) {
+    // Definitions:
+    size_t i;
+
+    int cb_buf;        // Which CB buffer to use
+    size_t num_cbs;    // CBs of the sequence
+    uint32_t *table;   // Next sequence range, PWM ranges and RP1 update word
+
+    struct dma_cb *dma_cb_base; // First control block
+    struct dma_cb *dma_cb_seq;  // Next control block
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    dma_cb_base = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+    dma_cb_seq = dma_cb_base;
+
+    // Range table follows the CBs:
+    num_cbs = 0;
+    for (i = 0; i < num_seg; i++) {
+        num_cbs += (pwmupd_bus_addr ? 4 : 3) + ((words[i] > 1) ? 1 : 0);
+    }
+    table = (uint32_t*)((char*)dma_cb_base + (num_cbs * cb_size(channel)));
+    table[0] = rng[0];
+    for (i = 0; i < num_seg; i++) {
+        table[i + 1] = rng[i];
+    }
+    table[num_seg + 1] = RP1_PWM_SET_UPDATE | RP1_PWM_CHAN_EN(0);
+
+    for (i = 0; i < num_seg; i++) {
+        // Set or clear GPIOs:
+        dma_cb_seq->info = dma_channels[channel].ti | \
+            dma_channels[channel].gpio_ti;
+        dma_cb_seq->src = clear[i] ? \
+            dma_channels[channel].clear_mask_bus_addr[cb_buf] : \
+            dma_channels[channel].set_mask_bus_addr[cb_buf];
+        dma_cb_seq->dst = clear[i] ? gpclr0_bus_addr : gpset0_bus_addr;
+        dma_cb_seq->length = dma_channels[channel].gpio_len;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        dma_cb_seq++;
+
+        // Wait the segment's FIFO words but the last:
+        if (words[i] > 1) {
+            dma_cb_seq->info = dma_channels[channel].ti | \
+                DMA_DREQ | DMA_PER_MAP(5);
+            dma_cb_seq->src = 0xABCDEF; // Random data
+            dma_cb_seq->dst = pwmfif1_bus_addr;
+            dma_cb_seq->length = 4 * (words[i] - 1);
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+        }
+
+        // Write the range of the next segment's FIFO words:
+        dma_cb_seq->info = dma_channels[channel].ti;
+        dma_cb_seq->src = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], \
+            &table[(i + 1 < num_seg) ? (i + 2) : 0]);
+        dma_cb_seq->dst = pwmrng1_bus_addr;
+        dma_cb_seq->length = 4;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        dma_cb_seq++;
+
+        // Apply it (RP1 channel settings are latched):
+        if (pwmupd_bus_addr) {
+            dma_cb_seq->info = dma_channels[channel].ti;
+            dma_cb_seq->src = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], &table[num_seg + 1]);
+            dma_cb_seq->dst = pwmupd_bus_addr;
+            dma_cb_seq->length = 4;
+            dma_cb_seq->stride = 0;
+            dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+                dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+            dma_cb_seq++;
+        }
+
+        // Wait the segment's last FIFO word:
+        dma_cb_seq->info = dma_channels[channel].ti | \
+            DMA_DREQ | DMA_PER_MAP(5);
+        dma_cb_seq->src = 0xABCDEF; // Random data
+        dma_cb_seq->dst = pwmfif1_bus_addr;
+        dma_cb_seq->length = 4;
+        dma_cb_seq->stride = 0;
+        dma_cb_seq->next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], (dma_cb_seq + 1));
+        dma_cb_seq++;
+    }
+
+    // Link last CB to beginning:
+    (dma_cb_seq - 1)->next = dma_channels[channel].cb_base_bus_addr[cb_buf];
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, dma_cb_seq - dma_cb_base);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Built timebase CB sequence for channel %d on buffer %d \n", \
+            channel, cb_buf);
+    }
+}
+
+// Give the running or queued timebase sequences of a channel the range of
+// the first segment of a sequence being queued after them (written by their
+// last segment, see build_timebase_seq()):
+static void link_timebase_seq(int channel, int cb_buf) {
+    // Definitions:
+    int i;
+
+    uint32_t first; // Range of the first segment
+
+    // First range of the queued sequence:
+    first = ((volatile uint32_t*)((char*)dma_channels[channel]. \
+        cb_base[cb_buf]->virt_addr + (dma_channels[channel].cb_num[cb_buf] * \
+        cb_size(channel))))[1];
+
+    // Write it to every sequence the DMA may be in:
+    for (i = 0; i < ring_bufs; i++) {
+        if ((i != cb_buf) && \
+           ((dma_channels[channel].buf_state[i] == BUF_LIVE) || \
+           (dma_channels[channel].buf_state[i] == BUF_QUEUED))) {
+            ((volatile uint32_t*)((char*)dma_channels[channel]. \
+                cb_base[i]->virt_addr + (dma_channels[channel].cb_num[i] * \
+                cb_size(channel))))[0] = first;
+        }
+    }
+}
+
+// Split a segment of a timebase chain into FIFO words of one PWM range:
+// (as few words as the range register allows, so one CB waits the whole
+// segment)
+static int plan_segment(int channel, double steps, uint32_t *rng, \
+    size_t *words) {
+    // Definitions:
+    uint64_t total; // Range steps of the segment
+
+    total = (steps > 0) ? (uint64_t)(steps + 0.5) : 0;
+    *words = (size_t)(total / UINT32_MAX) + 1;
+    *rng = (uint32_t)((total + (*words / 2)) / *words);
+
+    // Abort if the segment is too short or too long for one paced CB:
+    if ((*rng < TIMEBASE_MIN_RNG) || (*words > max_paced_words(channel))) {
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Set a PWM signal on a requested channel as a timebase chain:
+int set_timebase_pwm(int channel, int* gpio, size_t num_gpio, \
+    float freq, float duty_cycle) {
+    // Definitions:
+    size_t i;
+
+    int ret;            // Function return value
+    int max_gpio;       // Highest GPIO of the board
+    int cb_buf;         // Which CB buffer to use
+    int seamless;       // Queue the sequence on the running DMA
+    uint8_t gpio_len;   // Bytes written by a GPIO CB
+    uint64_t mask;      // GPIO mask
+    size_t num_seg;     // Segments of the chain
+    size_t num_cbs;     // CB sequence length
+    size_t num_words;   // FIFO words of the chain
+    float step_us;      // Duration of one range step
+    double period_us;   // Desired period
+    double high_us;     // Desired high time
+    double seg_us[2];   // Achieved segment durations
+    float bus_rate;     // Bus transfers per second
+
+    uint32_t rng[2];  // PWM range of each segment
+    size_t words[2];  // FIFO words of each segment
+    uint8_t clear[2]; // Segment clears GPIOs
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Timebase PWM signal to be set on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_timebase_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if duty cycle is not within bounds:
+    if ((duty_cycle < 0) || (duty_cycle > 100)) {
+        // Exit with error:
+        return -EINVDUTY;
+    }
+
+    // Abort if frequency does not make sense:
+    if (!(freq > 0)) {
+        // Exit with error:
+        return -EFREQNOTMET;
+    }
+
+    // Abort if input GPIOs do not make sense:
+    max_gpio = (pi_version == 5) ? RP1_MAX_GPIO : \
+        ((pi_version == 4) ? BCM2711_MAX_GPIO : BCM2835_MAX_GPIO);
+    gpio_len = 4;
+    mask = 0;
+    for (i = 0; i < num_gpio; i++) {
+        if ((gpio[i] < 0) || (gpio[i] > max_gpio)) {
+            // Debug logs:
+            if (DEBUG) {
+                // Log message:
+                printf("ERROR: GPIO %d is not valid\n", gpio[i]);
+                printf("ERROR: set_timebase_pwm() returned %d\n", \
+                    -EINVGPIO);
+            }
+
+            // Exit with error:
+            return -EINVGPIO;
+        }
+
+        // Write both banks with one CB if any GPIO is in bank 1:
+        gpio_len = (gpio[i] > 31) ? 8 : gpio_len;
+        mask |= ((uint64_t)1 << gpio[i]);
+    }
+
+    // Segments last their FIFO words only (the GPIO, range write and RP1
+    // update CBs run while the FIFO outputs queued words):
+    step_us = range_step_us();
+    period_us = 1e6 / freq;
+    high_us = period_us * duty_cycle / 100;
+
+    // Duty cycles of 0 and 100 are one segment, others a high and a low
+    // one:
+    if ((int)duty_cycle % 100 == 0) {
+        num_seg = 1;
+        clear[0] = ((int)duty_cycle == 0);
+        ret = plan_segment(channel, period_us / step_us, &rng[0], \
+            &words[0]);
+    } else {
+        num_seg = 2;
+        clear[0] = 0;
+        clear[1] = 1;
+        ret = plan_segment(channel, high_us / step_us, &rng[0], &words[0]);
+        ret = (ret < 0) ? ret : plan_segment(channel, \
+            (period_us - high_us) / step_us, &rng[1], &words[1]);
+    }
+
+    // Abort if a segment cannot be met:
+    if (ret < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_timebase_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Get achieved segment durations:
+    num_cbs = 0;
+    num_words = 0;
+    for (i = 0; i < num_seg; i++) {
+        seg_us[i] = (double)words[i] * rng[i] * step_us;
+        num_cbs += (pwmupd_bus_addr ? 4 : 3) + ((words[i] > 1) ? 1 : 0);
+        num_words += words[i] + (gpio_len / 4) + (pwmupd_bus_addr ? 2 : 1);
+    }
+
+    // Abort if bus budget is exceeded:
+    bus_rate = seq_bus_rate(num_cbs, num_words, seg_us[0] + \
+        ((num_seg > 1) ? seg_us[1] : 0));
+    if ((ret = check_bus_budget(channel, bus_rate)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_timebase_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Queue the sequence instead of restarting the DMA if a timebase chain
+    // is being output from the ring:
+    seamless = dma_channels[channel].enabled && \
+        (dma_channels[channel].mode == CHANNEL_MODE_TIMEBASE) && \
+        ((dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_LIVE) || \
+        (dma_channels[channel].buf_state[ \
+        dma_channels[channel].selected_cb_buf] == BUF_QUEUED));
+
+    // Leave input capture, ranging or clock output and set GPIOs to output:
+    if (dma_channels[channel].mode != CHANNEL_MODE_TIMEBASE) {
+        leave_mode(channel);
+    }
+
+    for (i = 0; i < num_gpio; i++) {
+        gpio_out(gpio[i]);
+    }
+
+    // Every GPIO is set and cleared together:
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = mask;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = mask;
+
+    // Update channel structure:
+    dma_channels[channel].t_sub_us = seg_us[0] + \
+        ((num_seg > 1) ? seg_us[1] : 0);
+    dma_channels[channel].freq_des = freq;
+    dma_channels[channel].freq_act = 1e6 / dma_channels[channel].t_sub_us;
+    dma_channels[channel].pwm_d_des = duty_cycle;
+    dma_channels[channel].pwm_d_act = (num_seg > 1) ? \
+        (100 * seg_us[0] / dma_channels[channel].t_sub_us) : \
+        (clear[0] ? 0 : 100);
+    dma_channels[channel].pwm_d_res = 100 * words[0] * step_us / \
+        dma_channels[channel].t_sub_us;
+    dma_channels[channel].cb_seq_num = num_cbs;
+    dma_channels[channel].cb_set_num = 0;
+    dma_channels[channel].cb_clr_num = 0;
+    dma_channels[channel].gpio_ti = (gpio_len > 4) ? \
+        (DMA_SRC_INC | DMA_DEST_INC) : 0;
+    dma_channels[channel].gpio_len = gpio_len;
+    dma_channels[channel].compressed = 1;
+    dma_channels[channel].bus_rate = bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].mode = CHANNEL_MODE_TIMEBASE;
+    dma_channels[channel].seq_built = 1;
+
+    // Build control block sequence for the DMA channel:
+    dma_channels[channel].buf_state[cb_buf] = BUF_BUILDING;
+    build_timebase_seq(channel, num_seg, rng, words, clear);
+
+    // Debug logs:
+    if (DEBUG) {
+        printf("Setting timebase PWM signal properties:\n");
+        printf("Range step = %0.4f us\n", step_us);
+        for (i = 0; i < num_seg; i++) {
+            printf("Segment %zu: %zu words of range %u\n", i, words[i], \
+                rng[i]);
+        }
+        printf("Actual frequency = %.3f Hz\n", \
+            dma_channels[channel].freq_act);
+    }
+
+    // Queue CB sequence at the end of the current period or load it and
+    // start DMA if channel is already enabled:
+    if (seamless) {
+        link_timebase_seq(channel, cb_buf);
+        queue_seq(channel, cb_buf);
+    } else if (dma_channels[channel].enabled) {
+        enable_pwm(channel);
+    } else {
+        dma_channels[channel].buf_state[cb_buf] = BUF_FREE;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Enable PWM output for a channel:
+int enable_pwm(int channel) {
+    // Definitions
+    uint8_t cb_buf; // Which CB buffer to use
+
+    int ret; // Function return value
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Channel %d to be enabled\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: enable_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if channel does not have a CB sequence built:
+    if (!(dma_channels[channel].seq_built)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Log message:
+            printf("ERROR: channel %d has no PWM signal set\n", channel);
+            printf("ERROR: enable_pwm() returned %d\n", -EPWMNOTSET);
+        }
+
+        // Exit with error:
+        return -EPWMNOTSET;
+    }
+
+    // Clock and PWM channel 2 outputs need no DMA:
+    if (dma_channels[channel].mode == CHANNEL_MODE_CLOCK) {
+        // Start clock:
+        start_gpclk(channel);
+
+        // Update/enforce channel status:
+        dma_channels[channel].enabled = 1;
+        arm_teardown(channel);
+
+        // Exit:
+        return 0;
+    } else if (dma_channels[channel].mode == CHANNEL_MODE_PWM2) {
+        // Enable PWM channel 2 in mark-space mode:
+        pwm_ctl_reg->ctl |= (PWM_EN2 | PWM_MSEN2);
+
+        // Update/enforce channel status:
+        dma_channels[channel].enabled = 1;
+        arm_teardown(channel);
+
+        // Exit:
+        return 0;
+    }
+
+    // Abort if the PWM FIFO is used by another channel in a conflicting way:
+    if (fifo_busy(channel)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: enable_pwm() returned %d\n", -EFIFOBUSY);
+        }
+
+        // Exit with error:
+        return -EFIFOBUSY;
+    }
+
+    // Get which CB buffer to load:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Loading CB sequence from buffer %d \n", cb_buf);
+    }
+
+    // Serialize FIFO words on the GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_SERIAL) {
+        serialize_pwm(1);
+        GPIO_ALT(gpio_base_virt_addr, dma_channels[channel].alt_gpio, \
+            pwm_fsel(1, dma_channels[channel].alt_gpio));
+    }
+
+    // Shift SPI0 FIFO words out on the GPIO:
+    if (dma_channels[channel].mode == CHANNEL_MODE_SPI) {
+        start_spi(channel);
+    }
+
+    // Decode from the first sample block if capturing:
+    if (dma_channels[channel].mode == CHANNEL_MODE_CAPTURE) {
+        // Reset decoding:
+        dma_channels[channel].cap_next_block = 0;
+        capture_resync__(dma_channels[channel].capture, 0);
+        clock_gettime(CLOCK_MONOTONIC, &dma_channels[channel].cap_last);
+    }
+
+    // Start a ranging round:
+    if (dma_channels[channel].mode == CHANNEL_MODE_RANGE) {
+        clock_gettime(CLOCK_MONOTONIC, &dma_channels[channel].range_start);
+    }
+
+    // Report events of this run only:
+    dma_channels[channel].update_pending = 0;
+    dma_channels[channel].stalled = 0;
+    dma_channels[channel].ended = 0;
+    dma_channels[channel].cap_lost = 0;
+    dma_channels[channel].ev_cb = 0;
+    dma_channels[channel].ev_block = 0;
+    clock_gettime(CLOCK_MONOTONIC, &dma_channels[channel].ev_moved);
+
+    // Load CB sequence (restored if it already ran) and start DMA:
+    rearm_rp1_seq(channel, cb_buf);
+    start_dma(channel, dma_channels[channel].cb_base_bus_addr[cb_buf]);
+
+    // Update/enforce channel status (the loaded buffer is the only one in
+    // use):
+    dma_channels[channel].enabled = 1;
+    reset_ring(channel, 1);
+    arm_teardown(channel);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Channel %d enabled\n", channel);
+    }
+
+    // Exit:
+    return 0;
+}
+
+// Run a calibration chain of GPIO clear CBs with an empty mask and get its
+// duration in us:
+// (timed by the DMA copying the system timer before and after the timed
+// CBs, or by the CPU from start to end of the chain without a system timer)
+static int time_chain(int channel, int cb_buf, size_t num_cbs, \
+    uint32_t *elapsed_us) {
+    // Definitions:
+    size_t i;
+
+    volatile uint32_t *scratch; // Timer samples and empty mask
+    uint32_t scratch_bus_addr;  // Timer samples and empty mask bus address
+
+    struct timespec poll = {.tv_sec = 0, .tv_nsec = 100000}; // Poll period
+    struct timespec start;                                    // Chain start
+    struct timespec end;                                      // Chain end
+
+    // Assign control block sequence to channel's cb virtual base:
+    struct dma_cb *dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+
+    // Scratch words follow the CBs:
+    scratch = (volatile uint32_t*)((char*)dma_cb_seq + \
+        (num_cbs + 2) * cb_size(channel));
+    scratch_bus_addr = uncached_virt_to_bus_addr__( \
+        dma_channels[channel].cb_base[cb_buf], (void*)scratch);
+    scratch[0] = 0;
+    scratch[1] = 0;
+    scratch[2] = 0;
+
+    // Build CB sequence:
+    for (i = 0; i < num_cbs + 2; i++) {
+        dma_cb_seq[i].info = dma_channels[channel].ti;
+        dma_cb_seq[i].length = 4;
+        dma_cb_seq[i].stride = 0;
+        dma_cb_seq[i].next = uncached_virt_to_bus_addr__( \
+            dma_channels[channel].cb_base[cb_buf], &dma_cb_seq[i + 1]);
+
+        // Copy system timer first and last:
+        if (((i == 0) || (i == num_cbs + 1)) && stclo_bus_addr) {
+            dma_cb_seq[i].src = stclo_bus_addr;
+            dma_cb_seq[i].dst = scratch_bus_addr + \
+                ((i == 0) ? 0 : sizeof(uint32_t));
+        // Clear no GPIOs:
+        } else {
+            dma_cb_seq[i].src = scratch_bus_addr + 2 * sizeof(uint32_t);
+            dma_cb_seq[i].dst = gpclr0_bus_addr;
+        }
+    }
+
+    // End of chain:
+    dma_cb_seq[num_cbs + 1].next = 0;
+
+    // Translate for the channel's DMA engine:
+    translate_seq(channel, cb_buf, num_cbs + 2);
+
+    // Run chain:
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    start_dma(channel, dma_channels[channel].cb_base_bus_addr[cb_buf]);
+
+    // Wait for the chain to end:
+    for (i = 0; (i < CALIBRATION_TIMEOUT_US / 100) && \
+        !(dma_done(channel)); i++) {
+        nanosleep(&poll, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Stop channel:
+    stop_dma(channel);
+
+    // Timed by the CPU without a system timer:
+    if (!(stclo_bus_addr)) {
+        scratch[0] = 0;
+        scratch[1] = (end.tv_sec - start.tv_sec) * 1000000 + \
+            (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+
+    // Abort if chain did not complete:
+    if ((i == CALIBRATION_TIMEOUT_US / 100) || (scratch[1] < scratch[0])) {
+        // Exit with error:
+        return -ECALFAIL;
+    }
+
+    // Exit with duration:
+    *elapsed_us = scratch[1] - scratch[0];
+    return 0;
+}
+
+// Measure the duration of an unpaced CB:
+// (a chain of GPIO clear CBs with an empty mask, which mirror the GPIO set
+// and clear CBs of a PWM signal, is timed by the DMA copying the system
+// timer before and after it; the RP1 has no system timer, so the CPU times
+// its chain against one without timed CBs, keeping the shortest of a few
+// runs, which cancels the latency of starting and polling the channel)
+float calibrate_pwm(int channel) {
+    // Definitions:
+    size_t i;
+
+    int ret; // Function return value
+
+    int cb_buf;          // Which CB buffer to use
+    uint8_t was_enabled; // Channel was enabled
+    size_t num_cbs;      // Number of timed CBs
+    float overhead_us;   // Measured CB duration
+
+    uint32_t elapsed_us; // Duration of the timed CBs
+    uint32_t full_us;    // Shortest CPU timed chain
+    uint32_t empty_us;   // Shortest CPU timed chain without timed CBs
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Calibrating CB overhead on channel %d\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: calibrate_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Use a free ring buffer (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Number of timed CBs fitting in the buffer with two timer CBs and
+    // three scratch words:
+    num_cbs = (dma_channels[channel].cb_base[cb_buf]->size - \
+        3 * sizeof(uint32_t)) / cb_size(channel) - 2;
+    num_cbs = (num_cbs > CALIBRATION_CBS) ? CALIBRATION_CBS : num_cbs;
+
+    // Stop the channel while timing:
+    was_enabled = dma_channels[channel].enabled;
+    dma_channels[channel].enabled = 0;
+
+    // Time chain:
+    if (stclo_bus_addr) {
+        ret = time_chain(channel, cb_buf, num_cbs, &elapsed_us);
+    // Time chains with and without timed CBs by the CPU:
+    } else {
+        full_us = UINT32_MAX;
+        empty_us = UINT32_MAX;
+        for (i = 0; (i < CALIBRATION_RUNS) && (ret == 0); i++) {
+            if ((ret = time_chain(channel, cb_buf, num_cbs, \
+                &elapsed_us)) == 0) {
+                full_us = (elapsed_us < full_us) ? elapsed_us : full_us;
+                ret = time_chain(channel, cb_buf, 0, &elapsed_us);
+                empty_us = (elapsed_us < empty_us) ? elapsed_us : empty_us;
+            }
+        }
+        elapsed_us = (full_us > empty_us) ? (full_us - empty_us) : 0;
+    }
+
+    // Restore output:
+    if (was_enabled) {
+        enable_pwm(channel);
+    }
+
+    // Abort if chain did not complete:
+    if (ret < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: calibration CB chain did not complete\n");
+            printf("ERROR: calibrate_pwm() returned %d\n", -ECALFAIL);
+        }
+
+        // Exit with error:
+        return -ECALFAIL;
+    }
+
+    // Each CB from the first timer copy to the last (or each timed CB):
+    overhead_us = elapsed_us / \
+        (float)(stclo_bus_addr ? (num_cbs + 1) : num_cbs);
+
+    // Update:
+    cb_overhead_us = overhead_us;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Timed %zu CBs in %u us\n", num_cbs, elapsed_us);
+        printf("Setting CB overhead to %0.4f us\n", cb_overhead_us);
+    }
+
+    // Exit with measured CB overhead:
+    return overhead_us;
+}
+
+// Get measured duration of an unpaced CB:
+float get_cb_overhead_pwm(void) {
+    // Return CB overhead:
+    return cb_overhead_us;
+}
+
+// Get sample period of input capture and ranging:
+float get_sample_tick_pwm(void) {
+    // Return sample period:
+    return sample_tick_us();
+}
+
+// Clear all channel GPIOs
+static int clear_channel_gpio(int channel) {
+    // Definitions:
+    int i;
+
+    int bit;           // Bit state
+    uint64_t set_mask; // GPIO set mask
+
+    uint8_t cb_buf; // Which CB buffer to use
+
+    // Nothing to clear if no signal was ever set:
+    if (!(dma_channels[channel].seq_built)) {
+        // Exit with success:
+        return 0;
+    }
+
+    // Get which CB buffer to use:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Get GPIO set mask to know which GPIOs to clear:
+    set_mask = *(uint64_t*) \
+        dma_channels[channel].set_mask[cb_buf]->virt_addr;
+
+    // Clear GPIOs:
+    for (i = 0; i < sizeof(uint64_t) * 8; i++) {
+        // Get bit value at the position:
+        bit = (set_mask >> i) & 0x01;
+
+        // Clear GPIO if it set:
+        if (bit) {
+            // Debug logs:
+            if (DEBUG) {
+                // Logs:
+                printf("GPIO BCM pin %d cleared\n", i);
+            }
+
+            // Clear pin:
+            gpio_clear(i);
+        }
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Disable DMA channel
+int disable_pwm(int channel) {
+    // Definitions:
+    int ret; // Function return value
+    
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Channel %d to be disabled\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: disable_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Nothing to stop on teardown:
+    teardown_armed[channel] = 0;
+
+    // Stop clock output, PWM channel 2 or DMA transfer:
+    if (dma_channels[channel].mode == CHANNEL_MODE_CLOCK) {
+        stop_gpclk(dma_channels[channel].gpclk);
+    } else if (dma_channels[channel].mode == CHANNEL_MODE_PWM2) {
+        pwm_ctl_reg->ctl &= ~PWM_EN2;
+    } else {
+        stop_dma(channel);
+    }
+
+    // Return PWM channel 1 to pacing DMA and hold the serializer GPIO low:
+    if ((dma_channels[channel].mode == CHANNEL_MODE_SERIAL) && \
+        dma_channels[channel].enabled) {
+        serialize_pwm(0);
+        gpio_in(dma_channels[channel].alt_gpio);
+        gpio_out(dma_channels[channel].alt_gpio);
+    }
+
+    // Return the PWM range to "wait" ticks for other channels:
+    if ((dma_channels[channel].mode == CHANNEL_MODE_TIMEBASE) && \
+        dma_channels[channel].enabled) {
+        restore_range();
+    }
+
+    // Stop SPI0 and hold the MOSI GPIO low:
+    if ((dma_channels[channel].mode == CHANNEL_MODE_SPI) && \
+        dma_channels[channel].enabled) {
+        spi_reg->cs = SPI_CS_CLEAR;
+        gpio_in(dma_channels[channel].alt_gpio);
+        gpio_out(dma_channels[channel].alt_gpio);
+    }
+
+    // Clear GPIOs:
+    clear_channel_gpio(channel);
+
+    // Update channel structure:
+    dma_channels[channel].enabled = 0;
+    reset_ring(channel, 0);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Channel %d disabled\n", channel);
+    }
+
+    // Exit with success:
+    return 0;
+
+}
+
+// Clean-up
+// - Halt DMA controller
+// - Free allocated memory
+int free_pwm(int channel) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Channel %d to be freed\n", channel);
+    }
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: free_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Disable DMA channel (if not already disabled):
+    if (dma_channels[channel].enabled) {
+        disable_pwm(channel);
+    }
+
+    // Free cached sequences:
+    flush_cache(channel);
+
+    // Free both buffers (pooled channels keep them for the next request):
+    if (!(dma_channels_pooled[channel])) {
+        dealloc_channel(channel);
+    }
+
+    // Free decoding and ranging state:
+    leave_mode(channel);
+
+    // Set flags:
+    dma_channels[channel].enabled = 0;
+    dma_channels[channel].seq_built = 0;
+
+    // Update channel status:
+    dma_channels_status[channel] = 1;
+
+    // Debug logs:
+    if (DEBUG) {
+        // Log message:
+        printf("Channel %d freed\n", channel);
+    }
+
+    // Return success:
+    return 0;
+}
+
+// Check if a DMA channel's engine is running (e.g. used by another driver):
+static int dma_active(int channel) {
+    // RP1 DMA channels run while enabled:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        // Exit with status:
+        return (dma_ctl_base_virt_addr[RP1_DMAC_CHEN] & \
+            RP1_CH_EN(dma_channels[channel].rp1_channel)) ? 1 : 0;
+    }
+
+    // Exit with status:
+    return (dma_channels[channel].dma_reg->cs & DMA_ACTIVE) ? 1 : 0;
+}
+
+// Pause a DMA channel without delays:
+static void pause_dma(int channel) {
+    // Pause:
+    if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+        enable_rp1_dma(channel, 0);
+    } else {
+        dma_channels[channel].dma_reg->cs &= ~DMA_ACTIVE;
+    }
+}
+
+// Get microseconds between two times:
+static float span_us(struct timespec *from, struct timespec *to) {
+    // Return span:
+    return (to->tv_sec - from->tv_sec) * 1e6 + \
+        (to->tv_nsec - from->tv_nsec) / 1e3;
+}
+
+// Move a requested channel to a free DMA engine of the same kind: the new
+// engine picks up the running CB chain at the control block the old one
+// has just reached before the old one is stopped
+int migrate_pwm(int channel, struct migrate_pwm *migrate) {
+    // Definitions:
+    int i;
+    int ret; // Function return value
+
+    int target = -1; // Channel of the new engine
+    int handoff;     // Running DMA to hand over
+    int boundary;    // Old engine reached the next control block
+    int pooled;      // Pooled flag of the new engine's channel
+
+    uint32_t cb;   // Control block register of the old engine
+    uint32_t last; // Control block register at the previous poll
+    uint32_t high; // RP1 address bits 63:32
+
+    struct channel free_state; // State of the new engine's channel
+
+    struct timespec call;  // Time of the call
+    struct timespec prev;  // Time of the last poll before the boundary
+    struct timespec now;   // Time of the current poll
+    struct timespec done;  // Time the old engine was paused
+
+    // Get time of the call:
+    clock_gettime(CLOCK_MONOTONIC, &call);
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: migrate_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Find a free channel with an idle engine of the same kind (CB chains
+    // are translated for their engine):
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        // Skip requested channels:
+        if ((i == channel) || !(dma_channels_status[i])) {
+            // Next channel:
+            continue;
+        }
+
+        // Map registers (free channels may never have been allocated):
+        map_channel(i);
+
+        // Check engine:
+        if ((dma_channels[i].engine == dma_channels[channel].engine) && \
+            !(dma_active(i))) {
+            // Set channel as target:
+            target = i;
+
+            // Exit:
+            break;
+        }
+    }
+
+    // Abort if no engine is free:
+    if (target < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: No free DMA engine to migrate channel %d to\n", \
+                channel);
+            printf("ERROR: migrate_pwm() returned %d\n", -ENOFREECHNL);
+        }
+
+        // Exit with error:
+        return -ENOFREECHNL;
+    }
+
+    // Copy channel state to the new engine (the old one keeps running on
+    // it until handed over):
+    free_state = dma_channels[target];
+    dma_channels[target] = dma_channels[channel];
+    map_channel(target);
+
+    // Only a running CB chain is handed over:
+    handoff = dma_channels[channel].enabled && \
+        (dma_channels[channel].mode != CHANNEL_MODE_CLOCK) && \
+        (dma_channels[channel].mode != CHANNEL_MODE_PWM2) && \
+        !(dma_done(channel));
+
+    migrate->phase_error_us = 0;
+
+    if (handoff) {
+        // Set up the new engine:
+        prepare_dma(target);
+
+        // Wait for the old engine to move on to the next control block:
+        high = (dma_channels[channel].engine == DMA_ENGINE_RP1) ? \
+            dma_channels[channel].rp1_reg->llp[1] : 0;
+        clock_gettime(CLOCK_MONOTONIC, &prev);
+        last = cb_reg(channel);
+        now = prev;
+        while (((cb = cb_reg(channel)) == last) && \
+            (span_us(&call, &now) < MIGRATE_TIMEOUT_US)) {
+            // Poll again:
+            prev = now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        }
+        boundary = (cb != last);
+
+        // An RP1 DMA channel holds the descriptor after the one it has just
+        // reached:
+        if (boundary && (dma_channels[channel].engine == DMA_ENGINE_RP1)) {
+            cb = last;
+        }
+
+        // An RP1 descriptor is no longer valid once written back:
+        if (dma_channels[channel].engine == DMA_ENGINE_RP1) {
+            revalidate_rp1_cb(channel, cb);
+        }
+
+        // Hand over:
+        run_dma(target, cb, high);
+        pause_dma(channel);
+        clock_gettime(CLOCK_MONOTONIC, &done);
+
+        // Get most the new engine lags behind (not known without a
+        // boundary, the control block being executed is then restarted or
+        // skipped):
+        migrate->phase_error_us = boundary ? span_us(&prev, &done) : -1;
+
+        // Stop the old engine:
+        teardown_armed[channel] = 0;
+        arm_teardown(target);
+        stop_dma(channel);
+    }
+
+    // Give the old engine the free channel's state:
+    dma_channels[channel] = free_state;
+    map_channel(channel);
+
+    pooled = dma_channels_pooled[target];
+    dma_channels_pooled[target] = dma_channels_pooled[channel];
+    dma_channels_pooled[channel] = pooled;
+
+    // Record the engines now reading the buffers:
+    set_buf_channel(target);
+    if (dma_channels_pooled[channel]) {
+        set_buf_channel(channel);
+    }
+
+    // Update channel status:
+    dma_channels_status[target] = 0;
+    dma_channels_status[channel] = 1;
+
+    // Output stop of a signal without DMA:
+    if (teardown_armed[channel]) {
+        teardown_armed[channel] = 0;
+        arm_teardown(target);
+    }
+
+    // Get handover results:
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    migrate->dma_channel = (pi_version == 5) ? \
+        dma_channels[target].rp1_channel : valid_dma_channels[target];
+    migrate->latency_us = span_us(&call, handoff ? &done : &now);
+
+    // Debug logs:
+    if (DEBUG) {
+        // Logs:
+        printf("Channel %d migrated to channel %d in %f us (phase error "
+            "%f us)\n", channel, target, migrate->latency_us, \
+            migrate->phase_error_us);
+    }
+
+    // Exit with new channel:
+    return target;
+}
+
+// Get channel PWM signal duty cycle:
+float get_duty_cycle_pwm(int channel) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_duty_cycle_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Return duty cycle:
+    return dma_channels[channel].pwm_d_act;
+}
+
+// Get channel PWM signal duty cycle frequency:
+float get_freq_pwm(int channel) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_freq_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Return frequency:
+    return dma_channels[channel].freq_act;
+}
+
+// Get the sample block a capturing channel's DMA is writing:
+// (-1 if not known)
+static long capture_block(int channel) {
+    // Definitions:
+    uint8_t cb_buf; // Which CB buffer is used
+
+    uint32_t conblk_ad; // Current control block bus address
+    size_t cb_index;    // Current control block index
+
+    // Get which CB buffer is used:
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    // Get current control block:
+    conblk_ad = current_cb(channel);
+
+    // Not known if DMA is not (yet) in the capture sequence:
+    if ((conblk_ad < dma_channels[channel].cb_base_bus_addr[cb_buf]) || \
+       ((char*)dma_channels[channel].cb_base[cb_buf]->virt_addr + \
+       (conblk_ad - dma_channels[channel].cb_base_bus_addr[cb_buf]) >= \
+       (char*)dma_channels[channel].cap_samples)) {
+        // Exit with not known:
+        return -1;
+    }
+
+    // Exit with sample block being written (two CBs per sample):
+    cb_index = (conblk_ad - dma_channels[channel].cb_base_bus_addr[cb_buf]) \
+        / cb_size(channel);
+    return (cb_index / 2) / CAPTURE_BLOCK_SAMPLES;
+}
+
+// Decode sample blocks completed since last decode:
+static void update_capture(int channel) {
+    // Definitions:
+    long block;          // Sample block being written (-1 if not known)
+    size_t cur_block;    // Sample block being written
+    float tick_us;       // Sample period
+    float elapsed_us;    // Time since last decode
+    struct timespec now; // Current time
+
+    // Nothing to decode if not sampling or DMA is not (yet) in the capture
+    // sequence:
+    if (!(dma_channels[channel].enabled) || \
+        ((block = capture_block(channel)) < 0)) {
+        // Exit:
+        return;
+    }
+
+    cur_block = block;
+
+    // Get time since last decode:
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_us = \
+        (now.tv_sec - dma_channels[channel].cap_last.tv_sec) * 1e6 + \
+        (now.tv_nsec - dma_channels[channel].cap_last.tv_nsec) / 1e3;
+
+    // Samples were lost if DMA could have lapped the ring since last decode:
+    tick_us = sample_tick_us();
+    if (elapsed_us > ((dma_channels[channel].cap_blocks - 1) * \
+        CAPTURE_BLOCK_SAMPLES * tick_us)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("Channel %d capture overrun after %0.1f us\n", \
+                channel, elapsed_us);
+        }
+
+        // Restart decoding at block being written:
+        capture_resync__(dma_channels[channel].capture, 1);
+        dma_channels[channel].cap_next_block = cur_block;
+    }
+
+    // Decode each completed block:
+    while (dma_channels[channel].cap_next_block != cur_block) {
+        // Decode block:
+        capture_block__(dma_channels[channel].capture, \
+            dma_channels[channel].cap_samples + \
+            (dma_channels[channel].cap_next_block * CAPTURE_BLOCK_SAMPLES), \
+            CAPTURE_BLOCK_SAMPLES);
+
+        // Next block:
+        dma_channels[channel].cap_next_block = \
+            (dma_channels[channel].cap_next_block + 1) % \
+            dma_channels[channel].cap_blocks;
+    }
+
+    // Update:
+    dma_channels[channel].cap_last = now;
+}
+
+// Get measured input signal properties of a captured GPIO:
+int get_capture_pwm(int channel, int gpio, struct capture_pwm *capture) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_capture_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if channel is not capturing:
+    if (dma_channels[channel].mode != CHANNEL_MODE_CAPTURE) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: channel %d is not set up for capture\n", channel);
+            printf("ERROR: get_capture_pwm() returned %d\n", -ENOTCAPTURE);
+        }
+
+        // Exit with error:
+        return -ENOTCAPTURE;
+    }
+
+    // Decode new sample blocks:
+    update_capture(channel);
+
+    // Get properties (each sample is paced by one "wait" CB):
+    if (capture_get__(dma_channels[channel].capture, gpio, \
+        sample_tick_us(), capture) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: GPIO %d is not captured\n", gpio);
+            printf("ERROR: get_capture_pwm() returned %d\n", -ENOTCAPTURE);
+        }
+
+        // Exit with error:
+        return -ENOTCAPTURE;
+    }
+
+    // Exit with success:
+    return 0;
+}
+
+// Read edges of captured GPIOs in order of occurrence:
+int read_capture_pwm(int channel, struct edge_pwm *edges, size_t max_edges) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: read_capture_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if channel is not capturing:
+    if (dma_channels[channel].mode != CHANNEL_MODE_CAPTURE) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: channel %d is not set up for capture\n", channel);
+            printf("ERROR: read_capture_pwm() returned %d\n", -ENOTCAPTURE);
+        }
+
+        // Exit with error:
+        return -ENOTCAPTURE;
+    }
+
+    // Decode new sample blocks:
+    update_capture(channel);
+
+    // Exit with number of edges read:
+    return capture_read__(dma_channels[channel].capture, \
+        sample_tick_us(), edges, max_edges);
+}
+
+// Get echo of a ranging sensor:
+int get_range_pwm(int channel, int sensor, struct range_pwm *range) {
+    // Definitions:
+    int ret; // Function return value
+
+    uint8_t cb_buf; // Which CB buffer is used
+
+    size_t rise;         // Sample of echo rising edge
+    size_t fall;         // Sample of echo falling edge
+    size_t cb_index;     // Current control block index
+    float tick_us;       // Sample period
+    float elapsed_us;    // Time since ranging was enabled
+    struct timespec now; // Current time
+
+    struct range_sensor *range_sensor; // Ranging sensor
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_range_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if channel is not ranging or sensor is not set:
+    if ((dma_channels[channel].mode != CHANNEL_MODE_RANGE) || \
+        (sensor < 0) || ((size_t)sensor >= dma_channels[channel].range_num)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: sensor %d is not set up on channel %d\n", \
+                sensor, channel);
+            printf("ERROR: get_range_pwm() returned %d\n", -ENOTRANGE);
+        }
+
+        // Exit with error:
+        return -ENOTRANGE;
+    }
+
+    range_sensor = &dma_channels[channel].range[sensor];
+    tick_us = sample_tick_us();
+
+    range->echo_us = 0;
+    range->delay_us = 0;
+    range->done = 0;
+    range->timeout = 0;
+
+    // Nothing sampled if not ranging:
+    if (!(dma_channels[channel].enabled)) {
+        // Exit:
+        return 0;
+    }
+
+    // Get time since ranging was enabled:
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_us = \
+        (now.tv_sec - dma_channels[channel].range_start.tv_sec) * 1e6 + \
+        (now.tv_nsec - dma_channels[channel].range_start.tv_nsec) / 1e3;
+
+    // Sensor is done once the DMA has passed its slot and is not sampling
+    // it again (a single round ends the chain):
+    if (dma_channels[channel].range_pad_ticks == 0) {
+        range->done = dma_done(channel);
+    } else if (elapsed_us >= range_sensor->end_us) {
+        // Get current control block:
+        cb_buf = dma_channels[channel].selected_cb_buf;
+        cb_index = (current_cb(channel) - \
+            dma_channels[channel].cb_base_bus_addr[cb_buf]) / \
+            cb_size(channel);
+
+        range->done = ((cb_index < range_sensor->first_cb) || \
+            (cb_index >= range_sensor->end_cb));
+    }
+
+    if (!(range->done)) {
+        // Exit:
+        return 0;
+    }
+
+    // Find echo pulse:
+    if (capture_pulse__(dma_channels[channel].range_samples + \
+        (sensor * dma_channels[channel].range_num_samples), \
+        dma_channels[channel].range_num_samples, range_sensor->echo_gpio, \
+        &rise, &fall)) {
+        range->delay_us = rise * tick_us;
+        range->echo_us = (fall - rise) * tick_us;
+    } else {
+        range->timeout = 1;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Set bus priority and transfer settings of a requested channel:
+int set_bus_pwm(int channel, struct bus_pwm *bus) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: set_bus_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Abort if priorities are out of bounds:
+    if ((bus->prio > 15) || (bus->panic_prio > 15)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: priority %d or panic priority %d out of bounds\n", \
+                bus->prio, bus->panic_prio);
+            printf("ERROR: set_bus_pwm() returned %d\n", -EINVBUS);
         }
 
-        // Increment control block:
-        dma_cb_seq++;
+        // Exit with error:
+        return -EINVBUS;
     }
 
+    // Update channel structure:
+    dma_channels[channel].prio = bus->prio;
+    dma_channels[channel].panic_prio = bus->panic_prio;
+    dma_channels[channel].ti = (bus->wide_bursts ? 0 : DMA_NO_WIDE_BURSTS) | \
+        (bus->wait_resp ? DMA_WAIT_RESP : 0);
+
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("Built CB sequence for channel %d on buffer %d \n", \
-            channel, cb_buf);
+        printf("Channel %d bus priority = %d, panic priority = %d, " \
+            "TI flags = 0x%08X\n", channel, dma_channels[channel].prio, \
+            dma_channels[channel].panic_prio, dma_channels[channel].ti);
     }
+
+    // Exit with success:
+    return 0;
 }
 
-// Setup a PWM signal for a requested channel:
-int set_pwm(int channel, int* gpio, size_t num_gpio, \
-    float freq, float duty_cycle) {
+// Get bus priority and transfer settings of a requested channel:
+int get_bus_pwm(int channel, struct bus_pwm *bus) {
     // Definitions:
-    int i;
-
     int ret; // Function return value
 
-    unsigned t_sub_us; // PWM sub cycle period
-    size_t cb_seq_num; // CB sequence length
-    size_t pages_req;  // Number of required pages for the CB sequence
-    float freq_act;    // Actual PWM frequency achieved
-    float pwm_d_res;   // PWM duty cycle resolution
-    float pwm_d_act;   // Actual PWM duty cycle achieved 
-    size_t cb_set_num; // Number of "wait" CBs while GPIO set
-    size_t cb_clr_num; // Number of "wait" CBs while GPIO clear
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_bus_pwm() returned %d\n", ret);
+        }
 
-    uint32_t set_mask = 0;   // GPIO set mask
-    uint32_t clear_mask = 0; // GPIO clear mask
+        // Exit with error:
+        return ret;
+    }
 
-    int cb_buf; // Which CB buffer to use
+    // Copy settings:
+    bus->prio = dma_channels[channel].prio;
+    bus->panic_prio = dma_channels[channel].panic_prio;
+    bus->wide_bursts = !(dma_channels[channel].ti & DMA_NO_WIDE_BURSTS);
+    bus->wait_resp = (dma_channels[channel].ti & DMA_WAIT_RESP) ? 1 : 0;
 
-    // Debug logs:
-    if (DEBUG) {
-        // Log message:
-        printf("PWM signal to be set on channel %d\n", channel);
-    }
+    // Exit with success:
+    return 0;
+}
+
+// Allow signals of a requested channel on a PWM channel 2 GPIO to be passed
+// through to it:
+int set_passthrough_pwm(int channel, int enable) {
+    // Definitions:
+    int ret; // Function return value
 
     // Check channel:
     if ((ret = check_channel(channel)) < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: set_pwm() returned %d\n", ret);
+            printf("ERROR: set_passthrough_pwm() returned %d\n", ret);
         }
 
         // Exit with error:
         return ret;
     }
 
-    // Abort if duty cycle is not within bounds:
-    if ((duty_cycle < 0) || (duty_cycle > 100)) {
+    // Update channel structure (applies from the next set_pwm() call):
+    dma_channels[channel].passthrough = enable ? 1 : 0;
+
+    // Exit with success:
+    return 0;
+}
+
+// Allow signals of a requested channel on the SPI MOSI GPIO to be streamed
+// through SPI0:
+int set_spi_engine_pwm(int channel, int enable) {
+    // Definitions:
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
         // Debug logs:
         if (DEBUG) {
-            // Log message:
-            printf("ERROR: duty cycle %0.3f is out of bounds\n", duty_cycle);
-            printf("ERROR: set_pwm() returned %d\n", -EINVDUTY);
+            // Logs:
+            printf("ERROR: set_spi_engine_pwm() returned %d\n", ret);
         }
 
         // Exit with error:
-        return -EINVDUTY;
+        return ret;
     }
 
-    // Abort if input GPIOs do not make sense:
-    for (i = 0; i < num_gpio; i++) {
-        if ((gpio[i] < 0) || (gpio[i] > 31)) {
-            // Debug logs:
-            if (DEBUG) {
-                // Log message:
-                printf("ERROR: GPIO %d is not valid\n", gpio[i]);
-                printf("ERROR: set_pwm() returned %d\n", -EINVGPIO);
-            }
-
-            // Exit with error:
-            return -EINVGPIO;
-        }
-    }
+    // Update channel structure (applies from the next set_pwm() call):
+    dma_channels[channel].spi = enable ? 1 : 0;
 
-    // Determine sub cycle period:
-    t_sub_us = 1e6 * (1.0 / freq);
+    // Exit with success:
+    return 0;
+}
 
-    // Determine number of CBs required:
-    cb_seq_num = (t_sub_us / pulse_width_us) / 2;
+// Set sequence cache memory cap of a requested channel:
+int set_cache_pwm(int channel, size_t max_bytes) {
+    // Definitions:
+    int i;
+    int ret; // Function return value
 
-    // Determine the number of required pages for the CB seq:
-    pages_req = CEILING((cb_seq_num / getpagesize()));
+    int oldest; // Least recently used droppable slot
 
-    // Abort if number of CBs is 0 (desired frequency cannot be met):
-    if (cb_seq_num == 0) {
-        // Exit with error:
-        return -EFREQNOTMET;
-    }
+    struct seq_entry *cache; // Cache
 
-    // Abort if number of required pages for the CB sequence is greater
-    // than what's allocated:
-    if (pages_req > allocated_pages) {
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: CB sequence pages required > allocated pages\n");
-            printf("ERROR: CB sequence pages required > allocated pages\n");
+            printf("ERROR: set_cache_pwm() returned %d\n", ret);
         }
 
         // Exit with error:
-        return -ENOMEM;
+        return ret;
     }
 
-    // Determine achieved frequency:
-    freq_act = (1.0 / (cb_seq_num * pulse_width_us * 1e-6)) / 2;
+    // Update:
+    cache = dma_channels[channel].cache;
+    dma_channels[channel].cache_max = max_bytes;
+
+    // Update CB buffer states:
+    update_ring(channel);
+
+    // Drop the least recently used sequences until within the cap (the
+    // selected sequence and those the DMA may still be running stay until
+    // another one is set):
+    while (dma_channels[channel].cache_bytes > max_bytes) {
+        oldest = -1;
+
+        for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+            if (cache[i].valid && ((SEQ_CACHE_FIRST + i) != \
+                dma_channels[channel].selected_cb_buf) && \
+                (dma_channels[channel].buf_state[SEQ_CACHE_FIRST + i] == \
+                BUF_FREE) && ((oldest < 0) || \
+                (cache[i].last_use < cache[oldest].last_use))) {
+                oldest = i;
+            }
+        }
 
-    // Determine PWM resolution:
-    pwm_d_res = 100.0 * (1 - (cb_seq_num - 1) / (float)cb_seq_num);
+        if (oldest < 0) {
+            break;
+        }
 
-    // For duty cycles of 0 and 100, desired can always be achieved:
-    if ((int)duty_cycle % 100 == 0) {
-        // Set actual to desired duty cycle:
-        pwm_d_act = duty_cycle;
-    // For all other duty cycles, must round desired to what can be
-    // achieved:
-    } else {
-        // Round desired PWM to nearest multiple of its resolution:
-        pwm_d_act = ROUND(duty_cycle / pwm_d_res) * pwm_d_res;
+        drop_seq(channel, oldest);
     }
 
-    // Determine number of set and clear CBs:
-    cb_set_num = (t_sub_us / pulse_width_us) * (pwm_d_act / 100) / 2;
-    cb_clr_num = abs(cb_seq_num - cb_set_num);
-
-    // Add additional number of CBs for GPIO set and clear:
-    cb_seq_num += ((int)duty_cycle % 100 == 0) ? 1 : 2;
-
-    // Select alternate buffer to use (it's not active):
-    cb_buf = (dma_channels[channel].selected_cb_buf ? 0 : 1);
-
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("Selecting CB buffer %d for channel %d \n", \
-            cb_buf, channel);
+        printf("Channel %d sequence cache capped at %zu bytes\n", \
+            channel, max_bytes);
     }
 
-    // Set input GPIOs to output and define set and clear mask:
-    for (i = 0; i < num_gpio; i++) {
-        // Set pin to output if not already:
-        GPIO_OUT(gpio_base_virt_addr, gpio[i]);
+    // Exit with success:
+    return 0;
+}
 
-        // Append to mask:
-        set_mask |= (1 << gpio[i]);
-        clear_mask |= (1 << gpio[i]);
+// Get sequence cache statistics of a requested channel:
+int get_cache_pwm(int channel, struct cache_pwm *cache) {
+    // Definitions:
+    int i;
+    int ret; // Function return value
+
+    // Check channel:
+    if ((ret = check_channel(channel)) < 0) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: get_cache_pwm() returned %d\n", ret);
+        }
+
+        // Exit with error:
+        return ret;
     }
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("Setting GPIO masks\n");
-        printf("GPIO set mask = 0x%08X\n", clear_mask);
-        printf("GPIO clear mask = 0x%08X\n", set_mask);
+    // Copy statistics:
+    cache->hits = dma_channels[channel].cache_hits;
+    cache->misses = dma_channels[channel].cache_misses;
+    cache->bytes = dma_channels[channel].cache_bytes;
+    cache->entries = 0;
+
+    for (i = 0; i < SEQ_CACHE_SLOTS; i++) {
+        cache->entries += dma_channels[channel].cache[i].valid;
     }
 
-    // Update masks:
-    *(uint32_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = \
-        clear_mask;
-    *(uint32_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = set_mask;
+    // Exit with success:
+    return 0;
+}
 
-    // Update channel structure:
-    dma_channels[channel].t_sub_us = t_sub_us;
-    dma_channels[channel].freq_des = freq;
-    dma_channels[channel].freq_act = freq_act;
-    dma_channels[channel].pwm_d_des = duty_cycle;
-    dma_channels[channel].pwm_d_act = pwm_d_act;
-    dma_channels[channel].cb_seq_num = cb_seq_num;
-    dma_channels[channel].cb_set_num = cb_set_num;
-    dma_channels[channel].cb_clr_num = cb_clr_num;
-    dma_channels[channel].selected_cb_buf = cb_buf;
+// Set PWM FIFO DREQ and panic thresholds shared by all channels:
+int set_fifo_pwm(int dreq, int panic) {
+    // Abort if thresholds are out of bounds:
+    if ((dreq < 1) || (dreq > 255) || (panic < 1) || (panic > 255)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: FIFO thresholds %d and %d out of bounds\n", \
+                dreq, panic);
+            printf("ERROR: set_fifo_pwm() returned %d\n", -EINVBUS);
+        }
 
-    // Debug logs:
-    if (DEBUG) { 
-        printf("Setting PWM signal and CB sequence properties:\n");
-        printf("Pulse width = %0.4f us\n", pulse_width_us);
-        printf("Subcycle = %d us\n", t_sub_us);
-        printf("Actual frequency = %.7f Hz\n", freq_act);
-        printf("Duty cycle resolution = %.7f%%\n", pwm_d_res);
-        printf("Actual duty cycle = %.7f%%\n", pwm_d_act);
-        printf("CB sequence \"set\" number = %d\n", cb_set_num);
-        printf("CB sequence \"clear\" number = %d\n", cb_clr_num);
-        printf("CB sequence total number = %d\n", cb_seq_num);
+        // Exit with error:
+        return -EINVBUS;
     }
 
-    // Build control block sequence for the DMA channel:
-    build_cb_seq(channel);
-
-    // Update flags:
-    dma_channels[channel].seq_built = 1;
+    // Update:
+    dreq_thresh = dreq;
+    panic_thresh = panic;
+
+    // Apply now if already initialized (the RP1 PWM has no panic
+    // threshold):
+    if (init_state && (pi_version == 5)) {
+        // Set threshold:
+        rp1_pwm_reg->fifo_ctrl = RP1_PWM_FIFO_DREQ_EN | \
+            RP1_PWM_FIFO_THRESH(dreq_thresh);
+
+        // Delay per data sheet:
+        nanosleep(&delay, NULL);
+    } else if (init_state) {
+        // Set thresholds:
+        pwm_ctl_reg->dmac = (PWM_DMA_ENB | PWM_DREQ_THRESH(dreq_thresh) | \
+            PWM_PANIC_THRESH(panic_thresh));
+
+        // Delay per data sheet:
+        nanosleep(&delay, NULL);
+    }
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("Channel %d PWM signal set\n", channel);
+        printf("PWM FIFO DREQ threshold = %d, panic threshold = %d\n", \
+            dreq_thresh, panic_thresh);
     }
 
-    // Load CB and start DMA if channel is already enabled (update PWM signal):
-    if (dma_channels[channel].enabled) {
+    // Exit with success:
+    return 0;
+}
+
+// Set bus transfer budget of all channels:
+int set_bus_budget_pwm(float budget) {
+    // Abort if budget does not make sense:
+    if (budget < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("Updating PWM signal now on channel %d as it's enabled\n",\
-                channel);
+            printf("ERROR: bus budget %0.0f is invalid\n", budget);
+            printf("ERROR: set_bus_budget_pwm() returned %d\n", -EINVBUS);
         }
 
-        // Update PWM signal:
-        enable_pwm(channel);
+        // Exit with error:
+        return -EINVBUS;
     }
 
-    // Exit:
-    return 0;
-}
-
-// Enable PWM output for a channel:
-int enable_pwm(int channel) {
-    // Definitions
-    uint8_t cb_buf; // Which CB buffer to use
-
-    int ret; // Function return value
+    // Update:
+    bus_budget = budget;
 
     // Debug logs:
     if (DEBUG) {
-        // Log message:
-        printf("Channel %d to be enabled\n", channel);
+        // Logs:
+        printf("Bus budget = %0.0f transfers/s\n", bus_budget);
     }
 
+    // Exit with success:
+    return 0;
+}
+
+// Get bus transfers per second of a channel's CB sequence:
+float get_bus_load_pwm(int channel) {
+    // Definitions:
+    int ret; // Function return value
+
     // Check channel:
     if ((ret = check_channel(channel)) < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: enable_pwm() returned %d\n", ret);
+            printf("ERROR: get_bus_load_pwm() returned %d\n", ret);
         }
 
         // Exit with error:
         return ret;
     }
 
-    // Abort if channel does not have a CB sequence built:
-    if (!(dma_channels[channel].seq_built)) {
-        // Debug logs:
-        if (DEBUG) {
-            // Log message:
-            printf("ERROR: channel %d has no PWM signal set\n", channel);
-            printf("ERROR: enable_pwm() returned %d\n", -EPWMNOTSET);
+    // Return rate (none until a sequence is set):
+    return dma_channels[channel].seq_built ? dma_channels[channel].bus_rate : 0;
+}
+
+// Get bus transfers per second of all channels:
+float get_bus_total_pwm(void) {
+    // Definitions:
+    int i;
+
+    float total = 0; // Total bus transfers per second
+
+    // Add every requested channel with a CB sequence:
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!(dma_channels_status[i]) && dma_channels[i].seq_built) {
+            total += dma_channels[i].bus_rate;
         }
+    }
 
-        // Exit with error:
-        return -EPWMNOTSET;
+    // Return total:
+    return total;
+}
+
+// Get PWM pulse width:
+float get_pulse_width(void) {
+    // Return pulse width:
+    return pulse_width_us;
+}
+
+// Relocate an address of a signal image CB program to a channel's CB
+// buffer:
+static uint32_t relocate_image_addr(int channel, int cb_buf, uint32_t addr) {
+    // CB program:
+    if ((addr >= IMAGE_PWM_CB_ADDR) && ((addr - IMAGE_PWM_CB_ADDR) < \
+        dma_channels[channel].cb_base[cb_buf]->size)) {
+        // Exit with CB buffer address:
+        return dma_channels[channel].cb_base_bus_addr[cb_buf] + \
+            (addr - IMAGE_PWM_CB_ADDR);
+    }
+
+    // GPIO masks:
+    if (addr == IMAGE_PWM_SET_ADDR) {
+        // Exit with set mask address:
+        return dma_channels[channel].set_mask_bus_addr[cb_buf];
+    } else if (addr == IMAGE_PWM_CLEAR_ADDR) {
+        // Exit with clear mask address:
+        return dma_channels[channel].clear_mask_bus_addr[cb_buf];
+    }
+
+    // Exit with peripheral address (same on every board of a version):
+    return addr;
+}
+
+// Build the CB sequence of a channel's PWM signal for a signal image, in
+// the legacy layout at its link addresses:
+// (returns the number of CBs)
+static size_t export_seq(int channel, struct dma_cb *program) {
+    // Definitions:
+    int cb_buf;   // Which CB buffer the builders use
+    size_t ret;   // Number of CBs
+
+    struct uncached_mem image_mem; // Program memory at its link address
+    struct channel saved;          // Channel state
+
+    // Point the selected buffer at the program:
+    saved = dma_channels[channel];
+    cb_buf = dma_channels[channel].selected_cb_buf;
+
+    image_mem = *dma_channels[channel].cb_base[cb_buf];
+    image_mem.virt_addr = program;
+    image_mem.bus_addr = IMAGE_PWM_CB_ADDR;
+
+    dma_channels[channel].cb_base[cb_buf] = &image_mem;
+    dma_channels[channel].cb_base_bus_addr[cb_buf] = IMAGE_PWM_CB_ADDR;
+    dma_channels[channel].set_mask_bus_addr[cb_buf] = IMAGE_PWM_SET_ADDR;
+    dma_channels[channel].clear_mask_bus_addr[cb_buf] = IMAGE_PWM_CLEAR_ADDR;
+
+    // Build without translating:
+    export_seqs = 1;
+
+    if (dma_channels[channel].compressed) {
+        build_compressed_seq(channel);
+    } else {
+        build_cb_seq(channel);
     }
 
-    // Get which CB buffer to load:
-    cb_buf = dma_channels[channel].selected_cb_buf;
+    export_seqs = 0;
+
+    // Restore channel state:
+    ret = dma_channels[channel].cb_num[cb_buf];
+    dma_channels[channel] = saved;
+
+    // Exit with number of CBs:
+    return ret;
+}
+
+// Save PWM signals of requested channels as a signal image:
+int save_image_pwm(const char *path, int *channels, size_t num_channels) {
+    // Definitions:
+    size_t i;
+    int ret; // Function return value
+
+    int channel;   // Channel to save
+    int selected;  // Its selected CB buffer
+    size_t offset; // Offset of the next CB program
+    size_t bytes;  // Size of a CB buffer
+
+    FILE *file; // Image file
+
+    struct image_pwm_header header;   // Image header
+    struct image_pwm_channel *record; // Channel records
+    struct dma_cb **program;          // CB programs
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("Loading CB sequence from buffer %d \n", cb_buf);
+        printf("Saving %zu channels to signal image %s\n", num_channels, \
+            path);
     }
 
-    // Abort current DMA transfer:
-    dma_channels[channel].dma_reg->cs |= DMA_ABORT;
+    // Abort if a channel has no PWM signal set:
+    for (i = 0; i < num_channels; i++) {
+        // Check channel:
+        if ((ret = check_channel(channels[i])) < 0) {
+            // Debug logs:
+            if (DEBUG) {
+                // Logs:
+                printf("ERROR: save_image_pwm() returned %d\n", ret);
+            }
 
-    // Delay per data sheet:
-    nanosleep(&delay, NULL);
+            // Exit with error:
+            return ret;
+        }
 
-    // Pause DMA transfer:
-    dma_channels[channel].dma_reg->cs &= ~DMA_ACTIVE;
+        if ((dma_channels[channels[i]].mode != CHANNEL_MODE_PWM) || \
+           !(dma_channels[channels[i]].seq_built)) {
+            // Debug logs:
+            if (DEBUG) {
+                // Logs:
+                printf("ERROR: channel %d has no PWM signal set\n", \
+                    channels[i]);
+                printf("ERROR: save_image_pwm() returned %d\n", -EPWMNOTSET);
+            }
 
-    // Clear transfer complete:
-    dma_channels[channel].dma_reg->cs |= DMA_END;
+            // Exit with error:
+            return -EPWMNOTSET;
+        }
+    }
 
-    // Reset channel:
-    dma_channels[channel].dma_reg->cs |= DMA_RESET;
+    // Header:
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IMAGE_PWM_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_PWM_VERSION;
+    header.pi_version = pi_version;
+    header.pages = allocated_pages;
+    header.clock_div = clock_div;
+    header.pwm_rng = pwm_rng;
+    header.pulse_width = pulse_width_us;
+    header.cb_overhead = cb_overhead_us;
+    header.num_channels = num_channels;
+
+    // Build each CB program after the records (32 byte aligned):
+    record = calloc(num_channels + 1, sizeof(struct image_pwm_channel));
+    program = calloc(num_channels + 1, sizeof(struct dma_cb*));
+    bytes = getpagesize() * allocated_pages;
+    offset = (sizeof(header) + (num_channels * sizeof(*record)) + \
+        sizeof(struct dma_cb) - 1) & ~(sizeof(struct dma_cb) - 1);
+
+    for (i = 0; i < num_channels; i++) {
+        channel = channels[i];
+        selected = dma_channels[channel].selected_cb_buf;
+        program[i] = calloc(1, bytes);
+
+        // Program:
+        record[i].offset = offset;
+        record[i].num_cbs = export_seq(channel, program[i]);
+        offset += record[i].num_cbs * sizeof(struct dma_cb);
+
+        // Signal:
+        record[i].mask = \
+            *(uint64_t*)dma_channels[channel].set_mask[selected]->virt_addr;
+        record[i].cb_seq_num = dma_channels[channel].cb_seq_num;
+        record[i].cb_set_num = dma_channels[channel].cb_set_num;
+        record[i].cb_clr_num = dma_channels[channel].cb_clr_num;
+        record[i].t_sub_us = dma_channels[channel].t_sub_us;
+        record[i].ti = dma_channels[channel].ti;
+        record[i].gpio_len = dma_channels[channel].gpio_len;
+        record[i].compressed = dma_channels[channel].compressed;
+        record[i].prio = dma_channels[channel].prio;
+        record[i].panic_prio = dma_channels[channel].panic_prio;
+        record[i].freq = dma_channels[channel].freq_des;
+        record[i].freq_act = dma_channels[channel].freq_act;
+        record[i].duty_cycle = dma_channels[channel].pwm_d_des;
+        record[i].duty_cycle_act = dma_channels[channel].pwm_d_act;
+        record[i].bus_rate = dma_channels[channel].bus_rate;
+    }
 
-    // Delay per data sheet:
-    nanosleep(&delay, NULL);
+    // Write image:
+    ret = 0;
+    if (!(file = fopen(path, "wb"))) {
+        ret = -EIMAGEIO;
+    } else {
+        // Header and records, padded to the first program:
+        if ((fwrite(&header, sizeof(header), 1, file) != 1) || \
+           (fwrite(record, sizeof(*record), num_channels, file) != \
+           num_channels) || (fseek(file, num_channels ? \
+           record[0].offset : 0, SEEK_SET) < 0)) {
+            ret = -EIMAGEIO;
+        }
 
-    // Load first control block:
-    dma_channels[channel].dma_reg->conblk_ad = \
-        dma_channels[channel].cb_base_bus_addr[cb_buf];
+        // Programs:
+        for (i = 0; (i < num_channels) && (ret == 0); i++) {
+            if (fwrite(program[i], sizeof(struct dma_cb), \
+               record[i].num_cbs, file) != record[i].num_cbs) {
+                ret = -EIMAGEIO;
+            }
+        }
 
-    // Set transaction priority and wait for outstanding writes:
-    dma_channels[channel].dma_reg->cs = \
-        DMA_PANIC_PRIO(7) | DMA_PRIO(7) | DMA_WAIT;
+        ret = (fclose(file) != 0) ? -EIMAGEIO : ret;
+    }
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("DMA Channel %d Register: CONBLK_AD = 0x%08X\n", \
-            channel, dma_channels[channel].dma_reg->conblk_ad);
+    // Free programs:
+    for (i = 0; i < num_channels; i++) {
+        free(program[i]);
     }
 
-    // Let's go:
-    dma_channels[channel].dma_reg->cs |= DMA_ACTIVE;
+    free(program);
+    free(record);
 
     // Debug logs:
     if (DEBUG) {
         // Logs:
-        printf("DMA Channel %d Register: CS = 0x%08X\n", \
-            channel, dma_channels[channel].dma_reg->cs);
+        if (ret < 0) {
+            printf("ERROR: could not write signal image %s\n", path);
+            printf("ERROR: save_image_pwm() returned %d\n", ret);
+        } else {
+            printf("Saved signal image %s (%zu bytes)\n", path, offset);
+        }
     }
 
-    // Update/enforce channel status:
-    dma_channels[channel].enabled = 1;
+    // Exit with result:
+    return ret;
+}
 
-    // Debug logs:
-    if (DEBUG) {
-        // Logs:
-        printf("Channel %d enabled\n", channel);
+// Check a signal image and its channel records:
+// (returns the number of channels)
+static int check_image(const uint8_t *image, size_t size, \
+    size_t max_channels) {
+    // Definitions:
+    size_t i;
+
+    const struct image_pwm_header *header;   // Image header
+    const struct image_pwm_channel *record;  // Channel records
+
+    // Header:
+    header = (const struct image_pwm_header*)image;
+    record = (const struct image_pwm_channel*)(header + 1);
+
+    if ((size < sizeof(*header)) || \
+       memcmp(header->magic, IMAGE_PWM_MAGIC, sizeof(header->magic)) || \
+       (header->version != IMAGE_PWM_VERSION) || \
+       (header->num_channels > max_channels) || \
+       (header->num_channels > NUM_DMA_CHANNELS) || \
+       ((size - sizeof(*header)) < \
+       (header->num_channels * sizeof(*record)))) {
+        // Exit with error:
+        return -EINVIMAGE;
     }
 
-    // Exit:
-    return 0;
+    // Programs (aligned, within the image and at least one CB):
+    for (i = 0; i < header->num_channels; i++) {
+        if ((record[i].offset % sizeof(struct dma_cb)) || \
+           (record[i].offset > size) || (record[i].num_cbs == 0) || \
+           (record[i].num_cbs > ((size - record[i].offset) / \
+           sizeof(struct dma_cb))) || (record[i].gpio_len == 0) || \
+           (record[i].gpio_len > 8)) {
+            // Exit with error:
+            return -EINVIMAGE;
+        }
+    }
+
+    // Exit with number of channels:
+    return header->num_channels;
 }
 
-// Clear all channel GPIOs
-static int clear_channel_gpio(int channel) {
+// Start the PWM signal of a signal image channel record on a requested
+// channel:
+static int load_image_channel(int channel, const uint8_t *image, \
+    const struct image_pwm_channel *record) {
     // Definitions:
-    int i;
+    size_t i;
+    int ret; // Function return value
 
-    int bit;           // Bit state
-    uint32_t set_mask; // GPIO set mask
+    int cb_buf;      // Which CB buffer to use
+    int max_gpio;    // Highest GPIO of the board
+    uint64_t mask;   // GPIOs of the signal
 
-    uint8_t cb_buf; // Which CB buffer to use
+    struct dma_cb cb;            // Relocated control block
+    const struct dma_cb *program; // CB program
+    struct dma_cb *dma_cb_seq;   // CB buffer
 
-    // Get which CB buffer to use:
-    cb_buf = dma_channels[channel].selected_cb_buf;
+    // Abort if the program does not fit in the CB buffer:
+    if ((record->num_cbs * cb_size(channel)) > \
+        dma_channels[channel].cb_base[0]->size) {
+        // Exit with error:
+        return -ENOMEM;
+    }
 
-    // Get GPIO set mask to know which GPIOs to clear:
-    set_mask = *(uint32_t*) \
-        dma_channels[channel].set_mask[cb_buf]->virt_addr;
+    // Abort if the signal uses GPIOs this board does not have:
+    max_gpio = (pi_version == 5) ? RP1_MAX_GPIO : \
+        ((pi_version == 4) ? BCM2711_MAX_GPIO : BCM2835_MAX_GPIO);
+    mask = record->mask;
 
-    // Clear GPIOs:
-    for (i = 0; i < sizeof(uint32_t) * 8; i++) {
-        // Get bit value at the position:
-        bit = (set_mask >> i) & 0x01;
+    if ((max_gpio < 63) && (mask >> (max_gpio + 1))) {
+        // Exit with error:
+        return -EINVGPIO;
+    }
 
-        // Clear GPIO if it set:
-        if (bit) {
-            // Debug logs:
-            if (DEBUG) {
-                // Logs:
-                printf("GPIO BCM pin %d cleared\n", i);
-            }
+    // Abort if the bus budget cannot hold the signal:
+    dma_channels[channel].ti = record->ti;
+    dma_channels[channel].prio = record->prio;
+    dma_channels[channel].panic_prio = record->panic_prio;
 
-            // Clear pin:
-            GPIO_CLEAR(gpio_base_virt_addr, i);
+    if ((ret = check_bus_budget(channel, record->bus_rate)) < 0) {
+        // Exit with error:
+        return ret;
+    }
+
+    // Select a free ring buffer to use (it's not active):
+    cb_buf = next_buf(channel);
+
+    // Update masks (bank 0 in the low word is followed by bank 1):
+    *(uint64_t*)dma_channels[channel].clear_mask[cb_buf]->virt_addr = mask;
+    *(uint64_t*)dma_channels[channel].set_mask[cb_buf]->virt_addr = mask;
+
+    // Copy and relocate each control block:
+    program = (const struct dma_cb*)(image + record->offset);
+    dma_cb_seq = \
+        (struct dma_cb*)dma_channels[channel].cb_base[cb_buf]->virt_addr;
+
+    for (i = 0; i < record->num_cbs; i++) {
+        cb = program[i];
+        cb.src = relocate_image_addr(channel, cb_buf, cb.src);
+        cb.dst = relocate_image_addr(channel, cb_buf, cb.dst);
+        cb.next = cb.next ? relocate_image_addr(channel, cb_buf, cb.next) : 0;
+
+        copy_to_uncached__((volatile uint32_t*)&dma_cb_seq[i], \
+            (uint32_t*)&cb, sizeof(cb) / 4);
+    }
+
+    // Translate to the channel's DMA engine:
+    translate_seq(channel, cb_buf, record->num_cbs);
+
+    // Update channel structure:
+    dma_channels[channel].t_sub_us = record->t_sub_us;
+    dma_channels[channel].freq_des = record->freq;
+    dma_channels[channel].freq_act = record->freq_act;
+    dma_channels[channel].pwm_d_des = record->duty_cycle;
+    dma_channels[channel].pwm_d_act = record->duty_cycle_act;
+    dma_channels[channel].cb_seq_num = record->cb_seq_num;
+    dma_channels[channel].cb_set_num = record->cb_set_num;
+    dma_channels[channel].cb_clr_num = record->cb_clr_num;
+    dma_channels[channel].gpio_ti = (record->gpio_len > 4) ? \
+        (DMA_SRC_INC | DMA_DEST_INC) : 0;
+    dma_channels[channel].gpio_len = record->gpio_len;
+    dma_channels[channel].compressed = record->compressed;
+    dma_channels[channel].bus_rate = record->bus_rate;
+    dma_channels[channel].selected_cb_buf = cb_buf;
+    dma_channels[channel].seq_built = 1;
+
+    // Set GPIOs to output:
+    for (i = 0; i < 64; i++) {
+        if ((mask >> i) & 1) {
+            gpio_out(i);
         }
     }
 
-    // Exit with success:
-    return 0;
+    // Start DMA:
+    return enable_pwm(channel);
 }
 
-// Disable DMA channel
-int disable_pwm(int channel) {
+// Start the PWM signals of a signal image on newly requested channels:
+int load_image_pwm(const char *path, int *channels, size_t max_channels) {
     // Definitions:
+    int i;
     int ret; // Function return value
-    
+
+    int fd;              // Image file descriptor
+    struct stat info;    // Image file status
+    uint8_t *image;      // Mapped image
+    int num_channels;    // Channels in the image
+
+    const struct image_pwm_header *header;   // Image header
+    const struct image_pwm_channel *record;  // Channel records
+
     // Debug logs:
     if (DEBUG) {
-        // Log message:
-        printf("Channel %d to be disabled\n", channel);
+        // Logs:
+        printf("Loading signal image %s\n", path);
     }
 
-    // Check channel:
-    if ((ret = check_channel(channel)) < 0) {
+    // Map image:
+    if ((fd = open(path, O_RDONLY)) < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: disable_pwm() returned %d\n", ret);
+            printf("ERROR: could not open signal image %s\n", path);
+            printf("ERROR: load_image_pwm() returned %d\n", -EIMAGEIO);
         }
 
         // Exit with error:
-        return ret;
+        return -EIMAGEIO;
     }
 
-    // Abort current DMA transfer:
-    dma_channels[channel].dma_reg->cs |= DMA_ABORT;
+    image = MAP_FAILED;
+    if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+        image = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
 
-    // Delay per data sheet:
-    nanosleep(&delay, NULL);
+    close(fd);
 
-    // Pause DMA transfer:
-    dma_channels[channel].dma_reg->cs &= ~DMA_ACTIVE;
+    if (image == MAP_FAILED) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: could not map signal image %s\n", path);
+            printf("ERROR: load_image_pwm() returned %d\n", -EIMAGEIO);
+        }
 
-    // Reset channel:
-    dma_channels[channel].dma_reg->cs |= DMA_RESET;
+        // Exit with error:
+        return -EIMAGEIO;
+    }
 
-    // Clear GPIOs:
-    clear_channel_gpio(channel);
+    header = (const struct image_pwm_header*)image;
+    record = (const struct image_pwm_channel*)(header + 1);
+
+    // Check image, initialize and check it was compiled for this board:
+    if ((ret = num_channels = \
+        check_image(image, info.st_size, max_channels)) < 0) {
+        // Exit below:
+    } else if ((ret = init_once()) < 0) {
+        // Exit below:
+    } else if ((int)header->pi_version != pi_version) {
+        ret = -EINVIMAGE;
+    // Configure memory and pulse width as compiled (only possible before
+    // any channel is requested):
+    } else if (((int)header->pages != allocated_pages) || \
+        (header->pulse_width != pulse_width_us)) {
+        if (((ret = config_pwm(header->pages, header->pulse_width)) == 0) && \
+           (((header->pulse_width - pulse_width_us) > 1e-3) || \
+           ((pulse_width_us - header->pulse_width) > 1e-3))) {
+            ret = -EINVIMAGE;
+        }
+    }
 
-    // Update channel structure:
-    dma_channels[channel].enabled = 0;
+    // Use the CB overhead the signals were planned with instead of
+    // measuring it:
+    if ((ret >= 0) && (init_state == 1)) {
+        cb_overhead_us = header->cb_overhead;
+        init_state = 2;
+    }
+
+    // Request a channel for each signal and start it:
+    for (i = 0; (ret >= 0) && (i < num_channels); i++) {
+        if ((ret = channels[i] = request_pwm()) >= 0) {
+            if ((ret = load_image_channel(channels[i], image, \
+                &record[i])) < 0) {
+                free_pwm(channels[i]);
+            }
+        }
+    }
+
+    // Free channels started before an error:
+    if (ret < 0) {
+        for (i--; i > 0; i--) {
+            free_pwm(channels[i - 1]);
+        }
+    }
+
+    // Unmap image:
+    munmap(image, info.st_size);
 
     // Debug logs:
     if (DEBUG) {
-        // Log message:
-        printf("Channel %d disabled\n", channel);
+        // Logs:
+        if (ret < 0) {
+            printf("ERROR: load_image_pwm() returned %d\n", ret);
+        } else {
+            printf("Started %d channels from signal image %s\n", \
+                num_channels, path);
+        }
     }
 
-    // Exit with success:
-    return 0;
-
+    // Exit with number of channels or error:
+    return (ret < 0) ? ret : num_channels;
 }
 
-// Clean-up
-// - Halt DMA controller
-// - Free allocated memory
-int free_pwm(int channel) {
+// Set the event timer to expire once in 0.5 to 1.5 intervals:
+// (checks at varying times see the control blocks of signals with a period
+// dividing the interval at varying phases)
+static void arm_events() {
     // Definitions:
-    int i;
+    float next_us; // Time until the next check
 
-    int ret; // Function return value
+    struct itimerspec timer; // Next check
 
-    // Debug logs:
-    if (DEBUG) {
-        // Log message:
-        printf("Channel %d to be freed\n", channel);
-    }
+    // Get time:
+    next_us = event_interval_us * \
+        (0.5 + (rand_r(&event_seed) % 1000) / 1000.0);
 
-    // Check channel:
-    if ((ret = check_channel(channel)) < 0) {
+    // Set timer:
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_nsec = 0;
+    timer.it_value.tv_sec = next_us / 1e6;
+    timer.it_value.tv_nsec = (next_us - timer.it_value.tv_sec * 1e6) * 1e3;
+    timerfd_settime(event_fd, 0, &timer, NULL);
+}
+
+// Open a timer fd polled for channel events:
+int open_events_pwm(float interval_us, float stall_us) {
+    // Abort if interval or stall time does not make sense:
+    if ((interval_us < 1) || (stall_us <= 0)) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: free_pwm() returned %d\n", ret);
+            printf("ERROR: %0.1f us event interval or %0.1f us stall time "
+                "is nonsensical\n", interval_us, stall_us);
+            printf("ERROR: open_events_pwm() returned %d\n", -EINVEVENT);
         }
 
         // Exit with error:
-        return ret;
+        return -EINVEVENT;
     }
 
-    // Disable DMA channel (if not already disabled):
-    disable_pwm(channel);
-
-    // Free both buffers:
-    for (i = 0; i < 2; i++) {
-        // Free allocated uncached memory:
-        uncached_free__(dma_channels[channel].cb_base[i]);
-        uncached_free__(dma_channels[channel].set_mask[i]);
-        uncached_free__(dma_channels[channel].clear_mask[i]);
+    // Create timer (kept if already open):
+    if ((event_fd < 0) && ((event_fd = timerfd_create(CLOCK_MONOTONIC, \
+        TFD_NONBLOCK | TFD_CLOEXEC)) < 0)) {
+        // Debug logs:
+        if (DEBUG) {
+            // Logs:
+            printf("ERROR: open_events_pwm() returned %d\n", -EEVENTFD);
+        }
 
-        // Free allocated memory:
-        free(dma_channels[channel].cb_base[i]);
-        free(dma_channels[channel].set_mask[i]);
-        free(dma_channels[channel].clear_mask[i]);
+        // Exit with error:
+        return -EEVENTFD;
     }
 
-    // Set flags:
-    dma_channels[channel].enabled = 0;
-    dma_channels[channel].seq_built = 0;
-
-    // Update channel status:
-    dma_channels_status[channel] = 1;
+    // Start timer:
+    event_interval_us = interval_us;
+    event_stall_us = stall_us;
+    arm_events();
 
     // Debug logs:
     if (DEBUG) {
-        // Log message:
-        printf("Channel %d freed\n", channel);
+        // Logs:
+        printf("Checking channel events every %0.1f us on fd %d\n", \
+            interval_us, event_fd);
     }
 
-    // Return success:
-    return 0;
+    // Exit with fd:
+    return event_fd;
 }
 
-// Get channel PWM signal duty cycle:
-float get_duty_cycle_pwm(int channel) {
+// Queue a channel event (dropping the oldest one if full):
+static void queue_event(int channel, int type) {
     // Definitions:
-    int ret; // Function return value
+    struct event_pwm *event; // Queued event
 
-    // Check channel:
-    if ((ret = check_channel(channel)) < 0) {
-        // Debug logs:
-        if (DEBUG) {
-            // Logs:
-            printf("ERROR: get_duty_cycle_pwm() returned %d\n", ret);
+    // Drop oldest event:
+    if (event_num == EVENT_QUEUE_LEN) {
+        event_first = (event_first + 1) % EVENT_QUEUE_LEN;
+        event_num--;
+    }
+
+    // Queue:
+    event = &event_queue[(event_first + event_num) % EVENT_QUEUE_LEN];
+    event->channel = channel;
+    event->type = type;
+    event_num++;
+}
+
+// Queue the events of a requested channel since the last check:
+static void check_events(int channel, struct timespec *now) {
+    // Definitions:
+    long block;  // Capture sample block being written (-1 if not known)
+    uint32_t cb; // Control block register
+
+    // Nothing to report without DMA:
+    if (!(dma_channels[channel].enabled) || \
+        (dma_channels[channel].mode == CHANNEL_MODE_CLOCK) || \
+        (dma_channels[channel].mode == CHANNEL_MODE_PWM2)) {
+        // Exit:
+        return;
+    }
+
+    // Queued sequence reached:
+    if (dma_channels[channel].update_pending) {
+        update_ring(channel);
+        if (dma_channels[channel].buf_state[ \
+            dma_channels[channel].selected_cb_buf] == BUF_LIVE) {
+            dma_channels[channel].update_pending = 0;
+            queue_event(channel, EVENT_UPDATE);
         }
+    }
 
-        // Exit with error:
-        return ret;
+    // CB chain ran to its end (e.g. a ranging round):
+    if (dma_done(channel)) {
+        // Report once:
+        if (!(dma_channels[channel].ended)) {
+            dma_channels[channel].ended = 1;
+            queue_event(channel, EVENT_BURST);
+        }
+
+        // Exit:
+        return;
     }
 
-    // Return duty cycle:
-    return dma_channels[channel].pwm_d_act;
+    // Control block not moving on, or moving on again:
+    cb = cb_reg(channel);
+    if (cb != dma_channels[channel].ev_cb) {
+        // Moved on:
+        dma_channels[channel].ev_cb = cb;
+        dma_channels[channel].ev_moved = *now;
+        if (dma_channels[channel].stalled) {
+            dma_channels[channel].stalled = 0;
+            queue_event(channel, EVENT_RECOVER);
+        }
+    } else if (!(dma_channels[channel].stalled) && \
+        (span_us(&dma_channels[channel].ev_moved, now) > event_stall_us)) {
+        // Stalled:
+        dma_channels[channel].stalled = 1;
+        queue_event(channel, EVENT_STALL);
+    }
+
+    // Capture sample block completed:
+    if ((dma_channels[channel].mode == CHANNEL_MODE_CAPTURE) && \
+        ((block = capture_block(channel)) >= 0) && \
+        ((size_t)block != dma_channels[channel].ev_block)) {
+        dma_channels[channel].ev_block = block;
+        queue_event(channel, EVENT_CAPTURE);
+    }
+
+    // Capture samples lost (DMA could have lapped the ring since the last
+    // decode):
+    if (dma_channels[channel].mode == CHANNEL_MODE_CAPTURE) {
+        // Report once until decoded again:
+        if (span_us(&dma_channels[channel].cap_last, now) > \
+            ((dma_channels[channel].cap_blocks - 1) * \
+            CAPTURE_BLOCK_SAMPLES * sample_tick_us())) {
+            if (!(dma_channels[channel].cap_lost)) {
+                dma_channels[channel].cap_lost = 1;
+                queue_event(channel, EVENT_UNDERRUN);
+            }
+        } else {
+            dma_channels[channel].cap_lost = 0;
+        }
+    }
+
+    // Serializer FIFO ran dry (PWM controller gap, cleared by writing it):
+    if ((dma_channels[channel].mode == CHANNEL_MODE_SERIAL) && \
+        (pi_version != 5) && (pwm_ctl_reg->sta & PWM_GAPO1)) {
+        pwm_ctl_reg->sta = PWM_GAPO1;
+        queue_event(channel, EVENT_UNDERRUN);
+    }
 }
 
-// Get channel PWM signal duty cycle frequency:
-float get_freq_pwm(int channel) {
+// Read channel events once the event fd is readable:
+int read_events_pwm(struct event_pwm *events, size_t max_events) {
     // Definitions:
-    int ret; // Function return value
+    int i;
 
-    // Check channel:
-    if ((ret = check_channel(channel)) < 0) {
+    uint64_t expirations; // Timer expirations since the last check
+    size_t num;           // Number of events read
+
+    struct timespec now; // Time of the check
+
+    // Abort if not open:
+    if (event_fd < 0) {
         // Debug logs:
         if (DEBUG) {
             // Logs:
-            printf("ERROR: get_freq_pwm() returned %d\n", ret);
+            printf("ERROR: read_events_pwm() returned %d\n", -EEVENTFD);
         }
 
         // Exit with error:
-        return ret;
+        return -EEVENTFD;
     }
 
-    // Return frequency:
-    return dma_channels[channel].freq_act;
+    // Acknowledge timer (not yet expired if called early) and set the next
+    // check:
+    if (read(event_fd, &expirations, sizeof(expirations)) > 0) {
+        arm_events();
+    }
+
+    // Check requested channels:
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!(dma_channels_status[i])) {
+            check_events(i, &now);
+        }
+    }
+
+    // Copy queued events:
+    for (num = 0; (num < max_events) && event_num; num++) {
+        events[num] = event_queue[event_first];
+        event_first = (event_first + 1) % EVENT_QUEUE_LEN;
+        event_num--;
+    }
+
+    // Exit with number of events:
+    return num;
 }
 
-// Get PWM pulse width:
-float get_pulse_width(void) {
-    // Return pulse width:
-    return pulse_width_us;
+// Close the event fd:
+int close_events_pwm(void) {
+    // Close timer:
+    if (event_fd >= 0) {
+        close(event_fd);
+        event_fd = -1;
+    }
+
+    // Drop queued events:
+    event_first = 0;
+    event_num = 0;
+
+    // Exit with success:
+    return 0;
 }
 
 // Get register status for debugging:
 struct reg_pwm get_reg_pwm(int channel) {
+    // RP1 PWM0 and DMA channel registers:
+    if (pi_version == 5) {
+        struct reg_pwm reg = {
+            .pwm_ctl_ctl = rp1_pwm_reg->global_ctrl,
+            .pwm_ctl_sta = rp1_pwm_reg->chan0_ctrl,
+            .pwm_ctl_dmac = rp1_pwm_reg->fifo_ctrl,
+            .pwm_clk_pwmctl = 0,
+            .pwm_clk_pwmdiv = rp1_pwm_reg->chan0_range,
+            .dma_cs = dma_ctl_base_virt_addr[RP1_DMAC_CHEN],
+            .dma_debug = dma_channels[channel].rp1_reg->status[0]
+        };
+        return reg;
+    }
+
     struct reg_pwm reg = {
         .pwm_ctl_ctl = pwm_ctl_reg->ctl,
         .pwm_ctl_sta = pwm_ctl_reg->sta,
@@ -1391,7 +8611,9 @@ struct reg_pwm get_reg_pwm(int channel) {
         .pwm_clk_pwmctl = pwm_clk_reg->pwmctl,
         .pwm_clk_pwmdiv = pwm_clk_reg->pwmdiv,
         .dma_cs = dma_channels[channel].dma_reg->cs,
-        .dma_debug = dma_channels[channel].dma_reg->debug
+        .dma_debug = (dma_channels[channel].engine == DMA_ENGINE_DMA4) ? \
+            dma_channels[channel].dma4_reg->debug : \
+            dma_channels[channel].dma_reg->debug
     };
     return reg;
 }
\ No newline at end of file
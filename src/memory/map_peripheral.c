@@ -29,6 +29,9 @@
 //  - Chris Hager's RPIO
 //  - Richard Hirst's ServoBlaster
 
+// RP1 peripherals are above 4 GB:
+#define _FILE_OFFSET_BITS 64
+
 // Include C standard libraries:
 #include <stdio.h>  // C Standard I/O libary
 #include <stdlib.h> // C Standard library
@@ -39,12 +42,20 @@
 #include <sys/mman.h> // Memory management library
 #include <unistd.h>   // Symbolic constants and types library
 
+// Include header files:
+#include "sim.h" // Simulated backend
+
 // Map peripheral physical address to virtual address
-volatile uint32_t* map_peripheral__(uint32_t base_addr) {
+volatile uint32_t* map_peripheral__(uint64_t base_addr) {
     // Definitions:
     int fd;          // File descriptor
     void *virt_addr; // Pointer to virtual address
 
+// Simulated backend maps host memory:
+#ifdef DMA_PWM_SIM
+    return sim_map_peripheral__(base_addr);
+#endif
+
     // Open /dev/mem for reading and writing
     fd = open("/dev/mem", O_RDWR | O_SYNC);
 
@@ -65,7 +76,7 @@ volatile uint32_t* map_peripheral__(uint32_t base_addr) {
         PROT_READ | PROT_WRITE, // Enable reading & writting to mapped memory
         MAP_SHARED,             // Shared with other processes
         fd,                     // File to map
-        base_addr               // Offset to peripheral
+        (off_t)base_addr        // Offset to peripheral
    );
 
     // Close /dev/mem:
@@ -30,4 +30,4 @@
 //  - Richard Hirst's ServoBlaster
 
 // Map peripheral physical address to virtual address
-volatile uint32_t* map_peripheral__(uint32_t base_addr);
\ No newline at end of file
+volatile uint32_t* map_peripheral__(uint64_t base_addr);
\ No newline at end of file
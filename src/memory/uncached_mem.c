@@ -37,10 +37,15 @@
 
 // Include C POSIX libraries:
 #include <unistd.h>   // Symbolic constants and types library
+#include <fcntl.h>    // File control library
+#include <signal.h>   // Signals (process existence)
+#include <errno.h>    // Error conditions
+#include <sys/file.h> // File locking library
 
 // Include header files:
 #include "mailbox.h"      // VideoCore mailbox interface from BroadCom
 #include "uncached_mem.h" // Allocate aligned memory and mapping functions
+#include "sim.h"          // Simulated backend
 
 // Mailbox flag definitions:
 #define MEM_FLAG_DISCARDABLE     (1 << 0)  // Can be resized to 0 at any time. Use for cached data
@@ -56,11 +61,158 @@
 // RAM bus to physical address:
 #define BCM_RAM_BUS_TO_PHYS(addr) (addr & ~0xC0000000)
 
+// Journal of allocations (VideoCore memory outlives the process that
+// allocated it, so blocks of a crashed process are released by the next):
+#define MEM_JOURNAL "/run/dma_pwm_journal"
+
+// Journal record of an allocation (free if pid is 0):
+struct mem_record {
+    int32_t pid;         // Allocating process
+    uint32_t handle;     // Mailbox handle
+    uint32_t bus_addr;   // Allocated memory bus address
+    uint32_t size;       // Memory allocation size
+    int32_t dma_channel; // DMA channel reading it (-1 if none)
+};
+
+// Journaled DMA channels as a bit mask (none if out of range):
+#define DMA_CHANNEL_BIT(c) \
+    ((((c) >= 0) && ((c) < 64)) ? ((uint64_t)1 << (c)) : 0)
+
+// Open and lock the allocation journal:
+// (-1 if it cannot be used, in which case allocations are not recorded)
+static int journal_open() {
+    // Definitions:
+    int fd; // File descriptor
+
+    // Open journal:
+    if ((fd = open(MEM_JOURNAL, O_RDWR | O_CREAT, 0600)) < 0) {
+        // Exit with error:
+        return -1;
+    }
+
+    // Lock against other processes:
+    if (flock(fd, LOCK_EX) < 0) {
+        close(fd);
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Exit with file descriptor:
+    return fd;
+}
+
+// Check whether the process of a journal record has exited:
+static int journal_exited(struct mem_record *record) {
+    // Exit with state (free slots and this process are not exited):
+    return (record->pid != 0) && (record->pid != getpid()) && \
+        (kill(record->pid, 0) < 0) && (errno == ESRCH);
+}
+
+// Record an allocation in the first free journal slot:
+static void journal_add(struct uncached_mem *block) {
+    // Definitions:
+    int fd;    // File descriptor
+    long slot; // Journal slot
+
+    struct mem_record record; // Journal record
+
+    block->journal_slot = -1;
+
+    // Open journal:
+    if ((fd = journal_open()) < 0) {
+        // Exit:
+        return;
+    }
+
+    // Find a free slot (or the end of the journal):
+    for (slot = 0; pread(fd, &record, sizeof(record), \
+        slot * sizeof(record)) == sizeof(record); slot++) {
+        if (record.pid == 0) {
+            break;
+        }
+    }
+
+    // Write record:
+    record.pid = getpid();
+    record.handle = block->mb_handle;
+    record.bus_addr = block->bus_addr;
+    record.size = block->size;
+    record.dma_channel = block->dma_channel;
+    if (pwrite(fd, &record, sizeof(record), slot * sizeof(record)) == \
+        sizeof(record)) {
+        block->journal_slot = slot;
+    }
+
+    // Close journal (unlocks):
+    close(fd);
+}
+
+// Remove an allocation from the journal:
+static void journal_remove(struct uncached_mem *block) {
+    // Definitions:
+    int fd; // File descriptor
+
+    struct mem_record record = {0}; // Free record
+
+    // Not recorded:
+    if (block->journal_slot < 0) {
+        // Exit:
+        return;
+    }
+
+    // Free slot:
+    if ((fd = journal_open()) >= 0) {
+        pwrite(fd, &record, sizeof(record), \
+            block->journal_slot * sizeof(record));
+        close(fd);
+    }
+
+    block->journal_slot = -1;
+}
+
+// Record the DMA channel reading uncached memory:
+void uncached_set_channel__(struct uncached_mem *block, int dma_channel) {
+    // Definitions:
+    int fd; // File descriptor
+
+    struct mem_record record; // Journal record
+
+    block->dma_channel = dma_channel;
+
+// Simulated memory is not journaled:
+#ifdef DMA_PWM_SIM
+    return;
+#endif
+
+    // Not recorded:
+    if (block->journal_slot < 0) {
+        // Exit:
+        return;
+    }
+
+    // Update record:
+    if ((fd = journal_open()) >= 0) {
+        if (pread(fd, &record, sizeof(record), block->journal_slot * \
+            sizeof(record)) == sizeof(record)) {
+            record.dma_channel = dma_channel;
+            pwrite(fd, &record, sizeof(record), \
+                block->journal_slot * sizeof(record));
+        }
+        close(fd);
+    }
+}
+
 // Allocate uncached memory:
 struct uncached_mem *uncached_malloc__(struct uncached_mem *block) {
     // Definitions:
     int fd; // File descriptor
 
+// Simulated backend allocates host memory:
+#ifdef DMA_PWM_SIM
+    return sim_uncached_malloc__(block);
+#endif
+
     // Open mailbox
     fd = mbox_open();
 
@@ -79,6 +231,9 @@ struct uncached_mem *uncached_malloc__(struct uncached_mem *block) {
     // Close mailbox
     mbox_close(fd);
 
+    // Record allocation until freed:
+    journal_add(block);
+
     // Return map
     return block;
 }
@@ -88,9 +243,17 @@ int uncached_free__(struct uncached_mem *block) {
     // Definitions:
     int fd; // File descriptor
 
+// Simulated backend frees host memory:
+#ifdef DMA_PWM_SIM
+    return sim_uncached_free__(block);
+#endif
+
      // Open mailbox
     fd = mbox_open();
 
+    // Forget allocation:
+    journal_remove(block);
+
     // Unmap memory
     unmapmem(block->virt_addr, block->size);
 
@@ -107,6 +270,91 @@ int uncached_free__(struct uncached_mem *block) {
     return 0;
 }
 
+// Release uncached memory left allocated by processes that have exited,
+// calling stop before with each DMA channel reading it (returns number of
+// blocks released):
+// (their DMA may still be reading it if they were killed without
+// stopping it; a DMA channel also recorded by a running process was set up
+// again by it and is left running)
+int uncached_reclaim__(void (*stop)(int dma_channel)) {
+    // Definitions:
+    int fd;       // Journal file descriptor
+    int mb_fd;    // Mailbox file descriptor
+    long slot;    // Journal slot
+    int released; // Blocks released
+
+    uint64_t live;    // DMA channels of running processes
+    uint64_t stopped; // DMA channels stopped or left running
+
+    struct mem_record record;            // Journal record
+    struct mem_record free_record = {0}; // Free record
+
+// Simulated memory is released with the process:
+#ifdef DMA_PWM_SIM
+    return 0;
+#endif
+
+    // Open journal:
+    if ((fd = journal_open()) < 0) {
+        // Exit with nothing released:
+        return 0;
+    }
+
+    mb_fd = -1;
+    live = 0;
+    released = 0;
+
+    // Find DMA channels of running processes:
+    for (slot = 0; pread(fd, &record, sizeof(record), \
+        slot * sizeof(record)) == sizeof(record); slot++) {
+        if ((record.pid != 0) && !(journal_exited(&record))) {
+            live |= DMA_CHANNEL_BIT(record.dma_channel);
+        }
+    }
+
+    stopped = live;
+
+    // Release blocks of each exited process:
+    for (slot = 0; pread(fd, &record, sizeof(record), \
+        slot * sizeof(record)) == sizeof(record); slot++) {
+        // Skip free slots and running processes:
+        if (!(journal_exited(&record))) {
+            // Next slot:
+            continue;
+        }
+
+        // Stop the DMA channel that may still be reading it (once):
+        if (DMA_CHANNEL_BIT(record.dma_channel) & ~stopped) {
+            stop(record.dma_channel);
+            stopped |= DMA_CHANNEL_BIT(record.dma_channel);
+        }
+
+        // Open mailbox (once):
+        if ((mb_fd < 0) && ((mb_fd = mbox_open()) < 0)) {
+            // Exit loop:
+            break;
+        }
+
+        // Unlock and free memory:
+        mem_unlock(mb_fd, record.handle);
+        mem_free(mb_fd, record.handle);
+
+        // Free slot:
+        pwrite(fd, &free_record, sizeof(free_record), \
+            slot * sizeof(record));
+        released++;
+    }
+
+    // Close mailbox and journal:
+    if (mb_fd >= 0) {
+        mbox_close(mb_fd);
+    }
+    close(fd);
+
+    // Exit with number released:
+    return released;
+}
+
 // Translate virtual to physical address of uncached memory
 uint32_t uncached_virt_to_bus_addr__(struct uncached_mem *block, void *ptr) {
     // Definitions:
@@ -36,6 +36,8 @@ struct uncached_mem {
     uint32_t mb_handle; // Mailbox handle
     uint32_t bus_addr;  // Allocated memory bus address
     void *virt_addr;     // Pointer to memory virtual address
+    long journal_slot;   // Record in the allocation journal (-1 if none)
+    int dma_channel;     // DMA channel reading it (0 to 63, -1 if none)
 };
 
 // Allocate uncached memory
@@ -44,5 +46,13 @@ struct uncached_mem *uncached_malloc__(struct uncached_mem *block);
 // Free allocated uncached memory
 int uncached_free__(struct uncached_mem *block);
 
+// Record the DMA channel reading uncached memory
+void uncached_set_channel__(struct uncached_mem *block, int dma_channel);
+
+// Release uncached memory left allocated by processes that have exited,
+// calling stop before with each DMA channel reading it (returns number of
+// blocks released)
+int uncached_reclaim__(void (*stop)(int dma_channel));
+
 // Translate virtual to physical address of uncached memory
 uint32_t uncached_virt_to_bus_addr__(struct uncached_mem *block, void *ptr);
\ No newline at end of file
@@ -0,0 +1,1373 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Check if simulated backend is enabled:
+#ifdef DMA_PWM_SIM
+
+// Include C standard libraries:
+#include <stdio.h>  // C Standard I/O libary
+#include <stdlib.h> // C Standard library
+#include <stdint.h> // C Standard integer types
+#include <string.h> // C Standard string manipulation libary
+#include <time.h>   // C Standard get and manipulate time library
+
+// Include C POSIX libraries:
+#include <pthread.h> // POSIX threads
+#include <unistd.h>  // Symbolic constants and types library
+
+// Include header files:
+#include "uncached_mem.h" // Allocate uncached memory and mapping functions
+#include "sim.h"          // Simulated backend
+
+// Peripheral addresses:
+#define SIM_PERI_BUS_ADDR 0x7E000000 // Peripheral bus base address
+#define SIM_PERI_MASK     0x00FFFFFF // Peripheral offset of an address
+#define SIM_PAGE_MASK     0x00FFF000 // Peripheral page of an address
+
+#define SIM_GPIO 0x200000 // GPIO offset
+#define SIM_DMA  0x007000 // DMA controller offset
+#define SIM_PWM  0x20C000 // PWM controller offset
+#define SIM_CM   0x101000 // Clock manager offset
+#define SIM_SPI  0x204000 // SPI0 offset
+#define SIM_ST   0x003000 // System timer offset
+
+// Register offsets in words:
+#define SIM_GPSET0 (0x1C / 4) // GPIO set
+#define SIM_GPSET1 (0x20 / 4) // GPIO set (bank 1)
+#define SIM_GPCLR0 (0x28 / 4) // GPIO clear
+#define SIM_GPCLR1 (0x2C / 4) // GPIO clear (bank 1)
+#define SIM_GPLEV0 (0x34 / 4) // GPIO level
+#define SIM_GPLEV1 (0x38 / 4) // GPIO level (bank 1)
+
+#define SIM_PWM_CTL   0         // PWM control
+#define SIM_PWM_RNG1  (0x10 / 4) // PWM channel 1 range
+#define SIM_PWM_DMAC  (0x08 / 4) // PWM DMA configuration
+#define SIM_PWM_FIF1  (0x18 / 4) // PWM FIFO input
+#define SIM_PWM_RNG2  (0x20 / 4) // PWM channel 2 range
+#define SIM_PWM_DAT2  (0x24 / 4) // PWM channel 2 data
+#define SIM_CM_PWMDIV (0xA4 / 4) // PWM clock divisor
+#define SIM_SPI_CS    0         // SPI control & status
+#define SIM_SPI_FIFO  (0x04 / 4) // SPI TX and RX FIFOs
+#define SIM_SPI_CLK   (0x08 / 4) // SPI clock divisor
+#define SIM_ST_CLO    (0x04 / 4) // System timer counter lower 32 bits
+
+#define SIM_DMA_CS        0 // DMA control & status
+#define SIM_DMA_CONBLK_AD 1 // DMA control block address (bits 39:5 on DMA4)
+#define SIM_DMA4_DEBUG    3 // DMA4 debug
+
+// PWM control:
+#define SIM_PWM_MODE1 (1 << 1) // Channel 1 serializer mode
+#define SIM_PWM_EN2   (1 << 8) // Channel 2 enabled
+
+// GPIOs with a PWM channel 2 output and their function select:
+#define SIM_PWM2_GPIO_A 13 // ALT0
+#define SIM_PWM2_FSEL_A 4
+#define SIM_PWM2_GPIO_B 19 // ALT5
+#define SIM_PWM2_FSEL_B 2
+
+// GPIOs with a PWM channel 1 output and their function select:
+#define SIM_PWM1_GPIO_A 12 // ALT0
+#define SIM_PWM1_FSEL_A 4
+#define SIM_PWM1_GPIO_B 18 // ALT5
+#define SIM_PWM1_FSEL_B 2
+
+// SPI control & status:
+#define SIM_SPI_TA (1 << 7) // Transfer active
+
+// GPIO with the SPI0 MOSI output and its function select:
+#define SIM_SPI_GPIO 10 // ALT0
+#define SIM_SPI_FSEL 4
+
+// DMA control & status:
+#define SIM_DMA_ACTIVE (1 << 0)  // Active
+#define SIM_DMA_END    (1 << 1)  // Transfer complete
+#define SIM_DMA_ABORT  (1 << 30) // Abort current CB
+#define SIM_DMA_RESET  (1u << 31) // Reset
+#define SIM_DMA4_RESET (1 << 23)  // Reset (DMA4 debug register)
+
+// DMA transfer information:
+#define SIM_TI_DEST_INC   (1 << 4)  // Increment destination address
+#define SIM_TI_DEST_DREQ  (1 << 6)  // Pace writes with DREQ
+#define SIM_TI_SRC_INC    (1 << 8)  // Increment source address
+#define SIM_TI_PERMAP(ti) (((ti) >> 16) & 0x1F) // Peripheral DREQ
+
+// DMA4 transfer and address information:
+#define SIM_TI4_D_DREQ     (1 << 15)             // Pace writes with DREQ
+#define SIM_TI4_PERMAP(ti) (((ti) >> 9) & 0x1F)  // Peripheral DREQ
+#define SIM_I4_INC         (1 << 12)             // Increment address
+#define SIM_I4_HIGH(i)     ((i) & 0xFF)          // Address bits 39:32
+#define SIM_DMA4_PERI_HIGH 0x04                  // Peripheral bits 39:32
+
+#define SIM_PERMAP_PWM    5 // PWM DREQ
+#define SIM_PERMAP_SPI_TX 6 // SPI TX DREQ
+
+// RP1 (Pi 5) peripheral offsets:
+#define SIM_RP1_DMA     0x188000 // DMA controller
+#define SIM_RP1_PWM0    0x098000 // PWM0
+#define SIM_RP1_RIO     0x0E0000 // Registered IO of bank 0
+#define SIM_RP1_RIO_SET 0x0E2000 // Registered IO set alias
+#define SIM_RP1_RIO_CLR 0x0E3000 // Registered IO clear alias
+#define SIM_RP1_BUS     0x40000000 // Peripherals as seen by the RP1 DMA
+#define SIM_RP1_RAM_HIGH 0x10      // Host SDRAM bits 63:32 from the RP1
+
+// RP1 register offsets in words:
+#define SIM_RIO_OUT       0            // RIO output
+#define SIM_RIO_SYNC_IN   2            // RIO synchronized input
+#define SIM_RP1_PWM_FIFO_CTRL (0x04 / 4) // PWM0 FIFO control
+#define SIM_RP1_PWM_DUTY_FIFO (0x10 / 4) // PWM0 FIFO input
+#define SIM_RP1_PWM_RANGE0 (0x18 / 4)    // PWM0 channel 0 range
+#define SIM_RP1_CHEN      (0x18 / 4)     // DMA channel enable
+#define SIM_RP1_CH_CFG    (0x20 / 4)     // DMA channel configuration
+#define SIM_RP1_CH_LLP    (0x28 / 4)     // DMA channel next descriptor
+
+// RP1 DMA configuration and descriptor control:
+#define SIM_RP1_CFG_DST_PER(cfg) (((cfg) >> 11) & 0x7F) // Destination
+                                                        // handshake
+#define SIM_RP1_CFG_TT_FC(cfg)   ((cfg) & 0x7) // Transfer type
+#define SIM_RP1_SINC_FIXED (1 << 4)   // Don't increment source address
+#define SIM_RP1_DINC_FIXED (1 << 6)   // Don't increment destination
+#define SIM_RP1_LLI_LAST   (1u << 30) // Last descriptor
+#define SIM_RP1_LLI_VALID  (1u << 31) // Descriptor is valid
+#define SIM_RP1_DREQ_PWM0  24         // PWM0 handshake
+#define SIM_RP1_MEM_TO_PER 1          // Memory to peripheral transfer
+
+// Constants:
+#define SIM_NUM_DMA      15           // Number of DMA channels
+#define SIM_RP1_NUM_DMA  8            // Number of RP1 DMA channels
+#define SIM_DMA4_FIRST   11           // First DMA4 channel on a Pi 4
+#define SIM_MAX_PAGES    32           // Maximum mapped peripheral pages
+#define SIM_MAX_BLOCKS   1024         // Maximum uncached memory blocks
+#define SIM_MAX_JUMPERS  16           // Maximum jumpered GPIOs
+#define SIM_NUM_SHIFTS   2            // Recorded serializer or SPI writes
+#define SIM_RAM_BUS_ADDR 0xC0000000   // Uncached RAM bus alias
+#define SIM_CLOCK_FREQ   500          // PWM clock source in MHz (PLLD)
+#define SIM_CORE_FREQ    250          // Core clock in MHz (SPI source)
+#define SIM_BCM2711_CORE_FREQ 500     // Core clock of the BCM2711 in MHz
+#define SIM_RP1_PWM_FREQ 50           // RP1 PWM0 clock in MHz
+#define SIM_TICK_NS      200000       // Simulation thread period in ns
+#define SIM_MAX_LAG_NS   (250 * SIM_TICK_NS) // Maximum channel lag in ns
+
+// Mapped peripheral page:
+struct sim_page {
+    uint32_t offset; // Peripheral page offset
+    uint32_t *virt;  // Host memory
+};
+
+// Uncached memory block:
+struct sim_block {
+    uint32_t bus_addr; // Bus address
+    size_t size;       // Size
+    void *virt;        // Host memory
+};
+
+// Jumpered GPIOs:
+struct sim_jumper {
+    int out; // Driving GPIO
+    int in;  // Driven GPIO
+};
+
+// DMA channel execution state:
+struct sim_dma {
+    uint8_t active;   // Channel running
+    uint64_t time_ns; // Channel time
+
+    uint64_t fifo_end_ns; // End of the PWM FIFO word being output
+    uint32_t fifo_words;  // PWM FIFO words waiting behind it
+};
+
+// Words shifted out by the PWM serializer or SPI, written by a paced CB:
+struct sim_shift {
+    uint64_t start_ns; // Time of the first word
+    uint64_t word_ns;  // Duration of a word
+    uint32_t src;      // Source address of the first word
+    uint32_t num;      // Number of words
+    int src_inc;       // Increment source address
+};
+
+// Global variables:
+static struct sim_page sim_pages[SIM_MAX_PAGES];    // Mapped peripherals
+static struct sim_block sim_blocks[SIM_MAX_BLOCKS]; // Uncached memory
+static struct sim_jumper sim_jumpers[SIM_MAX_JUMPERS]; // Jumpered GPIOs
+static struct sim_dma sim_dma[SIM_NUM_DMA];         // DMA channels
+static struct sim_shift sim_serial[SIM_NUM_SHIFTS]; // Serializer writes
+static struct sim_shift sim_spi[SIM_NUM_SHIFTS];    // SPI writes
+static int sim_next_serial;                         // Next to record
+static int sim_next_spi;                            // Next to record
+
+static int sim_num_pages;   // Number of mapped peripheral pages
+static int sim_num_jumpers; // Number of jumpered GPIOs
+
+static uint32_t sim_next_phys = 0x00100000; // Next uncached memory address
+static uint32_t sim_latch[2];               // GPIO output latches
+
+static uint64_t sim_exec_ns;   // Time of the executing DMA channel
+static uint64_t sim_cb_ns;     // Unpaced CB duration
+static uint64_t sim_jitter_ns; // Unpaced CB random extra duration
+static int sim_fifo = 1;       // Model the PWM FIFO
+static unsigned int sim_seed = 1; // Jitter random seed
+static int sim_pi;                // Simulated Pi board version
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER; // Tables lock
+static pthread_mutex_t sim_exec_lock = \
+    PTHREAD_MUTEX_INITIALIZER; // Held while executing CBs
+static pthread_once_t sim_once = PTHREAD_ONCE_INIT;         // Thread start
+
+// Get monotonic time in ns:
+static uint64_t sim_now_ns() {
+    // Definitions:
+    struct timespec now; // Current time
+
+    // Get time:
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Exit with time:
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// Find mapped peripheral page (allocated if mapped = 1):
+static uint32_t *sim_page(uint32_t offset, int map) {
+    // Definitions:
+    int i;
+
+    uint32_t *virt = NULL; // Host memory
+
+    // Page of offset:
+    offset &= SIM_PAGE_MASK;
+
+    // Lock tables:
+    pthread_mutex_lock(&sim_lock);
+
+    // Find page:
+    for (i = 0; i < sim_num_pages; i++) {
+        // Check match:
+        if (sim_pages[i].offset == offset) {
+            // Set:
+            virt = sim_pages[i].virt;
+
+            // Exit loop:
+            break;
+        }
+    }
+
+    // Map new page if not found:
+    if ((virt == NULL) && map && (sim_num_pages < SIM_MAX_PAGES)) {
+        // Allocate zeroed page:
+        virt = calloc(1, getpagesize());
+
+        // Append:
+        if (virt != NULL) {
+            sim_pages[sim_num_pages].offset = offset;
+            sim_pages[sim_num_pages].virt = virt;
+            sim_num_pages++;
+        }
+    }
+
+    // Unlock tables:
+    pthread_mutex_unlock(&sim_lock);
+
+    // Exit with host memory:
+    return virt;
+}
+
+// Translate bus address to host memory:
+static uint32_t *sim_translate(uint32_t bus_addr) {
+    // Definitions:
+    int i;
+
+    uint32_t *page;        // Peripheral page
+    uint32_t *virt = NULL; // Host memory
+
+    // Peripheral:
+    if ((bus_addr & ~SIM_PERI_MASK) == SIM_PERI_BUS_ADDR) {
+        // Find page:
+        page = sim_page(bus_addr, 0);
+
+        // Exit with register:
+        return (page == NULL) ? NULL : page + ((bus_addr & 0xFFF) / 4);
+    }
+
+    // Lock tables:
+    pthread_mutex_lock(&sim_lock);
+
+    // Find uncached memory block:
+    for (i = 0; i < SIM_MAX_BLOCKS; i++) {
+        // Check if address falls within block:
+        if ((sim_blocks[i].virt != NULL) && \
+           (bus_addr >= sim_blocks[i].bus_addr) && \
+           (bus_addr < sim_blocks[i].bus_addr + sim_blocks[i].size)) {
+            // Set:
+            virt = (uint32_t*)((char*)sim_blocks[i].virt + \
+                (bus_addr - sim_blocks[i].bus_addr));
+
+            // Exit loop:
+            break;
+        }
+    }
+
+    // Unlock tables:
+    pthread_mutex_unlock(&sim_lock);
+
+    // Exit with host memory:
+    return virt;
+}
+
+// Get PWM channel 2 output at the time of the executing DMA channel:
+// (mark-space output of its range and data)
+static uint32_t sim_pwm2_level() {
+    // Definitions:
+    uint32_t *pwm; // PWM controller registers
+    uint32_t *cm;  // Clock manager registers
+
+    uint64_t rng;    // Channel 2 range
+    uint64_t div;    // PWM clock divisor
+    uint64_t cycles; // PWM clock cycles
+
+    // Get registers:
+    pwm = sim_page(SIM_PWM, 0);
+    cm = sim_page(SIM_CM, 0);
+
+    // Low unless enabled:
+    if ((pwm == NULL) || (cm == NULL) || !(pwm[SIM_PWM_CTL] & SIM_PWM_EN2)) {
+        // Exit with level:
+        return 0;
+    }
+
+    // Get range and divisor:
+    rng = pwm[SIM_PWM_RNG2];
+    div = (cm[SIM_CM_PWMDIV] >> 12) & 0xFFF;
+
+    // Not set up:
+    if ((rng == 0) || (div == 0)) {
+        // Exit with level:
+        return 0;
+    }
+
+    // Exit with level:
+    cycles = (sim_exec_ns * SIM_CLOCK_FREQ) / (div * 1000);
+    return (cycles % rng) < pwm[SIM_PWM_DAT2];
+}
+
+// Get output of words shifted out at the time of the executing DMA
+// channel:
+// (most significant bit first, of each word for the PWM serializer or of
+// each byte in memory order for SPI)
+static uint32_t sim_shift_level(struct sim_shift *ring, uint32_t bits, \
+    int bytewise) {
+    // Definitions:
+    int i;
+
+    uint64_t off;  // Time since the first word
+    uint32_t *src; // Word in memory
+    uint32_t word; // Word being shifted out
+    uint64_t bit;  // Bit being shifted out
+
+    // Find write covering the time:
+    for (i = 0; i < SIM_NUM_SHIFTS; i++) {
+        // Check if within write:
+        if ((ring[i].num == 0) || (sim_exec_ns < ring[i].start_ns) || \
+           (sim_exec_ns >= ring[i].start_ns + \
+           (ring[i].num * ring[i].word_ns))) {
+            // Next write:
+            continue;
+        }
+
+        // Get word and bit:
+        off = sim_exec_ns - ring[i].start_ns;
+        src = sim_translate(ring[i].src + (ring[i].src_inc ? \
+            (uint32_t)(4 * (off / ring[i].word_ns)) : 0));
+        word = (src == NULL) ? 0 : *(volatile uint32_t*)src;
+        bit = ((off % ring[i].word_ns) * bits) / ring[i].word_ns;
+
+        // Low past the word:
+        if (bit >= 32) {
+            // Exit with level:
+            return 0;
+        }
+
+        // Exit with level:
+        return bytewise ? ((word >> ((bit & ~7) + 7 - (bit & 7))) & 0x01) : \
+            ((word >> (31 - bit)) & 0x01);
+    }
+
+    // Exit with level (FIFO empty):
+    return 0;
+}
+
+// Record words shifted out by the PWM serializer or SPI:
+static void sim_record_shift(struct sim_shift *ring, int *next, \
+    uint64_t start_ns, uint64_t word_ns, uint32_t src, uint32_t num, \
+    int src_inc) {
+    // Record:
+    ring[*next].start_ns = start_ns;
+    ring[*next].word_ns = word_ns;
+    ring[*next].src = src;
+    ring[*next].num = num;
+    ring[*next].src_inc = src_inc;
+    *next = (*next + 1) % SIM_NUM_SHIFTS;
+}
+
+// Check if a GPIO selects a function:
+static int sim_fsel(uint32_t *gpio, int p, uint32_t fsel) {
+    // Exit with match:
+    return ((gpio[p / 10] >> ((p % 10) * 3)) & 0x7) == fsel;
+}
+
+// Update GPIO level registers from output latches and jumpers:
+static void sim_update_levels() {
+    // Definitions:
+    int i;
+
+    uint32_t out[2];   // GPIO outputs
+    uint32_t level[2]; // GPIO levels
+    uint32_t bit;      // Driving GPIO level
+
+    uint32_t *gpio; // GPIO or RIO registers
+    uint32_t *pwm;  // PWM controller registers
+    uint32_t *spi;  // SPI0 registers
+
+    // Outputs follow output latches:
+    out[0] = sim_latch[0];
+    out[1] = sim_latch[1];
+
+    // PWM channel 2 drives its GPIOs when selected:
+    if ((sim_pi != 5) && ((gpio = sim_page(SIM_GPIO, 0)) != NULL) && \
+       (sim_fsel(gpio, SIM_PWM2_GPIO_A, SIM_PWM2_FSEL_A) || \
+       sim_fsel(gpio, SIM_PWM2_GPIO_B, SIM_PWM2_FSEL_B))) {
+        // Get level:
+        bit = sim_pwm2_level();
+
+        // Drive:
+        if (sim_fsel(gpio, SIM_PWM2_GPIO_A, SIM_PWM2_FSEL_A)) {
+            out[0] = (out[0] & ~(1u << SIM_PWM2_GPIO_A)) | \
+                (bit << SIM_PWM2_GPIO_A);
+        }
+        if (sim_fsel(gpio, SIM_PWM2_GPIO_B, SIM_PWM2_FSEL_B)) {
+            out[0] = (out[0] & ~(1u << SIM_PWM2_GPIO_B)) | \
+                (bit << SIM_PWM2_GPIO_B);
+        }
+    }
+
+    // PWM channel 1 serializer drives its GPIOs when selected:
+    if ((sim_pi != 5) && ((gpio = sim_page(SIM_GPIO, 0)) != NULL) && \
+       ((pwm = sim_page(SIM_PWM, 0)) != NULL) && \
+       (pwm[SIM_PWM_CTL] & SIM_PWM_MODE1)) {
+        // Get level:
+        bit = sim_shift_level(sim_serial, pwm[SIM_PWM_RNG1], 0);
+
+        // Drive:
+        if (sim_fsel(gpio, SIM_PWM1_GPIO_A, SIM_PWM1_FSEL_A)) {
+            out[0] = (out[0] & ~(1u << SIM_PWM1_GPIO_A)) | \
+                (bit << SIM_PWM1_GPIO_A);
+        }
+        if (sim_fsel(gpio, SIM_PWM1_GPIO_B, SIM_PWM1_FSEL_B)) {
+            out[0] = (out[0] & ~(1u << SIM_PWM1_GPIO_B)) | \
+                (bit << SIM_PWM1_GPIO_B);
+        }
+    }
+
+    // SPI0 drives its MOSI GPIO when selected and active:
+    if ((sim_pi != 5) && ((gpio = sim_page(SIM_GPIO, 0)) != NULL) && \
+       ((spi = sim_page(SIM_SPI, 0)) != NULL) && \
+       (spi[SIM_SPI_CS] & SIM_SPI_TA) && \
+       sim_fsel(gpio, SIM_SPI_GPIO, SIM_SPI_FSEL)) {
+        // Drive:
+        bit = sim_shift_level(sim_spi, 32, 1);
+        out[0] = (out[0] & ~(1u << SIM_SPI_GPIO)) | (bit << SIM_SPI_GPIO);
+    }
+
+    // Levels follow outputs:
+    level[0] = out[0];
+    level[1] = out[1];
+
+    // Jumpered GPIOs follow their driving GPIO:
+    for (i = 0; i < sim_num_jumpers; i++) {
+        // Get driving level:
+        bit = (out[sim_jumpers[i].out / 32] >> \
+            (sim_jumpers[i].out % 32)) & 0x01;
+
+        // Drive:
+        level[sim_jumpers[i].in / 32] &= ~(1u << (sim_jumpers[i].in % 32));
+        level[sim_jumpers[i].in / 32] |= (bit << (sim_jumpers[i].in % 32));
+    }
+
+    // Update RP1 RIO input (bank 0 only):
+    if (sim_pi == 5) {
+        // Update register:
+        if ((gpio = sim_page(SIM_RP1_RIO, 0)) != NULL) {
+            gpio[SIM_RIO_SYNC_IN] = level[0];
+        }
+
+        // Exit:
+        return;
+    }
+
+    // Update registers:
+    if ((gpio = sim_page(SIM_GPIO, 0)) != NULL) {
+        gpio[SIM_GPLEV0] = level[0];
+        gpio[SIM_GPLEV1] = level[1];
+    }
+}
+
+// Write a word to the bus:
+static void sim_write(uint32_t bus_addr, uint32_t value) {
+    // Definitions:
+    uint32_t *reg;  // Register or memory
+    uint32_t *gpio; // GPIO registers
+
+    // RP1 RIO set and clear aliases act on output latches:
+    if (((bus_addr & ~SIM_PERI_MASK) == SIM_PERI_BUS_ADDR) && \
+       (((bus_addr & SIM_PAGE_MASK) == SIM_RP1_RIO_SET) || \
+       ((bus_addr & SIM_PAGE_MASK) == SIM_RP1_RIO_CLR)) && \
+       ((bus_addr & 0xFFF) / 4 == SIM_RIO_OUT)) {
+        // Apply:
+        if ((bus_addr & SIM_PAGE_MASK) == SIM_RP1_RIO_SET) {
+            sim_latch[0] |= value;
+        } else {
+            sim_latch[0] &= ~value;
+        }
+
+        // Update levels:
+        sim_update_levels();
+
+        // Exit:
+        return;
+    }
+
+    // GPIO set and clear registers act on output latches:
+    if ((bus_addr & ~SIM_PERI_MASK) == SIM_PERI_BUS_ADDR && \
+       ((bus_addr & SIM_PAGE_MASK) == SIM_GPIO)) {
+        // Get GPIO registers:
+        gpio = sim_page(SIM_GPIO, 0);
+
+        // Apply:
+        switch ((bus_addr & 0xFFF) / 4) {
+        case SIM_GPSET0: sim_latch[0] |= value; break;
+        case SIM_GPSET1: sim_latch[1] |= value; break;
+        case SIM_GPCLR0: sim_latch[0] &= ~value; break;
+        case SIM_GPCLR1: sim_latch[1] &= ~value; break;
+        default:
+            // Plain register:
+            gpio[(bus_addr & 0xFFF) / 4] = value;
+        }
+
+        // Update levels:
+        sim_update_levels();
+
+        // Exit:
+        return;
+    }
+
+    // Translate:
+    reg = sim_translate(bus_addr);
+
+    // Writes to unmapped addresses are dropped:
+    if (reg != NULL) {
+        // Write:
+        *reg = value;
+    }
+}
+
+// Read a word from the bus:
+static uint32_t sim_read(uint32_t bus_addr) {
+    // Definitions:
+    uint32_t *reg; // Register or memory
+
+    // System timer counts microseconds of the executing DMA channel:
+    if (bus_addr == (SIM_PERI_BUS_ADDR | SIM_ST | (SIM_ST_CLO * 4))) {
+        // Exit with counter:
+        return (uint32_t)(sim_exec_ns / 1000);
+    }
+
+    // GPIO levels are sampled at the time of the executing DMA channel:
+    if ((bus_addr == (SIM_PERI_BUS_ADDR | SIM_GPIO | (SIM_GPLEV0 * 4))) || \
+       (bus_addr == (SIM_PERI_BUS_ADDR | SIM_GPIO | (SIM_GPLEV1 * 4)))) {
+        // Update levels:
+        sim_update_levels();
+    }
+
+    // Translate:
+    reg = sim_translate(bus_addr);
+
+    // Reads from unmapped addresses return 0:
+    return (reg == NULL) ? 0 : *(volatile uint32_t*)reg;
+}
+
+// Get duration of a PWM paced word:
+// (matches the timing model of set_pwm() where each "wait" CB spans two
+// pulse widths)
+static uint64_t sim_word_ns() {
+    // Definitions:
+    uint32_t *pwm; // PWM controller registers
+    uint32_t *cm;  // Clock manager registers
+
+    uint64_t rng; // PWM range
+    uint64_t div; // PWM clock divisor
+
+    // RP1 PWM0 pops one FIFO word per period of its fixed clock:
+    if (sim_pi == 5) {
+        // Get range:
+        pwm = sim_page(SIM_RP1_PWM0, 0);
+        rng = (pwm == NULL) ? 0 : pwm[SIM_RP1_PWM_RANGE0];
+
+        // Exit with duration (1 us if not set up):
+        return (rng == 0) ? 1000 : (rng * 1000) / SIM_RP1_PWM_FREQ;
+    }
+
+    // Get registers:
+    pwm = sim_page(SIM_PWM, 0);
+    cm = sim_page(SIM_CM, 0);
+
+    // Get range and divisor:
+    rng = (pwm == NULL) ? 0 : pwm[SIM_PWM_RNG1];
+    div = (cm == NULL) ? 0 : ((cm[SIM_CM_PWMDIV] >> 12) & 0xFFF);
+
+    // PWM not set up; pace at 1 us:
+    if ((rng == 0) || (div == 0)) {
+        // Exit with default:
+        return 1000;
+    }
+
+    // Exit with duration:
+    return (2 * rng * div * 1000) / SIM_CLOCK_FREQ;
+}
+
+// Get the PWM FIFO words a paced write may run ahead of the output:
+// (the DREQ threshold, 0 if the FIFO is not modelled)
+static uint32_t sim_fifo_depth() {
+    // Definitions:
+    uint32_t *pwm; // PWM controller registers
+
+    // Not modelled:
+    if (!(sim_fifo)) {
+        // Exit with depth:
+        return 0;
+    }
+
+    // Get registers:
+    pwm = sim_page((sim_pi == 5) ? SIM_RP1_PWM0 : SIM_PWM, 0);
+    if (pwm == NULL) {
+        // Exit with depth:
+        return 0;
+    }
+
+    // Exit with DREQ threshold:
+    return (sim_pi == 5) ? ((pwm[SIM_RP1_PWM_FIFO_CTRL] >> 11) & 0x1F) : \
+        (pwm[SIM_PWM_DMAC] & 0xFF);
+}
+
+// Output the PWM FIFO words a DMA channel wrote up to a time:
+// (each word lasts the range set when it starts being output)
+static void sim_fifo_output(int n, uint64_t now_ns) {
+    // Start each waiting word once the one before ends:
+    while (sim_dma[n].fifo_words && (sim_dma[n].fifo_end_ns <= now_ns)) {
+        sim_dma[n].fifo_end_ns += sim_word_ns();
+        sim_dma[n].fifo_words--;
+    }
+}
+
+// Write a word to the PWM FIFO at a DMA channel's time:
+// (the DMA waits while the FIFO holds as many words as the DREQ threshold,
+// or until the word is output if the FIFO is not modelled)
+static void sim_fifo_write(int n) {
+    // Definitions:
+    uint32_t depth; // Words the DMA may run ahead
+
+    // Not modelled:
+    if ((depth = sim_fifo_depth()) == 0) {
+        // Wait for the word:
+        sim_dma[n].time_ns += sim_word_ns();
+
+        // Exit:
+        return;
+    }
+
+    // Output words up to now:
+    sim_fifo_output(n, sim_dma[n].time_ns);
+
+    // Output idle; word starts now:
+    if (sim_dma[n].fifo_end_ns <= sim_dma[n].time_ns) {
+        sim_dma[n].fifo_end_ns = sim_dma[n].time_ns + sim_word_ns();
+
+        // Exit:
+        return;
+    }
+
+    // Wait for room:
+    while (sim_dma[n].fifo_words >= depth) {
+        sim_dma[n].time_ns = sim_dma[n].fifo_end_ns;
+        sim_fifo_output(n, sim_dma[n].time_ns);
+    }
+
+    // Queue:
+    sim_dma[n].fifo_words++;
+}
+
+// Get duration of a word shifted out by SPI0:
+static uint64_t sim_spi_word_ns() {
+    // Definitions:
+    uint32_t *spi; // SPI0 registers
+
+    uint64_t cdiv; // Clock divisor
+
+    // Get divisor (0 divides by 65536):
+    spi = sim_page(SIM_SPI, 0);
+    cdiv = (spi == NULL) ? 0 : (spi[SIM_SPI_CLK] & 0xFFFE);
+    cdiv = (cdiv == 0) ? 65536 : cdiv;
+
+    // Exit with duration:
+    return (32 * cdiv * 1000) / \
+        ((sim_pi == 4) ? SIM_BCM2711_CORE_FREQ : SIM_CORE_FREQ);
+}
+
+// Check if a DMA channel is a DMA4 engine:
+static int sim_dma4(int n) {
+    // Exit with engine:
+    return (sim_pi == 4) && (n >= SIM_DMA4_FIRST);
+}
+
+// Convert a DMA4 address to a bus address:
+// (peripherals keep their bus address and SDRAM gets the uncached alias)
+static uint32_t sim_dma4_bus(uint32_t addr, uint32_t high) {
+    // Peripheral:
+    if (high == SIM_DMA4_PERI_HIGH) {
+        // Exit with address:
+        return addr;
+    }
+
+    // SDRAM below 1 GB, otherwise unmapped:
+    return ((high == 0) && (addr < SIM_RAM_BUS_ADDR)) ? \
+        (SIM_RAM_BUS_ADDR | addr) : 0;
+}
+
+// Convert an RP1 DMA address to a bus address:
+// (RP1 peripherals keep their offset and host SDRAM gets the uncached
+// alias)
+static uint32_t sim_rp1_bus(uint32_t addr, uint32_t high) {
+    // RP1 peripheral:
+    if ((high == 0) && ((addr & ~SIM_PERI_MASK) == SIM_RP1_BUS)) {
+        // Exit with address:
+        return SIM_PERI_BUS_ADDR | (addr & SIM_PERI_MASK);
+    }
+
+    // Host SDRAM below 1 GB, otherwise unmapped:
+    return ((high == SIM_RP1_RAM_HIGH) && (addr < SIM_RAM_BUS_ADDR)) ? \
+        (SIM_RAM_BUS_ADDR | addr) : 0;
+}
+
+// Execute one linked list descriptor of an RP1 DMA channel:
+static void sim_rp1_step(int n, volatile uint32_t *dmac) {
+    // Definitions:
+    uint32_t i;
+
+    volatile uint32_t *reg; // Channel registers
+    uint32_t *cb;           // Descriptor
+    uint32_t lli[16];       // Descriptor as loaded by the channel
+    uint32_t *from;         // Source memory
+    uint32_t *to;           // Destination memory
+
+    uint32_t src;   // Source address
+    uint32_t dst;   // Destination address
+    uint32_t words; // Transfer length in words
+    int paced;      // Writes paced by PWM0 handshake
+
+    // Get channel registers and descriptor:
+    reg = dmac + ((0x100 + 0x100 * n) / 4);
+    cb = sim_translate(sim_rp1_bus(reg[SIM_RP1_CH_LLP], \
+        reg[SIM_RP1_CH_LLP + 1]));
+
+    // Stop on a bus error or invalid descriptor:
+    if ((cb == NULL) || !(cb[9] & SIM_RP1_LLI_VALID)) {
+        // Disable channel:
+        dmac[SIM_RP1_CHEN] &= ~(1u << n);
+        sim_dma[n].active = 0;
+
+        // Exit:
+        return;
+    }
+
+    // Load descriptor (the block may overwrite it):
+    memcpy(lli, cb, sizeof(lli));
+
+    // Decode descriptor (the channel paces writes to the PWM0 FIFO):
+    src = sim_rp1_bus(lli[0], lli[1]);
+    dst = sim_rp1_bus(lli[2], lli[3]);
+    words = lli[4] + 1;
+    paced = (SIM_RP1_CFG_TT_FC(reg[SIM_RP1_CH_CFG + 1]) == \
+        SIM_RP1_MEM_TO_PER) && \
+        (SIM_RP1_CFG_DST_PER(reg[SIM_RP1_CH_CFG]) == SIM_RP1_DREQ_PWM0) && \
+        (dst == (SIM_PERI_BUS_ADDR | SIM_RP1_PWM0 | \
+        (SIM_RP1_PWM_DUTY_FIFO * 4)));
+
+    // Output PWM FIFO words up to the descriptor (it may set their range):
+    sim_fifo_output(n, sim_dma[n].time_ns);
+
+    // Copy memory blocks whole (e.g. descriptor templates):
+    from = sim_translate(src);
+    to = sim_translate(dst);
+    if (!(paced) && !(lli[8] & (SIM_RP1_SINC_FIXED | SIM_RP1_DINC_FIXED)) && \
+       ((src & ~SIM_PERI_MASK) != SIM_PERI_BUS_ADDR) && \
+       ((dst & ~SIM_PERI_MASK) != SIM_PERI_BUS_ADDR) && (from != NULL) && \
+       (to != NULL) && (sim_translate(src + 4 * (words - 1)) == \
+       from + words - 1) && (sim_translate(dst + 4 * (words - 1)) == \
+       to + words - 1)) {
+        memmove(to, from, 4 * words);
+        words = 0;
+    }
+
+    // Transfer each word:
+    for (i = 0; i < words; i++) {
+        // Copy:
+        sim_write(dst, sim_read(src));
+
+        // Increment addresses:
+        src += (lli[8] & SIM_RP1_SINC_FIXED) ? 0 : 4;
+        dst += (lli[8] & SIM_RP1_DINC_FIXED) ? 0 : 4;
+
+        // Paced writes wait for the PWM FIFO:
+        if (paced) {
+            sim_fifo_write(n);
+        }
+    }
+
+    // Unpaced descriptors take bus time:
+    if (!(paced)) {
+        // Add duration and jitter:
+        sim_dma[n].time_ns += sim_cb_ns;
+        if (sim_jitter_ns) {
+            sim_dma[n].time_ns += rand_r(&sim_seed) % (sim_jitter_ns + 1);
+        }
+    }
+
+    // Write back control with the descriptor no longer valid (it has to be
+    // rewritten before it can be executed again):
+    cb[9] = lli[9] & ~SIM_RP1_LLI_VALID;
+
+    // Load next descriptor:
+    reg[SIM_RP1_CH_LLP] = lli[6];
+    reg[SIM_RP1_CH_LLP + 1] = lli[7];
+
+    // Channel disables itself after the last descriptor:
+    if (lli[9] & SIM_RP1_LLI_LAST) {
+        dmac[SIM_RP1_CHEN] &= ~(1u << n);
+        sim_dma[n].active = 0;
+    }
+}
+
+// Apply CPU writes to RP1 RIO and enabled RP1 DMA channels:
+static void sim_rp1_control(volatile uint32_t *dmac, uint64_t now_ns) {
+    // Definitions:
+    int n;
+
+    uint32_t *set; // RIO set alias
+    uint32_t *clr; // RIO clear alias
+
+    // Apply RIO set and clear writes made by the CPU:
+    // (back-to-back CPU writes within a period coalesce)
+    set = sim_page(SIM_RP1_RIO_SET, 0);
+    clr = sim_page(SIM_RP1_RIO_CLR, 0);
+    if ((set != NULL) && (clr != NULL)) {
+        sim_latch[0] |= set[SIM_RIO_OUT];
+        sim_latch[0] &= ~clr[SIM_RIO_OUT];
+        set[SIM_RIO_OUT] = clr[SIM_RIO_OUT] = 0;
+    }
+    sim_update_levels();
+
+    // Apply channel enables:
+    for (n = 0; n < SIM_RP1_NUM_DMA; n++) {
+        // Channel started or stopped:
+        if (!(dmac[SIM_RP1_CHEN] & (1u << n))) {
+            // Stopped:
+            sim_dma[n].active = 0;
+        } else if (!(sim_dma[n].active)) {
+            // Started:
+            sim_dma[n].active = 1;
+            sim_dma[n].time_ns = now_ns;
+        }
+
+        // Channels cannot lag behind more than a few periods:
+        if (sim_dma[n].active && \
+           (sim_dma[n].time_ns + SIM_MAX_LAG_NS < now_ns)) {
+            sim_dma[n].time_ns = now_ns - SIM_MAX_LAG_NS;
+        }
+    }
+}
+
+// Execute one control block of a DMA channel:
+static void sim_step(int n, volatile uint32_t *reg) {
+    // Definitions:
+    uint32_t i;
+
+    uint32_t *cb; // Control block
+
+    uint32_t ti;     // Transfer information
+    uint32_t src;    // Source address
+    uint32_t dst;    // Destination address
+    uint32_t length; // Transfer length
+    uint32_t next;   // Next control block register value
+    int src_inc;     // Increment source address
+    int dst_inc;     // Increment destination address
+    int paced;       // Writes paced by PWM or SPI TX DREQ
+    int fifo;        // Writes queued in the PWM FIFO
+    uint32_t permap; // Peripheral DREQ
+    uint64_t word_ns; // Duration of a paced write
+
+    uint32_t *pwm; // PWM controller registers
+    uint32_t *spi; // SPI0 registers
+
+    // Get control block:
+    cb = sim_translate(sim_dma4(n) ? \
+        sim_dma4_bus(reg[SIM_DMA_CONBLK_AD] << 5, 0) : \
+        reg[SIM_DMA_CONBLK_AD]);
+
+    // Stop on a bus error:
+    if (cb == NULL) {
+        // Stop channel:
+        reg[SIM_DMA_CS] = (reg[SIM_DMA_CS] & ~SIM_DMA_ACTIVE) | SIM_DMA_END;
+        sim_dma[n].active = 0;
+
+        // Exit:
+        return;
+    }
+
+    // Decode control block:
+    ti = cb[0];
+    if (sim_dma4(n)) {
+        src = sim_dma4_bus(cb[1], SIM_I4_HIGH(cb[2]));
+        src_inc = cb[2] & SIM_I4_INC;
+        dst = sim_dma4_bus(cb[3], SIM_I4_HIGH(cb[4]));
+        dst_inc = cb[4] & SIM_I4_INC;
+        length = cb[5] & 0x3FFFFFFF;
+        next = cb[6];
+        permap = SIM_TI4_PERMAP(ti);
+        paced = (ti & SIM_TI4_D_DREQ) && ((permap == SIM_PERMAP_PWM) || \
+            (permap == SIM_PERMAP_SPI_TX));
+    } else {
+        src = cb[1];
+        src_inc = ti & SIM_TI_SRC_INC;
+        dst = cb[2];
+        dst_inc = ti & SIM_TI_DEST_INC;
+        length = cb[3];
+        next = cb[5];
+        permap = SIM_TI_PERMAP(ti);
+        paced = (ti & SIM_TI_DEST_DREQ) && ((permap == SIM_PERMAP_PWM) || \
+            (permap == SIM_PERMAP_SPI_TX));
+    }
+
+    // Paced writes wait for the PWM FIFO or SPI shifter:
+    word_ns = (permap == SIM_PERMAP_SPI_TX) ? sim_spi_word_ns() : \
+        sim_word_ns();
+
+    // Set time for system timer reads:
+    sim_exec_ns = sim_dma[n].time_ns;
+
+    // Output PWM FIFO words up to the CB (it may set their range):
+    sim_fifo_output(n, sim_dma[n].time_ns);
+
+    // PWM words are queued in the FIFO unless serialized (recorded as
+    // written below):
+    pwm = sim_page(SIM_PWM, 0);
+    fifo = paced && (permap == SIM_PERMAP_PWM) && (pwm != NULL) && \
+        !(pwm[SIM_PWM_CTL] & SIM_PWM_MODE1);
+
+    // Record words serialized by PWM channel 1:
+    if (paced && (dst == (SIM_PERI_BUS_ADDR | SIM_PWM | (SIM_PWM_FIF1 * 4))) \
+        && ((pwm = sim_page(SIM_PWM, 0)) != NULL) && \
+        (pwm[SIM_PWM_CTL] & SIM_PWM_MODE1)) {
+        // Record:
+        sim_record_shift(sim_serial, &sim_next_serial, sim_dma[n].time_ns, \
+            word_ns, src, length / 4, src_inc);
+    }
+
+    // Record words shifted out by SPI0:
+    if (paced && (dst == (SIM_PERI_BUS_ADDR | SIM_SPI | (SIM_SPI_FIFO * 4))) \
+        && ((spi = sim_page(SIM_SPI, 0)) != NULL) && \
+        (spi[SIM_SPI_CS] & SIM_SPI_TA)) {
+        // Record:
+        sim_record_shift(sim_spi, &sim_next_spi, sim_dma[n].time_ns, \
+            word_ns, src, length / 4, src_inc);
+    }
+
+    // Transfer each word:
+    for (i = 0; i < (length / 4); i++) {
+        // Copy:
+        sim_write(dst, sim_read(src));
+
+        // Increment addresses:
+        src += src_inc ? 4 : 0;
+        dst += dst_inc ? 4 : 0;
+
+        // Paced writes wait for the PWM FIFO or SPI shifter:
+        if (fifo) {
+            sim_fifo_write(n);
+        } else if (paced) {
+            sim_dma[n].time_ns += word_ns;
+        }
+    }
+
+    // Unpaced CBs take bus time:
+    if (!(paced)) {
+        // Add duration and jitter:
+        sim_dma[n].time_ns += sim_cb_ns;
+        if (sim_jitter_ns) {
+            sim_dma[n].time_ns += rand_r(&sim_seed) % (sim_jitter_ns + 1);
+        }
+    }
+
+    // Load next control block:
+    reg[SIM_DMA_CONBLK_AD] = next;
+
+    // Transfer complete at end of chain:
+    if (next == 0) {
+        // Stop channel:
+        reg[SIM_DMA_CS] = (reg[SIM_DMA_CS] & ~SIM_DMA_ACTIVE) | SIM_DMA_END;
+        sim_dma[n].active = 0;
+    }
+}
+
+// Execute control blocks of all channels in time order up to simulation
+// time:
+static void sim_execute(uint32_t *dma, uint64_t now_ns) {
+    // Definitions:
+    int n;
+
+    int next; // Channel furthest behind
+
+    // Memory cannot be freed while executing:
+    pthread_mutex_lock(&sim_exec_lock);
+
+    // Execute control blocks in time order up to simulation time:
+    while (1) {
+        // Find active channel furthest behind:
+        next = -1;
+        for (n = 0; n < SIM_NUM_DMA; n++) {
+            // Check if behind:
+            if (sim_dma[n].active && (sim_dma[n].time_ns < now_ns) && \
+               ((next < 0) || \
+               (sim_dma[n].time_ns < sim_dma[next].time_ns))) {
+                next = n;
+            }
+        }
+
+        // All caught up:
+        if (next < 0) {
+            // Exit loop:
+            break;
+        }
+
+        // Execute:
+        if (sim_pi == 5) {
+            sim_rp1_step(next, dma);
+        } else {
+            sim_step(next, (volatile uint32_t*)dma + (next * 0x40));
+        }
+    }
+
+    // Done executing:
+    pthread_mutex_unlock(&sim_exec_lock);
+}
+
+// Simulation thread:
+static void *sim_thread(void *arg) {
+    // Definitions:
+    int n;
+
+    uint64_t start_ns; // Simulation start
+    uint64_t now_ns;   // Simulation time
+
+    uint32_t *gpio;         // GPIO registers
+    uint32_t *dma;          // DMA controller registers
+    volatile uint32_t *reg; // DMA channel registers
+
+    struct timespec period = {
+        .tv_sec = 0,
+        .tv_nsec = SIM_TICK_NS
+    };
+
+    // Unused:
+    (void)arg;
+
+    // Get start:
+    start_ns = sim_now_ns();
+
+    // Run forever:
+    while (1) {
+        // Wait:
+        nanosleep(&period, NULL);
+
+        // Get simulation time:
+        now_ns = sim_now_ns() - start_ns;
+
+        // Get registers:
+        gpio = sim_page(SIM_GPIO, 0);
+        dma = sim_page(SIM_DMA, 0);
+
+        // RP1 peripherals:
+        if (sim_pi == 5) {
+            // Get registers:
+            dma = sim_page(SIM_RP1_DMA, 0);
+
+            // Nothing to simulate until mapped:
+            if (dma == NULL) {
+                // Next period:
+                continue;
+            }
+
+            // Apply control and execute:
+            sim_rp1_control(dma, now_ns);
+            sim_execute(dma, now_ns);
+
+            // Next period:
+            continue;
+        }
+
+        // Nothing to simulate until mapped:
+        if ((gpio == NULL) || (dma == NULL)) {
+            // Next period:
+            continue;
+        }
+
+        // Apply GPIO set and clear writes made by the CPU:
+        // (back-to-back CPU writes within a period coalesce)
+        sim_latch[0] |= gpio[SIM_GPSET0];
+        sim_latch[1] |= gpio[SIM_GPSET1];
+        sim_latch[0] &= ~gpio[SIM_GPCLR0];
+        sim_latch[1] &= ~gpio[SIM_GPCLR1];
+        gpio[SIM_GPSET0] = gpio[SIM_GPSET1] = 0;
+        gpio[SIM_GPCLR0] = gpio[SIM_GPCLR1] = 0;
+        sim_update_levels();
+
+        // Apply channel control:
+        for (n = 0; n < SIM_NUM_DMA; n++) {
+            // Get channel registers:
+            reg = (volatile uint32_t*)dma + (n * 0x40);
+
+            // DMA4 reset (self clearing) stops the channel, which then
+            // restarts below if CS was written active since:
+            if (sim_dma4(n) && (reg[SIM_DMA4_DEBUG] & SIM_DMA4_RESET)) {
+                reg[SIM_DMA4_DEBUG] &= ~SIM_DMA4_RESET;
+                sim_dma[n].active = 0;
+            }
+
+            // Reset stops the channel:
+            if (!(sim_dma4(n)) && (reg[SIM_DMA_CS] & SIM_DMA_RESET)) {
+                // Reset:
+                reg[SIM_DMA_CS] = 0;
+                sim_dma[n].active = 0;
+
+                // Next channel:
+                continue;
+            }
+
+            // CBs execute whole; nothing to abort:
+            reg[SIM_DMA_CS] &= ~SIM_DMA_ABORT;
+
+            // Channel started or stopped:
+            if (!(reg[SIM_DMA_CS] & SIM_DMA_ACTIVE)) {
+                // Stopped:
+                sim_dma[n].active = 0;
+            } else if (!(sim_dma[n].active)) {
+                // Started:
+                sim_dma[n].active = 1;
+                sim_dma[n].time_ns = now_ns;
+            }
+
+            // Channels cannot lag behind more than a few periods (e.g. they
+            // were paused in between):
+            if (sim_dma[n].active && \
+               (sim_dma[n].time_ns + SIM_MAX_LAG_NS < now_ns)) {
+                sim_dma[n].time_ns = now_ns - SIM_MAX_LAG_NS;
+            }
+        }
+
+        // Execute:
+        sim_execute(dma, now_ns);
+    }
+
+    // Never reached:
+    return NULL;
+}
+
+// Start simulation thread:
+static void sim_start() {
+    // Definitions:
+    int i;
+
+    char *env;  // Environment variable
+    char *save; // Tokenizer state
+    char *tok;  // Jumper token
+
+    pthread_t thread; // Simulation thread
+
+    // Board version:
+    sim_pi = sim_get_pi_version__();
+
+    // Unpaced CB duration and jitter:
+    if ((env = getenv("DMA_PWM_SIM_CB_NS")) != NULL) {
+        sim_cb_ns = strtoull(env, NULL, 10);
+    }
+    if ((env = getenv("DMA_PWM_SIM_JITTER_NS")) != NULL) {
+        sim_jitter_ns = strtoull(env, NULL, 10);
+    }
+
+    // PWM FIFO model:
+    if ((env = getenv("DMA_PWM_SIM_FIFO")) != NULL) {
+        sim_fifo = atoi(env);
+    }
+
+    // Jumpered GPIOs:
+    if ((env = getenv("DMA_PWM_SIM_JUMPERS")) != NULL) {
+        // Copy as tokenizing modifies:
+        env = strdup(env);
+
+        // Parse each "out:in" pair:
+        for (tok = strtok_r(env, ",", &save), i = 0; \
+            (tok != NULL) && (i < SIM_MAX_JUMPERS); \
+            tok = strtok_r(NULL, ",", &save)) {
+            // Append if valid:
+            if ((sscanf(tok, "%d:%d", &sim_jumpers[i].out, \
+                &sim_jumpers[i].in) == 2) && \
+               (sim_jumpers[i].out >= 0) && (sim_jumpers[i].out < 64) && \
+               (sim_jumpers[i].in >= 0) && (sim_jumpers[i].in < 64)) {
+                i++;
+            }
+        }
+
+        // Update:
+        sim_num_jumpers = i;
+        free(env);
+    }
+
+    // Start thread:
+    pthread_create(&thread, NULL, sim_thread, NULL);
+    pthread_detach(thread);
+}
+
+// Map simulated peripheral registers:
+volatile uint32_t *sim_map_peripheral__(uint64_t base_addr) {
+    // Start simulation on first mapping:
+    pthread_once(&sim_once, sim_start);
+
+    // Exit with page (BCM and RP1 peripherals differ in offset):
+    return sim_page((uint32_t)(base_addr & SIM_PERI_MASK), 1);
+}
+
+// Allocate simulated uncached memory:
+struct uncached_mem *sim_uncached_malloc__(struct uncached_mem *block) {
+    // Definitions:
+    int i;
+
+    uint32_t phys; // Simulated physical address
+
+    // Allocate aligned host memory:
+    if (posix_memalign(&block->virt_addr, getpagesize(), block->size) != 0) {
+        // Exit with error:
+        block->virt_addr = NULL;
+        return block;
+    }
+
+    // Zero like freshly allocated VideoCore memory:
+    memset(block->virt_addr, 0, block->size);
+
+    // Lock tables:
+    pthread_mutex_lock(&sim_lock);
+
+    // Assign aligned bus address:
+    phys = (sim_next_phys + block->alignment - 1) & ~(block->alignment - 1);
+    sim_next_phys = phys + block->size;
+    block->bus_addr = SIM_RAM_BUS_ADDR | phys;
+    block->mb_handle = 0;
+
+    // Record block:
+    for (i = 0; i < SIM_MAX_BLOCKS; i++) {
+        // Find free entry:
+        if (sim_blocks[i].virt == NULL) {
+            // Record:
+            sim_blocks[i].bus_addr = block->bus_addr;
+            sim_blocks[i].size = block->size;
+            sim_blocks[i].virt = block->virt_addr;
+            block->mb_handle = i + 1;
+
+            // Exit loop:
+            break;
+        }
+    }
+
+    // Unlock tables:
+    pthread_mutex_unlock(&sim_lock);
+
+    // Exit with block:
+    return block;
+}
+
+// Free simulated uncached memory:
+int sim_uncached_free__(struct uncached_mem *block) {
+    // Wait for CBs being executed:
+    pthread_mutex_lock(&sim_exec_lock);
+
+    // Lock tables:
+    pthread_mutex_lock(&sim_lock);
+
+    // Forget block:
+    if ((block->mb_handle > 0) && (block->mb_handle <= SIM_MAX_BLOCKS)) {
+        sim_blocks[block->mb_handle - 1].virt = NULL;
+    }
+
+    // Unlock tables:
+    pthread_mutex_unlock(&sim_lock);
+
+    // Free host memory:
+    free(block->virt_addr);
+
+    // Done:
+    pthread_mutex_unlock(&sim_exec_lock);
+
+    // Exit with success:
+    return 0;
+}
+
+// Get simulated Raspberry Pi board version:
+int sim_get_pi_version__() {
+    // Definitions:
+    char *env; // Environment variable
+
+    // Get version:
+    env = getenv("DMA_PWM_SIM_PI");
+
+    // Exit with version:
+    return (env == NULL) ? 3 : atoi(env);
+}
+
+#else
+
+// Make GCC happy
+extern int make_iso_compilers_happy;
+
+#endif // DMA_PWM_SIM
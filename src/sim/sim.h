@@ -0,0 +1,57 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Simulated backend (configure --enable-sim):
+// Peripheral registers and uncached memory are host memory and a thread
+// executes DMA control blocks in real time, so the library runs unmodified
+// on any Linux host. Environment variables:
+//  - DMA_PWM_SIM_PI      : Simulated Pi board version (default 3; 4 makes
+//                          DMA channels 11 to 14 DMA4 engines and 5
+//                          simulates the RP1 DMA, PWM and RIO)
+//  - DMA_PWM_SIM_JUMPERS : Jumpered GPIOs "out:in,out:in" (default none)
+//  - DMA_PWM_SIM_CB_NS   : Duration of an unpaced CB in ns (default 0)
+//  - DMA_PWM_SIM_JITTER_NS : Random extra duration of an unpaced CB in ns
+//                            (default 0)
+
+// Uncached memory structure (uncached_mem.h):
+struct uncached_mem;
+
+// Map simulated peripheral registers
+volatile uint32_t *sim_map_peripheral__(uint64_t base_addr);
+
+// Allocate simulated uncached memory
+struct uncached_mem *sim_uncached_malloc__(struct uncached_mem *block);
+
+// Free simulated uncached memory
+int sim_uncached_free__(struct uncached_mem *block);
+
+// Get simulated Raspberry Pi board version
+int sim_get_pi_version__();
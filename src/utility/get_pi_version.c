@@ -33,6 +33,10 @@
 #include <stdio.h>  // C Standard I/O libary
 #include <stdlib.h> // C Standard library
 #include <string.h> // C Standard string manipulation libary
+#include <stdint.h> // C Standard integer types
+
+// Include header files:
+#include "sim.h" // Simulated backend
 
 // Pi version description struct:
 static struct pi_version_struct {
@@ -244,6 +248,42 @@ static struct pi_version_struct pi_version[] = {
     {
         .revision_string = "c03131",
         .version = 4
+    },
+
+    // Pi 5 2GB
+    {
+        .revision_string = "b04170",
+        .version = 5
+    },
+
+    // Pi 5 4GB
+    {
+        .revision_string = "c04170",
+        .version = 5
+    },
+
+    // Pi 5 8GB
+    {
+        .revision_string = "d04170",
+        .version = 5
+    },
+
+    // Pi 5 16GB
+    {
+        .revision_string = "e04171",
+        .version = 5
+    },
+
+    // Pi 500
+    {
+        .revision_string = "d04190",
+        .version = 5
+    },
+
+    // Compute Module 5
+    {
+        .revision_string = "d04180",
+        .version = 5
     }
 };
 
@@ -257,6 +297,11 @@ int get_pi_version__() {
 
     int i;
 
+// Simulated backend sets the board version:
+#ifdef DMA_PWM_SIM
+    return sim_get_pi_version__();
+#endif
+
     // Open file:
     FILE *fd = fopen("/proc/cpuinfo", "r");
 
@@ -0,0 +1,80 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+
+// Include C standard libraries:
+#include <stddef.h> // C Standard definitions
+#include <stdint.h> // C Standard integer types
+
+// Include header files:
+#include "kernels.h" // Hot kernels
+
+// Copy words out of uncached memory:
+void copy_from_uncached__(uint32_t *dst, const volatile uint32_t *src, \
+    size_t num_words) {
+    // Definitions:
+    size_t i;
+
+    // Copy:
+    for (i = 0; i < num_words; i++) {
+        dst[i] = src[i];
+    }
+}
+
+// Copy words into uncached memory:
+void copy_to_uncached__(volatile uint32_t *dst, const uint32_t *src, \
+    size_t num_words) {
+    // Definitions:
+    size_t i;
+
+    // Copy:
+    for (i = 0; i < num_words; i++) {
+        dst[i] = src[i];
+    }
+}
+
+// Find the first sample whose masked bits differ from the last sample:
+size_t find_change__(const uint32_t *samples, size_t num_samples, \
+    uint32_t last, uint32_t mask) {
+    // Definitions:
+    size_t i;
+
+    // Compare each sample:
+    for (i = 0; i < num_samples; i++) {
+        if ((samples[i] ^ last) & mask) {
+            // Exit with index:
+            return i;
+        }
+    }
+
+    // Exit with none:
+    return num_samples;
+}
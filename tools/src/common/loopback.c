@@ -0,0 +1,407 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+#include <stdint.h> // C Standard integer types library
+#include <string.h> // C Standard string manipulation libary
+#include <math.h>   // C Standard math library
+#include <time.h>   // C Standard get and manipulate time library
+
+// Include header files:
+#include "dma_pwm.h"  // Library API
+#include "loopback.h" // Loopback measurement
+
+// Edges read per capture poll:
+#define LOOPBACK_READ_EDGES 256
+
+// Capture poll interval in ns:
+#define LOOPBACK_POLL_NS 1000000
+
+// Tolerance in sample ticks for a period to match a configuration:
+#define LOOPBACK_MATCH_TICKS 1.5
+
+// Measured periods and edge pairing state:
+struct loopback_periods {
+    uint64_t *period; // Period of each complete period in ticks
+    uint64_t *high;   // High time of each complete period in ticks
+    size_t num;       // Number of complete periods
+    size_t size;      // Allocated number of periods
+
+    uint64_t last_rise; // Tick of last rising edge
+    uint64_t last_fall; // Tick of last falling edge
+    int rise_valid;     // Rising edge observed
+    int fall_valid;     // Falling edge observed since last rising edge
+};
+
+// Get seconds elapsed since a start time:
+static double elapsed_s(struct timespec *start) {
+    // Definitions:
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Return difference:
+    return (now.tv_sec - start->tv_sec) + \
+        (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Pair edges into complete periods:
+static int add_edges(struct loopback *lb, struct loopback_periods *periods, \
+    struct edge_pwm *edges, size_t num_edges) {
+    // Definitions:
+    size_t i;
+
+    for (i = 0; i < num_edges; i++) {
+        // Skip other GPIOs:
+        if (edges[i].gpio != lb->in_gpio) {
+            continue;
+        }
+
+        // Falling edge only marks the end of the high time:
+        if (!edges[i].level) {
+            periods->last_fall = edges[i].tick;
+            periods->fall_valid = periods->rise_valid;
+            continue;
+        }
+
+        // Rising edge closes a period when one was opened:
+        if (periods->rise_valid && periods->fall_valid) {
+            // Grow storage:
+            if (periods->num == periods->size) {
+                periods->size = periods->size ? (2 * periods->size) : 1024;
+                periods->period = realloc(periods->period, \
+                    periods->size * sizeof(uint64_t));
+                periods->high = realloc(periods->high, \
+                    periods->size * sizeof(uint64_t));
+
+                if ((periods->period == NULL) || (periods->high == NULL)) {
+                    // Exit with error:
+                    return -1;
+                }
+            }
+
+            periods->period[periods->num] = \
+                edges[i].tick - periods->last_rise;
+            periods->high[periods->num] = \
+                periods->last_fall - periods->last_rise;
+            periods->num++;
+        }
+
+        // Open next period:
+        periods->last_rise = edges[i].tick;
+        periods->rise_valid = 1;
+        periods->fall_valid = 0;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Poll captured edges for a duration:
+static int poll_edges(struct loopback *lb, struct loopback_periods *periods, \
+    float seconds, int *overrun) {
+    // Definitions:
+    int num_edges;
+    struct timespec start;
+    struct timespec poll = {.tv_sec = 0, .tv_nsec = LOOPBACK_POLL_NS};
+    struct capture_pwm capture;
+    struct edge_pwm edges[LOOPBACK_READ_EDGES];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    do {
+        // Read queued edges:
+        if ((num_edges = read_capture_pwm(lb->in_channel, edges, \
+            LOOPBACK_READ_EDGES)) < 0) {
+            // Exit with error:
+            return num_edges;
+        }
+
+        if (add_edges(lb, periods, edges, num_edges) < 0) {
+            // Exit with error:
+            return -1;
+        }
+
+        // Track lost samples:
+        if ((get_capture_pwm(lb->in_channel, lb->in_gpio, &capture) == 0) && \
+            capture.overrun) {
+            *overrun = 1;
+        }
+
+        // Sleep only once the queue is drained:
+        if (num_edges < LOOPBACK_READ_EDGES) {
+            nanosleep(&poll, NULL);
+        }
+    } while (elapsed_s(&start) < seconds);
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Check if a period matches a configuration:
+static int matches(struct loopback *lb, uint64_t period, uint64_t high, \
+    float freq, float duty) {
+    // Definitions:
+    double exp_period = 1e6 / freq / lb->tick_us;
+    double exp_high = exp_period * duty / 100;
+
+    return (fabs(period - exp_period) <= LOOPBACK_MATCH_TICKS) && \
+        (fabs(high - exp_high) <= LOOPBACK_MATCH_TICKS);
+}
+
+// Bin a tick error into a histogram:
+static void bin(uint64_t *hist, double error) {
+    // Definitions:
+    long i = lround(error);
+
+    // Clamp to outermost bins:
+    if (i < -LOOPBACK_HIST_HALF) {
+        i = -LOOPBACK_HIST_HALF;
+    } else if (i > LOOPBACK_HIST_HALF) {
+        i = LOOPBACK_HIST_HALF;
+    }
+
+    hist[i + LOOPBACK_HIST_HALF]++;
+}
+
+// Compare doubles for sorting:
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Request and set up the output and capture channels:
+int loopback_open(struct loopback *lb, int out_gpio, int in_gpio, \
+    float window) {
+    // Definitions:
+    int ret;
+
+    memset(lb, 0, sizeof(*lb));
+    lb->out_gpio = out_gpio;
+    lb->in_gpio = in_gpio;
+
+    // Request channels:
+    if ((lb->out_channel = request_pwm()) < 0) {
+        // Exit with error:
+        return lb->out_channel;
+    }
+
+    if ((lb->in_channel = request_pwm()) < 0) {
+        ret = lb->in_channel;
+        free_pwm(lb->out_channel);
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Sample period (one GPIO level copy and one "wait" CB):
+    lb->tick_us = get_sample_tick_pwm();
+
+    // Start sampling the input:
+    if (((ret = set_capture_pwm(lb->in_channel, &lb->in_gpio, 1, \
+        window)) < 0) || ((ret = enable_pwm(lb->in_channel)) < 0)) {
+        loopback_close(lb);
+
+        // Exit with error:
+        return ret;
+    }
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Apply a configuration and measure it:
+int loopback_run(struct loopback *lb, float freq, float duty, \
+    float settle_s, float measure_s, struct loopback_report *report) {
+    // Definitions:
+    size_t i;
+    int ret;
+    double sum_period = 0;
+    double sum_high = 0;
+    double exp_period;
+    double exp_high;
+    double *deviation;
+
+    struct loopback_periods periods;
+
+    memset(report, 0, sizeof(*report));
+    memset(&periods, 0, sizeof(periods));
+    report->freq = freq;
+    report->duty = duty;
+
+    // Drain edges of the previous configuration, keeping the pairing state
+    // so the period spanning the update is measured:
+    if ((ret = poll_edges(lb, &periods, 0, &report->overrun)) < 0) {
+        goto out;
+    }
+    periods.num = 0;
+
+    // Update output:
+    // Rejected configurations are reported rather than failing the run:
+    if (((report->error = set_pwm(lb->out_channel, &lb->out_gpio, 1, freq, \
+        duty)) < 0) || (!lb->configured && \
+        ((report->error = enable_pwm(lb->out_channel)) < 0))) {
+        goto out;
+    }
+
+    report->actual_freq = get_freq_pwm(lb->out_channel);
+    report->actual_duty = get_duty_cycle_pwm(lb->out_channel);
+    report->bus_load = get_bus_load_pwm(lb->out_channel);
+
+    // Settle while counting periods matching neither configuration:
+    if ((ret = poll_edges(lb, &periods, settle_s, &report->overrun)) < 0) {
+        goto out;
+    }
+
+    for (i = 0; i < periods.num; i++) {
+        if (matches(lb, periods.period[i], periods.high[i], \
+                report->actual_freq, report->actual_duty) || \
+            (lb->configured && matches(lb, periods.period[i], \
+                periods.high[i], lb->last_freq, lb->last_duty))) {
+            continue;
+        }
+
+        report->glitch_periods++;
+        report->glitch_us += periods.period[i] * (double)lb->tick_us;
+    }
+
+    lb->configured = 1;
+    lb->last_freq = report->actual_freq;
+    lb->last_duty = report->actual_duty;
+
+    // Measure:
+    periods.num = 0;
+    report->overrun = 0;
+
+    if ((ret = poll_edges(lb, &periods, measure_s, &report->overrun)) < 0) {
+        goto out;
+    }
+
+    if ((report->periods = periods.num) == 0) {
+        goto out;
+    }
+
+    exp_period = 1e6 / report->actual_freq / lb->tick_us;
+    exp_high = exp_period * report->actual_duty / 100;
+
+    for (i = 0; i < periods.num; i++) {
+        sum_period += periods.period[i];
+        sum_high += periods.high[i];
+
+        bin(report->period_hist, periods.period[i] - exp_period);
+        bin(report->high_hist, periods.high[i] - exp_high);
+    }
+
+    report->mean_period_us = sum_period / periods.num * lb->tick_us;
+    report->mean_freq = 1e6 / report->mean_period_us;
+    report->mean_duty = 100 * sum_high / sum_period;
+
+    // Jitter percentiles of absolute deviation from the mean period:
+    if ((deviation = malloc(periods.num * sizeof(double))) == NULL) {
+        ret = -1;
+        goto out;
+    }
+
+    for (i = 0; i < periods.num; i++) {
+        deviation[i] = fabs(periods.period[i] * (double)lb->tick_us - \
+            report->mean_period_us);
+    }
+
+    qsort(deviation, periods.num, sizeof(double), cmp_double);
+
+    report->jitter_p50_us = deviation[(size_t)(0.50 * (periods.num - 1))];
+    report->jitter_p90_us = deviation[(size_t)(0.90 * (periods.num - 1))];
+    report->jitter_p99_us = deviation[(size_t)(0.99 * (periods.num - 1))];
+    report->jitter_max_us = deviation[periods.num - 1];
+
+    free(deviation);
+
+out:
+    free(periods.period);
+    free(periods.high);
+
+    // Exit with library or allocation error:
+    return (ret < 0) ? ret : 0;
+}
+
+// Print a histogram as a JSON array:
+static void print_hist(FILE *stream, uint64_t *hist) {
+    // Definitions:
+    int i;
+
+    fprintf(stream, "[");
+
+    for (i = 0; i < LOOPBACK_HIST_BINS; i++) {
+        fprintf(stream, "%s%llu", i ? "," : "", (unsigned long long)hist[i]);
+    }
+
+    fprintf(stream, "]");
+}
+
+// Print a report as a single JSON line:
+// (extra members, if any, are printed first)
+void loopback_print(FILE *stream, struct loopback *lb, \
+    struct loopback_report *report, const char *extra) {
+    fprintf(stream, "{%s%s", extra ? extra : "", extra ? "," : "");
+    fprintf(stream, "\"out_gpio\":%d,\"in_gpio\":%d,\"tick_us\":%g,", \
+        lb->out_gpio, lb->in_gpio, lb->tick_us);
+    fprintf(stream, "\"freq\":%g,\"duty\":%g,", report->freq, report->duty);
+    fprintf(stream, "\"actual_freq\":%g,\"actual_duty\":%g,", \
+        report->actual_freq, report->actual_duty);
+    fprintf(stream, "\"bus_load\":%.0f,", report->bus_load);
+    fprintf(stream, "\"error\":%d,\"overrun\":%s,", report->error, \
+        report->overrun ? "true" : "false");
+    fprintf(stream, "\"periods\":%llu,\"mean_period_us\":%.3f,", \
+        (unsigned long long)report->periods, report->mean_period_us);
+    fprintf(stream, "\"mean_freq\":%.3f,\"mean_duty\":%.3f,", \
+        report->mean_freq, report->mean_duty);
+    fprintf(stream, "\"hist_min_ticks\":%d,\"period_hist\":", \
+        -LOOPBACK_HIST_HALF);
+    print_hist(stream, report->period_hist);
+    fprintf(stream, ",\"high_hist\":");
+    print_hist(stream, report->high_hist);
+    fprintf(stream, ",\"jitter_us\":{\"p50\":%.3f,\"p90\":%.3f,", \
+        report->jitter_p50_us, report->jitter_p90_us);
+    fprintf(stream, "\"p99\":%.3f,\"max\":%.3f},", report->jitter_p99_us, \
+        report->jitter_max_us);
+    fprintf(stream, "\"glitch_periods\":%llu,\"glitch_us\":%.3f}\n", \
+        (unsigned long long)report->glitch_periods, report->glitch_us);
+}
+
+// Free the output and capture channels:
+void loopback_close(struct loopback *lb) {
+    free_pwm(lb->out_channel);
+    free_pwm(lb->in_channel);
+}
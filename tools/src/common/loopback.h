@@ -0,0 +1,101 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+// Include C standard libraries:
+#include <stdio.h>  // C Standard I/O libary
+#include <stdint.h> // C Standard integer types library
+
+// Histogram bins of period and high time error in sample ticks, centred on
+// zero error with the outermost bins collecting everything beyond them:
+#define LOOPBACK_HIST_HALF 8
+#define LOOPBACK_HIST_BINS (2 * LOOPBACK_HIST_HALF + 1)
+
+// Loopback output and capture setup:
+struct loopback {
+    int out_gpio;    // BCM GPIO pin driven by the output channel
+    int in_gpio;     // BCM GPIO pin sampled by the capture channel
+    int out_channel; // Output channel
+    int in_channel;  // Capture channel
+    float tick_us;   // Capture sample tick in us
+
+    int configured;   // Output has been set at least once
+    float last_freq;  // Actual frequency of the previous configuration
+    float last_duty;  // Actual duty cycle of the previous configuration
+};
+
+// Measurement report of a single configuration:
+struct loopback_report {
+    float freq;        // Requested frequency in Hz
+    float duty;        // Requested duty cycle in percent
+    float actual_freq; // Frequency reported by the library in Hz
+    float actual_duty; // Duty cycle reported by the library in percent
+    float bus_load;    // Bus transfers per second of the output channel
+
+    uint64_t periods;      // Complete periods measured
+    double mean_period_us; // Mean measured period in us
+    double mean_freq;      // Mean measured frequency in Hz
+    double mean_duty;      // Mean measured duty cycle in percent
+
+    uint64_t period_hist[LOOPBACK_HIST_BINS]; // Period error histogram
+    uint64_t high_hist[LOOPBACK_HIST_BINS];   // High time error histogram
+
+    double jitter_p50_us; // Median absolute period deviation in us
+    double jitter_p90_us; // 90th percentile absolute period deviation in us
+    double jitter_p99_us; // 99th percentile absolute period deviation in us
+    double jitter_max_us; // Maximum absolute period deviation in us
+
+    uint64_t glitch_periods; // Periods matching neither configuration after
+                             // the update
+    double glitch_us;        // Duration of those periods in us
+
+    int overrun; // Capture samples were lost during the measurement
+    int error;   // Library error of the configuration (0 = none)
+};
+
+// Request and set up the output and capture channels:
+int loopback_open(struct loopback *lb, int out_gpio, int in_gpio, \
+    float window);
+
+// Apply a configuration and measure it:
+int loopback_run(struct loopback *lb, float freq, float duty, \
+    float settle_s, float measure_s, struct loopback_report *report);
+
+// Print a report as a single JSON line with optional extra members:
+void loopback_print(FILE *stream, struct loopback *lb, \
+    struct loopback_report *report, const char *extra);
+
+// Free the output and capture channels:
+void loopback_close(struct loopback *lb);
+
+#endif // !LOOPBACK_H
@@ -0,0 +1,704 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+#include <stdint.h> // C Standard integer types
+#include <string.h> // C Standard string manipulation libary
+
+// Include C POSIX libraries:
+#include <unistd.h> // Symbolic constants and types library
+
+// Include header files:
+#include "dma_pwm.h" // Library API and signal image layout
+
+// Maximum number of live signals and GPIOs per signal:
+#define MAX_SIGNALS 7
+#define MAX_GPIOS   64
+
+// Default VCD length in periods of the slowest signal:
+#define DEFAULT_PERIODS 2
+
+// Timing tolerance relative to the period planned by the library:
+#define TOLERANCE 1e-4
+
+// Transfer information flags of a control block:
+#define TI_INTEN          (1 << 0)  // Interrupt at end of transfer
+#define TI_TDMODE         (1 << 1)  // 2D mode
+#define TI_WAIT_RESP      (1 << 3)  // Wait for a write response
+#define TI_DEST_INC       (1 << 4)  // Increment destination address
+#define TI_DEST_WIDTH     (1 << 5)  // 128 bit destination writes
+#define TI_DEST_DREQ      (1 << 6)  // Destination paced by a DREQ
+#define TI_DEST_IGNORE    (1 << 7)  // Don't write
+#define TI_SRC_INC        (1 << 8)  // Increment source address
+#define TI_SRC_WIDTH      (1 << 9)  // 128 bit source reads
+#define TI_SRC_DREQ       (1 << 10) // Source paced by a DREQ
+#define TI_SRC_IGNORE     (1 << 11) // Don't read
+#define TI_PERMAP(ti)     (((ti) >> 16) & 0x1F) // Pacing peripheral
+#define TI_WAITS(ti)      (((ti) >> 21) & 0x1F) // Cycles after each write
+#define TI_NO_WIDE_BURSTS (1 << 26) // No 2 beat write bursts
+
+// Pacing peripheral of "wait" control blocks (PWM):
+#define PERMAP_PWM 5
+
+// Control block of a signal image program (BCM2835 layout):
+struct cb {
+    uint32_t info;   // TI
+    uint32_t src;    // SOURCE_AD
+    uint32_t dst;    // DEST_AD
+    uint32_t length; // TXFR_LEN
+    uint32_t stride; // 2D stride mode
+    uint32_t next;   // NEXTCONBK
+    uint32_t res[2]; // Reserved
+};
+
+// Level change of a signal:
+struct edge {
+    double time_us; // Time since the start of the loop
+    uint8_t level;  // Level after the change
+};
+
+// Analysed channel:
+struct analysis {
+    const struct image_pwm_channel *record; // Channel record
+    const struct cb *program;               // CB program
+    struct edge *edges;                     // Edges in one loop
+    size_t num_edges;                       // Number of edges
+    double period_us;                       // Loop duration
+    double high_us;                         // Time set in one loop
+    uint8_t idle_level;                     // Level before the first edge
+    int ok;                                 // Chain and timing verified
+};
+
+// Level change in the VCD trace:
+struct change {
+    uint64_t time_ns; // Time
+    int channel;      // Channel index
+    uint8_t level;    // Level after the change
+};
+
+// Print usage:
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [options] <image>\n", name);
+    fprintf(stderr, "       %s [options] -s <gpio[,gpio...]:freq:duty> "
+        "...\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -s <gpio[,gpio...]:freq:duty>: Build a signal with the "
+        "library and analyse it, repeatable\n");
+    fprintf(stderr, "  -w <us>: Pulse width of built signals (default %d)\n", \
+        DEFAULT_PULSE_WIDTH);
+    fprintf(stderr, "  -p <pages>: Pages per channel of built signals "
+        "(default %d)\n", DEFAULT_PAGES);
+    fprintf(stderr, "  -v: List every control block\n");
+    fprintf(stderr, "  -o <vcd>: Write a VCD trace of the GPIOs\n");
+    fprintf(stderr, "  -n <periods>: VCD length in periods of the slowest "
+        "signal (default %d)\n", DEFAULT_PERIODS);
+    fprintf(stderr, "Exits with 1 if a chain is not a well-formed loop or its "
+        "timing differs from what the library planned\n");
+}
+
+// Name a link address of a program:
+static const char *addr_name(uint32_t addr, char *buf, size_t len) {
+    if (addr == IMAGE_PWM_SET_ADDR) {
+        return "SET";
+    } else if (addr == IMAGE_PWM_CLEAR_ADDR) {
+        return "CLEAR";
+    }
+
+    snprintf(buf, len, "0x%08X", addr);
+
+    return buf;
+}
+
+// Print transfer information flags:
+static void print_ti(uint32_t ti) {
+    printf("TI 0x%08X (", ti);
+    printf("%s%s%s%s%s%s%s%s%s%s%s%s", \
+        (ti & TI_INTEN) ? " INTEN" : "", \
+        (ti & TI_TDMODE) ? " TDMODE" : "", \
+        (ti & TI_WAIT_RESP) ? " WAIT_RESP" : "", \
+        (ti & TI_DEST_INC) ? " DEST_INC" : "", \
+        (ti & TI_DEST_WIDTH) ? " DEST_WIDTH" : "", \
+        (ti & TI_DEST_DREQ) ? " DEST_DREQ" : "", \
+        (ti & TI_DEST_IGNORE) ? " DEST_IGNORE" : "", \
+        (ti & TI_SRC_INC) ? " SRC_INC" : "", \
+        (ti & TI_SRC_WIDTH) ? " SRC_WIDTH" : "", \
+        (ti & TI_SRC_DREQ) ? " SRC_DREQ" : "", \
+        (ti & TI_SRC_IGNORE) ? " SRC_IGNORE" : "", \
+        (ti & TI_NO_WIDE_BURSTS) ? " NO_WIDE_BURSTS" : "");
+
+    if (ti & (TI_DEST_DREQ | TI_SRC_DREQ)) {
+        printf(" PERMAP %u", TI_PERMAP(ti));
+    }
+
+    if (TI_WAITS(ti)) {
+        printf(" WAITS %u", TI_WAITS(ti));
+    }
+
+    printf(" )");
+}
+
+// Get the index of a control block linked to (-1 if dangling):
+static long cb_index(const struct analysis *a, uint32_t addr) {
+    if ((addr < IMAGE_PWM_CB_ADDR) || \
+        ((addr - IMAGE_PWM_CB_ADDR) % sizeof(struct cb)) || \
+        (((addr - IMAGE_PWM_CB_ADDR) / sizeof(struct cb)) >= \
+        a->record->num_cbs)) {
+        return -1;
+    }
+
+    return (addr - IMAGE_PWM_CB_ADDR) / sizeof(struct cb);
+}
+
+// Verify a channel's chain is a loop through every control block from the
+// first one, and time one loop:
+static void analyse(struct analysis *a, const struct image_pwm_header *header, \
+    int verbose) {
+    // Definitions:
+    size_t i;
+    long cur;
+    long next;
+    size_t steps;
+    double t_us = 0;
+    double tick_us;
+    double duration_us;
+    double words_us;
+    double fifo_us;
+    double queued_us;
+    double planned_us;
+    char src[16];
+    char dst[16];
+    uint8_t *visited;
+    const struct cb *cb;
+
+    a->ok = 1;
+    a->edges = calloc(a->record->num_cbs + 1, sizeof(struct edge));
+    a->num_edges = 0;
+    visited = calloc(a->record->num_cbs, 1);
+
+    // Each paced word written to the PWM FIFO spans two pulse widths, and
+    // the DMA runs ahead of the output by up to the DREQ threshold in words
+    // (thresholds are not saved, so the default is assumed):
+    tick_us = 2 * header->pulse_width;
+    fifo_us = DEFAULT_FIFO_THRESH * tick_us;
+    queued_us = fifo_us;
+
+    // Links (every control block must link within the program, the loop
+    // never ends):
+    for (i = 0; i < a->record->num_cbs; i++) {
+        cb = &a->program[i];
+
+        if (!(cb->next)) {
+            printf("  CB %zu ends the chain\n", i);
+            a->ok = 0;
+        } else if (cb_index(a, cb->next) < 0) {
+            printf("  CB %zu links to 0x%08X outside the program\n", i, \
+                cb->next);
+            a->ok = 0;
+        }
+
+        if ((cb->length == 0) || (cb->length % 4)) {
+            printf("  CB %zu transfers %u bytes\n", i, cb->length);
+            a->ok = 0;
+        }
+    }
+
+    if (!(a->ok)) {
+        free(visited);
+        return;
+    }
+
+    // Follow the chain from the first control block:
+    for (cur = 0, steps = 0; !(visited[cur]); cur = next, steps++) {
+        visited[cur] = 1;
+        cb = &a->program[cur];
+        next = cb_index(a, cb->next);
+
+        // "Wait" control blocks fill the FIFO at once and then wait for it
+        // to drain, others take the CB overhead while it drains:
+        if ((cb->info & TI_DEST_DREQ) && (TI_PERMAP(cb->info) == PERMAP_PWM)) {
+            words_us = (cb->length / 4) * tick_us;
+            duration_us = (words_us > (fifo_us - queued_us)) ? \
+                (words_us - (fifo_us - queued_us)) : 0;
+            queued_us = ((queued_us + words_us) > fifo_us) ? fifo_us : \
+                (queued_us + words_us);
+        } else {
+            duration_us = header->cb_overhead;
+            queued_us = (queued_us > duration_us) ? \
+                (queued_us - duration_us) : 0;
+        }
+
+        // GPIOs change as a mask is written:
+        if ((cb->src == IMAGE_PWM_SET_ADDR) || \
+            (cb->src == IMAGE_PWM_CLEAR_ADDR)) {
+            a->edges[a->num_edges].time_us = t_us;
+            a->edges[a->num_edges].level = (cb->src == IMAGE_PWM_SET_ADDR);
+            a->num_edges++;
+        }
+
+        if (verbose) {
+            printf("  [%4ld] ", cur);
+            print_ti(cb->info);
+            printf(" src %s dst %s len %u next [%ld] at %.3f us\n", \
+                addr_name(cb->src, src, sizeof(src)), \
+                addr_name(cb->dst, dst, sizeof(dst)), cb->length, next, \
+                t_us);
+        }
+
+        t_us += duration_us;
+    }
+
+    // Loop must return to the first control block through all of them:
+    if (cur != 0) {
+        printf("  Chain loops back to CB %ld instead of the first\n", cur);
+        a->ok = 0;
+    }
+
+    if (steps != a->record->num_cbs) {
+        printf("  %zu of %u CBs are unreachable\n", \
+            a->record->num_cbs - steps, a->record->num_cbs);
+        a->ok = 0;
+    }
+
+    free(visited);
+
+    // Time set in one loop (the level before the first edge is the last
+    // one of the loop):
+    a->period_us = t_us;
+    a->high_us = 0;
+    a->idle_level = a->num_edges ? a->edges[a->num_edges - 1].level : 0;
+
+    for (i = 0; i < a->num_edges; i++) {
+        if (a->edges[i].level) {
+            a->high_us += ((i + 1 < a->num_edges) ? \
+                a->edges[i + 1].time_us : t_us) - a->edges[i].time_us;
+        }
+    }
+
+    if (a->idle_level && a->num_edges) {
+        a->high_us += a->edges[0].time_us;
+    }
+
+    // Compare with what the library planned:
+    planned_us = 1e6 / a->record->freq_act;
+
+    if ((a->period_us <= 0) || \
+        ((a->period_us - planned_us) > (TOLERANCE * planned_us)) || \
+        ((planned_us - a->period_us) > (TOLERANCE * planned_us)) || \
+        (((100.0 * a->high_us / a->period_us) - a->record->duty_cycle_act) > \
+        (100.0 * TOLERANCE)) || \
+        ((a->record->duty_cycle_act - (100.0 * a->high_us / a->period_us)) > \
+        (100.0 * TOLERANCE))) {
+        printf("  Timing differs from planned %.3f Hz %.3f%%\n", \
+            a->record->freq_act, a->record->duty_cycle_act);
+        a->ok = 0;
+    }
+}
+
+// Print the report of an analysed channel:
+static void report(int index, const struct analysis *a) {
+    // Definitions:
+    size_t i;
+    int gpio;
+
+    printf("  GPIO");
+    for (gpio = 0; gpio < 64; gpio++) {
+        if ((a->record->mask >> gpio) & 1) {
+            printf(" %d", gpio);
+        }
+    }
+    printf("\n");
+
+    printf("  %u CBs%s, period %.3f us (%.3f Hz), high %.3f us "
+        "(%.3f%%)\n", a->record->num_cbs, \
+        a->record->compressed ? " (compressed)" : "", a->period_us, \
+        1e6 / a->period_us, a->high_us, 100.0 * a->high_us / a->period_us);
+
+    for (i = 0; i < a->num_edges; i++) {
+        // Only level changes are edges:
+        if (a->edges[i].level != \
+            (i ? a->edges[i - 1].level : a->idle_level)) {
+            printf("  %s at %.3f us\n", a->edges[i].level ? "Rise" : "Fall", \
+                a->edges[i].time_us);
+        }
+    }
+
+    printf("Signal %d: %s\n", index, a->ok ? "OK" : "FAILED");
+}
+
+// Order trace changes by time:
+static int compare_changes(const void *x, const void *y) {
+    const struct change *a = x;
+    const struct change *b = y;
+
+    return (a->time_ns > b->time_ns) - (a->time_ns < b->time_ns);
+}
+
+// Write a VCD trace of every GPIO:
+static int write_vcd(const char *path, struct analysis *a, size_t num, \
+    int periods) {
+    // Definitions:
+    size_t i;
+    size_t j;
+    size_t num_changes = 0;
+    size_t max_changes = 0;
+    int gpio;
+    double end_us = 0;
+    double loop_us;
+    uint64_t last_ns = (uint64_t)-1;
+
+    struct change *changes;
+
+    FILE *file;
+
+    // Trace length:
+    for (i = 0; i < num; i++) {
+        end_us = (a[i].period_us > end_us) ? a[i].period_us : end_us;
+    }
+
+    end_us *= periods;
+
+    for (i = 0; i < num; i++) {
+        max_changes += a[i].num_edges * \
+            ((size_t)(end_us / a[i].period_us) + 1);
+    }
+
+    changes = calloc(max_changes + 1, sizeof(struct change));
+
+    // Repeat each loop over the trace:
+    for (i = 0; i < num; i++) {
+        for (loop_us = 0; loop_us < end_us; loop_us += a[i].period_us) {
+            for (j = 0; (j < a[i].num_edges) && \
+                ((loop_us + a[i].edges[j].time_us) < end_us); j++) {
+                changes[num_changes].time_ns = \
+                    (loop_us + a[i].edges[j].time_us) * 1e3 + 0.5;
+                changes[num_changes].channel = i;
+                changes[num_changes].level = a[i].edges[j].level;
+                num_changes++;
+            }
+        }
+    }
+
+    qsort(changes, num_changes, sizeof(struct change), compare_changes);
+
+    if (!(file = fopen(path, "w"))) {
+        free(changes);
+        return -1;
+    }
+
+    // Header with one wire per GPIO (identifier '!' + GPIO):
+    fprintf(file, "$timescale 1 ns $end\n");
+    fprintf(file, "$scope module dma_pwm $end\n");
+
+    for (i = 0; i < num; i++) {
+        for (gpio = 0; gpio < 64; gpio++) {
+            if ((a[i].record->mask >> gpio) & 1) {
+                fprintf(file, "$var wire 1 %c gpio%d $end\n", '!' + gpio, \
+                    gpio);
+            }
+        }
+    }
+
+    fprintf(file, "$upscope $end\n$enddefinitions $end\n");
+
+    // Levels before the first edges:
+    fprintf(file, "$dumpvars\n");
+
+    for (i = 0; i < num; i++) {
+        for (gpio = 0; gpio < 64; gpio++) {
+            if ((a[i].record->mask >> gpio) & 1) {
+                fprintf(file, "%d%c\n", a[i].idle_level, '!' + gpio);
+            }
+        }
+    }
+
+    fprintf(file, "$end\n");
+
+    // Changes:
+    for (i = 0; i < num_changes; i++) {
+        if (changes[i].time_ns != last_ns) {
+            fprintf(file, "#%llu\n", (unsigned long long)changes[i].time_ns);
+            last_ns = changes[i].time_ns;
+        }
+
+        for (gpio = 0; gpio < 64; gpio++) {
+            if ((a[changes[i].channel].record->mask >> gpio) & 1) {
+                fprintf(file, "%d%c\n", changes[i].level, '!' + gpio);
+            }
+        }
+    }
+
+    fprintf(file, "#%llu\n", (unsigned long long)(end_us * 1e3 + 0.5));
+
+    free(changes);
+
+    return (fclose(file) == 0) ? 0 : -1;
+}
+
+// Build signals with the library and save them to an image:
+static int build(char **specs, int num_specs, int pages, float pulse_width, \
+    const char *path) {
+    // Definitions:
+    int i;
+    int ret = 0;
+    int num_gpio;
+    int gpio[MAX_GPIOS];
+    int channels[MAX_SIGNALS];
+    char gpios[128];
+    char *token;
+    float freq;
+    float duty;
+
+    if ((ret = config_pwm(pages, pulse_width)) < 0) {
+        fprintf(stderr, "Could not configure dma_pwm.c (%d)\n", ret);
+        return -1;
+    }
+
+    for (i = 0; i < num_specs; i++) {
+        if (sscanf(specs[i], "%127[0-9,]:%f:%f", gpios, &freq, &duty) != 3) {
+            fprintf(stderr, "Invalid signal %s\n", specs[i]);
+            ret = -1;
+            break;
+        }
+
+        for (num_gpio = 0, token = strtok(gpios, ","); token && \
+            (num_gpio < MAX_GPIOS); token = strtok(NULL, ",")) {
+            gpio[num_gpio++] = atoi(token);
+        }
+
+        if ((channels[i] = request_pwm()) < 0) {
+            fprintf(stderr, "Could not request channel (%d)\n", channels[i]);
+            ret = -1;
+            break;
+        }
+
+        if ((ret = set_pwm(channels[i], gpio, num_gpio, freq, duty)) < 0) {
+            fprintf(stderr, "Could not set signal %s (%d)\n", specs[i], ret);
+            i++;
+            break;
+        }
+    }
+
+    if ((ret >= 0) && ((ret = save_image_pwm(path, channels, i)) < 0)) {
+        fprintf(stderr, "Could not save signals (%d)\n", ret);
+    }
+
+    while (i-- > 0) {
+        free_pwm(channels[i]);
+    }
+
+    return (ret < 0) ? -1 : 0;
+}
+
+// Read a signal image:
+// (returns its size, 0 on error)
+static size_t read_image(const char *path, uint8_t **image) {
+    // Definitions:
+    long size;
+    size_t i;
+
+    const struct image_pwm_header *header;
+    const struct image_pwm_channel *record;
+
+    FILE *file;
+
+    if (!(file = fopen(path, "rb"))) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+
+    *image = malloc((size > 0) ? size : 1);
+
+    if ((size < (long)sizeof(*header)) || \
+        (fread(*image, 1, size, file) != (size_t)size)) {
+        fprintf(stderr, "Could not read %s\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    fclose(file);
+
+    // Check layout:
+    header = (const struct image_pwm_header*)*image;
+    record = (const struct image_pwm_channel*)(header + 1);
+
+    if (memcmp(header->magic, IMAGE_PWM_MAGIC, sizeof(header->magic)) || \
+        (header->version != IMAGE_PWM_VERSION) || \
+        ((size - sizeof(*header)) / sizeof(*record) < \
+        header->num_channels)) {
+        fprintf(stderr, "%s is not a signal image\n", path);
+        return 0;
+    }
+
+    for (i = 0; i < header->num_channels; i++) {
+        if ((record[i].offset > size) || (record[i].num_cbs == 0) || \
+            (record[i].offset % sizeof(struct cb)) || \
+            (record[i].num_cbs > (size - record[i].offset) / \
+            sizeof(struct cb))) {
+            fprintf(stderr, "Signal %zu of %s is truncated\n", i, path);
+            return 0;
+        }
+    }
+
+    return size;
+}
+
+// Analyse the CB chains of a signal image:
+int main(int argc, char **argv) {
+    // Definitions:
+    int opt;
+    int ok = 1;
+    int verbose = 0;
+    int periods = DEFAULT_PERIODS;
+    int pages = DEFAULT_PAGES;
+    int num_specs = 0;
+    int fd;
+    size_t i;
+    float pulse_width = DEFAULT_PULSE_WIDTH;
+    char *specs[MAX_SIGNALS];
+    char path[] = "/tmp/dma_pwm_analyze_XXXXXX";
+    const char *image_path = NULL;
+    const char *vcd = NULL;
+    uint8_t *image = NULL;
+
+    const struct image_pwm_header *header;
+    const struct image_pwm_channel *record;
+    struct analysis *analyses;
+
+    // Parse options:
+    while ((opt = getopt(argc, argv, "s:w:p:vo:n:h")) != -1) {
+        switch (opt) {
+        case 's':
+            if (num_specs < MAX_SIGNALS) {
+                specs[num_specs++] = optarg;
+            }
+            break;
+        case 'w':
+            pulse_width = atof(optarg);
+            break;
+        case 'p':
+            pages = atoi(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'o':
+            vcd = optarg;
+            break;
+        case 'n':
+            periods = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    if (num_specs && (optind == argc)) {
+        // Save built signals to a temporary image:
+        if ((fd = mkstemp(path)) < 0) {
+            fprintf(stderr, "Could not create %s\n", path);
+            return -1;
+        }
+
+        close(fd);
+
+        if (build(specs, num_specs, pages, pulse_width, path) < 0) {
+            unlink(path);
+            return -1;
+        }
+
+        image_path = path;
+    } else if (!(num_specs) && (optind == (argc - 1))) {
+        image_path = argv[optind];
+    }
+
+    if (!(image_path) || (periods < 1)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (!(read_image(image_path, &image))) {
+        free(image);
+        return -1;
+    }
+
+    if (image_path == path) {
+        unlink(path);
+    }
+
+    // Report each signal:
+    header = (const struct image_pwm_header*)image;
+    record = (const struct image_pwm_channel*)(header + 1);
+    analyses = calloc(header->num_channels + 1, sizeof(struct analysis));
+
+    printf("Pi %u, %u pages, pulse width %.3f us, CB overhead %.3f us\n", \
+        header->pi_version, header->pages, header->pulse_width, \
+        header->cb_overhead);
+
+    for (i = 0; i < header->num_channels; i++) {
+        printf("Signal %zu: %.3f Hz %.3f%% planned as %.3f Hz %.3f%%\n", i, \
+            record[i].freq, record[i].duty_cycle, record[i].freq_act, \
+            record[i].duty_cycle_act);
+
+        analyses[i].record = &record[i];
+        analyses[i].program = (const struct cb*)(image + record[i].offset);
+        analyse(&analyses[i], header, verbose);
+
+        if (analyses[i].ok || analyses[i].period_us > 0) {
+            report(i, &analyses[i]);
+        } else {
+            printf("Signal %zu: FAILED\n", i);
+        }
+
+        ok &= analyses[i].ok;
+    }
+
+    // Trace:
+    if (vcd && ok && (write_vcd(vcd, analyses, header->num_channels, \
+        periods) < 0)) {
+        fprintf(stderr, "Could not write %s\n", vcd);
+        ok = 0;
+    }
+
+    for (i = 0; i < header->num_channels; i++) {
+        free(analyses[i].edges);
+    }
+
+    free(analyses);
+    free(image);
+
+    return ok ? 0 : 1;
+}
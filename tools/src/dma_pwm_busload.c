@@ -0,0 +1,287 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+#include <string.h> // C Standard string manipulation libary
+
+// Include C POSIX libraries:
+#include <unistd.h>  // Symbolic constants and types library
+#include <pthread.h> // POSIX threads
+
+// Include header files:
+#include "dma_pwm.h"  // Library API
+#include "loopback.h" // Loopback measurement
+
+// Maximum number of bus settings and load threads in one run:
+#define MAX_SETTINGS 16
+#define MAX_THREADS  64
+
+// Synthetic memory bus load:
+static volatile int load_running; // Load threads keep copying while set
+static size_t load_bytes;         // Bytes copied per pass by each thread
+
+// Copy between two buffers larger than the caches until stopped:
+static void *load_thread(void *arg) {
+    // Definitions:
+    char *src;
+    char *dst;
+
+    (void)arg;
+
+    src = malloc(load_bytes);
+    dst = malloc(load_bytes);
+
+    if ((src != NULL) && (dst != NULL)) {
+        memset(src, 0x5A, load_bytes);
+
+        while (load_running) {
+            memcpy(dst, src, load_bytes);
+            memcpy(src, dst, load_bytes);
+        }
+    }
+
+    free(src);
+    free(dst);
+
+    return NULL;
+}
+
+// Print usage:
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o <gpio>: Output GPIO (default 26)\n");
+    fprintf(stderr, "  -i <gpio>: Capture GPIO, jumpered to the output or "
+        "equal to it (default 19)\n");
+    fprintf(stderr, "  -w <us>: Pulse width (default %d)\n", \
+        DEFAULT_PULSE_WIDTH);
+    fprintf(stderr, "  -p <pages>: Pages per channel (default %d)\n", \
+        DEFAULT_PAGES);
+    fprintf(stderr, "  -s <s>: Settle time after each update (default 0.2)\n");
+    fprintf(stderr, "  -m <s>: Measurement time (default 2)\n");
+    fprintf(stderr, "  -c <freq:duty>: Configuration to measure "
+        "(default 1000:50)\n");
+    fprintf(stderr, "  -t <threads>: Load threads (default online CPUs)\n");
+    fprintf(stderr, "  -l <MiB>: Buffer size per load thread (default 16)\n");
+    fprintf(stderr, "  -P <prio:panic[:wide[:wait]]>: Output channel bus "
+        "settings, repeatable (default %d:%d:0:1)\n", DEFAULT_DMA_PRIO, \
+        DEFAULT_DMA_PRIO);
+    fprintf(stderr, "  -f <dreq:panic>: PWM FIFO thresholds (default %d:%d)\n", \
+        DEFAULT_FIFO_THRESH, DEFAULT_FIFO_THRESH);
+    fprintf(stderr, "Each setting is measured idle and under load; one JSON "
+        "report is printed per measurement\n");
+}
+
+// Jitter under synthetic memory bus load for each bus setting:
+int main(int argc, char **argv) {
+    // Definitions:
+    int opt;
+    int ret = 0;
+    int i;
+    int j;
+    int k;
+    int out_gpio = 26;
+    int in_gpio = 19;
+    int pages = DEFAULT_PAGES;
+    int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_settings = 0;
+    int fifo_dreq = 0;
+    int fifo_panic = 0;
+    int wide;
+    int wait;
+    float pulse_width = DEFAULT_PULSE_WIDTH;
+    float settle_s = 0.2;
+    float measure_s = 2;
+    float freq = 1000;
+    float duty = 50;
+    char extra[256];
+
+    struct bus_pwm bus[MAX_SETTINGS];
+    struct bus_pwm capture_bus = {.prio = 15, .panic_prio = 15, \
+        .wide_bursts = 0, .wait_resp = 1};
+    struct loopback lb;
+    struct loopback_report report;
+    pthread_t threads[MAX_THREADS];
+
+    load_bytes = 16 << 20;
+
+    // Parse options:
+    while ((opt = getopt(argc, argv, "o:i:w:p:s:m:c:t:l:P:f:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_gpio = atoi(optarg);
+            break;
+        case 'i':
+            in_gpio = atoi(optarg);
+            break;
+        case 'w':
+            pulse_width = atof(optarg);
+            break;
+        case 'p':
+            pages = atoi(optarg);
+            break;
+        case 's':
+            settle_s = atof(optarg);
+            break;
+        case 'm':
+            measure_s = atof(optarg);
+            break;
+        case 'c':
+            if (sscanf(optarg, "%f:%f", &freq, &duty) != 2) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 't':
+            num_threads = atoi(optarg);
+            break;
+        case 'l':
+            load_bytes = (size_t)atoi(optarg) << 20;
+            break;
+        case 'P':
+            wide = 0;
+            wait = 1;
+            if ((num_settings == MAX_SETTINGS) || (sscanf(optarg, \
+                "%hhu:%hhu:%d:%d", &bus[num_settings].prio, \
+                &bus[num_settings].panic_prio, &wide, &wait) < 2)) {
+                usage(argv[0]);
+                return -1;
+            }
+            bus[num_settings].wide_bursts = wide;
+            bus[num_settings].wait_resp = wait;
+            num_settings++;
+            break;
+        case 'f':
+            if (sscanf(optarg, "%d:%d", &fifo_dreq, &fifo_panic) != 2) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    // Default setting:
+    if (num_settings == 0) {
+        bus[0].prio = DEFAULT_DMA_PRIO;
+        bus[0].panic_prio = DEFAULT_DMA_PRIO;
+        bus[0].wide_bursts = 0;
+        bus[0].wait_resp = 1;
+        num_settings = 1;
+    }
+
+    // Bound load threads:
+    num_threads = (num_threads < 1) ? 1 : num_threads;
+    num_threads = (num_threads > MAX_THREADS) ? MAX_THREADS : num_threads;
+
+    // Configure:
+    if (config_pwm(pages, pulse_width) != 0) {
+        fprintf(stderr, "Could not configure dma_pwm.c\n");
+
+        // Exit with error:
+        return -1;
+    }
+
+    if ((fifo_dreq > 0) && ((ret = set_fifo_pwm(fifo_dreq, \
+        fifo_panic)) < 0)) {
+        fprintf(stderr, "Could not set FIFO thresholds (%d)\n", ret);
+
+        // Exit with error:
+        return -1;
+    }
+
+    if ((ret = loopback_open(&lb, out_gpio, in_gpio, \
+        DEFAULT_CAPTURE_WINDOW)) < 0) {
+        fprintf(stderr, "Could not set up loopback (%d)\n", ret);
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Sample at the highest priority so the output is what is measured,
+    // restarting capture to apply it:
+    set_bus_pwm(lb.in_channel, &capture_bus);
+    set_capture_pwm(lb.in_channel, &lb.in_gpio, 1, DEFAULT_CAPTURE_WINDOW);
+    enable_pwm(lb.in_channel);
+
+    for (i = 0; (i < num_settings) && (ret == 0); i++) {
+        if ((ret = set_bus_pwm(lb.out_channel, &bus[i])) < 0) {
+            fprintf(stderr, "Invalid bus setting (%d)\n", ret);
+            break;
+        }
+
+        // Measure idle, then loaded:
+        for (j = 0; j < 2; j++) {
+            k = 0;
+
+            if (j) {
+                load_running = 1;
+                for (k = 0; k < num_threads; k++) {
+                    if (pthread_create(&threads[k], NULL, load_thread, \
+                        NULL) != 0) {
+                        break;
+                    }
+                }
+            }
+
+            // Applying the configuration restarts the output with the
+            // channel's bus setting:
+            ret = loopback_run(&lb, freq, duty, settle_s, measure_s, &report);
+
+            load_running = 0;
+            while (k > 0) {
+                pthread_join(threads[--k], NULL);
+            }
+
+            if (ret < 0) {
+                fprintf(stderr, "Measurement failed (%d)\n", ret);
+                break;
+            }
+
+            snprintf(extra, sizeof(extra), "\"prio\":%d,\"panic_prio\":%d," \
+                "\"wide_bursts\":%d,\"wait_resp\":%d,\"load_threads\":%d," \
+                "\"load_mib\":%zu", bus[i].prio, bus[i].panic_prio, \
+                bus[i].wide_bursts, bus[i].wait_resp, j ? num_threads : 0, \
+                load_bytes >> 20);
+            loopback_print(stdout, &lb, &report, extra);
+            fflush(stdout);
+        }
+    }
+
+    loopback_close(&lb);
+
+    // Exit:
+    return (ret < 0) ? -1 : 0;
+}
@@ -0,0 +1,275 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+#include <string.h> // C Standard string manipulation libary
+
+// Include C POSIX libraries:
+#include <unistd.h> // Symbolic constants and types library
+#include <time.h>   // Clocks
+
+// Include header files:
+#include "dma_pwm.h" // Library API
+
+// Maximum number of signals and GPIOs per signal in a description:
+#define MAX_SIGNALS 7
+#define MAX_GPIOS   64
+
+// Maximum length of a description line:
+#define MAX_LINE 256
+
+// Signal of a description:
+struct signal {
+    int gpio[MAX_GPIOS]; // BCM GPIO pins
+    size_t num_gpio;     // Number of pins
+    float freq;          // Frequency in Hz
+    float duty_cycle;    // Duty cycle in percent
+};
+
+// Get monotonic time in seconds:
+static double now_s(void) {
+    // Definitions:
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+// Print usage:
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s -o <image> <description>\n", name);
+    fprintf(stderr, "       %s -l <image> [-t <s>]\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o <image>: Compile the description into an image\n");
+    fprintf(stderr, "  -l <image>: Start the signals of an image\n");
+    fprintf(stderr, "  -t <s>: Output time after loading (default until "
+        "interrupted)\n");
+    fprintf(stderr, "Description lines (# starts a comment):\n");
+    fprintf(stderr, "  pages <pages>: Pages per channel (default %d)\n", \
+        DEFAULT_PAGES);
+    fprintf(stderr, "  pulse_width <us>: Pulse width (default %d)\n", \
+        DEFAULT_PULSE_WIDTH);
+    fprintf(stderr, "  signal <gpio>[,<gpio>...] <freq> <duty>: Signal on a "
+        "channel of its own, repeatable\n");
+}
+
+// Parse a signal description:
+// (returns the number of signals, -1 on error)
+static int parse(const char *path, int *pages, float *pulse_width, \
+    struct signal *signals) {
+    // Definitions:
+    int num_signals = 0;
+    int line_num = 0;
+    char line[MAX_LINE];
+    char *token;
+    char *key;
+    char *gpios;
+    char *freq;
+    char *duty;
+
+    FILE *file;
+
+    if (!(file = fopen(path, "r"))) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        line_num++;
+
+        // Strip comment:
+        if ((token = strchr(line, '#'))) {
+            *token = '\0';
+        }
+
+        if (!(key = strtok(line, " \t\r\n"))) {
+            continue;
+        }
+
+        if (!strcmp(key, "pages") && (token = strtok(NULL, " \t\r\n"))) {
+            *pages = atoi(token);
+        } else if (!strcmp(key, "pulse_width") && \
+            (token = strtok(NULL, " \t\r\n"))) {
+            *pulse_width = atof(token);
+        } else if (!strcmp(key, "signal") && (num_signals < MAX_SIGNALS) && \
+            (gpios = strtok(NULL, " \t\r\n")) && \
+            (freq = strtok(NULL, " \t\r\n")) && \
+            (duty = strtok(NULL, " \t\r\n"))) {
+            signals[num_signals].freq = atof(freq);
+            signals[num_signals].duty_cycle = atof(duty);
+            signals[num_signals].num_gpio = 0;
+
+            for (token = strtok(gpios, ","); token && \
+                (signals[num_signals].num_gpio < MAX_GPIOS); \
+                token = strtok(NULL, ",")) {
+                signals[num_signals].gpio[signals[num_signals].num_gpio++] = \
+                    atoi(token);
+            }
+
+            num_signals++;
+        } else {
+            fprintf(stderr, "%s:%d: invalid line\n", path, line_num);
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+
+    return num_signals;
+}
+
+// Compile a signal description into an image:
+static int compile(const char *path, const char *image) {
+    // Definitions:
+    int i;
+    int ret;
+    int num_signals;
+    int pages = DEFAULT_PAGES;
+    int channels[MAX_SIGNALS];
+    float pulse_width = DEFAULT_PULSE_WIDTH;
+
+    struct signal signals[MAX_SIGNALS];
+
+    if ((num_signals = parse(path, &pages, &pulse_width, signals)) < 0) {
+        return -1;
+    }
+
+    if ((ret = config_pwm(pages, pulse_width)) < 0) {
+        fprintf(stderr, "Could not configure dma_pwm.c (%d)\n", ret);
+        return -1;
+    }
+
+    // Plan and build each signal on a channel of its own:
+    for (i = 0; i < num_signals; i++) {
+        if ((channels[i] = request_pwm()) < 0) {
+            fprintf(stderr, "Could not request channel (%d)\n", channels[i]);
+            ret = channels[i];
+            break;
+        }
+
+        if ((ret = set_pwm(channels[i], signals[i].gpio, \
+            signals[i].num_gpio, signals[i].freq, \
+            signals[i].duty_cycle)) < 0) {
+            fprintf(stderr, "Could not set signal %d (%d)\n", i, ret);
+            i++;
+            break;
+        }
+
+        printf("{\"signal\": %d, \"freq\": %.3f, \"duty\": %.3f, "
+            "\"actual_freq\": %.3f, \"actual_duty\": %.3f}\n", i, \
+            signals[i].freq, signals[i].duty_cycle, \
+            get_freq_pwm(channels[i]), get_duty_cycle_pwm(channels[i]));
+    }
+
+    if ((ret >= 0) && \
+        ((ret = save_image_pwm(image, channels, num_signals)) < 0)) {
+        fprintf(stderr, "Could not save %s (%d)\n", image, ret);
+    }
+
+    while (i-- > 0) {
+        free_pwm(channels[i]);
+    }
+
+    return (ret < 0) ? -1 : 0;
+}
+
+// Start the signals of an image:
+static int load(const char *image, float hold_s) {
+    // Definitions:
+    int i;
+    int ret;
+    int channels[MAX_SIGNALS];
+    double start;
+
+    start = now_s();
+
+    if ((ret = load_image_pwm(image, channels, MAX_SIGNALS)) < 0) {
+        fprintf(stderr, "Could not load %s (%d)\n", image, ret);
+        return -1;
+    }
+
+    printf("{\"channels\": %d, \"load_us\": %.1f}\n", ret, \
+        (now_s() - start) * 1e6);
+    fflush(stdout);
+
+    // Output (the library's signal handler frees the channels if
+    // interrupted):
+    if (hold_s > 0) {
+        usleep(hold_s * 1e6);
+    } else {
+        pause();
+    }
+
+    for (i = 0; i < ret; i++) {
+        free_pwm(channels[i]);
+    }
+
+    return 0;
+}
+
+// Compile a signal description or start an image:
+int main(int argc, char **argv) {
+    // Definitions:
+    int opt;
+    float hold_s = 0;
+    const char *out = NULL;
+    const char *in = NULL;
+
+    // Parse options:
+    while ((opt = getopt(argc, argv, "o:l:t:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            out = optarg;
+            break;
+        case 'l':
+            in = optarg;
+            break;
+        case 't':
+            hold_s = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    if (out && !in && (optind == (argc - 1))) {
+        return compile(argv[optind], out);
+    } else if (in && !out && (optind == argc)) {
+        return load(in, hold_s);
+    }
+
+    usage(argv[0]);
+    return -1;
+}
@@ -0,0 +1,171 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+//  - Richard Hirst's ServoBlaster
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+
+// Include C POSIX libraries:
+#include <unistd.h> // Symbolic constants and types library
+
+// Include header files:
+#include "dma_pwm.h"  // Library API
+#include "loopback.h" // Loopback measurement
+
+// Maximum number of configurations measured in one run:
+#define MAX_CONFIGS 64
+
+// Print usage:
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o <gpio>: Output GPIO (default 26)\n");
+    fprintf(stderr, "  -i <gpio>: Capture GPIO, jumpered to the output or "
+        "equal to it (default 19)\n");
+    fprintf(stderr, "  -w <us>: Pulse width (default %d)\n", \
+        DEFAULT_PULSE_WIDTH);
+    fprintf(stderr, "  -p <pages>: Pages per channel (default %d)\n", \
+        DEFAULT_PAGES);
+    fprintf(stderr, "  -s <s>: Settle time after each update (default 0.2)\n");
+    fprintf(stderr, "  -m <s>: Measurement time (default 1)\n");
+    fprintf(stderr, "  -c <freq:duty>: Configuration to measure, repeatable "
+        "(default 1000:50)\n");
+    fprintf(stderr, "  -b <transfers/s>: Bus transfer budget (default "
+        "unlimited)\n");
+    fprintf(stderr, "One JSON report is printed per configuration\n");
+}
+
+// Loopback jitter and accuracy measurement:
+int main(int argc, char **argv) {
+    // Definitions:
+    int opt;
+    int ret;
+    int i;
+    int out_gpio = 26;
+    int in_gpio = 19;
+    int pages = DEFAULT_PAGES;
+    int num_configs = 0;
+    float pulse_width = DEFAULT_PULSE_WIDTH;
+    float settle_s = 0.2;
+    float measure_s = 1;
+    float budget = 0;
+    float freq[MAX_CONFIGS];
+    float duty[MAX_CONFIGS];
+
+    struct loopback lb;
+    struct loopback_report report;
+
+    // Parse options:
+    while ((opt = getopt(argc, argv, "o:i:w:p:s:m:c:b:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_gpio = atoi(optarg);
+            break;
+        case 'i':
+            in_gpio = atoi(optarg);
+            break;
+        case 'w':
+            pulse_width = atof(optarg);
+            break;
+        case 'p':
+            pages = atoi(optarg);
+            break;
+        case 's':
+            settle_s = atof(optarg);
+            break;
+        case 'm':
+            measure_s = atof(optarg);
+            break;
+        case 'c':
+            if ((num_configs == MAX_CONFIGS) || (sscanf(optarg, "%f:%f", \
+                &freq[num_configs], &duty[num_configs]) != 2)) {
+                usage(argv[0]);
+                return -1;
+            }
+            num_configs++;
+            break;
+        case 'b':
+            budget = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    // Default configuration:
+    if (num_configs == 0) {
+        freq[0] = 1000;
+        duty[0] = 50;
+        num_configs = 1;
+    }
+
+    // Configure:
+    if (config_pwm(pages, pulse_width) != 0) {
+        fprintf(stderr, "Could not configure dma_pwm.c\n");
+
+        // Exit with error:
+        return -1;
+    }
+
+    if ((ret = set_bus_budget_pwm(budget)) < 0) {
+        fprintf(stderr, "Could not set bus budget (%d)\n", ret);
+
+        // Exit with error:
+        return -1;
+    }
+
+    if ((ret = loopback_open(&lb, out_gpio, in_gpio, \
+        DEFAULT_CAPTURE_WINDOW)) < 0) {
+        fprintf(stderr, "Could not set up loopback (%d)\n", ret);
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Measure each configuration in order, so update glitches are measured
+    // from the previous one:
+    for (i = 0; i < num_configs; i++) {
+        if ((ret = loopback_run(&lb, freq[i], duty[i], settle_s, measure_s, \
+            &report)) < 0) {
+            fprintf(stderr, "Measurement failed (%d)\n", ret);
+            break;
+        }
+
+        loopback_print(stdout, &lb, &report, NULL);
+        fflush(stdout);
+    }
+
+    loopback_close(&lb);
+
+    // Exit:
+    return (ret < 0) ? -1 : 0;
+}
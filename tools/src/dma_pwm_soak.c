@@ -0,0 +1,742 @@
+// DMA PWM: Direct Memory Access (DMA) PWM for the Raspberry Pi
+//     ___     ___     __                  __                ___     ___
+//    |   |   |   |   |  \  |\/|  /\      |__) |  |  |\/|   |   |   |   |
+//    |   |   |   |   |__/  |  | /~~\ ___ |    |/\|  |  |   |   |   |   |
+//  __|   |___|   |_________________________________________|   |___|   |__
+//
+// Copyright (c) 2020 Benjamin Spencer
+// ============================================================================
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+// ============================================================================
+//
+// Acknowledgements:
+//  - Chris Hager's RPIO
+
+// Include C standard libraries:
+#include <stdlib.h> // C Standard library
+#include <stdio.h>  // C Standard I/O libary
+#include <stdint.h> // C Standard integer types
+#include <string.h> // C Standard string manipulation libary
+#include <errno.h>  // C Standard for error conditions
+#include <math.h>   // C Standard math library
+#include <time.h>   // C Standard get and manipulate time library
+
+// Include C POSIX libraries:
+#include <unistd.h>  // Symbolic constants and types library
+#include <pthread.h> // POSIX threads
+
+// Include header files:
+#include "dma_pwm.h"  // Library API
+#include "loopback.h" // Loopback measurement
+
+// Maximum number of stress threads (every other channel is used for the
+// monitored output and its capture):
+#define MAX_STRESS 5
+
+// Maximum number of stress GPIOs:
+#define MAX_GPIOS 16
+
+// Monitored configurations kept to match periods against:
+#define NUM_CONFIGS 1024
+
+// Latency samples kept (reservoir sampled beyond):
+#define NUM_SAMPLES 100000
+
+// Pages per channel (the capture ring then spans the longest library calls
+// holding the lock):
+#define SOAK_PAGES 64
+
+// Edges read per capture poll:
+#define READ_EDGES 256
+
+// Capture poll interval in ns:
+#define POLL_NS 1000000
+
+// Tolerance in sample ticks for a period to match a configuration, plus a
+// fraction of the period for the error of the calibrated sample tick:
+#define MATCH_TICKS 1.5
+#define MATCH_ERROR 0.02
+
+// Periods without an edge before the monitored output counts as stuck:
+#define STUCK_PERIODS 4
+
+// Frequencies of the monitored output (whole numbers of "wait" CBs at the
+// preset pulse widths):
+static const float monitor_freqs[] = {250, 500, 1000, 2000};
+
+// Monitored output configuration:
+struct config {
+    double start_us;  // Time it was set in us since the start of the run
+    double period_us; // Actual period in us
+    double high_us;   // Actual high time in us
+};
+
+// Soak state shared by all threads (library calls are serialized, the
+// library is not thread safe):
+struct soak {
+    pthread_mutex_t lock; // Library and state lock
+    volatile int running; // Threads keep going
+
+    struct timespec start; // Start of the run
+
+    // Operations:
+    uint64_t sets;     // Successful set_pwm() calls
+    uint64_t enables;  // Successful enable_pwm() calls
+    uint64_t disables; // Successful disable_pwm() calls
+    uint64_t requests; // Successful request_pwm() calls
+    uint64_t frees;    // Successful free_pwm() calls
+    uint64_t rejected; // Calls refused for lack of resources or state
+    uint64_t errors;   // Unexpected errors
+
+    // set_pwm() latency samples:
+    double samples[NUM_SAMPLES];
+    uint64_t num_samples;
+    unsigned int sample_seed;
+
+    // Monitored output:
+    struct loopback lb;                 // Output and capture channels
+    struct config configs[NUM_CONFIGS]; // Ring of configurations
+    uint64_t num_configs;               // Configurations set
+
+    // Glitches:
+    uint64_t periods; // Complete periods checked
+    uint64_t runts;   // High or low time shorter than any configuration
+    uint64_t missed;  // Period longer than any configuration
+    uint64_t stuck;   // No edges for several periods
+    uint64_t other;   // Period matching no configuration otherwise
+    uint64_t overrun; // Polls that lost capture samples
+};
+
+// Stress thread:
+struct stress {
+    struct soak *soak;   // Shared state
+    int gpio[MAX_GPIOS]; // GPIOs to output on
+    int num_gpio;        // Number of GPIOs
+    float rate;          // Operations per second (0 = unlimited)
+    unsigned int seed;   // Random seed
+};
+
+// Get seconds elapsed since a start time:
+static double elapsed_s(struct timespec *start) {
+    // Definitions:
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + \
+        (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Sleep to keep an operation rate:
+static void pace(float rate, double *next_s, struct timespec *start) {
+    // Definitions:
+    double wait_s;
+    struct timespec ts;
+
+    if (rate <= 0) {
+        return;
+    }
+
+    *next_s += 1.0 / rate;
+
+    // Do not catch up in a burst after waiting for the lock:
+    if ((wait_s = *next_s - elapsed_s(start)) < 0) {
+        *next_s -= wait_s;
+    } else {
+        ts.tv_sec = (time_t)wait_s;
+        ts.tv_nsec = (wait_s - ts.tv_sec) * 1e9;
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Count the result of a library call:
+static void count(struct soak *soak, int ret, uint64_t *ok) {
+    if (ret >= 0) {
+        (*ok)++;
+    } else if ((ret == -EFREQNOTMET) || (ret == -ENOMEM) || \
+        (ret == -EBUSBUDGET) || (ret == -ENOFREECHNL) || \
+        (ret == -EFIFOBUSY) || (ret == -EPWMNOTSET)) {
+        soak->rejected++;
+    } else {
+        soak->errors++;
+    }
+}
+
+// Set a signal, sampling its latency (lock held):
+static int timed_set(struct soak *soak, int channel, int *gpio, \
+    size_t num_gpio, float freq, float duty) {
+    // Definitions:
+    int ret;
+    uint64_t slot;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = set_pwm(channel, gpio, num_gpio, freq, duty);
+
+    // Keep a uniform sample of all latencies:
+    slot = (soak->num_samples < NUM_SAMPLES) ? soak->num_samples : \
+        ((uint64_t)rand_r(&soak->sample_seed) * (soak->num_samples + 1) / \
+        ((uint64_t)RAND_MAX + 1));
+
+    if (slot < NUM_SAMPLES) {
+        soak->samples[slot] = elapsed_s(&start) * 1e6;
+    }
+
+    soak->num_samples++;
+    count(soak, ret, &soak->sets);
+
+    return ret;
+}
+
+// Hammer a channel of its own with random requests, signals, enables,
+// disables and frees:
+static void *stress_thread(void *arg) {
+    // Definitions:
+    struct stress *st = arg;
+    struct soak *soak = st->soak;
+
+    int channel = -1;
+    int op;
+    int num_gpio;
+    double next_s = 0;
+
+    while (soak->running) {
+        pthread_mutex_lock(&soak->lock);
+
+        op = rand_r(&st->seed) % 16;
+
+        if (channel < 0) {
+            if ((channel = request_pwm()) >= 0) {
+                soak->requests++;
+            } else {
+                count(soak, channel, &soak->requests);
+            }
+        } else if (op < 10) {
+            // Random signal on a random number of the GPIOs:
+            num_gpio = 1 + (rand_r(&st->seed) % st->num_gpio);
+            timed_set(soak, channel, st->gpio, num_gpio, \
+                100 + (rand_r(&st->seed) % 20000), \
+                rand_r(&st->seed) % 101);
+        } else if (op < 13) {
+            count(soak, enable_pwm(channel), &soak->enables);
+        } else if (op < 15) {
+            count(soak, disable_pwm(channel), &soak->disables);
+        } else {
+            count(soak, free_pwm(channel), &soak->frees);
+            channel = -1;
+        }
+
+        pthread_mutex_unlock(&soak->lock);
+
+        pace(st->rate, &next_s, &soak->start);
+    }
+
+    if (channel >= 0) {
+        pthread_mutex_lock(&soak->lock);
+        free_pwm(channel);
+        pthread_mutex_unlock(&soak->lock);
+    }
+
+    return NULL;
+}
+
+// Set the monitored output and log its configuration (lock held):
+static int set_monitor(struct soak *soak, float freq, float duty) {
+    // Definitions:
+    int ret;
+    double start_us;
+
+    struct config *config;
+
+    start_us = elapsed_s(&soak->start) * 1e6;
+
+    if ((ret = timed_set(soak, soak->lb.out_channel, &soak->lb.out_gpio, 1, \
+        freq, duty)) < 0) {
+        // Exit with error:
+        return ret;
+    }
+
+    config = &soak->configs[soak->num_configs % NUM_CONFIGS];
+    config->start_us = start_us;
+    config->period_us = 1e6 / get_freq_pwm(soak->lb.out_channel);
+    config->high_us = config->period_us * \
+        get_duty_cycle_pwm(soak->lb.out_channel) / 100;
+    soak->num_configs++;
+
+    // Exit with no errors:
+    return 0;
+}
+
+// Update the monitored output with random configurations:
+static void *monitor_update_thread(void *arg) {
+    // Definitions:
+    struct stress *st = arg;
+    struct soak *soak = st->soak;
+
+    double next_s = 0;
+    float freq;
+    float duty;
+
+    while (soak->running) {
+        freq = monitor_freqs[rand_r(&st->seed) % \
+            (sizeof(monitor_freqs) / sizeof(monitor_freqs[0]))];
+        duty = 10 + (rand_r(&st->seed) % 81);
+
+        pthread_mutex_lock(&soak->lock);
+        set_monitor(soak, freq, duty);
+        pthread_mutex_unlock(&soak->lock);
+
+        pace(st->rate, &next_s, &soak->start);
+    }
+
+    return NULL;
+}
+
+// Classify a monitored period against the configurations that may have
+// been output during it (lock held). Capture and wall time drift apart over
+// hours, so the period is placed by the wall time of the poll before its
+// rising edge was read:
+static void check_period(struct soak *soak, double from_us, double period_us, \
+    double high_us) {
+    // Definitions:
+    uint64_t i;
+    uint64_t first;
+    double slack_us;
+    double end_us = INFINITY;
+    double tol_us = MATCH_TICKS * soak->lb.tick_us;
+    double min_high = INFINITY;
+    double min_low = INFINITY;
+    double max_period = 0;
+
+    struct config *config;
+
+    soak->periods++;
+
+    // Updates take effect at the end of the period being output and may
+    // queue behind others in the buffer ring:
+    slack_us = 2 * STUCK_PERIODS * 1e6 / monitor_freqs[0];
+
+    first = (soak->num_configs > NUM_CONFIGS) ? \
+        (soak->num_configs - NUM_CONFIGS) : 0;
+
+    for (i = soak->num_configs; i-- > first;) {
+        config = &soak->configs[i % NUM_CONFIGS];
+
+        // Replaced before the period:
+        if ((end_us + slack_us) < from_us) {
+            break;
+        }
+
+        // Matches:
+        if ((fabs(period_us - config->period_us) <= \
+            (tol_us + MATCH_ERROR * config->period_us)) && \
+            (fabs(high_us - config->high_us) <= \
+            (tol_us + MATCH_ERROR * config->period_us))) {
+            return;
+        }
+
+        min_high = fmin(min_high, config->high_us);
+        min_low = fmin(min_low, config->period_us - config->high_us);
+        max_period = fmax(max_period, config->period_us);
+
+        end_us = config->start_us;
+    }
+
+    // Classify:
+    if ((high_us < (min_high - tol_us)) || \
+        ((period_us - high_us) < (min_low - tol_us))) {
+        soak->runts++;
+    } else if (period_us > (max_period + tol_us)) {
+        soak->missed++;
+    } else {
+        soak->other++;
+    }
+}
+
+// Check the captured monitored output for glitches:
+static void *monitor_capture_thread(void *arg) {
+    // Definitions:
+    struct soak *soak = arg;
+
+    int i;
+    int num_edges;
+    int rise_valid = 0;
+    int fall_valid = 0;
+    int started = 0;
+    double rise_from_us = 0;
+    double last_poll_us;
+    double last_edge_us;
+    double now_us;
+    uint64_t last_rise = 0;
+    uint64_t last_fall = 0;
+
+    struct capture_pwm capture;
+    struct edge_pwm edges[READ_EDGES];
+    struct timespec poll = {.tv_sec = 0, .tv_nsec = POLL_NS};
+
+    last_poll_us = last_edge_us = elapsed_s(&soak->start) * 1e6;
+
+    while (soak->running) {
+        pthread_mutex_lock(&soak->lock);
+
+        now_us = elapsed_s(&soak->start) * 1e6;
+
+        // Lost samples break the pairing and hide edges:
+        if ((get_capture_pwm(soak->lb.in_channel, soak->lb.in_gpio, \
+            &capture) == 0) && capture.overrun) {
+            soak->overrun++;
+            last_edge_us = now_us;
+            rise_valid = 0;
+        }
+
+        num_edges = read_capture_pwm(soak->lb.in_channel, edges, READ_EDGES);
+
+        for (i = 0; i < num_edges; i++) {
+            if (edges[i].gpio != soak->lb.in_gpio) {
+                continue;
+            }
+
+            last_edge_us = now_us;
+
+            if (!edges[i].level) {
+                last_fall = edges[i].tick;
+                fall_valid = rise_valid;
+                continue;
+            }
+
+            // Rising edge closes a period (the first is short by the PWM
+            // FIFO depth as the DMA fills the FIFO after enabling):
+            if (rise_valid && fall_valid && started++) {
+                check_period(soak, rise_from_us, \
+                    (edges[i].tick - last_rise) * (double)soak->lb.tick_us, \
+                    (last_fall - last_rise) * (double)soak->lb.tick_us);
+            }
+
+            last_rise = edges[i].tick;
+            rise_from_us = last_poll_us;
+            rise_valid = 1;
+            fall_valid = 0;
+        }
+
+        // Stuck if there were no edges for several of the longest periods:
+        if ((now_us - last_edge_us) > (STUCK_PERIODS * 1e6 / \
+            monitor_freqs[0])) {
+            soak->stuck++;
+            last_edge_us = now_us;
+            rise_valid = 0;
+        }
+
+        last_poll_us = now_us;
+
+        pthread_mutex_unlock(&soak->lock);
+
+        if (num_edges < READ_EDGES) {
+            nanosleep(&poll, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+// Compare latencies for sorting:
+static int compare_latency(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Print the totals so far as a single JSON line (lock held):
+static void print_report(struct soak *soak, int threads, double *sorted) {
+    // Definitions:
+    size_t n;
+    double elapsed;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+
+    elapsed = elapsed_s(&soak->start);
+
+    // Latency percentiles of the samples:
+    n = (soak->num_samples < NUM_SAMPLES) ? soak->num_samples : NUM_SAMPLES;
+
+    if (n) {
+        memcpy(sorted, soak->samples, n * sizeof(*sorted));
+        qsort(sorted, n, sizeof(*sorted), compare_latency);
+        p50 = sorted[(n - 1) * 50 / 100];
+        p90 = sorted[(n - 1) * 90 / 100];
+        p99 = sorted[(n - 1) * 99 / 100];
+        max = sorted[n - 1];
+    }
+
+    printf("{\"elapsed_s\":%.1f,\"threads\":%d,", elapsed, threads);
+    printf("\"updates\":%llu,\"updates_per_s\":%.1f,", \
+        (unsigned long long)soak->sets, soak->sets / elapsed);
+    printf("\"ops\":{\"set\":%llu,\"enable\":%llu,\"disable\":%llu,", \
+        (unsigned long long)soak->sets, (unsigned long long)soak->enables, \
+        (unsigned long long)soak->disables);
+    printf("\"request\":%llu,\"free\":%llu},", \
+        (unsigned long long)soak->requests, (unsigned long long)soak->frees);
+    printf("\"rejected\":%llu,\"errors\":%llu,", \
+        (unsigned long long)soak->rejected, (unsigned long long)soak->errors);
+    printf("\"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,", \
+        p50, p90, p99);
+    printf("\"max\":%.1f},\"periods\":%llu,", max, \
+        (unsigned long long)soak->periods);
+    printf("\"glitches\":{\"runt\":%llu,\"missed\":%llu,\"stuck\":%llu,", \
+        (unsigned long long)soak->runts, (unsigned long long)soak->missed, \
+        (unsigned long long)soak->stuck);
+    printf("\"other\":%llu},\"overrun\":%llu}\n", \
+        (unsigned long long)soak->other, (unsigned long long)soak->overrun);
+    fflush(stdout);
+}
+
+// Print usage:
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -t <threads>: Stress threads, 0-%d (default %d)\n", \
+        MAX_STRESS, MAX_STRESS);
+    fprintf(stderr, "  -d <s>: Duration (default 60)\n");
+    fprintf(stderr, "  -I <s>: Report interval (default 10)\n");
+    fprintf(stderr, "  -r <ops/s>: Operations per second per stress thread, "
+        "0 for "
+        "unlimited (default 100)\n");
+    fprintf(stderr, "  -u <updates/s>: Monitored output updates per second, "
+        "0 for unlimited (default 100)\n");
+    fprintf(stderr, "  -S <seed>: Random seed (default time)\n");
+    fprintf(stderr, "  -o <gpio>: Monitored output GPIO (default 26)\n");
+    fprintf(stderr, "  -i <gpio>: Capture GPIO, jumpered to the output or "
+        "equal to it (default 19)\n");
+    fprintf(stderr, "  -g <gpio>[,<gpio>...]: Stress GPIOs, shared out "
+        "between threads (default 5,6,22,23,24,25,27)\n");
+    fprintf(stderr, "  -w <us>: Pulse width (default %d)\n", \
+        DEFAULT_PULSE_WIDTH);
+    fprintf(stderr, "  -p <pages>: Pages per channel (default %d)\n", \
+        SOAK_PAGES);
+    fprintf(stderr, "  -b <bufs>: CB buffers per channel (default %d)\n", \
+        DEFAULT_RING_BUFS);
+    fprintf(stderr, "One JSON report is printed per interval and at the "
+        "end\n");
+}
+
+// Stress and soak test with glitch detection:
+int main(int argc, char **argv) {
+    // Definitions:
+    int opt;
+    int ret;
+    int i;
+    int threads = MAX_STRESS;
+    int out_gpio = 26;
+    int in_gpio = 19;
+    int pages = SOAK_PAGES;
+    int ring = DEFAULT_RING_BUFS;
+    int num_gpio = 0;
+    int gpio[MAX_GPIOS];
+    unsigned int seed = time(NULL);
+    float pulse_width = DEFAULT_PULSE_WIDTH;
+    float rate = 100;
+    float monitor_rate = 100;
+    double duration_s = 60;
+    double interval_s = 10;
+    double next_s;
+    double *sorted;
+    char *token;
+
+    struct soak *soak;
+    struct stress st[MAX_STRESS + 1];
+    pthread_t stress_id[MAX_STRESS + 1];
+    pthread_t capture_id;
+    struct timespec tick = {.tv_sec = 0, .tv_nsec = 100000000};
+
+    // Parse options:
+    while ((opt = getopt(argc, argv, "t:d:I:r:u:S:o:i:g:w:p:b:h")) != -1) {
+        switch (opt) {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atof(optarg);
+            break;
+        case 'I':
+            interval_s = atof(optarg);
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'u':
+            monitor_rate = atof(optarg);
+            break;
+        case 'S':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            out_gpio = atoi(optarg);
+            break;
+        case 'i':
+            in_gpio = atoi(optarg);
+            break;
+        case 'g':
+            for (token = strtok(optarg, ","); token; \
+                token = strtok(NULL, ",")) {
+                if (num_gpio == MAX_GPIOS) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                gpio[num_gpio++] = atoi(token);
+            }
+            break;
+        case 'w':
+            pulse_width = atof(optarg);
+            break;
+        case 'p':
+            pages = atoi(optarg);
+            break;
+        case 'b':
+            ring = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : -1;
+        }
+    }
+
+    if ((threads < 0) || (threads > MAX_STRESS) || (interval_s <= 0)) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // Default stress GPIOs:
+    if (num_gpio == 0) {
+        gpio[num_gpio++] = 5;
+        gpio[num_gpio++] = 6;
+        gpio[num_gpio++] = 22;
+        gpio[num_gpio++] = 23;
+        gpio[num_gpio++] = 24;
+        gpio[num_gpio++] = 25;
+        gpio[num_gpio++] = 27;
+    }
+
+    // Every thread needs a GPIO of its own:
+    if (num_gpio < threads) {
+        fprintf(stderr, "Need at least one stress GPIO per thread\n");
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Configure:
+    if ((config_pwm(pages, pulse_width) != 0) || \
+        (config_ring_pwm(ring) != 0)) {
+        fprintf(stderr, "Could not configure dma_pwm.c\n");
+
+        // Exit with error:
+        return -1;
+    }
+
+    if (((soak = calloc(1, sizeof(*soak))) == NULL) || \
+        ((sorted = malloc(NUM_SAMPLES * sizeof(*sorted))) == NULL)) {
+        fprintf(stderr, "Out of memory\n");
+
+        // Exit with error:
+        return -1;
+    }
+
+    pthread_mutex_init(&soak->lock, NULL);
+    soak->running = 1;
+    soak->sample_seed = seed;
+    clock_gettime(CLOCK_MONOTONIC, &soak->start);
+
+    if ((ret = loopback_open(&soak->lb, out_gpio, in_gpio, \
+        DEFAULT_CAPTURE_WINDOW)) < 0) {
+        fprintf(stderr, "Could not set up loopback (%d)\n", ret);
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Start the monitored output:
+    if (((ret = set_monitor(soak, monitor_freqs[0], 50)) < 0) || \
+        ((ret = enable_pwm(soak->lb.out_channel)) < 0)) {
+        fprintf(stderr, "Could not start the monitored output (%d)\n", ret);
+        loopback_close(&soak->lb);
+
+        // Exit with error:
+        return -1;
+    }
+
+    // Share the stress GPIOs out between the threads:
+    memset(st, 0, sizeof(st));
+
+    for (i = 0; i <= threads; i++) {
+        st[i].soak = soak;
+        st[i].rate = i ? rate : monitor_rate;
+        st[i].seed = seed + i;
+    }
+
+    for (i = 0; (i < num_gpio) && threads; i++) {
+        st[1 + (i % threads)].gpio[st[1 + (i % threads)].num_gpio++] = \
+            gpio[i];
+    }
+
+    // Start threads (the first updates the monitored output):
+    pthread_create(&capture_id, NULL, monitor_capture_thread, soak);
+    pthread_create(&stress_id[0], NULL, monitor_update_thread, &st[0]);
+
+    for (i = 1; i <= threads; i++) {
+        pthread_create(&stress_id[i], NULL, stress_thread, &st[i]);
+    }
+
+    // Report each interval until done:
+    next_s = interval_s;
+
+    while (elapsed_s(&soak->start) < duration_s) {
+        nanosleep(&tick, NULL);
+
+        if ((elapsed_s(&soak->start) >= next_s) && \
+            (next_s < duration_s)) {
+            pthread_mutex_lock(&soak->lock);
+            print_report(soak, threads, sorted);
+            pthread_mutex_unlock(&soak->lock);
+            next_s += interval_s;
+        }
+    }
+
+    // Stop threads:
+    soak->running = 0;
+    pthread_join(capture_id, NULL);
+
+    for (i = 0; i <= threads; i++) {
+        pthread_join(stress_id[i], NULL);
+    }
+
+    print_report(soak, threads, sorted);
+
+    ret = (soak->runts || soak->missed || soak->stuck || soak->other || \
+        soak->errors) ? 1 : 0;
+
+    loopback_close(&soak->lb);
+    pthread_mutex_destroy(&soak->lock);
+    free(sorted);
+    free(soak);
+
+    // Exit:
+    return ret;
+}